@@ -25,6 +25,7 @@
 #include <stdint.h>
 
 #include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
 
 /*! possibe termination types
  *
@@ -131,6 +132,26 @@ int osmo_conv_decode_get_output(struct osmo_conv_decoder *decoder,
 	/* All-in-one */
 int osmo_conv_decode(const struct osmo_conv_code *code,
                      const sbit_t *input, ubit_t *output);
+int osmo_conv_decode_batch(const struct osmo_conv_code *code,
+                           const sbit_t * const *input, ubit_t **output,
+                           unsigned int num);
+
+/*! Viterbi kernels used by \ref osmo_conv_decode_batch */
+enum osmo_conv_batch_kernel {
+	OSMO_CONV_BATCH_SCALAR,	/*!< one codeword after the other */
+	OSMO_CONV_BATCH_AVX2,	/*!< 16 codewords per pass (AVX2) */
+	OSMO_CONV_BATCH_AVX512,	/*!< 32 codewords per pass (AVX-512BW) */
+};
+
+extern const struct value_string osmo_conv_batch_kernel_names[];
+static inline const char *osmo_conv_batch_kernel_name(enum osmo_conv_batch_kernel kernel)
+{
+	return get_value_string(osmo_conv_batch_kernel_names, kernel);
+}
+
+int osmo_conv_batch_kernel_supported(enum osmo_conv_batch_kernel kernel);
+int osmo_conv_batch_set_kernel(enum osmo_conv_batch_kernel kernel);
+enum osmo_conv_batch_kernel osmo_conv_batch_get_kernel(void);
 
 
 /*! @} */
@@ -34,6 +34,15 @@ struct osmo_crcXXgen_code {
 	uintXX_t remainder; /*!< Remainder of the CRC (final XOR) */
 };
 
+/*! structure holding the precomputed tables of a CRC code, used to compute
+ *  the CRC of packed bits a byte at a time, see osmo_crcXXgen_table_init() */
+struct osmo_crcXXgen_table {
+	const struct osmo_crcXXgen_code *code; /*!< Code the tables are for */
+	uintXX_t tab[256];  /*!< State update for each input byte (state MSB-aligned) */
+	uint64_t clmul_mu;  /*!< floor(x^(64+bits) / poly) without x^64, for Barrett reduction */
+	int clmul;          /*!< Use carry-less multiplication (set if the CPU has it) */
+};
+
 uintXX_t osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
                                     const ubit_t *in, int len);
 int osmo_crcXXgen_check_bits(const struct osmo_crcXXgen_code *code,
@@ -41,6 +50,17 @@ int osmo_crcXXgen_check_bits(const struct osmo_crcXXgen_code *code,
 void osmo_crcXXgen_set_bits(const struct osmo_crcXXgen_code *code,
                             const ubit_t *in, int len, ubit_t *crc_bits);
 
+void osmo_crcXXgen_table_init(struct osmo_crcXXgen_table *table,
+                              const struct osmo_crcXXgen_code *code);
+uintXX_t osmo_crcXXgen_compute_pbits(const struct osmo_crcXXgen_table *table,
+                                     const pbit_t *in, int len, int lsb_mode);
+int osmo_crcXXgen_check_pbits(const struct osmo_crcXXgen_table *table,
+                              const pbit_t *in, int len, int lsb_mode,
+                              const ubit_t *crc_bits);
+void osmo_crcXXgen_set_pbits(const struct osmo_crcXXgen_table *table,
+                             const pbit_t *in, int len, int lsb_mode,
+                             ubit_t *crc_bits);
+
 
 /*! @} */
 
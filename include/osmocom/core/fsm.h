@@ -17,6 +17,9 @@
  * \file fsm.h */
 
 struct osmo_fsm_inst;
+struct osmo_fsm_inst_index;
+struct osmo_fsm_inst_cache;
+struct osmo_fsm_stats;
 
 enum osmo_fsm_term_cause {
 	/*! terminate because parent terminated */
@@ -81,6 +84,17 @@ struct osmo_fsm {
 	const struct value_string *event_names;
 	/*! graceful exit function, called at the beginning of termination */
 	void (*pre_term)(struct osmo_fsm_inst *fi, enum osmo_fsm_term_cause cause);
+	/*! member in the hash table of registered FSMs by name */
+	struct hlist_node node_by_name;
+	/*! hash index of the instances by id and name, see osmo_fsm_set_inst_index() */
+	struct osmo_fsm_inst_index *inst_index;
+	/*! free instances kept for re-use, see osmo_fsm_set_inst_cache() */
+	struct osmo_fsm_inst_cache *inst_cache;
+	/*! if true, events dispatched to instances of this FSM are queued and processed later, see
+	 *  _osmo_fsm_inst_dispatch() */
+	bool queue_events;
+	/*! statistics of the states and events, see osmo_fsm_set_stats() */
+	struct osmo_fsm_stats *stats;
 };
 
 /*! a single instanceof an osmocom finite state machine */
@@ -118,6 +132,16 @@ struct osmo_fsm_inst {
 		/*! Indicator whether osmo_fsm_inst_term() was already invoked on this instance. */
 		bool terminating;
 	} proc;
+
+	/*! member in fsm->inst_index by id, if the index is enabled and the id is set */
+	struct hlist_node node_by_id;
+	/*! member in fsm->inst_index by name, if the index is enabled */
+	struct hlist_node node_by_name;
+	/*! storage of id and name (in this order), unless they are too long and allocated separately */
+	char id_name_buf[128];
+	/*! monotonic time in nanoseconds at which the current state was entered, if statistics are enabled for the
+	 *  FSM (see osmo_fsm_set_stats()), 0 otherwise */
+	uint64_t state_entered_ns;
 };
 
 void osmo_fsm_log_addr(bool log_addr);
@@ -209,6 +233,39 @@ struct osmo_fsm_inst *osmo_fsm_inst_find_by_name(const struct osmo_fsm *fsm,
 						 const char *name);
 struct osmo_fsm_inst *osmo_fsm_inst_find_by_id(const struct osmo_fsm *fsm,
 						const char *id);
+int osmo_fsm_set_inst_index(struct osmo_fsm *fsm, bool enable);
+int osmo_fsm_set_inst_cache(struct osmo_fsm *fsm, unsigned int max_cached);
+
+/*! Number of buckets of a struct osmo_fsm_hist. Bucket 0 counts durations of less than 1 nanosecond, bucket n counts
+ *  durations of at least 2^(n-1) and less than 2^n nanoseconds, the last bucket also counts all longer durations. */
+#define OSMO_FSM_HIST_BUCKETS 48
+
+/*! histogram of durations, see osmo_fsm_set_stats() */
+struct osmo_fsm_hist {
+	/*! number of recorded durations */
+	uint64_t count;
+	/*! sum of all recorded durations in nanoseconds */
+	uint64_t sum_ns;
+	/*! longest recorded duration in nanoseconds */
+	uint64_t max_ns;
+	/*! number of recorded durations by their magnitude, see OSMO_FSM_HIST_BUCKETS */
+	uint64_t buckets[OSMO_FSM_HIST_BUCKETS];
+};
+
+/*! statistics of one state of an FSM, see osmo_fsm_set_stats() */
+struct osmo_fsm_state_stats {
+	/*! time spent in this state, recorded when an instance leaves the state or is freed */
+	struct osmo_fsm_hist residency;
+	/*! CPU time spent in the action or allstate_action for the events dispatched in this state */
+	struct osmo_fsm_hist action;
+	/*! number of events dispatched in this state, by event */
+	uint64_t events[32];
+	/*! number of events dispatched in this state that were not permitted */
+	uint64_t rejected;
+};
+
+int osmo_fsm_set_stats(struct osmo_fsm *fsm, bool enable);
+const struct osmo_fsm_state_stats *osmo_fsm_state_stats(const struct osmo_fsm *fsm, uint32_t state);
 struct osmo_fsm_inst *osmo_fsm_inst_alloc(struct osmo_fsm *fsm, void *ctx, void *priv,
 					  int log_level, const char *id);
 struct osmo_fsm_inst *osmo_fsm_inst_alloc_child(struct osmo_fsm *fsm,
@@ -301,6 +358,25 @@ int _osmo_fsm_inst_state_chg_keep_or_start_timer_ms(struct osmo_fsm_inst *fi, ui
 int _osmo_fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data,
 			    const char *file, int line);
 
+/*! statistics of the per-thread FSM event queue, see osmo_fsm_event_queue_stats() */
+struct osmo_fsm_event_queue_stats {
+	/*! number of events currently queued */
+	unsigned int len;
+	/*! maximum number of events that were queued at the same time */
+	unsigned int max_len;
+	/*! number of events dispatched from the queue */
+	uint64_t dispatched;
+	/*! number of events dropped, because their FSM instance was freed before they were dispatched */
+	uint64_t dropped;
+	/*! sum of the time the dispatched events spent in the queue, in nanoseconds */
+	uint64_t wait_ns_total;
+	/*! maximum time an event spent in the queue, in nanoseconds */
+	uint64_t wait_ns_max;
+};
+
+int osmo_fsm_event_queue_run(void);
+const struct osmo_fsm_event_queue_stats *osmo_fsm_event_queue_stats(void);
+
 /*! Terminate FSM instance with given cause
  *
  *  This is a macro that calls _osmo_fsm_inst_term() with the given parameters
@@ -8,11 +8,16 @@
  *  @{
  *  \file osmo_it_q.h */
 
+struct osmo_it_q_ring;
+
 /*! One instance of an inter-thread queue.  The user can use this to queue messages
  *  between different threads.  The enqueue operation is non-blocking (but of course
  *  grabs a mutex for the actual list operations to safeguard against races).  The
  *  receiving thread is woken up by an event_fd which can be registered in the libosmocore
- *  select loop handling. */
+ *  select loop handling.
+ *
+ *  A queue allocated by osmo_it_q_alloc_mpsc() instead uses a bounded lock-free ring, which
+ *  any number of threads may enqueue to but only one thread may dequeue from. */
 struct osmo_it_q {
 	/* entry in global list of message queues */
 	struct llist_head entry;
@@ -34,6 +39,10 @@ struct osmo_it_q {
 	void (*read_cb)(struct osmo_it_q *q, struct llist_head *item);
 	/* opaque data pointer passed through to call-back function */
 	void *data;
+
+	/* lock-free ring of an osmo_it_q_alloc_mpsc() queue; NULL for the mutex-protected list.
+	 * current_length is not maintained for such queues. */
+	struct osmo_it_q_ring *ring;
 };
 
 struct osmo_it_q *osmo_it_q_by_name(const char *name);
@@ -51,9 +60,13 @@ struct llist_head *_osmo_it_q_dequeue(struct osmo_it_q *queue);
 		*item = llist_entry(l, typeof(**item), member);		\
 } while (0)
 
+unsigned int osmo_it_q_dequeue_batch(struct osmo_it_q *queue, struct llist_head *items, unsigned int max_items);
 
 struct osmo_it_q *osmo_it_q_alloc(void *ctx, const char *name, unsigned int max_length,
 
+					void (*read_cb)(struct osmo_it_q *q, struct llist_head *item),
+					void *data);
+struct osmo_it_q *osmo_it_q_alloc_mpsc(void *ctx, const char *name, unsigned int max_length,
 					void (*read_cb)(struct osmo_it_q *q, struct llist_head *item),
 					void *data);
 void osmo_it_q_destroy(struct osmo_it_q *q);
@@ -281,6 +281,7 @@ enum log_target_type {
 	LOG_TGT_TYPE_STRRB,	/*!< osmo_strrb-backed logging */
 	LOG_TGT_TYPE_GSMTAP,	/*!< GSMTAP network logging */
 	LOG_TGT_TYPE_SYSTEMD,	/*!< systemd journal logging */
+	LOG_TGT_TYPE_BINARY,	/*!< binary logging, see logging_binary.h */
 };
 
 /*! Whether/how to log the source filename (and line number). */
@@ -357,6 +358,12 @@ struct log_target {
 		struct {
 			bool raw;
 		} sd_journal;
+
+		struct {
+			const char *fname;
+			size_t size;
+			void *priv;
+		} tgt_binary;
 	};
 
 	/*! call-back function to be called when the logging framework
@@ -455,6 +462,26 @@ struct log_target *log_target_find(enum log_target_type type, const char *fname)
 
 void log_enable_multithread(void);
 
+/*! What an asynchronously logging thread does when its ring is full */
+enum log_async_overflow {
+	LOG_ASYNC_OVERFLOW_DROP,	/*!< drop the message and count it */
+	LOG_ASYNC_OVERFLOW_DROP_LOW,	/*!< drop INFO and DEBUG, wait for room for NOTICE and above */
+	LOG_ASYNC_OVERFLOW_BLOCK,	/*!< wait for the writer thread to make room */
+};
+
+/*! Counters of asynchronous logging, summed over all threads */
+struct log_async_stats {
+	uint64_t enqueued;	/*!< messages handed to the writer thread */
+	uint64_t dropped;	/*!< messages dropped because a ring was full */
+	uint64_t waited;	/*!< times a thread had to wait for room in its ring */
+};
+
+int log_async_start(size_t ring_size, enum log_async_overflow overflow);
+void log_async_stop(void);
+void log_async_flush(void);
+bool log_async_is_running(void);
+void log_async_get_stats(struct log_async_stats *stats);
+
 void log_tgt_mutex_lock_impl(void);
 void log_tgt_mutex_unlock_impl(void);
 #define LOG_MTX_DEBUG 0
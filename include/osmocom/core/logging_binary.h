@@ -0,0 +1,91 @@
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#pragma once
+
+/*! \defgroup logging_binary Osmocom binary (deferred formatting) logging
+ *  @{
+ * \file logging_binary.h */
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct log_target;
+
+/*! Magic at the start of a binary log file */
+#define LOG_BINARY_MAGIC	"OSMOBLOG"
+/*! Version of the binary log file layout */
+#define LOG_BINARY_VERSION	1
+/*! Value of log_binary_hdr.byte_order, in the byte order of the writer */
+#define LOG_BINARY_BYTE_ORDER	0x01020304
+/*! Dictionary id of 'no string', see struct log_binary_rec */
+#define LOG_BINARY_ID_NONE	0
+
+/*! Header at offset 0 of a binary log file.
+ *  The file consists of this header, a dictionary of strings (format
+ *  strings, source file names, category names), which is only ever
+ *  appended to, and a ring of struct log_binary_rec. All numbers are in the
+ *  byte order of the writer. */
+struct log_binary_hdr {
+	char magic[8];		/*!< LOG_BINARY_MAGIC, not NUL terminated */
+	uint32_t version;	/*!< LOG_BINARY_VERSION */
+	uint32_t byte_order;	/*!< LOG_BINARY_BYTE_ORDER */
+	uint64_t dict_off;	/*!< file offset of the dictionary */
+	uint64_t dict_size;	/*!< size of the dictionary area */
+	uint64_t dict_used;	/*!< bytes of the dictionary in use */
+	uint64_t ring_off;	/*!< file offset of the record ring */
+	uint64_t ring_size;	/*!< size of the record ring, a power of two */
+	uint64_t head;		/*!< number of ring bytes ever written */
+	uint64_t tail;		/*!< ring position of the oldest record; tail <= head */
+};
+
+/*! Kind of a dictionary string */
+enum log_binary_str_kind {
+	LOG_BINARY_STR_ID,	/*!< format string or source file name, by dictionary id */
+	LOG_BINARY_STR_CAT,	/*!< category name, id is the category number */
+};
+
+/*! Entry of the dictionary, padded to a multiple of 8 bytes */
+struct log_binary_str {
+	uint32_t id;		/*!< dictionary id (LOG_BINARY_STR_ID), category (LOG_BINARY_STR_CAT) */
+	uint16_t kind;		/*!< enum log_binary_str_kind */
+	uint16_t len;		/*!< string length, without the terminating NUL */
+	char str[0];		/*!< NUL terminated string */
+};
+
+/*! Log record in the ring, padded to a multiple of 8 bytes.
+ *  A record never wraps around the end of the ring: a 'len' of 0 marks the
+ *  unused end of the ring, the next record starts at ring offset 0. */
+struct log_binary_rec {
+	uint16_t len;		/*!< length of the record including this header */
+	uint8_t level;		/*!< log level */
+	uint8_t cont;		/*!< continuation of the previous message */
+	uint16_t subsys;	/*!< (mapped) logging sub-system */
+	uint16_t args_len;	/*!< length of the arguments */
+	uint32_t fmt_id;	/*!< dictionary id of the format string; LOG_BINARY_ID_NONE: "%s" */
+	uint32_t file_id;	/*!< dictionary id of the source file name; LOG_BINARY_ID_NONE if unknown */
+	uint32_t line;		/*!< source line number */
+	uint32_t tid;		/*!< thread id of the logging thread */
+	int64_t time_us;	/*!< time of the log statement, microseconds since the epoch */
+	uint8_t args[0];	/*!< arguments, see log_binary_render() */
+};
+
+struct log_target *log_target_create_binary(const char *fname, size_t size);
+int log_binary_render(char *buf, size_t buf_len, const char *fmt,
+		      const uint8_t *args, size_t args_len);
+
+/*! @} */
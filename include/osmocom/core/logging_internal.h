@@ -4,6 +4,10 @@
  *  @{
  * \file logging_internal.h */
 
+#include <stdarg.h>
+#include <stdbool.h>
+#include <sys/time.h>
+
 #include <osmocom/core/utils.h>
 
 extern void *tall_log_ctx;
@@ -13,4 +17,23 @@ extern struct llist_head osmo_log_target_list;
 
 void assert_loginfo(const char *src);
 
+struct log_context;
+
+/*! Where and when a log statement was issued, if it is output later */
+struct log_origin {
+	struct timeval tv;	/*!< time of the log statement */
+	long tid;		/*!< thread id of the logging thread */
+};
+
+void log_output_recorded(int subsys, int level, const char *file, int line, int cont,
+			 const struct log_context *ctx, const struct log_origin *origin,
+			 const char *msg);
+int log_map_subsys(int subsys);
+const struct log_origin *log_current_origin(void);
+bool log_tgt_mutex_held(void);
+
+extern bool log_async_running;
+int log_async_vlogp(int subsys, int level, const char *file, int line, int cont,
+		    const struct log_context *ctx, const char *format, va_list ap);
+
 /*! @} */
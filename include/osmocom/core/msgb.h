@@ -742,6 +742,23 @@ bool _msgb_eq(const char *file, size_t line, const char *func, uint8_t level,
 uint8_t *msgb_data(const struct msgb *msg);
 
 void *msgb_talloc_ctx_init(void *root_ctx, unsigned int pool_size);
+
+/*! Maximum number of size classes of a msgb pool, see msgb_pool_init() */
+#define MSGB_POOL_MAX_CLASSES	16
+
+/*! Counters of the "msgb:pool" rate counter group */
+enum msgb_pool_ctr {
+	MSGB_POOL_CTR_ALLOC_HIT,	/*!< allocation served from a free list */
+	MSGB_POOL_CTR_ALLOC_MISS,	/*!< allocation of a new msgb of a size class */
+	MSGB_POOL_CTR_FREE_CACHED,	/*!< msgb put into a free list */
+	MSGB_POOL_CTR_FREE_RELEASED,	/*!< msgb released, as the free list was full */
+};
+
+struct rate_ctr_group;
+int msgb_pool_init(void *ctx, const uint16_t *sizes, unsigned int num_sizes, unsigned int max_cached,
+		   unsigned int ctrg_idx);
+void msgb_pool_destroy(void);
+struct rate_ctr_group *msgb_pool_get_ctrg(void);
 void msgb_set_talloc_ctx(void *ctx) OSMO_DEPRECATED("Use msgb_talloc_ctx_init() instead");
 int msgb_printf(struct msgb *msgb, const char *format, ...);
 
@@ -59,6 +59,9 @@
 
 struct osmo_io_fd;
 
+/*! maximum number of datagrams handled per system call, see osmo_iofd_set_batch_size() */
+#define OSMO_IO_BATCH_SIZE_MAX 64
+
 /*! The _mode_ of an osmo_io_fd determines if read/write, recvfrom/sendmsg or recvmsg/sendmsg semantics are
  * used. */
 enum osmo_io_fd_mode {
@@ -204,6 +207,7 @@ void osmo_iofd_init(void);
 struct osmo_io_fd *osmo_iofd_setup(const void *ctx, int fd, const char *name,
 		  enum osmo_io_fd_mode mode, const struct osmo_io_ops *ioops, void *data);
 int osmo_iofd_set_cmsg_size(struct osmo_io_fd *iofd, size_t cmsg_size);
+int osmo_iofd_set_batch_size(struct osmo_io_fd *iofd, unsigned int batch_size);
 int osmo_iofd_register(struct osmo_io_fd *iofd, int fd);
 int osmo_iofd_unregister(struct osmo_io_fd *iofd);
 unsigned int osmo_iofd_txqueue_len(struct osmo_io_fd *iofd);
@@ -53,6 +53,8 @@ struct rate_ctr_group_desc {
 	const struct rate_ctr_desc *ctr_desc;
 };
 
+struct rate_ctr_shards;
+
 /*! One instance of a counter group class */
 struct rate_ctr_group {
 	/*! Linked list of all counter groups in the system */
@@ -63,6 +65,8 @@ struct rate_ctr_group {
 	unsigned int idx;
 	/*! Optional string-based identifier to be used instead of index at report time */
 	char *name;
+	/*! Per-thread counter slots if allocated by rate_ctr_group_alloc_sharded(), NULL otherwise */
+	struct rate_ctr_shards *shards;
 	/*! Actual counter structures below. Don't access it directly, use APIs below! */
 	struct rate_ctr ctr[0];
 };
@@ -70,6 +74,10 @@ struct rate_ctr_group {
 struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 					    const struct rate_ctr_group_desc *desc,
 					    unsigned int idx);
+struct rate_ctr_group *rate_ctr_group_alloc_sharded(void *ctx,
+						    const struct rate_ctr_group_desc *desc,
+						    unsigned int idx, unsigned int num_shards);
+void rate_ctr_group_sync(struct rate_ctr_group *grp);
 
 static inline void rate_ctr_group_upd_idx(struct rate_ctr_group *grp, unsigned int idx)
 {
@@ -86,13 +94,19 @@ void rate_ctr_group_free(struct rate_ctr_group *grp);
  *  \param inc quantity to increment \a ctr by */
 void rate_ctr_add(struct rate_ctr *ctr, int inc);
 
+void _rate_ctr_shard_add(struct rate_ctr_group *ctrg, unsigned int idx, int inc);
+
 /*! Increment the counter by \a inc
+ *  In a group allocated by rate_ctr_group_alloc_sharded(), this may be called from any thread.
  *  \param ctrg \ref rate_ctr_group of counter
  *  \param idx index into \a ctrg counter group
  *  \param inc quantity to increment \a ctr by */
 static inline void rate_ctr_add2(struct rate_ctr_group *ctrg, unsigned int idx, int inc)
 {
-	rate_ctr_add(rate_ctr_group_get_ctr(ctrg, idx), inc);
+	if (ctrg->shards)
+		_rate_ctr_shard_add(ctrg, idx, inc);
+	else
+		rate_ctr_add(rate_ctr_group_get_ctr(ctrg, idx), inc);
 }
 
 /*! Increment the counter by 1
@@ -103,11 +117,12 @@ static inline void rate_ctr_inc(struct rate_ctr *ctr)
 }
 
 /*! Increment the counter by 1
+ *  In a group allocated by rate_ctr_group_alloc_sharded(), this may be called from any thread.
  *  \param ctrg \ref rate_ctr_group of counter
  *  \param idx index into \a ctrg counter group */
 static inline void rate_ctr_inc2(struct rate_ctr_group *ctrg, unsigned int idx)
 {
-	rate_ctr_inc(rate_ctr_group_get_ctr(ctrg, idx));
+	rate_ctr_add2(ctrg, idx, 1);
 }
 
 
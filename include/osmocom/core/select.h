@@ -5,6 +5,7 @@
 #pragma once
 
 #include <osmocom/core/linuxlist.h>
+#include <osmocom/core/utils.h>
 #include <stdbool.h>
 #include <time.h>
 #include <signal.h>
@@ -22,6 +23,24 @@
 /*! Used as when_mask in osmo_fd_update_when() */
 #define OSMO_FD_MASK	0xFFFF
 
+/*! The back-end used by osmo_select_main() to wait for events on the registered file descriptors.  The back-end
+ * is chosen once per process at startup time via the LIBOSMO_SELECT_BACKEND environment variable. */
+enum osmo_select_backend {
+	/*! classic back-end using poll(2); the set of pollfd is re-built from all registered osmo_fd on every
+	 * iteration of osmo_select_main() */
+	OSMO_SELECT_BACKEND_POLL,
+	/*! back-end using epoll(7); the kernel interest set is updated incrementally by osmo_fd_register(),
+	 * osmo_fd_unregister() and osmo_fd_update_when(), and only ready file descriptors are dispatched */
+	OSMO_SELECT_BACKEND_EPOLL,
+};
+
+enum osmo_select_backend osmo_select_get_backend(void);
+
+extern const struct value_string osmo_select_backend_names[];
+/*! return the string name of an osmo_select_backend */
+static inline const char *osmo_select_backend_name(enum osmo_select_backend val)
+{ return get_value_string(osmo_select_backend_names, val); }
+
 /* legacy naming dating back to early OpenBSC / bsc_hack of 2008 */
 #define BSC_FD_READ	OSMO_FD_READ
 #define BSC_FD_WRITE	OSMO_FD_WRITE
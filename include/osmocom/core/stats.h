@@ -38,6 +38,7 @@ struct osmo_stat_item_group;
 struct osmo_stat_item_desc;
 struct rate_ctr_group;
 struct rate_ctr_desc;
+struct osmo_stats_statsd_names;
 
 /*! Statistics Class definitions */
 enum osmo_stats_class {
@@ -98,6 +99,9 @@ struct osmo_stats_reporter {
 		const struct osmo_stat_item_group *statg,
 		const struct osmo_stat_item_desc *desc,
 		int64_t value);
+
+	/*! metric names pre-rendered by the statsd reporter, see stats_statsd.c */
+	struct osmo_stats_statsd_names *statsd_names;
 };
 
 struct osmo_stats_config {
@@ -0,0 +1,94 @@
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#pragma once
+
+/*! \addtogroup stats
+ *  @{
+ * \file stats_shm.h */
+
+#include <stdint.h>
+
+/*! Magic at the start of a shared memory stats file */
+#define OSMO_STATS_SHM_MAGIC		"OSMOSTAT"
+/*! Version of the shared memory stats file layout */
+#define OSMO_STATS_SHM_VERSION		1
+/*! Value of osmo_stats_shm_hdr.byte_order, in the byte order of the writer */
+#define OSMO_STATS_SHM_BYTE_ORDER	0x01020304
+
+#define STATS_SHM_DEFAULT_INTERVAL	1000	/* msecs */
+
+/*! Header at offset 0 of a shared memory stats file.
+ *  The file consists of this header, an index of num_entries struct
+ *  osmo_stats_shm_entry, the names referenced by the index and an array of
+ *  num_entries int64_t values, where values[i] belongs to entries[i]. All
+ *  numbers are in the byte order of the writer.
+ *
+ *  The index never changes once the file is in place. When counter groups
+ *  are allocated, freed or renamed, the writer moves a new file with a new
+ *  index to the same path and sets 'obsolete' in the old one; readers then
+ *  have to map the path again.
+ *
+ *  The values are updated under a sequence lock: 'seq' is odd while an
+ *  update is in progress. Readers copy the values and retry if 'seq' was
+ *  odd or changed meanwhile, see osmo_stats_shm_read_values(). */
+struct osmo_stats_shm_hdr {
+	char magic[8];		/*!< OSMO_STATS_SHM_MAGIC, not NUL terminated */
+	uint32_t version;	/*!< OSMO_STATS_SHM_VERSION */
+	uint32_t byte_order;	/*!< OSMO_STATS_SHM_BYTE_ORDER */
+	uint32_t seq;		/*!< sequence lock of values and time_us */
+	uint32_t obsolete;	/*!< non-zero once a newer file was moved in place */
+	uint32_t pid;		/*!< process id of the writer */
+	uint32_t num_entries;	/*!< number of index entries and values */
+	uint64_t entries_off;	/*!< file offset of the index */
+	uint64_t names_off;	/*!< file offset of the names */
+	uint64_t names_size;	/*!< size of the names area */
+	uint64_t values_off;	/*!< file offset of the values, 64 byte aligned */
+	uint64_t file_size;	/*!< size of the whole file */
+	int64_t time_us;	/*!< time of the last update, microseconds since the epoch */
+};
+
+/*! Kind of an exported value */
+enum osmo_stats_shm_kind {
+	OSMO_STATS_SHM_RATE_CTR = 1,	/*!< rate_ctr, current counter value */
+	OSMO_STATS_SHM_STAT_ITEM = 2,	/*!< osmo_stat_item, last value */
+};
+
+/*! Index entry describing one value */
+struct osmo_stats_shm_entry {
+	uint32_t name_off;	/*!< offset of the NUL terminated name in the names area */
+	uint16_t name_len;	/*!< name length, without the terminating NUL */
+	uint8_t kind;		/*!< enum osmo_stats_shm_kind */
+	uint8_t class_id;	/*!< enum osmo_stats_class of the group */
+};
+
+struct osmo_stats_shm_config {
+	/* file the values are exported to, NULL if disabled; use osmo_stats_shm_open() to manipulate */
+	char *path;
+	/* update interval in milliseconds, use osmo_stats_shm_set_interval() to manipulate this value */
+	unsigned int interval;
+};
+extern struct osmo_stats_shm_config *osmo_stats_shm_config;
+
+int osmo_stats_shm_open(const char *path);
+void osmo_stats_shm_close(void);
+int osmo_stats_shm_set_interval(unsigned int interval);
+int osmo_stats_shm_update(void);
+
+int osmo_stats_shm_read_values(const struct osmo_stats_shm_hdr *hdr, int64_t *values, int64_t *time_us);
+
+/*! @} */
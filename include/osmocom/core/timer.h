@@ -42,6 +42,7 @@
 #include <osmocom/core/linuxlist.h>
 #include <osmocom/core/linuxrbtree.h>
 #include <osmocom/core/timer_compat.h>
+#include <osmocom/core/utils.h>
 
 /* convert absolute time (in seconds) to elapsed days/hours/minutes */
 #define OSMO_SEC2MIN(sec) ((sec % (60 * 60)) / 60)
@@ -50,8 +51,8 @@
 
 /*! A structure representing a single instance of a timer */
 struct osmo_timer_list {
-	struct rb_node node;	  /*!< rb-tree node header */
-	struct llist_head list;   /*!< internal list header */
+	struct rb_node node;	  /*!< rb-tree node header (unused by the timing wheel) */
+	struct llist_head list;   /*!< internal list header (timing wheel slot or eviction list) */
 	struct timeval timeout;   /*!< expiration time */
 	unsigned int active  : 1; /*!< is it active? */
 
@@ -85,6 +86,23 @@ void osmo_timers_prepare(void);
 int osmo_timers_update(void);
 int osmo_timers_check(void);
 
+/*! The data structure used to manage the pending timers of a thread.  The back-end is chosen once per process
+ * at startup time via the LIBOSMO_TIMER_BACKEND environment variable ("RBTREE" or "WHEEL"); the default can be
+ * changed at build time with ./configure --enable-timer-wheel. */
+enum osmo_timer_backend {
+	/*! red-black tree ordered by expiration time; O(log n) add and delete */
+	OSMO_TIMER_BACKEND_RBTREE,
+	/*! hashed hierarchical timing wheel with 1ms granularity; O(1) add, delete and re-schedule */
+	OSMO_TIMER_BACKEND_WHEEL,
+};
+
+enum osmo_timer_backend osmo_timers_get_backend(void);
+
+extern const struct value_string osmo_timer_backend_names[];
+/*! return the string name of an osmo_timer_backend */
+static inline const char *osmo_timer_backend_name(enum osmo_timer_backend val)
+{ return get_value_string(osmo_timer_backend_names, val); }
+
 int osmo_gettimeofday(struct timeval *tv, struct timezone *tz);
 int osmo_clock_gettime(clockid_t clk_id, struct timespec *tp);
 
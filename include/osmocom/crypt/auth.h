@@ -115,6 +115,12 @@ struct osmo_auth_impl {
 			    struct osmo_sub_auth_data2 *aud,
 			    const uint8_t *auts, const uint8_t *rand_auts,
 			    const uint8_t *_rand);
+
+	/*! optional callback for generating several vectors at once,
+	 *  see osmo_auth_gen_vecs2() */
+	int (*gen_vecs)(struct osmo_auth_vector *vec, unsigned int num,
+			struct osmo_sub_auth_data2 *aud,
+			const uint8_t *_rand);
 };
 
 int osmo_auth_gen_vec(struct osmo_auth_vector *vec,
@@ -124,6 +130,9 @@ int osmo_auth_gen_vec(struct osmo_auth_vector *vec,
 int osmo_auth_gen_vec2(struct osmo_auth_vector *vec,
 		       struct osmo_sub_auth_data2 *aud, const uint8_t *_rand);
 
+int osmo_auth_gen_vecs2(struct osmo_auth_vector *vec, unsigned int num,
+			struct osmo_sub_auth_data2 *aud, const uint8_t *_rand);
+
 int osmo_auth_gen_vec_auts(struct osmo_auth_vector *vec,
 			   struct osmo_sub_auth_data *aud,
 			   const uint8_t *auts, const uint8_t *rand_auts,
@@ -107,8 +107,8 @@ struct bssgp_flow_control {
 struct bssgp_bvc_ctx {
 	struct llist_head list;
 
-	struct gprs_ra_id ra_id; /*!< parsed RA ID of the remote BTS */
-	uint16_t cell_id; /*!< Cell ID of the remote BTS */
+	struct gprs_ra_id ra_id; /*!< parsed RA ID of the remote BTS; only set via bssgp_bvc_ctx_set_raid_cid() */
+	uint16_t cell_id; /*!< Cell ID of the remote BTS; only set via bssgp_bvc_ctx_set_raid_cid() */
 
 	/* NSEI and BVCI of underlying Gb link.  Together they
 	 * uniquely identify a link to a BTS (5.4.4) */
@@ -130,6 +130,10 @@ struct bssgp_bvc_ctx {
 	/* we might want to add this as a shortcut later, avoiding the NSVC
 	 * lookup for every packet, similar to a routing cache */
 	//struct gprs_nsvc *nsvc;
+
+	/*! entries in the library-internal lookup indexes, don't touch */
+	struct hlist_node node_by_bvci_nsei;
+	struct hlist_node node_by_raid_cid;
 };
 extern struct llist_head bssgp_bvc_ctxts;
 /* Create a BTS Context with BVCI+NSEI */
@@ -138,6 +142,8 @@ struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei);
 struct bssgp_bvc_ctx *btsctx_by_raid_cid(const struct gprs_ra_id *raid, uint16_t cid);
 /* Find a BTS context based on BVCI+NSEI tuple */
 struct bssgp_bvc_ctx *btsctx_by_bvci_nsei(uint16_t bvci, uint16_t nsei);
+/* Set RA ID and Cell ID of a BTS Context, keeping btsctx_by_raid_cid() fast */
+void bssgp_bvc_ctx_set_raid_cid(struct bssgp_bvc_ctx *ctx, const struct gprs_ra_id *raid, uint16_t cid);
 /* Free a given BTS context */
 void bssgp_bvc_ctx_free(struct bssgp_bvc_ctx *ctx);
 
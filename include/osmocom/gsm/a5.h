@@ -45,6 +45,15 @@ osmo_a5_fn_count(uint32_t fn)
 	 *    (converted internally to fn_count)
 	 */
 int osmo_a5(int n, const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul);
+/*! One (key, frame number) pair of osmo_a5_batch() */
+struct osmo_a5_batch_req {
+	const uint8_t *key;	/*!< 8 byte key (16 for A5/4), as for osmo_a5() */
+	uint32_t fn;		/*!< the _real_ GSM frame number */
+	ubit_t *dl;		/*!< 114 bits of downlink cipher stream, or NULL */
+	ubit_t *ul;		/*!< 114 bits of uplink cipher stream, or NULL */
+};
+
+int osmo_a5_batch(int n, const struct osmo_a5_batch_req *req, unsigned int num);
 void osmo_a5_1(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul) OSMO_DEPRECATED("Use generic osmo_a5() instead");
 void osmo_a5_2(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul) OSMO_DEPRECATED("Use generic osmo_a5() instead");
 
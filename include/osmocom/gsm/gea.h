@@ -10,13 +10,43 @@
 #pragma once
 
 #include <osmocom/crypt/gprs_cipher.h>
+#include <osmocom/gsm/kasumi.h>
 
 #include <stdint.h>
 
+struct msgb;
+
 int gea3(uint8_t *out, uint16_t len, uint8_t *kc, uint32_t iv,
 	 enum gprs_cipher_direction direct);
 
 int gea4(uint8_t *out, uint16_t len, uint8_t *kc, uint32_t iv,
 	 enum gprs_cipher_direction direct);
 
+/*! GEA3/GEA4 ciphering context of one key, see osmo_gea_ctx_init() */
+struct osmo_gea_ctx {
+	enum gprs_ciph_algo algo;	/*!< GPRS_ALGO_GEA3 or GPRS_ALGO_GEA4 */
+	uint8_t key[16];		/*!< KASUMI key CK (derived from Kc by osmo_c4() for GEA3) */
+	struct osmo_kasumi_key ck;	/*!< KASUMI key schedule of CK */
+	struct osmo_kasumi_key ck_km;	/*!< KASUMI key schedule of CK XOR KM */
+};
+
+int osmo_gea_ctx_init(struct osmo_gea_ctx *ctx, enum gprs_ciph_algo algo, const uint8_t *kc);
+void osmo_gea_ctx_clear(struct osmo_gea_ctx *ctx);
+
+void osmo_gea_xor(const struct osmo_gea_ctx *ctx, uint8_t *data, uint16_t len, uint32_t iv,
+		  enum gprs_cipher_direction direction);
+int osmo_gea_msgb(const struct osmo_gea_ctx *ctx, struct msgb *msg, unsigned int offset, uint32_t iv,
+		  enum gprs_cipher_direction direction);
+
+/*! One frame of osmo_gea_batch() */
+struct osmo_gea_batch_req {
+	const struct osmo_gea_ctx *ctx;		/*!< key of the frame */
+	uint8_t *data;				/*!< data to cipher/decipher in place */
+	uint16_t len;				/*!< length of data, in bytes */
+	uint32_t iv;				/*!< input, see gprs_cipher_gen_input_ui() */
+	enum gprs_cipher_direction direction;	/*!< direction of the frame */
+};
+
+int osmo_gea_batch(const struct osmo_gea_batch_req *req, unsigned int num);
+
 /*! @} */
@@ -46,3 +46,18 @@ void _kasumi_kgcore(uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd, const uint8
  *  \param[out] KIi3 Expanded subkeys
  */
 void _kasumi_key_expand(const uint8_t *key, uint16_t *KLi1, uint16_t *KLi2, uint16_t *KOi1, uint16_t *KOi2, uint16_t *KOi3, uint16_t *KIi1, uint16_t *KIi2, uint16_t *KIi3);
+
+/*! Expanded KASUMI key: the subkeys of all 8 rounds, see _kasumi_key_expand() */
+struct osmo_kasumi_key {
+	uint16_t KLi1[8];
+	uint16_t KLi2[8];
+	uint16_t KOi1[8];
+	uint16_t KOi2[8];
+	uint16_t KOi3[8];
+	uint16_t KIi1[8];
+	uint16_t KIi2[8];
+	uint16_t KIi3[8];
+};
+
+void osmo_kasumi_key_expand(struct osmo_kasumi_key *key, const uint8_t *k);
+uint64_t osmo_kasumi(const struct osmo_kasumi_key *key, uint64_t P);
@@ -46,6 +46,7 @@ enum osmo_tlv_parser_error {
 	OSMO_TLVP_ERR_OFS_BEYOND_BUFFER		= -1,
 	OSMO_TLVP_ERR_OFS_LEN_BEYOND_BUFFER	= -2,
 	OSMO_TLVP_ERR_UNKNOWN_TLV_TYPE		= -3,
+	OSMO_TLVP_ERR_TOO_MANY_IES		= -4,
 
 	OSMO_TLVP_ERR_MAND_IE_MISSING		= -50,
 	OSMO_TLVP_ERR_IE_TOO_SHORT		= -51,
@@ -652,6 +653,110 @@ static inline uint32_t tlvp_val32be(const struct tlv_parsed *tp, int pos)
 }
 
 
+/*! Maximum number of different IEs in a \ref tlv_parsed_sparse */
+#define TLV_PARSED_SPARSE_MAX_IE	32
+
+/*! Compact result of the TLV parser, see tlv_parse_sparse().
+ *  Unlike \ref tlv_parsed, which has an entry for each of the 256 tags and
+ *  needs to be cleared completely before each parse, this only holds the
+ *  IEs actually found: a bitmap of the tags present, and a dense array of
+ *  their entries. Only the bitmap needs to be cleared; idx[] is valid for
+ *  present tags only. Access it with the TLVPS_*() macros and tlvps_*()
+ *  functions, which work like their TLVP_*() and tlvp_*() counterparts. */
+struct tlv_parsed_sparse {
+	uint64_t present[4];	/*!< bit (tag % 64) of present[tag / 64] is set if tag is present */
+	uint8_t num;		/*!< number of entries in ie[] and tag[] */
+	uint8_t idx[256];	/*!< index in ie[] by tag, only valid if the tag is present */
+	uint8_t tag[TLV_PARSED_SPARSE_MAX_IE];			/*!< tag of each entry in ie[] */
+	struct tlv_p_entry ie[TLV_PARSED_SPARSE_MAX_IE];	/*!< IEs present, in the order they were found */
+};
+
+/*! Return pointer to a TLV element if it is present, like TLVP_GET().
+ * \param[in] tp  pointer to \ref tlv_parsed_sparse.
+ * \param[in] tag  IE tag to return.
+ * \returns struct tlv_p_entry pointer, or NULL if not present.
+ */
+static inline const struct tlv_p_entry *tlvps_get(const struct tlv_parsed_sparse *tp, uint8_t tag)
+{
+	if (!(tp->present[tag / 64] & (1ULL << (tag % 64))))
+		return NULL;
+	return &tp->ie[tp->idx[tag]];
+}
+
+/*! Length of a TLV element, 0 if it is not present, like TLVP_LEN() */
+static inline uint16_t tlvps_len(const struct tlv_parsed_sparse *tp, uint8_t tag)
+{
+	const struct tlv_p_entry *e = tlvps_get(tp, tag);
+	return e ? e->len : 0;
+}
+
+/*! Value of a TLV element, NULL if it is not present, like TLVP_VAL() */
+static inline const uint8_t *tlvps_val(const struct tlv_parsed_sparse *tp, uint8_t tag)
+{
+	const struct tlv_p_entry *e = tlvps_get(tp, tag);
+	return e ? e->val : NULL;
+}
+
+/*! Like tlvps_get(), but enforcing a minimum val length, like TLVP_GET_MINLEN() */
+static inline const struct tlv_p_entry *tlvps_get_minlen(const struct tlv_parsed_sparse *tp, uint8_t tag,
+							 uint16_t min_len)
+{
+	const struct tlv_p_entry *e = tlvps_get(tp, tag);
+	return e && e->len >= min_len ? e : NULL;
+}
+
+/* The TLVPS_*() macros can replace the TLVP_*() ones when moving code from
+ * \ref tlv_parsed to \ref tlv_parsed_sparse. Unlike the latter, they are not
+ * lvalues and never evaluate to the entry of an absent tag. */
+#define TLVPS_PRESENT(x, y)	(!!((x)->present[(uint8_t)(y) / 64] & (1ULL << ((uint8_t)(y) % 64))))
+#define TLVPS_LEN(x, y)		tlvps_len(x, y)
+#define TLVPS_VAL(x, y)		tlvps_val(x, y)
+#define TLVPS_PRES_LEN(tp, tag, min_len)	(!!tlvps_get_minlen(tp, tag, min_len))
+#define TLVPS_GET(_tp, tag)	tlvps_get(_tp, tag)
+#define TLVPS_GET_MINLEN(_tp, tag, min_len)	tlvps_get_minlen(_tp, tag, min_len)
+#define TLVPS_VAL_MINLEN(_tp, tag, min_len) \
+	(tlvps_get_minlen(_tp, tag, min_len) ? tlvps_get(_tp, tag)->val : NULL)
+
+/*! Obtain 1-byte TLV element, like tlvp_val8().
+ *  \param[in] tp pointer to \ref tlv_parsed_sparse
+ *  \param[in] tag the Tag to look for
+ *  \param[in] default_val default value to use if tag not available
+ *  \returns the 1st byte of value with a given tag or default_val if tag was not found
+ */
+static inline uint8_t tlvps_val8(const struct tlv_parsed_sparse *tp, uint8_t tag, uint8_t default_val)
+{
+	const struct tlv_p_entry *e = tlvps_get_minlen(tp, tag, 1);
+
+	if (e)
+		return e->val[0];
+
+	return default_val;
+}
+
+/*! Retrieve (possibly unaligned) TLV element and convert to host byte order, like tlvp_val16be().
+ *  \param[in] tp pointer to \ref tlv_parsed_sparse
+ *  \param[in] pos element to return
+ *  \returns aligned 16 bit value in host byte order
+ */
+static inline uint16_t tlvps_val16be(const struct tlv_parsed_sparse *tp, int pos)
+{
+	return osmo_load16be(TLVPS_VAL(tp, pos));
+}
+
+/*! Retrieve (possibly unaligned) TLV element and convert to host byte order, like tlvp_val32be().
+ *  \param[in] tp pointer to \ref tlv_parsed_sparse
+ *  \param[in] pos element to return
+ *  \returns aligned 32 bit value in host byte order
+ */
+static inline uint32_t tlvps_val32be(const struct tlv_parsed_sparse *tp, int pos)
+{
+	return osmo_load32be(TLVPS_VAL(tp, pos));
+}
+
+int tlv_parse_sparse(struct tlv_parsed_sparse *dec, const struct tlv_definition *def,
+		     const uint8_t *buf, int buf_len, uint8_t lv_tag, uint8_t lv_tag2);
+void tlv_parsed_sparse_to_full(struct tlv_parsed *dst, const struct tlv_parsed_sparse *src);
+
 struct tlv_parsed *osmo_tlvp_copy(const struct tlv_parsed *tp_orig, void *ctx);
 int osmo_tlvp_merge(struct tlv_parsed *dst, const struct tlv_parsed *src);
 int osmo_shift_v_fixed(uint8_t **data, size_t *data_len,
@@ -100,6 +100,23 @@
  *
  * \file gsm0503_coding.c */
 
+/*
+ * CRC tables of the codes applied to byte-aligned packed data
+ */
+
+static struct osmo_crc64gen_table fire_crc40_tab;
+static struct osmo_crc16gen_table cs234_crc16_tab;
+static struct osmo_crc8gen_table rach_crc6_tab;
+static struct osmo_crc16gen_table sch_crc10_tab;
+
+static __attribute__((constructor)) void on_dso_load_coding(void)
+{
+	osmo_crc64gen_table_init(&fire_crc40_tab, &gsm0503_fire_crc40);
+	osmo_crc16gen_table_init(&cs234_crc16_tab, &gsm0503_cs234_crc16);
+	osmo_crc8gen_table_init(&rach_crc6_tab, &gsm0503_rach_crc6);
+	osmo_crc16gen_table_init(&sch_crc10_tab, &gsm0503_sch_crc10);
+}
+
 /*
  * EGPRS coding limits
  */
@@ -592,18 +609,22 @@ static int osmo_conv_decode_ber(const struct osmo_conv_code *code,
 static int _xcch_decode_cB(uint8_t *l2_data, const sbit_t *cB,
 	int *n_errors, int *n_bits_total)
 {
+	uint8_t l2[GSM_MACBLOCK_LEN];
 	ubit_t conv[224];
 	int rv;
 
 	osmo_conv_decode_ber(&gsm0503_xcch, cB,
 		conv, n_errors, n_bits_total);
 
-	rv = osmo_crc64gen_check_bits(&gsm0503_fire_crc40,
-		conv, 184, conv + 184);
+	/* pack into a local buffer, the caller's one is left untouched on CRC error */
+	osmo_ubit2pbit_ext(l2, 0, conv, 0, 184, 1);
+
+	rv = osmo_crc64gen_check_pbits(&fire_crc40_tab,
+		l2, 184, 1, conv + 184);
 	if (rv)
 		return -1;
 
-	osmo_ubit2pbit_ext(l2_data, 0, conv, 0, 184, 1);
+	memcpy(l2_data, l2, GSM_MACBLOCK_LEN);
 
 	return 0;
 }
@@ -618,7 +639,7 @@ static int _xcch_encode_cB(ubit_t *cB, const uint8_t *l2_data)
 
 	osmo_pbit2ubit_ext(conv, 0, l2_data, 0, 184, 1);
 
-	osmo_crc64gen_set_bits(&gsm0503_fire_crc40, conv, 184, conv + 184);
+	osmo_crc64gen_set_pbits(&fire_crc40_tab, l2_data, 184, 1, conv + 184);
 
 	osmo_conv_encode(&gsm0503_xcch, conv, cB);
 
@@ -1023,6 +1044,7 @@ int gsm0503_pdtch_decode(uint8_t *l2_data, const sbit_t *bursts, uint8_t *usf_p,
 {
 	sbit_t iB[456], cB[676], hl_hn[8];
 	ubit_t conv[456];
+	uint8_t l2[54] = { 0 }; /* spare bits of the last octet are left zero */
 	int i, j, k, rv, best = 0, cs = 0, usf = 0; /* make GCC happy */
 
 	for (i = 0; i < 4; i++)
@@ -1050,13 +1072,14 @@ int gsm0503_pdtch_decode(uint8_t *l2_data, const sbit_t *bursts, uint8_t *usf_p,
 		if (usf_p)
 			*usf_p = (conv[0] << 2) | (conv[1] << 1) | (conv[2] << 0);
 
-		rv = osmo_crc64gen_check_bits(&gsm0503_fire_crc40,
-			conv, 184, conv + 184);
+		osmo_ubit2pbit_ext(l2, 0, conv, 0, 184, 1);
+
+		rv = osmo_crc64gen_check_pbits(&fire_crc40_tab,
+			l2, 184, 1, conv + 184);
 		if (rv)
 			return -1;
 
-		osmo_ubit2pbit_ext(l2_data, 0, conv, 0, 184, 1);
-
+		memcpy(l2_data, l2, 23);
 		return 23;
 	case 2:
 		/* reorder, set punctured bits to 0 (unknown state) */
@@ -1092,13 +1115,14 @@ int gsm0503_pdtch_decode(uint8_t *l2_data, const sbit_t *bursts, uint8_t *usf_p,
 		if (usf_p)
 			*usf_p = usf;
 
-		rv = osmo_crc16gen_check_bits(&gsm0503_cs234_crc16,
-			conv + 3, 271, conv + 3 + 271);
+		osmo_ubit2pbit_ext(l2, 0, conv, 3, 271, 1);
+
+		rv = osmo_crc16gen_check_pbits(&cs234_crc16_tab,
+			l2, 271, 1, conv + 3 + 271);
 		if (rv)
 			return -1;
 
-		osmo_ubit2pbit_ext(l2_data, 0, conv, 3, 271, 1);
-
+		memcpy(l2_data, l2, 34);
 		return 34;
 	case 3:
 		/* reorder, set punctured bits to 0 (unknown state) */
@@ -1134,13 +1158,14 @@ int gsm0503_pdtch_decode(uint8_t *l2_data, const sbit_t *bursts, uint8_t *usf_p,
 		if (usf_p)
 			*usf_p = usf;
 
-		rv = osmo_crc16gen_check_bits(&gsm0503_cs234_crc16,
-			conv + 3, 315, conv + 3 + 315);
+		osmo_ubit2pbit_ext(l2, 0, conv, 3, 315, 1);
+
+		rv = osmo_crc16gen_check_pbits(&cs234_crc16_tab,
+			l2, 315, 1, conv + 3 + 315);
 		if (rv)
 			return -1;
 
-		osmo_ubit2pbit_ext(l2_data, 0, conv, 3, 315, 1);
-
+		memcpy(l2_data, l2, 40);
 		return 40;
 	case 4:
 		for (i = 12; i < 456; i++)
@@ -1163,8 +1188,10 @@ int gsm0503_pdtch_decode(uint8_t *l2_data, const sbit_t *bursts, uint8_t *usf_p,
 		if (usf_p)
 			*usf_p = usf;
 
-		rv = osmo_crc16gen_check_bits(&gsm0503_cs234_crc16,
-			conv + 9, 431, conv + 9 + 431);
+		osmo_ubit2pbit_ext(l2, 0, conv, 9, 431, 1);
+
+		rv = osmo_crc16gen_check_pbits(&cs234_crc16_tab,
+			l2, 431, 1, conv + 9 + 431);
 		if (rv) {
 			*n_bits_total = 456 - 12;
 			*n_errors = *n_bits_total;
@@ -1174,8 +1201,7 @@ int gsm0503_pdtch_decode(uint8_t *l2_data, const sbit_t *bursts, uint8_t *usf_p,
 		*n_bits_total = 456 - 12;
 		*n_errors = 0;
 
-		osmo_ubit2pbit_ext(l2_data, 0, conv, 9, 431, 1);
-
+		memcpy(l2_data, l2, 54);
 		return 54;
 	default:
 		*n_bits_total = 0;
@@ -1458,7 +1484,7 @@ int gsm0503_pdtch_encode(ubit_t *bursts, const uint8_t *l2_data, uint8_t l2_len)
 	case 23:
 		osmo_pbit2ubit_ext(conv, 0, l2_data, 0, 184, 1);
 
-		osmo_crc64gen_set_bits(&gsm0503_fire_crc40, conv, 184, conv + 184);
+		osmo_crc64gen_set_pbits(&fire_crc40_tab, l2_data, 184, 1, conv + 184);
 
 		osmo_conv_encode(&gsm0503_xcch, conv, cB);
 
@@ -1469,8 +1495,8 @@ int gsm0503_pdtch_encode(ubit_t *bursts, const uint8_t *l2_data, uint8_t l2_len)
 		osmo_pbit2ubit_ext(conv, 3, l2_data, 0, 271, 1);
 		usf = l2_data[0] & 0x7;
 
-		osmo_crc16gen_set_bits(&gsm0503_cs234_crc16, conv + 3,
-			271, conv + 3 + 271);
+		osmo_crc16gen_set_pbits(&cs234_crc16_tab, l2_data,
+			271, 1, conv + 3 + 271);
 
 		memcpy(conv, gsm0503_usf2six[usf], 6);
 
@@ -1487,8 +1513,8 @@ int gsm0503_pdtch_encode(ubit_t *bursts, const uint8_t *l2_data, uint8_t l2_len)
 		osmo_pbit2ubit_ext(conv, 3, l2_data, 0, 315, 1);
 		usf = l2_data[0] & 0x7;
 
-		osmo_crc16gen_set_bits(&gsm0503_cs234_crc16, conv + 3,
-			315, conv + 3 + 315);
+		osmo_crc16gen_set_pbits(&cs234_crc16_tab, l2_data,
+			315, 1, conv + 3 + 315);
 
 		memcpy(conv, gsm0503_usf2six[usf], 6);
 
@@ -1505,8 +1531,8 @@ int gsm0503_pdtch_encode(ubit_t *bursts, const uint8_t *l2_data, uint8_t l2_len)
 		osmo_pbit2ubit_ext(cB, 9, l2_data, 0, 431, 1);
 		usf = l2_data[0] & 0x7;
 
-		osmo_crc16gen_set_bits(&gsm0503_cs234_crc16, cB + 9,
-			431, cB + 9 + 431);
+		osmo_crc16gen_set_pbits(&cs234_crc16_tab, l2_data,
+			431, 1, cB + 9 + 431);
 
 		memcpy(cB, gsm0503_usf2twelve_ubit[usf], 12);
 
@@ -3328,7 +3354,7 @@ int gsm0503_rach_ext_encode(ubit_t *burst, uint16_t ra11, uint8_t bsic, bool is_
 
 	osmo_pbit2ubit_ext(conv, 0, ra, 0, nbits, 1);
 
-	osmo_crc8gen_set_bits(&gsm0503_rach_crc6, conv, nbits, conv + nbits);
+	osmo_crc8gen_set_pbits(&rach_crc6_tab, ra, nbits, 1, conv + nbits);
 
 	rach_apply_bsic(conv, bsic, nbits);
 
@@ -3371,7 +3397,7 @@ int gsm0503_sch_encode(ubit_t *burst, const uint8_t *sb_info)
 
 	osmo_pbit2ubit_ext(conv, 0, sb_info, 0, 25, 1);
 
-	osmo_crc16gen_set_bits(&gsm0503_sch_crc10, conv, 25, conv + 25);
+	osmo_crc16gen_set_pbits(&sch_crc10_tab, sb_info, 25, 1, conv + 25);
 
 	osmo_conv_encode(&gsm0503_sch, conv, burst);
 
@@ -236,6 +236,10 @@ osmo_conv_encode(const struct osmo_conv_code *code,
 int
 osmo_conv_decode_acc(const struct osmo_conv_code *code,
 		     const sbit_t *input, ubit_t *output);
+int
+osmo_conv_decode_acc_batch(const struct osmo_conv_code *code,
+			   const sbit_t * const *input, ubit_t **output,
+			   unsigned int num);
 
 void
 osmo_conv_decode_init(struct osmo_conv_decoder *decoder,
@@ -671,4 +675,38 @@ osmo_conv_decode(const struct osmo_conv_code *code,
 	return rv;
 }
 
+/*! All-in-one convolutional decoding of several codewords
+ *  \param[in] code description of convolutional code to be used
+ *  \param[in] input arrays of soft bits (coded), one per codeword
+ *  \param[out] output arrays of unpacked bits (decoded), one per codeword
+ *  \param[in] num number of codewords
+ *  \returns 0 on success; negative on error of any of the codewords
+ *
+ * Decodes the same as calling \ref osmo_conv_decode for each codeword, but
+ * for the codes supported by the accelerated decoder (K=5 and K=7, N<=4)
+ * several codewords are run through the trellis in parallel, using the
+ * kernel selected by \ref osmo_conv_batch_set_kernel (by default the widest
+ * one the CPU supports).
+ */
+int
+osmo_conv_decode_batch(const struct osmo_conv_code *code,
+		       const sbit_t * const *input, ubit_t **output,
+		       unsigned int num)
+{
+	unsigned int i;
+	int rc, ret = 0;
+
+	/* Use accelerated implementation for supported codes */
+	if ((code->N <= 4) && ((code->K == 5) || (code->K == 7)))
+		return osmo_conv_decode_acc_batch(code, input, output, num);
+
+	for (i = 0; i < num; i++) {
+		rc = osmo_conv_decode(code, input[i], output[i]);
+		if (rc < 0 && !ret)
+			ret = rc;
+	}
+
+	return ret;
+}
+
 /*! @} */
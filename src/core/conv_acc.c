@@ -46,6 +46,7 @@ static int init_complete = 0;
 __attribute__ ((visibility("hidden"))) int avx2_supported = 0;
 __attribute__ ((visibility("hidden"))) int ssse3_supported = 0;
 __attribute__ ((visibility("hidden"))) int sse41_supported = 0;
+__attribute__ ((visibility("hidden"))) int avx512bw_supported = 0;
 
 /**
  * These pointers are being initialized at runtime by the
@@ -145,6 +146,80 @@ void osmo_conv_neon_metrics_k7_n4(const int8_t *seq, const int16_t *out,
 	int16_t *sums, int16_t *paths, int norm);
 #endif
 
+/* Forward Multi-codeword Metric Units (see conv_acc_batch_impl.h) */
+typedef void (*batch_metric_func_t)(const int16_t *seq, const uint8_t *pat,
+	int16_t *sums, uint32_t *dec, int norm);
+
+#define DECLARE_BATCH_UNITS(simd) \
+	void *osmo_conv_##simd##_batch_malloc(size_t size); \
+	void osmo_conv_##simd##_batch_free(void *ptr); \
+	void osmo_conv_##simd##_batch_metrics_k5_n2(const int16_t *seq, \
+		const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm); \
+	void osmo_conv_##simd##_batch_metrics_k5_n3(const int16_t *seq, \
+		const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm); \
+	void osmo_conv_##simd##_batch_metrics_k5_n4(const int16_t *seq, \
+		const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm); \
+	void osmo_conv_##simd##_batch_metrics_k7_n2(const int16_t *seq, \
+		const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm); \
+	void osmo_conv_##simd##_batch_metrics_k7_n3(const int16_t *seq, \
+		const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm); \
+	void osmo_conv_##simd##_batch_metrics_k7_n4(const int16_t *seq, \
+		const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm);
+
+/* Multi-codeword kernel
+ * id        - Public kernel identifier
+ * lanes     - Number of codewords decoded in parallel
+ * dec_shift - Bit position of a lane in the decision mask is lane << shift
+ * metrics   - Metric units indexed by [K == 7][N - 2]
+ */
+struct vbatch_kernel {
+	enum osmo_conv_batch_kernel id;
+	int lanes;
+	int dec_shift;
+	void *(*malloc)(size_t size);
+	void (*free)(void *ptr);
+	batch_metric_func_t metrics[2][3];
+};
+
+#define BATCH_KERNEL(simd, _id, _lanes, _dec_shift) \
+{ \
+	.id = _id, \
+	.lanes = _lanes, \
+	.dec_shift = _dec_shift, \
+	.malloc = osmo_conv_##simd##_batch_malloc, \
+	.free = osmo_conv_##simd##_batch_free, \
+	.metrics = { \
+		{ osmo_conv_##simd##_batch_metrics_k5_n2, \
+		  osmo_conv_##simd##_batch_metrics_k5_n3, \
+		  osmo_conv_##simd##_batch_metrics_k5_n4 }, \
+		{ osmo_conv_##simd##_batch_metrics_k7_n2, \
+		  osmo_conv_##simd##_batch_metrics_k7_n3, \
+		  osmo_conv_##simd##_batch_metrics_k7_n4 }, \
+	}, \
+}
+
+#if defined(HAVE_AVX2)
+DECLARE_BATCH_UNITS(avx2)
+static const struct vbatch_kernel batch_avx2 =
+	BATCH_KERNEL(avx2, OSMO_CONV_BATCH_AVX2, 16, 1);
+#endif
+
+#if defined(HAVE_AVX512BW)
+DECLARE_BATCH_UNITS(avx512)
+static const struct vbatch_kernel batch_avx512 =
+	BATCH_KERNEL(avx512, OSMO_CONV_BATCH_AVX512, 32, 0);
+#endif
+
+/* Selected multi-codeword kernel, NULL decodes one codeword at a time */
+static const struct vbatch_kernel *batch_kernel;
+
+const struct value_string osmo_conv_batch_kernel_names[] = {
+	{ OSMO_CONV_BATCH_SCALAR,	"scalar" },
+	{ OSMO_CONV_BATCH_AVX2,		"avx2" },
+	{ OSMO_CONV_BATCH_AVX512,	"avx512" },
+	{ 0, NULL }
+};
+
 /* Trellis State
  * state - Internal lshift register value
  * prev  - Register values of previous 0 and 1 states
@@ -549,10 +624,6 @@ static void vdec_deinit(struct vdecoder *dec)
  */
 static int vdec_init(struct vdecoder *dec, const struct osmo_conv_code *code)
 {
-	int i, ns, rc;
-
-	ns = NUM_STATES(code->K);
-
 	dec->n = code->N;
 	dec->k = code->K;
 	dec->recursive = conv_code_recursive(code);
@@ -601,9 +672,15 @@ static int vdec_init(struct vdecoder *dec, const struct osmo_conv_code *code)
 	else
 		dec->len = code->len;
 
-	rc = generate_trellis(dec, code);
-	if (rc)
-		return rc;
+	dec->paths = NULL;
+
+	return generate_trellis(dec, code);
+}
+
+/* Allocate the path decisions of a single codeword decoder */
+static int vdec_alloc_paths(struct vdecoder *dec)
+{
+	int i, ns = dec->trellis.num_states;
 
 	dec->paths = (int16_t **) malloc(sizeof(int16_t *) * dec->len);
 	if (!dec->paths)
@@ -700,6 +777,10 @@ static void osmo_conv_init(void)
 	#ifdef HAVE_SSE4_1
 		sse41_supported = __builtin_cpu_supports("sse4.1");
 	#endif
+
+	#ifdef HAVE_AVX512BW
+		avx512bw_supported = __builtin_cpu_supports("avx512bw");
+	#endif
 #endif
 
 /**
@@ -725,6 +806,16 @@ static void osmo_conv_init(void)
 #else
 	INIT_POINTERS(gen);
 #endif
+
+	/* Widest multi-codeword kernel first */
+#if defined(HAVE_AVX512BW)
+	if (avx512bw_supported)
+		batch_kernel = &batch_avx512;
+#endif
+#if defined(HAVE_AVX2)
+	if (!batch_kernel && avx2_supported)
+		batch_kernel = &batch_avx2;
+#endif
 }
 
 /* All-in-one Viterbi decoding  */
@@ -745,6 +836,10 @@ int osmo_conv_decode_acc(const struct osmo_conv_code *code,
 	if (rc)
 		return rc;
 
+	rc = vdec_alloc_paths(&dec);
+	if (rc)
+		return rc;
+
 	rc = conv_decode(&dec, input, code->puncture,
 		output, code->len, code->term);
 
@@ -752,3 +847,303 @@ int osmo_conv_decode_acc(const struct osmo_conv_code *code,
 
 	return rc;
 }
+
+/* Multi-codeword decoder object
+ * kernel      - Selected SIMD kernel
+ * metric_func - Code specific metric unit of the kernel
+ * pat         - Output pattern of each butterfly, bit j set for a '+1'
+ * depunc      - Depunctured soft bits of punctured codes [lanes][len * n]
+ * seq         - Depunctured soft bits, transposed to [len][n][lanes]
+ * sums        - Accumulated path metrics [num_states][lanes]
+ * dec         - Path decision lane masks [len][num_states]
+ */
+struct vbatch {
+	const struct vbatch_kernel *kernel;
+	batch_metric_func_t metric_func;
+	uint8_t pat[32];
+	int8_t *depunc;
+	int16_t *seq;
+	int16_t *sums;
+	uint32_t *dec;
+};
+
+static void vbatch_deinit(struct vbatch *b)
+{
+	b->kernel->free(b->dec);
+	b->kernel->free(b->sums);
+	b->kernel->free(b->seq);
+	free(b->depunc);
+}
+
+/* Initialize the multi-codeword decoder from an initialized scalar
+ * decoder object, which provides the trellis and code parameters. */
+static int vbatch_init(struct vbatch *b, const struct vdecoder *dec,
+	const struct osmo_conv_code *code, const struct vbatch_kernel *kernel)
+{
+	int i, j, ns = dec->trellis.num_states;
+	int olen = (dec->n == 2) ? 2 : 4;
+
+	b->kernel = kernel;
+	b->metric_func = kernel->metrics[dec->k == 7][dec->n - 2];
+
+	for (i = 0; i < ns / 2; i++) {
+		b->pat[i] = 0;
+		for (j = 0; j < dec->n; j++) {
+			if (dec->trellis.outputs[olen * i + j] > 0)
+				b->pat[i] |= 1 << j;
+		}
+	}
+
+	b->depunc = NULL;
+	if (code->puncture) {
+		b->depunc = malloc(dec->len * dec->n * kernel->lanes);
+		if (!b->depunc)
+			return -ENOMEM;
+	}
+
+	b->seq = kernel->malloc(sizeof(int16_t) * dec->len * dec->n * kernel->lanes);
+	b->sums = kernel->malloc(sizeof(int16_t) * ns * kernel->lanes);
+	b->dec = kernel->malloc(sizeof(uint32_t) * dec->len * ns);
+	if (!b->seq || !b->sums || !b->dec) {
+		vbatch_deinit(b);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/* Depuncture and transpose up to 'lanes' codewords, unused lanes are
+ * fed with erasures. Reset the path metrics like generate_trellis(). */
+static void vbatch_load(struct vbatch *b, const struct vdecoder *dec,
+	const struct osmo_conv_code *code, const sbit_t * const *input,
+	int count)
+{
+	int i, lane, lanes = b->kernel->lanes;
+	int nbits = dec->len * dec->n;
+	const int8_t *seq[lanes];
+	int16_t *row;
+
+	for (lane = 0; lane < count; lane++) {
+		seq[lane] = input[lane];
+		if (code->puncture) {
+			depuncture(input[lane], code->puncture,
+				&b->depunc[lane * nbits], nbits);
+			seq[lane] = &b->depunc[lane * nbits];
+		}
+	}
+
+	/* Bit by bit, so that the writes stay sequential */
+	for (i = 0; i < nbits; i++) {
+		row = &b->seq[i * lanes];
+		for (lane = 0; lane < count; lane++)
+			row[lane] = seq[lane][i];
+		for (; lane < lanes; lane++)
+			row[lane] = 0;
+	}
+
+	memset(b->sums, 0, sizeof(int16_t) * dec->trellis.num_states * lanes);
+	if (code->term != CONV_TERM_TAIL_BITING) {
+		for (i = 0; i < lanes; i++)
+			b->sums[i] = INT8_MAX * code->N * code->K;
+	}
+}
+
+/* Forward trellis recursion of all lanes, see forward_traverse() */
+static void vbatch_forward(struct vbatch *b, const struct vdecoder *dec)
+{
+	int i, ns = dec->trellis.num_states;
+	int step = dec->n * b->kernel->lanes;
+
+	for (i = 0; i < dec->len; i++) {
+		b->metric_func(&b->seq[step * i], b->pat, b->sums,
+			&b->dec[ns * i], !(i % dec->intrvl));
+	}
+}
+
+/* Path decision of one lane, equal to the scalar 'paths[i][state] + 1' */
+static inline unsigned vbatch_path(const struct vbatch *b,
+	const struct vdecoder *dec, int i, unsigned state, int lane)
+{
+	uint32_t mask = b->dec[dec->trellis.num_states * i + state];
+
+	return (mask >> (lane << b->kernel->dec_shift)) & 0x01;
+}
+
+/* Traceback of a single lane, equivalent to traceback() */
+static int vbatch_traceback(const struct vbatch *b, const struct vdecoder *dec,
+	int lane, uint8_t *out, int term, int len)
+{
+	int i, j, sum, max = -1;
+	int lanes = b->kernel->lanes;
+	unsigned path, state = 0, state_scan;
+
+	if (term == CONV_TERM_TAIL_BITING) {
+		for (i = 0; i < dec->trellis.num_states; i++) {
+			state_scan = i;
+			for (j = len - 1; j >= 0; j--) {
+				path = vbatch_path(b, dec, j, state_scan, lane);
+				state_scan = vstate_lshift(state_scan, dec->k, path);
+			}
+			if (state_scan != i)
+				continue;
+			sum = b->sums[i * lanes + lane];
+			if (sum > max) {
+				max = sum;
+				state = i;
+			}
+		}
+	}
+
+	if ((max < 0) && (term != CONV_TERM_FLUSH)) {
+		for (i = 0; i < dec->trellis.num_states; i++) {
+			sum = b->sums[i * lanes + lane];
+			if (sum > max) {
+				max = sum;
+				state = i;
+			}
+		}
+
+		if (max < 0)
+			return -EPROTO;
+	}
+
+	for (i = dec->len - 1; i >= len; i--) {
+		path = vbatch_path(b, dec, i, state, lane);
+		state = vstate_lshift(state, dec->k, path);
+	}
+
+	for (i = len - 1; i >= 0; i--) {
+		path = vbatch_path(b, dec, i, state, lane);
+		if (dec->recursive)
+			out[i] = path ^ dec->trellis.vals[state];
+		else
+			out[i] = dec->trellis.vals[state];
+		state = vstate_lshift(state, dec->k, path);
+	}
+
+	return 0;
+}
+
+/* All-in-one Viterbi decoding of several codewords of the same code */
+int osmo_conv_decode_acc_batch(const struct osmo_conv_code *code,
+	const sbit_t * const *input, ubit_t **output, unsigned int num)
+{
+	const struct vbatch_kernel *kernel;
+	struct vdecoder dec;
+	struct vbatch b;
+	unsigned int i, j, count;
+	int rc, ret = 0;
+
+	if (!init_complete)
+		osmo_conv_init();
+
+	if ((code->N < 2) || (code->N > 4) || (code->len < 1) ||
+		((code->K != 5) && (code->K != 7)))
+		return -EINVAL;
+
+	/* A single codeword does not pay for the transposition */
+	kernel = batch_kernel;
+	if (!kernel || num < 2) {
+		for (i = 0; i < num; i++) {
+			rc = osmo_conv_decode_acc(code, input[i], output[i]);
+			if (rc < 0 && !ret)
+				ret = rc;
+		}
+		return ret;
+	}
+
+	rc = vdec_init(&dec, code);
+	if (rc)
+		return rc;
+
+	rc = vbatch_init(&b, &dec, code, kernel);
+	if (rc) {
+		vdec_deinit(&dec);
+		return rc;
+	}
+
+	for (i = 0; i < num; i += count) {
+		count = OSMO_MIN(num - i, kernel->lanes);
+
+		vbatch_load(&b, &dec, code, &input[i], count);
+		vbatch_forward(&b, &dec);
+		if (code->term == CONV_TERM_TAIL_BITING)
+			vbatch_forward(&b, &dec);
+
+		for (j = 0; j < count; j++) {
+			rc = vbatch_traceback(&b, &dec, j, output[i + j],
+				code->term, code->len);
+			if (rc < 0 && !ret)
+				ret = rc;
+		}
+	}
+
+	vbatch_deinit(&b);
+	vdec_deinit(&dec);
+
+	return ret;
+}
+
+/*! Check whether a multi-codeword Viterbi kernel can run on this CPU
+ *  \param[in] kernel kernel to check
+ *  \returns 1 if supported, 0 otherwise */
+int osmo_conv_batch_kernel_supported(enum osmo_conv_batch_kernel kernel)
+{
+	if (!init_complete)
+		osmo_conv_init();
+
+	switch (kernel) {
+	case OSMO_CONV_BATCH_SCALAR:
+		return 1;
+#if defined(HAVE_AVX2)
+	case OSMO_CONV_BATCH_AVX2:
+		return avx2_supported;
+#endif
+#if defined(HAVE_AVX512BW)
+	case OSMO_CONV_BATCH_AVX512:
+		return avx512bw_supported;
+#endif
+	default:
+		return 0;
+	}
+}
+
+/*! Select the kernel used by osmo_conv_decode_batch()
+ *  \param[in] kernel kernel to use from now on
+ *  \returns 0 on success; -ENOTSUP if not supported on this CPU
+ *
+ * By default the widest kernel supported by the CPU is used, this is
+ * mostly useful to compare the kernels against each other. */
+int osmo_conv_batch_set_kernel(enum osmo_conv_batch_kernel kernel)
+{
+	if (!osmo_conv_batch_kernel_supported(kernel))
+		return -ENOTSUP;
+
+	switch (kernel) {
+#if defined(HAVE_AVX2)
+	case OSMO_CONV_BATCH_AVX2:
+		batch_kernel = &batch_avx2;
+		break;
+#endif
+#if defined(HAVE_AVX512BW)
+	case OSMO_CONV_BATCH_AVX512:
+		batch_kernel = &batch_avx512;
+		break;
+#endif
+	default:
+		batch_kernel = NULL;
+		break;
+	}
+
+	return 0;
+}
+
+/*! Get the kernel used by osmo_conv_decode_batch()
+ *  \returns currently selected kernel */
+enum osmo_conv_batch_kernel osmo_conv_batch_get_kernel(void)
+{
+	if (!init_complete)
+		osmo_conv_init();
+
+	return batch_kernel ? batch_kernel->id : OSMO_CONV_BATCH_SCALAR;
+}
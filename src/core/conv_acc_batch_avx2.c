@@ -0,0 +1,63 @@
+/*! \file conv_acc_batch_avx2.c
+ * Accelerated multi-codeword Viterbi decoder implementation
+ * for architectures with AVX2 support (16 codewords per pass). */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#include <immintrin.h>
+
+#define AVX2_ALIGN 32
+
+#define BATCH_LANES		16
+#define BATCH_VEC		__m256i
+#define BATCH_LOAD(P)		_mm256_load_si256((const __m256i *) (P))
+#define BATCH_STORE(P, V)	_mm256_store_si256((__m256i *) (P), V)
+#define BATCH_ZERO()		_mm256_setzero_si256()
+#define BATCH_ADD(A, B)		_mm256_add_epi16(A, B)
+#define BATCH_SUB(A, B)		_mm256_sub_epi16(A, B)
+#define BATCH_ADDS(A, B)	_mm256_adds_epi16(A, B)
+#define BATCH_SUBS(A, B)	_mm256_subs_epi16(A, B)
+#define BATCH_MAX(A, B)		_mm256_max_epi16(A, B)
+#define BATCH_MIN(A, B)		_mm256_min_epi16(A, B)
+
+/* There is no 16-bit movemask, so each lane shows up as two adjacent
+ * bits and the decoder reads bit (2 * lane). */
+#define BATCH_DECISION(A, B) \
+	((uint32_t) _mm256_movemask_epi8(_mm256_cmpgt_epi16(B, A)))
+
+/**
+ * Include common batch implementation
+ */
+#include <conv_acc_batch_impl.h>
+
+/* Aligned Memory Allocator */
+__attribute__ ((visibility("hidden")))
+void *osmo_conv_avx2_batch_malloc(size_t size)
+{
+	return _mm_malloc(size, AVX2_ALIGN);
+}
+
+__attribute__ ((visibility("hidden")))
+void osmo_conv_avx2_batch_free(void *ptr)
+{
+	_mm_free(ptr);
+}
+
+BATCH_METRICS_ALL(avx2)
@@ -0,0 +1,59 @@
+/*! \file conv_acc_batch_avx512.c
+ * Accelerated multi-codeword Viterbi decoder implementation
+ * for architectures with AVX-512BW support (32 codewords per pass). */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#include <immintrin.h>
+
+#define AVX512_ALIGN 64
+
+#define BATCH_LANES		32
+#define BATCH_VEC		__m512i
+#define BATCH_LOAD(P)		_mm512_load_si512((const void *) (P))
+#define BATCH_STORE(P, V)	_mm512_store_si512((void *) (P), V)
+#define BATCH_ZERO()		_mm512_setzero_si512()
+#define BATCH_ADD(A, B)		_mm512_add_epi16(A, B)
+#define BATCH_SUB(A, B)		_mm512_sub_epi16(A, B)
+#define BATCH_ADDS(A, B)	_mm512_adds_epi16(A, B)
+#define BATCH_SUBS(A, B)	_mm512_subs_epi16(A, B)
+#define BATCH_MAX(A, B)		_mm512_max_epi16(A, B)
+#define BATCH_MIN(A, B)		_mm512_min_epi16(A, B)
+#define BATCH_DECISION(A, B)	((uint32_t) _mm512_cmpgt_epi16_mask(B, A))
+
+/**
+ * Include common batch implementation
+ */
+#include <conv_acc_batch_impl.h>
+
+/* Aligned Memory Allocator */
+__attribute__ ((visibility("hidden")))
+void *osmo_conv_avx512_batch_malloc(size_t size)
+{
+	return _mm_malloc(size, AVX512_ALIGN);
+}
+
+__attribute__ ((visibility("hidden")))
+void osmo_conv_avx512_batch_free(void *ptr)
+{
+	_mm_free(ptr);
+}
+
+BATCH_METRICS_ALL(avx512)
@@ -0,0 +1,123 @@
+/*! \file conv_acc_batch_impl.h
+ * Accelerated Viterbi decoder implementation:
+ * Multi-codeword path metric unit which is being included
+ * from both conv_acc_batch_avx2.c and conv_acc_batch_avx512.c. */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Some distributions (notably Alpine Linux) for some strange reason
+ * don't have this #define */
+#ifndef __always_inline
+#define __always_inline         inline __attribute__((always_inline))
+#endif
+
+/* Unlike the SSE/AVX units, which spread the states of a single trellis
+ * over the register, each 16-bit element here belongs to a different
+ * codeword: one vector holds the metric of one state for BATCH_LANES
+ * independent decoders. All trellis operations are then plain vertical
+ * vector operations, no shuffles are required, and the results are
+ * bit-exact with the generic implementation for every lane.
+ *
+ * The including file defines:
+ * BATCH_LANES          - Number of 16-bit lanes (codewords) per vector
+ * BATCH_VEC            - Vector type
+ * BATCH_LOAD/STORE     - Aligned vector load and store
+ * BATCH_ZERO           - All-zero vector
+ * BATCH_ADD/SUB        - Wrapping 16-bit add and subtract
+ * BATCH_ADDS/SUBS      - Saturating 16-bit add and subtract
+ * BATCH_MAX/MIN        - Signed 16-bit maximum and minimum
+ * BATCH_DECISION(A, B) - Lane mask (uint32_t) of B > A
+ */
+
+/* Multi-codeword branch and path metrics unit
+ * Input:
+ * seq  - Received soft bits of one trellis step, N vectors [N][LANES]
+ * pat  - Output pattern of each butterfly, bit j set for a '+1' output j
+ * sums - Accumulated path metrics [NS][LANES]
+ *
+ * Output:
+ * sums - Updated accumulated path metrics
+ * dec  - Lane masks of the path decisions [NS], set where the '1' path
+ *        survived (the generic implementation stores this as 0, else -1)
+ */
+static __always_inline void _batch_metrics(int ns, int n, const int16_t *seq,
+	const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm)
+{
+	BATCH_VEC s[4], bm[16], new_sums[ns];
+	BATCH_VEC m, s0, s1, sum0, sum1, sum2, sum3, min;
+	int i, j, p;
+
+	for (j = 0; j < n; j++)
+		s[j] = BATCH_LOAD(&seq[j * BATCH_LANES]);
+
+	/* Branch metrics for each of the 2^N output patterns */
+	for (p = 0; p < (1 << n); p++) {
+		m = BATCH_ZERO();
+		for (j = 0; j < n; j++) {
+			if ((p >> j) & 0x01)
+				m = BATCH_ADD(m, s[j]);
+			else
+				m = BATCH_SUB(m, s[j]);
+		}
+		bm[p] = m;
+	}
+
+	/* Add-Compare-Select butterflies */
+	for (i = 0; i < ns / 2; i++) {
+		m = bm[pat[i]];
+		s0 = BATCH_LOAD(&sums[(2 * i + 0) * BATCH_LANES]);
+		s1 = BATCH_LOAD(&sums[(2 * i + 1) * BATCH_LANES]);
+
+		sum0 = BATCH_ADDS(s0, m);
+		sum1 = BATCH_SUBS(s1, m);
+		sum2 = BATCH_SUBS(s0, m);
+		sum3 = BATCH_ADDS(s1, m);
+
+		new_sums[i] = BATCH_MAX(sum0, sum1);
+		new_sums[i + ns / 2] = BATCH_MAX(sum2, sum3);
+		dec[i] = BATCH_DECISION(sum0, sum1);
+		dec[i + ns / 2] = BATCH_DECISION(sum2, sum3);
+	}
+
+	/* Per-codeword normalization */
+	if (norm) {
+		min = new_sums[0];
+		for (i = 1; i < ns; i++)
+			min = BATCH_MIN(min, new_sums[i]);
+		for (i = 0; i < ns; i++)
+			new_sums[i] = BATCH_SUB(new_sums[i], min);
+	}
+
+	for (i = 0; i < ns; i++)
+		BATCH_STORE(&sums[i * BATCH_LANES], new_sums[i]);
+}
+
+/* Generate the exported units for one SIMD flavour */
+#define BATCH_METRICS(simd, k, ns, n) \
+__attribute__ ((visibility("hidden"))) \
+void osmo_conv_##simd##_batch_metrics_k##k##_n##n(const int16_t *seq, \
+	const uint8_t *pat, int16_t *sums, uint32_t *dec, int norm) \
+{ \
+	_batch_metrics(ns, n, seq, pat, sums, dec, norm); \
+}
+
+#define BATCH_METRICS_ALL(simd) \
+	BATCH_METRICS(simd, 5, 16, 2) \
+	BATCH_METRICS(simd, 5, 16, 3) \
+	BATCH_METRICS(simd, 5, 16, 4) \
+	BATCH_METRICS(simd, 7, 64, 2) \
+	BATCH_METRICS(simd, 7, 64, 3) \
+	BATCH_METRICS(simd, 7, 64, 4)
@@ -24,11 +24,19 @@
  *
  *  \file crcXXgen.c.tpl */
 
+#include "config.h"
+
 #include <stdint.h>
 
 #include <osmocom/core/bits.h>
 #include <osmocom/core/crcXXgen.h>
 
+#ifdef HAVE_PCLMUL
+__attribute__ ((visibility("hidden")))
+uint64_t osmo_crc_clmul_blocks(uint64_t crc, int bits, uint64_t poly, uint64_t mu,
+			       const pbit_t *in, unsigned int num, int lsb_mode);
+#endif
+
 
 /*! Compute the CRC value of a given array of hard-bits
  *  \param[in] code The CRC code description to apply
@@ -53,7 +61,7 @@ osmo_crcXXgen_compute_bits(const struct osmo_crcXXgen_code *code,
 		} else {
 			crc <<= 1;
 		}
-		crc &= ((uintXX_t)1 << code->bits) - 1;
+		crc &= (uintXX_t)~0 >> (XX - code->bits);
 	}
 
 	crc ^= code->remainder;
@@ -109,6 +117,168 @@ osmo_crcXXgen_set_bits(const struct osmo_crcXXgen_code *code,
 		crc_bits[i] = ((crc >> (code->bits-i-1)) & 1);
 }
 
+
+/*! Generate the tables of a CRC code for the packed bits routines
+ *  \param[out] table Caller-allocated tables to fill in
+ *  \param[in] code The CRC code description to generate the tables for
+ *
+ * The code must stay valid as long as the table is used.
+ */
+void
+osmo_crcXXgen_table_init(struct osmo_crcXXgen_table *table,
+                         const struct osmo_crcXXgen_code *code)
+{
+	const uintXX_t msb = (uintXX_t)1 << (XX-1);
+	const uintXX_t poly = code->poly << (XX - code->bits);
+	uintXX_t crc;
+	uint64_t mu;
+	int i, j, fb;
+
+	table->code = code;
+
+	/* State (kept in the upper code->bits bits) after shifting in
+	 * each byte value, starting from zero */
+	for (i=0; i<256; i++) {
+		crc = (uintXX_t)i << (XX-8);
+		for (j=0; j<8; j++)
+			crc = (crc & msb) ? (crc << 1) ^ poly : crc << 1;
+		table->tab[i] = crc;
+	}
+
+	/* The feedback bits of dividing x^64 * x^bits by the polynom are the
+	 * quotient: the first one is x^64, the 64 others are kept */
+	crc = 0;
+	mu = 0;
+	for (i=0; i<65; i++) {
+		fb = !!(crc & msb) ^ (i == 0);
+		crc = fb ? (crc << 1) ^ poly : crc << 1;
+		mu = (mu << 1) | fb;
+	}
+	table->clmul_mu = mu;
+
+	table->clmul = 0;
+#if defined(HAVE_PCLMUL) && defined(HAVE___BUILTIN_CPU_SUPPORTS)
+	table->clmul = !!__builtin_cpu_supports("pclmul");
+#endif
+}
+
+static inline uint8_t
+_crcXXgen_get_byte(const pbit_t *in, int i, int lsb_mode)
+{
+	uint8_t b = in[i];
+
+	if (lsb_mode) {
+		b = (b & 0xf0) >> 4 | (b & 0x0f) << 4;
+		b = (b & 0xcc) >> 2 | (b & 0x33) << 2;
+		b = (b & 0xaa) >> 1 | (b & 0x55) << 1;
+	}
+	return b;
+}
+
+/*! Compute the CRC value of a given array of packed bits
+ *  \param[in] table The tables of the CRC code to apply
+ *  \param[in] in Array of packed bits
+ *  \param[in] len Number of bits in the array
+ *  \param[in] lsb_mode Bits are packed LSB first (like osmo_ubit2pbit_ext())
+ *  \returns The CRC value
+ *
+ * Gives the same result as osmo_crcXXgen_compute_bits() on the unpacked
+ * bits, but processes whole bytes with a table lookup each, or blocks of
+ * 8 bytes with two carry-less multiplications where the CPU supports them.
+ */
+uintXX_t
+osmo_crcXXgen_compute_pbits(const struct osmo_crcXXgen_table *table,
+                            const pbit_t *in, int len, int lsb_mode)
+{
+	const struct osmo_crcXXgen_code *code = table->code;
+	const int shift = XX - code->bits;
+	const uintXX_t poly = code->poly << shift;
+	uintXX_t crc = code->init << shift;
+	int i, bit, bytes = len / 8;
+
+#ifdef HAVE_PCLMUL
+	if (table->clmul && bytes >= 8) {
+		unsigned int blocks = bytes / 8;
+
+		crc = osmo_crc_clmul_blocks(crc >> shift, code->bits, code->poly,
+					    table->clmul_mu, in, blocks, lsb_mode) << shift;
+		in += blocks * 8;
+		bytes -= blocks * 8;
+		len -= blocks * 64;
+	}
+#endif
+
+	for (i=0; i<bytes; i++)
+		crc = (crc << 8) ^ table->tab[(crc >> (XX-8)) ^ _crcXXgen_get_byte(in, i, lsb_mode)];
+
+	/* Remaining bits of the last byte */
+	for (i=bytes*8; i<len; i++) {
+		bit = (in[i/8] >> (lsb_mode ? i%8 : 7-i%8)) & 1;
+		if (bit ^ !!(crc >> (XX-1)))
+			crc = (crc << 1) ^ poly;
+		else
+			crc <<= 1;
+	}
+
+	crc = (crc >> shift) ^ code->remainder;
+
+	return crc;
+}
+
+
+/*! Checks the CRC value of a given array of packed bits
+ *  \param[in] table The tables of the CRC code to apply
+ *  \param[in] in Array of packed bits
+ *  \param[in] len Number of bits in the array
+ *  \param[in] lsb_mode Bits are packed LSB first (like osmo_ubit2pbit_ext())
+ *  \param[in] crc_bits Array of hard bits with the alleged CRC
+ *  \returns 0 if CRC matches. 1 in case of error.
+ *
+ * The crc_bits array must have a length of code->len
+ */
+int
+osmo_crcXXgen_check_pbits(const struct osmo_crcXXgen_table *table,
+                          const pbit_t *in, int len, int lsb_mode,
+                          const ubit_t *crc_bits)
+{
+	const int n = table->code->bits;
+	uintXX_t crc;
+	int i;
+
+	crc = osmo_crcXXgen_compute_pbits(table, in, len, lsb_mode);
+
+	for (i=0; i<n; i++)
+		if (crc_bits[i] ^ ((crc >> (n-i-1)) & 1))
+			return 1;
+
+	return 0;
+}
+
+
+/*! Computes and writes the CRC value of a given array of packed bits
+ *  \param[in] table The tables of the CRC code to apply
+ *  \param[in] in Array of packed bits
+ *  \param[in] len Number of bits in the array
+ *  \param[in] lsb_mode Bits are packed LSB first (like osmo_ubit2pbit_ext())
+ *  \param[in] crc_bits Array of hard bits to write the computed CRC to
+ *
+ * The crc_bits array must have a length of code->len
+ */
+void
+osmo_crcXXgen_set_pbits(const struct osmo_crcXXgen_table *table,
+                        const pbit_t *in, int len, int lsb_mode,
+                        ubit_t *crc_bits)
+{
+	const int n = table->code->bits;
+	uintXX_t crc;
+	int i;
+
+	crc = osmo_crcXXgen_compute_pbits(table, in, len, lsb_mode);
+
+	for (i=0; i<n; i++)
+		crc_bits[i] = ((crc >> (n-i-1)) & 1);
+}
+
 /*! @} */
 
 /* vim: set syntax=c: */
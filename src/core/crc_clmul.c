@@ -0,0 +1,77 @@
+/*! \file crc_clmul.c
+ * Generic CRC computation over blocks of 64 packed bits
+ * for architectures with PCLMULQDQ (carry-less multiplication) support. */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include "config.h"
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#include <osmocom/core/bits.h>
+
+/* Reverse the bit order within each byte */
+static inline uint64_t revbytebits_64(uint64_t x)
+{
+	x = (x & 0x5555555555555555ULL) << 1 | (x & 0xaaaaaaaaaaaaaaaaULL) >> 1;
+	x = (x & 0x3333333333333333ULL) << 2 | (x & 0xccccccccccccccccULL) >> 2;
+	x = (x & 0x0f0f0f0f0f0f0f0fULL) << 4 | (x & 0xf0f0f0f0f0f0f0f0ULL) >> 4;
+	return x;
+}
+
+/*! Shift blocks of 64 bits into a CRC state
+ *  \param[in] crc CRC state (bits wide, right-aligned)
+ *  \param[in] bits Number of bits of the CRC, 1..64
+ *  \param[in] poly Polynom (normal representation, MSB omitted)
+ *  \param[in] mu floor(x^(64+bits) / poly) without the x^64 term
+ *  \param[in] in Packed input bits
+ *  \param[in] num Number of 8 byte blocks to process
+ *  \param[in] lsb_mode Bits are packed LSB first
+ *  \returns the CRC state after the last block
+ *
+ * With A = crc * x^(64-bits) + block, the new state is A * x^bits mod P,
+ * computed with a Barrett reduction: the quotient is A + (A * mu) / x^64,
+ * and the remainder the low bits of quotient * P, since A * x^bits has
+ * none there.
+ */
+__attribute__ ((visibility("hidden")))
+uint64_t osmo_crc_clmul_blocks(uint64_t crc, int bits, uint64_t poly, uint64_t mu,
+			       const pbit_t *in, unsigned int num, int lsb_mode)
+{
+	const __m128i k = _mm_set_epi64x(mu, poly);
+	const uint64_t mask = ~(uint64_t)0 >> (64 - bits);
+	uint64_t d;
+	__m128i a, q;
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		d = osmo_load64be(&in[i * 8]);
+		if (lsb_mode)
+			d = revbytebits_64(d);
+		d ^= crc << (64 - bits);
+
+		a = _mm_loadl_epi64((const __m128i *) &d);
+		q = _mm_clmulepi64_si128(a, k, 0x10);
+		q = _mm_xor_si128(a, _mm_srli_si128(q, 8));
+		q = _mm_clmulepi64_si128(q, k, 0x00);
+		_mm_storel_epi64((__m128i *) &crc, q);
+		crc &= mask;
+	}
+
+	return crc;
+}
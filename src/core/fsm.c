@@ -22,7 +22,13 @@
 #include <inttypes.h>
 
 #include <osmocom/core/fsm.h>
+#include <osmocom/core/hashtable.h>
+#include <osmocom/core/jhash.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/stats.h>
 #include <osmocom/core/talloc.h>
+#include <osmocom/core/timer_compat.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
 
@@ -84,6 +90,8 @@
  * \file fsm.c */
 
 LLIST_HEAD(osmo_g_fsms);
+/*! registered FSMs by name, see osmo_fsm_find_by_name() */
+static DEFINE_HASHTABLE(fsm_by_name, 7);
 static bool fsm_log_addr = true;
 static bool fsm_log_timeouts = false;
 /*! See osmo_fsm_term_safely(). */
@@ -232,16 +240,489 @@ static void osmo_fsm_defer_free(void *talloc_object)
 	talloc_steal(fsm_term_safely.collect_ctx, talloc_object);
 }
 
+/*! Hash index of the instances of one FSM, see osmo_fsm_set_inst_index().
+ * Both tables have the same size, a power of two that grows with the number of indexed instances. */
+struct osmo_fsm_inst_index {
+	/*! instances with an id, hashed by fi->id */
+	struct hlist_head *by_id;
+	/*! all indexed instances, hashed by fi->name */
+	struct hlist_head *by_name;
+	/*! size of by_id and by_name minus one */
+	uint32_t mask;
+	/*! number of instances in by_name */
+	unsigned int num;
+};
+
+#define FSM_INST_INDEX_MIN_SIZE 64
+
+static inline uint32_t fsm_str_hash(const char *str)
+{
+	return osmo_jhash(str, strlen(str), 0);
+}
+
+/* allocate both tables of the index with the given size, a power of two */
+static int inst_index_alloc_tables(struct osmo_fsm_inst_index *idx, uint32_t size)
+{
+	struct hlist_head *by_id, *by_name;
+
+	/* an all zero hlist_head is an empty list */
+	by_id = talloc_zero_array(idx, struct hlist_head, size);
+	by_name = talloc_zero_array(idx, struct hlist_head, size);
+	if (!by_id || !by_name) {
+		talloc_free(by_id);
+		talloc_free(by_name);
+		return -ENOMEM;
+	}
+	talloc_free(idx->by_id);
+	talloc_free(idx->by_name);
+	idx->by_id = by_id;
+	idx->by_name = by_name;
+	idx->mask = size - 1;
+	return 0;
+}
+
+static void inst_index_hash(struct osmo_fsm_inst_index *idx, struct osmo_fsm_inst *fi)
+{
+	if (fi->id)
+		hlist_add_head(&fi->node_by_id, &idx->by_id[fsm_str_hash(fi->id) & idx->mask]);
+	hlist_add_head(&fi->node_by_name, &idx->by_name[fsm_str_hash(fi->name) & idx->mask]);
+}
+
+/* Add an instance to the index of its FSM, if enabled, after its id and name were set. */
+static void inst_index_add(struct osmo_fsm_inst *fi)
+{
+	struct osmo_fsm_inst_index *idx = fi->fsm->inst_index;
+	struct osmo_fsm_inst *i;
+
+	if (!idx || !fi->name)
+		return;
+
+	if (idx->num >= idx->mask + 1 && inst_index_alloc_tables(idx, (idx->mask + 1) * 2) == 0) {
+		/* Re-hash everything that was in the old tables. fi itself is not hashed yet, and may not even be
+		 * in fsm->instances yet when called from osmo_fsm_inst_alloc(). */
+		llist_for_each_entry(i, &fi->fsm->instances, list) {
+			if (hlist_unhashed(&i->node_by_name))
+				continue;
+			inst_index_hash(idx, i);
+		}
+	}
+
+	inst_index_hash(idx, fi);
+	idx->num++;
+}
+
+/* Remove an instance from the index of its FSM, if it is in there, before its id or name change. */
+static void inst_index_del(struct osmo_fsm_inst *fi)
+{
+	if (hlist_unhashed(&fi->node_by_name))
+		return;
+	hlist_del_init(&fi->node_by_id);
+	hlist_del_init(&fi->node_by_name);
+	fi->fsm->inst_index->num--;
+}
+
+/*! Enable or disable a hash index of the instances of an FSM by id and by name.
+ *
+ * By default, osmo_fsm_inst_find_by_id() and osmo_fsm_inst_find_by_name() walk the list of all instances of the FSM.
+ * For FSMs with many instances that are looked up frequently, e.g. per subscriber, enabling the index makes these
+ * lookups take constant time, at the cost of hashing the id and name whenever an instance is allocated or its id
+ * changes. The index can be enabled at any time, instances that exist already are added to it.
+ *
+ * \param[in] fsm  FSM class to enable or disable the index for.
+ * \param[in] enable  true to index the instances, false to drop the index again.
+ * \returns 0 on success, -ENOMEM if the index cannot be allocated.
+ */
+int osmo_fsm_set_inst_index(struct osmo_fsm *fsm, bool enable)
+{
+	struct osmo_fsm_inst_index *idx = fsm->inst_index;
+	struct osmo_fsm_inst *fi;
+	unsigned int num = 0;
+	uint32_t size = FSM_INST_INDEX_MIN_SIZE;
+
+	if (!enable) {
+		if (!idx)
+			return 0;
+		llist_for_each_entry(fi, &fsm->instances, list) {
+			INIT_HLIST_NODE(&fi->node_by_id);
+			INIT_HLIST_NODE(&fi->node_by_name);
+		}
+		fsm->inst_index = NULL;
+		talloc_free(idx);
+		return 0;
+	}
+
+	if (idx)
+		return 0;
+
+	llist_for_each_entry(fi, &fsm->instances, list)
+		num++;
+	while (size < num)
+		size *= 2;
+
+	idx = talloc_zero(NULL, struct osmo_fsm_inst_index);
+	if (!idx)
+		return -ENOMEM;
+	talloc_set_name(idx, "osmo_fsm_inst_index(%s)", fsm->name);
+	if (inst_index_alloc_tables(idx, size) < 0) {
+		talloc_free(idx);
+		return -ENOMEM;
+	}
+
+	llist_for_each_entry(fi, &fsm->instances, list)
+		inst_index_hash(idx, fi);
+	idx->num = num;
+	fsm->inst_index = idx;
+	return 0;
+}
+
+/*! Free instances of one FSM kept for re-use, see osmo_fsm_set_inst_cache(). */
+struct osmo_fsm_inst_cache {
+	/*! cached instances, linked by fi->list */
+	struct llist_head cached;
+	/*! number of instances in cached */
+	unsigned int num;
+	/*! maximum number of instances kept in cached */
+	unsigned int max;
+};
+
+/* Take an instance from the cache of fsm and move it to ctx, or return NULL if there is none. */
+static struct osmo_fsm_inst *inst_cache_get(struct osmo_fsm *fsm, void *ctx)
+{
+	struct osmo_fsm_inst_cache *cache = fsm->inst_cache;
+	struct osmo_fsm_inst *fi;
+
+	if (!cache || llist_empty(&cache->cached))
+		return NULL;
+
+	fi = llist_first_entry(&cache->cached, struct osmo_fsm_inst, list);
+	llist_del(&fi->list);
+	cache->num--;
+	talloc_steal(ctx, fi);
+	talloc_set_name_const(fi, "struct osmo_fsm_inst");
+	memset(fi, 0, sizeof(*fi));
+	return fi;
+}
+
+/* Put a terminated instance into the cache of its FSM instead of deallocating it, after deallocating everything that
+ * belongs to it. Returns true if it was taken. */
+static bool inst_cache_put(struct osmo_fsm_inst *fi)
+{
+#if defined(EMBEDDED)
+	/* talloc_free_children() and talloc_reference_count() are not available with pseudotalloc */
+	return false;
+#else
+	struct osmo_fsm_inst_cache *cache = fi->fsm->inst_cache;
+
+	/* Only when deallocating right away; something referencing the instance or having asked to keep deallocated
+	 * instances around (osmo_fsm_set_dealloc_ctx()) also expects to find the memory as it was. */
+	if (!cache || cache->num >= cache->max || fsm_term_safely.fsm_dealloc_ctx)
+		return false;
+	if (talloc_reference_count(fi) != 0)
+		return false;
+
+	talloc_free_children(fi);
+	talloc_steal(cache, fi);
+	talloc_set_name_const(fi, "osmo_fsm_inst_cached");
+	llist_add(&fi->list, &cache->cached);
+	cache->num++;
+	return true;
+#endif
+}
+
+/*! Keep up to max_cached deallocated instances of an FSM for re-use by osmo_fsm_inst_alloc().
+ *
+ * For FSMs whose instances are allocated and deallocated at a high rate, this saves a memory allocation and
+ * deallocation per instance, and keeps the instances from fragmenting the heap. An instance is only re-used if it is
+ * deallocated directly by osmo_fsm_inst_free(), i.e. not via its talloc parent or as part of a cascade of terminating
+ * FSM instances collected by osmo_fsm_term_safely(). Talloc children of the instance are still deallocated along with
+ * it, but the instance must not have a talloc destructor.
+ *
+ * \param[in] fsm  FSM class to enable the cache for.
+ * \param[in] max_cached  Maximum number of instances to keep, 0 to disable the cache and deallocate cached instances.
+ * \returns 0 on success, -ENOMEM if the cache cannot be allocated, -ENOTSUP on embedded builds.
+ */
+int osmo_fsm_set_inst_cache(struct osmo_fsm *fsm, unsigned int max_cached)
+{
+	struct osmo_fsm_inst_cache *cache = fsm->inst_cache;
+
+#if defined(EMBEDDED)
+	if (max_cached)
+		return -ENOTSUP;
+#endif
+
+	if (!max_cached) {
+		fsm->inst_cache = NULL;
+		talloc_free(cache);
+		return 0;
+	}
+
+	if (!cache) {
+		cache = talloc_zero(NULL, struct osmo_fsm_inst_cache);
+		if (!cache)
+			return -ENOMEM;
+		talloc_set_name(cache, "osmo_fsm_inst_cache(%s)", fsm->name);
+		INIT_LLIST_HEAD(&cache->cached);
+		fsm->inst_cache = cache;
+	}
+
+	cache->max = max_cached;
+	while (cache->num > cache->max) {
+		struct osmo_fsm_inst *fi = llist_first_entry(&cache->cached, struct osmo_fsm_inst, list);
+		llist_del(&fi->list);
+		talloc_free(fi);
+		cache->num--;
+	}
+	return 0;
+}
+
+/*! Statistics of the states and events of one FSM, see osmo_fsm_set_stats(). */
+struct osmo_fsm_stats {
+	/*! statistics by state, fsm->num_states entries */
+	struct osmo_fsm_state_stats *states;
+	/*! index of the counter in ctrg plus one by state * 32 + event, 0 for events not permitted in the state */
+	unsigned int *event_ctr;
+	/*! counters "event:STATE:EVENT" of the events permitted in each state, NULL if there are none */
+	struct rate_ctr_group *ctrg;
+	/*! items "state:STATE:residency" and "state:STATE:action" of each state, in this order */
+	struct osmo_stat_item_group *statg;
+};
+
+/* index of the next rate counter and stat item groups of FSM statistics */
+static unsigned int fsm_stats_idx;
+
+static inline uint64_t fsm_stats_now_ns(clockid_t clk_id)
+{
+	struct timespec ts;
+
+	osmo_clock_gettime(clk_id, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Record a duration in the histogram h and report it in microseconds via the stat item with index item_idx. */
+static void fsm_stats_hist_add(struct osmo_fsm_stats *stats, struct osmo_fsm_hist *h, unsigned int item_idx,
+			       uint64_t ns)
+{
+	unsigned int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+
+	h->count++;
+	h->sum_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+	h->buckets[OSMO_MIN(bucket, OSMO_FSM_HIST_BUCKETS - 1)]++;
+	osmo_stat_item_set(osmo_stat_item_group_get_item(stats->statg, item_idx), OSMO_MIN(ns / 1000, INT32_MAX));
+}
+
+/* Record the time fi spent in its current state, if it is known. */
+static void fsm_stats_leave_state(struct osmo_fsm_inst *fi, uint64_t now_ns)
+{
+	struct osmo_fsm_stats *stats = fi->fsm->stats;
+
+	if (!fi->state_entered_ns)
+		return;
+	fsm_stats_hist_add(stats, &stats->states[fi->state].residency, 2 * fi->state, now_ns - fi->state_entered_ns);
+}
+
+/* Count an event dispatched to fi in its current state. */
+static void fsm_stats_event(struct osmo_fsm_inst *fi, uint32_t event)
+{
+	struct osmo_fsm_stats *stats = fi->fsm->stats;
+	unsigned int ctr;
+
+	if (event >= 32)
+		return;
+	stats->states[fi->state].events[event]++;
+	ctr = stats->event_ctr[fi->state * 32 + event];
+	if (ctr)
+		rate_ctr_inc2(stats->ctrg, ctr - 1);
+}
+
+/* Run the action for an event dispatched to fi, and record the CPU time it takes. */
+static void fsm_stats_action(struct osmo_fsm_inst *fi,
+			     void (*action)(struct osmo_fsm_inst *fi, uint32_t event, void *data),
+			     uint32_t event, void *data)
+{
+	struct osmo_fsm_stats *stats = fi->fsm->stats;
+	uint32_t state = fi->state;
+	uint64_t start_ns = fsm_stats_now_ns(CLOCK_THREAD_CPUTIME_ID);
+
+	action(fi, event, data);
+	/* fi may be gone by now */
+	fsm_stats_hist_add(stats, &stats->states[state].action, 2 * state + 1,
+			   fsm_stats_now_ns(CLOCK_THREAD_CPUTIME_ID) - start_ns);
+}
+
+/* Set up the counters and stat items of stats, see struct osmo_fsm_stats. */
+static int fsm_stats_alloc_groups(struct osmo_fsm *fsm, struct osmo_fsm_stats *stats)
+{
+	struct rate_ctr_desc *ctr_desc;
+	struct osmo_stat_item_desc *item_desc;
+	const struct rate_ctr_group_desc *ctrg_desc;
+	const struct osmo_stat_item_group_desc *statg_desc;
+	unsigned int s, e, num_ctr = 0;
+	char *name;
+
+	for (s = 0; s < fsm->num_states; s++) {
+		for (e = 0; e < 32; e++) {
+			if ((fsm->states[s].in_event_mask | fsm->allstate_event_mask) & (1U << e))
+				stats->event_ctr[s * 32 + e] = ++num_ctr;
+		}
+	}
+
+	ctr_desc = talloc_zero_array(stats, struct rate_ctr_desc, num_ctr);
+	item_desc = talloc_zero_array(stats, struct osmo_stat_item_desc, 2 * fsm->num_states);
+	if ((num_ctr && !ctr_desc) || !item_desc)
+		return -ENOMEM;
+
+	for (s = 0; s < fsm->num_states; s++) {
+		const char *state_name = osmo_fsm_state_name(fsm, s);
+
+		for (e = 0; e < 32; e++) {
+			unsigned int ctr = stats->event_ctr[s * 32 + e];
+			if (!ctr)
+				continue;
+			name = talloc_asprintf(ctr_desc, "event:%s:%s", state_name, osmo_fsm_event_name(fsm, e));
+			osmo_identifier_sanitize_buf(name, NULL, '-');
+			ctr_desc[ctr - 1].name = name;
+			ctr_desc[ctr - 1].description = talloc_asprintf(ctr_desc, "Events %s dispatched in state %s",
+									osmo_fsm_event_name(fsm, e), state_name);
+		}
+
+		name = talloc_asprintf(item_desc, "state:%s:residency", state_name);
+		osmo_identifier_sanitize_buf(name, NULL, '-');
+		item_desc[2 * s] = (struct osmo_stat_item_desc){
+			.name = name,
+			.description = talloc_asprintf(item_desc, "Time spent in state %s", state_name),
+			.unit = "us",
+		};
+		name = talloc_asprintf(item_desc, "state:%s:action", state_name);
+		osmo_identifier_sanitize_buf(name, NULL, '-');
+		item_desc[2 * s + 1] = (struct osmo_stat_item_desc){
+			.name = name,
+			.description = talloc_asprintf(item_desc, "CPU time of the actions in state %s", state_name),
+			.unit = "us",
+		};
+	}
+
+	if (num_ctr) {
+		ctrg_desc = talloc_memdup(stats, (&(struct rate_ctr_group_desc){
+				.group_name_prefix = "fsm",
+				.group_description = "FSM events",
+				.class_id = OSMO_STATS_CLASS_GLOBAL,
+				.num_ctr = num_ctr,
+				.ctr_desc = ctr_desc,
+			}), sizeof(*ctrg_desc));
+		if (!ctrg_desc)
+			return -ENOMEM;
+		stats->ctrg = rate_ctr_group_alloc(stats, ctrg_desc, fsm_stats_idx);
+		if (!stats->ctrg)
+			return -ENOMEM;
+		rate_ctr_group_set_name(stats->ctrg, fsm->name);
+	}
+
+	statg_desc = talloc_memdup(stats, (&(struct osmo_stat_item_group_desc){
+			.group_name_prefix = "fsm",
+			.group_description = "FSM states",
+			.class_id = OSMO_STATS_CLASS_GLOBAL,
+			.num_items = 2 * fsm->num_states,
+			.item_desc = item_desc,
+		}), sizeof(*statg_desc));
+	if (!statg_desc)
+		return -ENOMEM;
+	stats->statg = osmo_stat_item_group_alloc(stats, statg_desc, fsm_stats_idx);
+	if (!stats->statg)
+		return -ENOMEM;
+	osmo_stat_item_group_set_name(stats->statg, fsm->name);
+
+	fsm_stats_idx++;
+	return 0;
+}
+
+/*! Enable or disable statistics of the states and events of an FSM.
+ *
+ * With statistics enabled, the FSM records for each state how long instances stay in it, how often each event is
+ * dispatched in it and how much CPU time the state's action (or the allstate_action) takes for an event, in
+ * histograms that can be retrieved with osmo_fsm_state_stats() and are shown by the 'show fsm NAME statistics' VTY
+ * command. The durations are also reported in microseconds via the stat items "state:STATE:residency" and
+ * "state:STATE:action" of a stat item group "fsm" named like the FSM, and the events permitted in each state are
+ * counted by the counters "event:STATE:EVENT" of a rate counter group "fsm" named like the FSM.
+ *
+ * The cost is reading the clock on each state change and twice for each event dispatched. The time instances spend
+ * in the state they are in when statistics are enabled is not recorded. Disabling the statistics drops all of them.
+ * This must not be called from the callbacks of the FSM itself.
+ *
+ * \param[in] fsm  FSM class to enable or disable the statistics for.
+ * \param[in] enable  true to record statistics, false to drop them again.
+ * \returns 0 on success, -ENOMEM if the statistics cannot be allocated.
+ */
+int osmo_fsm_set_stats(struct osmo_fsm *fsm, bool enable)
+{
+	struct osmo_fsm_stats *stats = fsm->stats;
+	struct osmo_fsm_inst *fi;
+
+	if (!enable) {
+		if (!stats)
+			return 0;
+		fsm->stats = NULL;
+		llist_for_each_entry(fi, &fsm->instances, list)
+			fi->state_entered_ns = 0;
+		rate_ctr_group_free(stats->ctrg);
+		osmo_stat_item_group_free(stats->statg);
+		talloc_free(stats);
+		return 0;
+	}
+
+	if (stats)
+		return 0;
+
+	stats = talloc_zero(NULL, struct osmo_fsm_stats);
+	if (!stats)
+		return -ENOMEM;
+	talloc_set_name(stats, "osmo_fsm_stats(%s)", fsm->name);
+	stats->states = talloc_zero_array(stats, struct osmo_fsm_state_stats, fsm->num_states);
+	stats->event_ctr = talloc_zero_array(stats, unsigned int, fsm->num_states * 32);
+	if (!stats->states || !stats->event_ctr || fsm_stats_alloc_groups(fsm, stats) < 0) {
+		rate_ctr_group_free(stats->ctrg);
+		osmo_stat_item_group_free(stats->statg);
+		talloc_free(stats);
+		return -ENOMEM;
+	}
+
+	fsm->stats = stats;
+	return 0;
+}
+
+/*! Get the statistics of one state of an FSM, see osmo_fsm_set_stats().
+ * \param[in] fsm  FSM class.
+ * \param[in] state  State number.
+ * \returns the statistics, or NULL if statistics are not enabled for the FSM or the state does not exist.
+ */
+const struct osmo_fsm_state_stats *osmo_fsm_state_stats(const struct osmo_fsm *fsm, uint32_t state)
+{
+	if (!fsm->stats || state >= fsm->num_states)
+		return NULL;
+	return &fsm->stats->states[state];
+}
+
+/*! Find a registered FSM by its name.
+ * \param[in] name  Name of the FSM, as in osmo_fsm.name.
+ * \returns the FSM, or NULL if no FSM of that name is registered.
+ */
 struct osmo_fsm *osmo_fsm_find_by_name(const char *name)
 {
 	struct osmo_fsm *fsm;
-	llist_for_each_entry(fsm, &osmo_g_fsms, list) {
+	hash_for_each_possible(fsm_by_name, fsm, node_by_name, fsm_str_hash(name)) {
 		if (!strcmp(name, fsm->name))
 			return fsm;
 	}
 	return NULL;
 }
 
+/*! Find an instance of an FSM by its name.
+ * Takes constant time if the index of the FSM is enabled, see osmo_fsm_set_inst_index().
+ * \param[in] fsm  FSM class of the instance.
+ * \param[in] name  Name of the instance, as in osmo_fsm_inst.name.
+ * \returns the instance, or NULL if there is none with that name.
+ */
 struct osmo_fsm_inst *osmo_fsm_inst_find_by_name(const struct osmo_fsm *fsm,
 						 const char *name)
 {
@@ -250,6 +731,15 @@ struct osmo_fsm_inst *osmo_fsm_inst_find_by_name(const struct osmo_fsm *fsm,
 	if (!name)
 		return NULL;
 
+	if (fsm->inst_index) {
+		struct osmo_fsm_inst_index *idx = fsm->inst_index;
+		hlist_for_each_entry(fi, &idx->by_name[fsm_str_hash(name) & idx->mask], node_by_name) {
+			if (!strcmp(name, fi->name))
+				return fi;
+		}
+		return NULL;
+	}
+
 	llist_for_each_entry(fi, &fsm->instances, list) {
 		if (!fi->name)
 			continue;
@@ -259,12 +749,32 @@ struct osmo_fsm_inst *osmo_fsm_inst_find_by_name(const struct osmo_fsm *fsm,
 	return NULL;
 }
 
+/*! Find an instance of an FSM by its id.
+ * Takes constant time if the index of the FSM is enabled, see osmo_fsm_set_inst_index().
+ * \param[in] fsm  FSM class of the instance.
+ * \param[in] id  Id of the instance, as in osmo_fsm_inst.id.
+ * \returns an instance with that id, or NULL if there is none.
+ */
 struct osmo_fsm_inst *osmo_fsm_inst_find_by_id(const struct osmo_fsm *fsm,
 						const char *id)
 {
 	struct osmo_fsm_inst *fi;
 
+	if (!id)
+		return NULL;
+
+	if (fsm->inst_index) {
+		struct osmo_fsm_inst_index *idx = fsm->inst_index;
+		hlist_for_each_entry(fi, &idx->by_id[fsm_str_hash(id) & idx->mask], node_by_id) {
+			if (!strcmp(id, fi->id))
+				return fi;
+		}
+		return NULL;
+	}
+
 	llist_for_each_entry(fi, &fsm->instances, list) {
+		if (!fi->id)
+			continue;
 		if (!strcmp(id, fi->id))
 			return fi;
 	}
@@ -290,6 +800,7 @@ int osmo_fsm_register(struct osmo_fsm *fsm)
 	if (fsm->event_names == NULL)
 		LOGP(DLGLOBAL, LOGL_ERROR, "FSM '%s' has no event names! Please fix!\n", fsm->name);
 	llist_add_tail(&fsm->list, &osmo_g_fsms);
+	hash_add(fsm_by_name, &fsm->node_by_name, fsm_str_hash(fsm->name));
 	INIT_LLIST_HEAD(&fsm->instances);
 
 	return 0;
@@ -305,6 +816,7 @@ int osmo_fsm_register(struct osmo_fsm *fsm)
 void osmo_fsm_unregister(struct osmo_fsm *fsm)
 {
 	llist_del(&fsm->list);
+	hash_del(&fsm->node_by_name);
 }
 
 /* small wrapper function around timer expiration (for logging) */
@@ -345,11 +857,56 @@ int osmo_fsm_inst_update_id(struct osmo_fsm_inst *fi, const char *id)
 		return osmo_fsm_inst_update_id_f(fi, "%s", id);
 }
 
-static void update_name(struct osmo_fsm_inst *fi)
+/* whether p points into the inline storage of fi, or was allocated separately */
+static inline bool in_id_name_buf(const struct osmo_fsm_inst *fi, const char *p)
 {
-	if (fi->name)
+	return p >= fi->id_name_buf && p < fi->id_name_buf + sizeof(fi->id_name_buf);
+}
+
+/* Set the id of an FSM instance and compose its name. id is NULL, a valid identifier allocated as talloc child of fi
+ * that is too long for fi->id_name_buf, or a valid identifier that fits into fi->id_name_buf (and may point anywhere,
+ * even to the current fi->id). */
+static void set_id_and_name(struct osmo_fsm_inst *fi, const char *id)
+{
+	const char *old_id = fi->id;
+	char *name;
+	size_t name_off = 0, avail;
+	int len;
+
+	if (fi->name && !in_id_name_buf(fi, fi->name))
 		talloc_free((char*)fi->name);
+	fi->name = NULL;
+
+	if (id && strlen(id) < sizeof(fi->id_name_buf)) {
+		name_off = strlen(id) + 1;
+		/* id may overlap with the inline storage */
+		memmove(fi->id_name_buf, id, name_off);
+		fi->id = fi->id_name_buf;
+	} else {
+		fi->id = id;
+	}
+	if (old_id && !in_id_name_buf(fi, old_id) && old_id != fi->id)
+		talloc_free((char*)old_id);
+
+	name = fi->id_name_buf + name_off;
+	avail = sizeof(fi->id_name_buf) - name_off;
+	if (!fsm_log_addr) {
+		if (fi->id)
+			len = snprintf(name, avail, "%s(%s)", fi->fsm->name, fi->id);
+		else
+			len = snprintf(name, avail, "%s", fi->fsm->name);
+	} else {
+		if (fi->id)
+			len = snprintf(name, avail, "%s(%s)[%p]", fi->fsm->name, fi->id, fi);
+		else
+			len = snprintf(name, avail, "%s[%p]", fi->fsm->name, fi);
+	}
+	if (len >= 0 && (size_t)len < avail) {
+		fi->name = name;
+		return;
+	}
 
+	/* too long for the inline storage */
 	if (!fsm_log_addr) {
 		if (fi->id)
 			fi->name = talloc_asprintf(fi, "%s(%s)", fi->fsm->name, fi->id);
@@ -364,6 +921,8 @@ static void update_name(struct osmo_fsm_inst *fi)
 }
 
 /*! Change id of the FSM instance using a string format.
+ * The id and the name composed from it are stored inside the FSM instance if they fit, so that usually no memory is
+ * allocated.
  * \param[in] fi FSM instance.
  * \param[in] fmt format string to compose new ID.
  * \param[in] ... variable argument list for format string.
@@ -371,29 +930,38 @@ static void update_name(struct osmo_fsm_inst *fi)
  */
 int osmo_fsm_inst_update_id_f(struct osmo_fsm_inst *fi, const char *fmt, ...)
 {
+	char buf[sizeof(fi->id_name_buf)];
 	char *id = NULL;
 
 	if (fmt) {
 		va_list ap;
+		int len;
 
 		va_start(ap, fmt);
-		id = talloc_vasprintf(fi, fmt, ap);
+		len = vsnprintf(buf, sizeof(buf), fmt, ap);
 		va_end(ap);
 
+		if (len >= 0 && (size_t)len < sizeof(buf)) {
+			id = buf;
+		} else {
+			va_start(ap, fmt);
+			id = talloc_vasprintf(fi, fmt, ap);
+			va_end(ap);
+		}
+
 		if (!osmo_identifier_valid(id)) {
 			LOGP(DLGLOBAL, LOGL_ERROR,
 			     "Attempting to set illegal id for FSM instance of type '%s': %s\n",
 			     fi->fsm->name, osmo_quote_str(id, -1));
-			talloc_free(id);
+			if (id != buf)
+				talloc_free(id);
 			return -EINVAL;
 		}
 	}
 
-	if (fi->id)
-		talloc_free((char*)fi->id);
-	fi->id = id;
-
-	update_name(fi);
+	inst_index_del(fi);
+	set_id_and_name(fi, id);
+	inst_index_add(fi);
 	return 0;
 }
 
@@ -408,21 +976,28 @@ int osmo_fsm_inst_update_id_f(struct osmo_fsm_inst *fi, const char *fmt, ...)
  */
 int osmo_fsm_inst_update_id_f_sanitize(struct osmo_fsm_inst *fi, char replace_with, const char *fmt, ...)
 {
-	char *id = NULL;
+	char buf[sizeof(fi->id_name_buf)];
+	char *id = buf;
 	va_list ap;
-	int rc;
+	int len, rc;
 
 	if (!fmt)
 		return osmo_fsm_inst_update_id(fi, NULL);
 
 	va_start(ap, fmt);
-	id = talloc_vasprintf(fi, fmt, ap);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
 	va_end(ap);
+	if (len < 0 || (size_t)len >= sizeof(buf)) {
+		va_start(ap, fmt);
+		id = talloc_vasprintf(fi, fmt, ap);
+		va_end(ap);
+	}
 
 	osmo_identifier_sanitize_buf(id, NULL, replace_with);
 
 	rc = osmo_fsm_inst_update_id(fi, id);
-	talloc_free(id);
+	if (id != buf)
+		talloc_free(id);
 	return rc;
 }
 
@@ -437,7 +1012,13 @@ int osmo_fsm_inst_update_id_f_sanitize(struct osmo_fsm_inst *fi, char replace_wi
 struct osmo_fsm_inst *osmo_fsm_inst_alloc(struct osmo_fsm *fsm, void *ctx, void *priv,
 					  int log_level, const char *id)
 {
-	struct osmo_fsm_inst *fi = talloc_zero(ctx, struct osmo_fsm_inst);
+	struct osmo_fsm_inst *fi = inst_cache_get(fsm, ctx);
+
+	if (!fi) {
+		fi = talloc_zero(ctx, struct osmo_fsm_inst);
+		if (!fi)
+			return NULL;
+	}
 
 	fi->fsm = fsm;
 	fi->priv = priv;
@@ -452,6 +1033,8 @@ struct osmo_fsm_inst *osmo_fsm_inst_alloc(struct osmo_fsm *fsm, void *ctx, void
 	INIT_LLIST_HEAD(&fi->proc.children);
 	INIT_LLIST_HEAD(&fi->proc.child);
 	llist_add(&fi->list, &fsm->instances);
+	if (fsm->stats)
+		fi->state_entered_ns = fsm_stats_now_ns(CLOCK_MONOTONIC);
 
 	LOGPFSM(fi, "Allocated\n");
 
@@ -530,13 +1113,179 @@ void osmo_fsm_inst_change_parent(struct osmo_fsm_inst *fi,
 	}
 }
 
+/*! An event in the per-thread FSM event queue, see _osmo_fsm_inst_dispatch(). */
+struct fsm_queued_event {
+	/*! member in fsm_evq.events or fsm_evq.free */
+	struct llist_head list;
+	struct osmo_fsm_inst *fi;
+	uint32_t event;
+	void *data;
+	const char *file;
+	int line;
+	/*! CLOCK_MONOTONIC time at which the event was queued */
+	struct timespec queued;
+};
+
+/* maximum number of unused queue entries kept for re-use */
+#define FSM_EVQ_MAX_FREE 256
+
+/*! Per-thread queue of events for FSMs with osmo_fsm.queue_events set. Like the timers, it is processed by the
+ * osmo_select_main() of the thread that dispatched the events. */
+static __thread struct {
+	/*! queued events, in the order they were dispatched */
+	struct llist_head events;
+	/*! unused entries for re-use */
+	struct llist_head free;
+	unsigned int num_free;
+	/*! zero timeout timer to process the queue from osmo_select_main() */
+	struct osmo_timer_list timer;
+	bool initialized;
+	struct osmo_fsm_event_queue_stats stats;
+} fsm_evq;
+
+static void fsm_evq_timer_cb(void *data)
+{
+	osmo_fsm_event_queue_run();
+}
+
+static void fsm_evq_init(void)
+{
+	/* TLS cannot use LLIST_HEAD() */
+	INIT_LLIST_HEAD(&fsm_evq.events);
+	INIT_LLIST_HEAD(&fsm_evq.free);
+	osmo_timer_setup(&fsm_evq.timer, fsm_evq_timer_cb, NULL);
+	fsm_evq.initialized = true;
+}
+
+static void fsm_evq_release(struct fsm_queued_event *e)
+{
+	if (fsm_evq.num_free >= FSM_EVQ_MAX_FREE) {
+		talloc_free(e);
+		return;
+	}
+	llist_add(&e->list, &fsm_evq.free);
+	fsm_evq.num_free++;
+}
+
+static int fsm_evq_add(struct osmo_fsm_inst *fi, uint32_t event, void *data, const char *file, int line)
+{
+	struct fsm_queued_event *e;
+
+	if (!fsm_evq.initialized)
+		fsm_evq_init();
+
+	if (!llist_empty(&fsm_evq.free)) {
+		e = llist_first_entry(&fsm_evq.free, struct fsm_queued_event, list);
+		llist_del(&e->list);
+		fsm_evq.num_free--;
+	} else {
+		e = talloc_zero(NULL, struct fsm_queued_event);
+		if (!e)
+			return -ENOMEM;
+	}
+
+	e->fi = fi;
+	e->event = event;
+	e->data = data;
+	e->file = file;
+	e->line = line;
+	osmo_clock_gettime(CLOCK_MONOTONIC, &e->queued);
+	llist_add_tail(&e->list, &fsm_evq.events);
+
+	fsm_evq.stats.len++;
+	if (fsm_evq.stats.len > fsm_evq.stats.max_len)
+		fsm_evq.stats.max_len = fsm_evq.stats.len;
+	if (!osmo_timer_pending(&fsm_evq.timer))
+		osmo_timer_schedule(&fsm_evq.timer, 0, 0);
+	return 0;
+}
+
+/* Drop all queued events of an FSM instance that is being freed. */
+static void fsm_evq_purge(struct osmo_fsm_inst *fi)
+{
+	struct fsm_queued_event *e, *e2;
+
+	if (!fsm_evq.stats.len)
+		return;
+
+	llist_for_each_entry_safe(e, e2, &fsm_evq.events, list) {
+		if (e->fi != fi)
+			continue;
+		LOGPFSMSRC(fi, e->file, e->line, "Freed, dropping queued event %s\n",
+			   osmo_fsm_event_name(fi->fsm, e->event));
+		llist_del(&e->list);
+		fsm_evq.stats.len--;
+		fsm_evq.stats.dropped++;
+		fsm_evq_release(e);
+	}
+}
+
+static int fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data, const char *file, int line);
+
+/*! Dispatch the events in the FSM event queue of the current thread.
+ *
+ * Dispatches the events that were queued when this function was called, in the order they were queued. Events queued
+ * by the actions of these are left for the next call, so that a ping-pong of events cannot starve other work. This is
+ * called from osmo_select_main() as long as events are queued, so that applications only need to call it to process
+ * the queue at other times.
+ *
+ * \returns the number of events dispatched.
+ */
+int osmo_fsm_event_queue_run(void)
+{
+	unsigned int todo = fsm_evq.stats.len;
+	int dispatched = 0;
+
+	while (todo-- && fsm_evq.stats.len) {
+		struct fsm_queued_event *e = llist_first_entry(&fsm_evq.events, struct fsm_queued_event, list);
+		struct osmo_fsm_inst *fi = e->fi;
+		uint32_t event = e->event;
+		void *data = e->data;
+		const char *file = e->file;
+		int line = e->line;
+		struct timespec now, wait;
+		uint64_t wait_ns;
+
+		osmo_clock_gettime(CLOCK_MONOTONIC, &now);
+		timespecsub(&now, &e->queued, &wait);
+		wait_ns = (uint64_t)wait.tv_sec * 1000000000 + wait.tv_nsec;
+		fsm_evq.stats.wait_ns_total += wait_ns;
+		if (wait_ns > fsm_evq.stats.wait_ns_max)
+			fsm_evq.stats.wait_ns_max = wait_ns;
+
+		llist_del(&e->list);
+		fsm_evq.stats.len--;
+		fsm_evq.stats.dispatched++;
+		fsm_evq_release(e);
+
+		fsm_inst_dispatch(fi, event, data, file, line);
+		dispatched++;
+	}
+
+	if (fsm_evq.stats.len && !osmo_timer_pending(&fsm_evq.timer))
+		osmo_timer_schedule(&fsm_evq.timer, 0, 0);
+	return dispatched;
+}
+
+/*! Statistics of the FSM event queue of the current thread.
+ * \returns pointer to the statistics, valid for the lifetime of the thread.
+ */
+const struct osmo_fsm_event_queue_stats *osmo_fsm_event_queue_stats(void)
+{
+	return &fsm_evq.stats;
+}
+
 /*! delete a given instance of a FSM
  *  \param[in] fi FSM instance to be un-registered and deleted
  */
 void osmo_fsm_inst_free(struct osmo_fsm_inst *fi)
 {
+	if (fi->fsm->stats)
+		fsm_stats_leave_state(fi, fsm_stats_now_ns(CLOCK_MONOTONIC));
 	osmo_timer_del(&fi->timer);
 	llist_del(&fi->list);
+	inst_index_del(fi);
+	fsm_evq_purge(fi);
 
 	if (fsm_term_safely.depth) {
 		/* Another FSM instance has caused this one to free and is still busy with its termination. Don't free
@@ -566,7 +1315,8 @@ void osmo_fsm_inst_free(struct osmo_fsm_inst *fi)
 		fsm_term_safely.collect_ctx = NULL;
 	} else {
 		LOGPFSM(fi, "Deallocated\n");
-		fsm_free_or_steal(fi);
+		if (!inst_cache_put(fi))
+			fsm_free_or_steal(fi);
 	}
 	fsm_term_safely.root_fi = NULL;
 }
@@ -679,6 +1429,12 @@ static int state_chg(struct osmo_fsm_inst *fi, uint32_t new_state,
 			   osmo_fsm_state_name(fsm, new_state));
 	}
 
+	if (fsm->stats) {
+		uint64_t now_ns = fsm_stats_now_ns(CLOCK_MONOTONIC);
+		fsm_stats_leave_state(fi, now_ns);
+		fi->state_entered_ns = now_ns;
+	}
+
 	fi->state = new_state;
 	st = &fsm->states[new_state];
 
@@ -823,6 +1579,16 @@ int _osmo_fsm_inst_state_chg_keep_or_start_timer_ms(struct osmo_fsm_inst *fi, ui
  *  them via this function.  It verifies, whether the event is permitted
  *  based on the current state of the FSM.  If not, -1 is returned.
  *
+ *  If osmo_fsm.queue_events is set for the FSM of the instance, an event that
+ *  is permitted in the current state is not dispatched right away, but appended
+ *  to the FSM event queue of the current thread, and 0 is returned. Queued
+ *  events are dispatched in the order they were queued, by osmo_select_main()
+ *  or osmo_fsm_event_queue_run(), after the current action and whatever caused
+ *  it have completed, and are checked against the state at that time again.
+ *  \a data must remain valid until then. Queued events of an instance that is
+ *  freed are dropped. The parent term event of a terminating child is never
+ *  queued, see _osmo_fsm_inst_term().
+ *
  *  \param[in] fi FSM instance
  *  \param[in] event Event to send to FSM instance
  *  \param[in] data Data to pass along with the event
@@ -832,9 +1598,35 @@ int _osmo_fsm_inst_state_chg_keep_or_start_timer_ms(struct osmo_fsm_inst *fi, ui
  */
 int _osmo_fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data,
 			    const char *file, int line)
+{
+	struct osmo_fsm *fsm;
+
+	if (!fi || !fi->fsm->queue_events || fi->proc.terminating)
+		return fsm_inst_dispatch(fi, event, data, file, line);
+
+	/* reject right away what fsm_inst_dispatch() would reject in the current state */
+	fsm = fi->fsm;
+	OSMO_ASSERT(fi->state < fsm->num_states);
+	if (!(((1 << event) & fsm->allstate_event_mask) && fsm->allstate_action)
+	    && !((1 << event) & fsm->states[fi->state].in_event_mask)) {
+		LOGPFSMLSRC(fi, LOGL_ERROR, file, line,
+			    "Event %s not permitted\n",
+			    osmo_fsm_event_name(fsm, event));
+		if (fsm->stats) {
+			fsm_stats_event(fi, event);
+			fsm->stats->states[fi->state].rejected++;
+		}
+		return -1;
+	}
+
+	return fsm_evq_add(fi, event, data, file, line);
+}
+
+static int fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data, const char *file, int line)
 {
 	struct osmo_fsm *fsm;
 	const struct osmo_fsm_state *fs;
+	void (*action)(struct osmo_fsm_inst *fi, uint32_t event, void *data);
 
 	if (!fi) {
 		LOGPSRC(DLGLOBAL, LOGL_ERROR, file, line,
@@ -859,20 +1651,28 @@ int _osmo_fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data
 	LOGPFSMSRC(fi, file, line,
 		   "Received Event %s\n", osmo_fsm_event_name(fsm, event));
 
-	if (((1 << event) & fsm->allstate_event_mask) && fsm->allstate_action) {
-		fsm->allstate_action(fi, event, data);
-		return 0;
-	}
+	if (fsm->stats)
+		fsm_stats_event(fi, event);
 
-	if (!((1 << event) & fs->in_event_mask)) {
+	if (((1 << event) & fsm->allstate_event_mask) && fsm->allstate_action) {
+		action = fsm->allstate_action;
+	} else if (!((1 << event) & fs->in_event_mask)) {
 		LOGPFSMLSRC(fi, LOGL_ERROR, file, line,
 			    "Event %s not permitted\n",
 			    osmo_fsm_event_name(fsm, event));
+		if (fsm->stats)
+			fsm->stats->states[fi->state].rejected++;
 		return -1;
+	} else {
+		action = fs->action;
 	}
 
-	if (fs->action)
-		fs->action(fi, event, data);
+	if (!action)
+		return 0;
+	if (fsm->stats)
+		fsm_stats_action(fi, action, event, data);
+	else
+		action(fi, event, data);
 
 	return 0;
 }
@@ -886,6 +1686,8 @@ int _osmo_fsm_inst_dispatch(struct osmo_fsm_inst *fi, uint32_t event, void *data
  *
  *  Finally, the parent FSM instance (if any) is notified using the
  *  parent termination event configured at time of FSM instance start.
+ *  This event is dispatched right away, also if the FSM of the parent has
+ *  osmo_fsm.queue_events set, since \a data is only valid during this call.
  *
  *  \param[in] fi FSM instance to be terminated
  *  \param[in] cause Cause / reason for termination
@@ -957,10 +1759,10 @@ void _osmo_fsm_inst_term(struct osmo_fsm_inst *fi,
 		osmo_fsm_inst_free(fi);
 	}
 
-	/* indicate our termination to the parent */
+	/* indicate our termination to the parent, bypassing the event queue: data may not outlive this call */
 	if (parent && cause != OSMO_FSM_TERM_PARENT)
-		_osmo_fsm_inst_dispatch(parent, parent_term_event, data,
-					file, line);
+		fsm_inst_dispatch(parent, parent_term_event, data,
+				  file, line);
 
 	/* Newer, safe deallocation: free only after the parent_term_event was dispatched, to catch all termination
 	 * cascades, and free all FSM instances at once. (If fsm_term_safely is enabled, depth will *always* be > 0
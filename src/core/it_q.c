@@ -30,6 +30,11 @@
  * The receiving thread is woken up from its osmo_select_main() loop by eventfd,
  * and a general osmo_fd callback function for the eventfd will dequeue each item
  * and call a queue-specific callback function.
+ *
+ * Queues allocated with osmo_it_q_alloc_mpsc() are for the common case of one
+ * receiving thread: they use a bounded lock-free ring instead of a mutex-protected
+ * list, and only write to the eventfd when the receiver is not already signalled,
+ * i.e. once per burst of items rather than once per item.
  */
 
 #include "config.h"
@@ -37,6 +42,7 @@
 #ifdef HAVE_SYS_EVENTFD_H
 
 #include <pthread.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -47,6 +53,10 @@
 #include <osmocom/core/utils.h>
 #include <osmocom/core/it_q.h>
 
+/* maximum number of items an MPSC queue hands to its read_cb per wake-up, so that a busy producer
+ * cannot starve the other file descriptors of the consumer's select loop */
+#define IT_Q_RING_DRAIN_BATCH 64
+
 /* "increment" the eventfd by specified 'inc' */
 static int eventfd_increment(int fd, uint64_t inc)
 {
@@ -59,6 +69,26 @@ static int eventfd_increment(int fd, uint64_t inc)
 	return 0;
 }
 
+/* One slot of the MPSC ring. 'seq' tells whose turn it is: the slot is free for the producer
+ * enqueueing at position 'pos' if seq == pos, and holds the item at 'pos' if seq == pos + 1. */
+struct it_q_ring_slot {
+	unsigned long seq;
+	struct llist_head *item;
+};
+
+/* bounded multi-producer / single-consumer ring (Vyukov's bounded queue, single consumer) */
+struct osmo_it_q_ring {
+	/* next position to enqueue at; advanced by the producers */
+	unsigned long tail __attribute__((aligned(64)));
+	/* whether the consumer has been signalled via eventfd and not yet woken up */
+	bool signalled;
+	/* next position to dequeue from; only written by the consumer */
+	unsigned long head __attribute__((aligned(64)));
+	/* number of slots - 1, the number of slots being a power of two */
+	unsigned long mask;
+	struct it_q_ring_slot slots[0];
+};
+
 /* global (for all threads) list of message queues in a program + associated lock */
 static LLIST_HEAD(it_queues);
 static pthread_rwlock_t it_queues_rwlock = PTHREAD_RWLOCK_INITIALIZER;
@@ -74,6 +104,58 @@ static struct osmo_it_q *_osmo_it_q_by_name(const char *name)
 	return NULL;
 }
 
+/* lock-free enqueue to the MPSC ring; may be called from any thread */
+static int ring_enqueue(struct osmo_it_q *q, struct llist_head *item)
+{
+	struct osmo_it_q_ring *r = q->ring;
+	struct it_q_ring_slot *slot;
+	unsigned long pos, seq;
+
+	pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+	while (1) {
+		/* enforce max_length also if it is not a power of two. 'head' may be stale here,
+		 * which can only make the queue look fuller than it actually is. */
+		if ((long)(pos - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) >= (long)q->max_length)
+			return -ENOSPC;
+		slot = &r->slots[pos & r->mask];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == pos) {
+			/* slot is free: try to claim position 'pos'; on failure 'pos' is updated */
+			if (__atomic_compare_exchange_n(&r->tail, &pos, pos + 1, true,
+							__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if ((long)(seq - pos) < 0) {
+			/* slot still holds the item from one lap ago */
+			return -ENOSPC;
+		} else {
+			/* another producer claimed 'pos' meanwhile */
+			pos = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->item = item;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* dequeue from the MPSC ring; must only be called from the consumer thread */
+static struct llist_head *ring_dequeue(struct osmo_it_q_ring *r)
+{
+	unsigned long pos = r->head;
+	struct it_q_ring_slot *slot = &r->slots[pos & r->mask];
+	struct llist_head *item;
+
+	/* empty, or the producer of this slot has not finished yet */
+	if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+		return NULL;
+
+	item = slot->item;
+	/* hand the slot to the producer one lap ahead */
+	__atomic_store_n(&slot->seq, pos + r->mask + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&r->head, pos + 1, __ATOMIC_RELEASE);
+	return item;
+}
+
 /*! resolve it-queue by its [globally unique] name */
 struct osmo_it_q *osmo_it_q_by_name(const char *name)
 {
@@ -88,6 +170,7 @@ struct osmo_it_q *osmo_it_q_by_name(const char *name)
 static int osmo_it_q_fd_cb(struct osmo_fd *ofd, unsigned int what)
 {
 	struct osmo_it_q *q = (struct osmo_it_q *) ofd->data;
+	struct llist_head *item;
 	uint64_t val;
 	int i, rc;
 
@@ -98,8 +181,24 @@ static int osmo_it_q_fd_cb(struct osmo_fd *ofd, unsigned int what)
 	if (rc < sizeof(val))
 		return rc;
 
+	if (q->ring) {
+		/* re-arm the wake-up before draining: anything enqueued from now on which we might
+		 * miss below will signal the eventfd again */
+		__atomic_store_n(&q->ring->signalled, false, __ATOMIC_SEQ_CST);
+		for (i = 0; i < IT_Q_RING_DRAIN_BATCH; i++) {
+			item = _osmo_it_q_dequeue(q);
+			if (!item)
+				return 0;
+			q->read_cb(q, item);
+		}
+		/* items may be left: signal ourselves to continue in the next select loop iteration */
+		if (!__atomic_exchange_n(&q->ring->signalled, true, __ATOMIC_SEQ_CST))
+			eventfd_increment(ofd->fd, 1);
+		return 0;
+	}
+
 	for (i = 0; i < val; i++) {
-		struct llist_head *item = _osmo_it_q_dequeue(q);
+		item = _osmo_it_q_dequeue(q);
 		/* in case the user might have called osmo_it_q_flush() we may
 		 * end up in the eventfd-dispatch but without any messages left in the queue,
 		 * otherwise I'd have loved to OSMO_ASSERT(msg) here. */
@@ -111,23 +210,13 @@ static int osmo_it_q_fd_cb(struct osmo_fd *ofd, unsigned int what)
 	return 0;
 }
 
-/*! Allocate a new inter-thread message queue.
- *  \param[in] ctx talloc context from which to allocate the queue
- *  \param[in] name human-readable string name of the queue; function creates a copy.
- *  \param[in] read_cb call-back function to be called for each de-queued message; may be
- *  			NULL in case you don't want eventfd/osmo_select integration and
- *  			will manually take care of noticing if and when to dequeue.
- *  \returns a newly-allocated inter-thread message queue; NULL in case of error */
-struct osmo_it_q *osmo_it_q_alloc(void *ctx, const char *name, unsigned int max_length,
-					void (*read_cb)(struct osmo_it_q *q, struct llist_head *item),
-					void *data)
+/* common part of osmo_it_q_alloc*(): initialize the queue and add it to the global list */
+static struct osmo_it_q *it_q_init(struct osmo_it_q *q, const char *name, unsigned int max_length,
+				   void (*read_cb)(struct osmo_it_q *q, struct llist_head *item),
+				   void *data)
 {
-	struct osmo_it_q *q;
 	int fd;
 
-	q = talloc_zero(ctx, struct osmo_it_q);
-	if (!q)
-		return NULL;
 	q->data = data;
 	q->name = talloc_strdup(q, name);
 	q->current_length = 0;
@@ -165,6 +254,67 @@ struct osmo_it_q *osmo_it_q_alloc(void *ctx, const char *name, unsigned int max_
 	return q;
 }
 
+/*! Allocate a new inter-thread message queue.
+ *  \param[in] ctx talloc context from which to allocate the queue
+ *  \param[in] name human-readable string name of the queue; function creates a copy.
+ *  \param[in] read_cb call-back function to be called for each de-queued message; may be
+ *  			NULL in case you don't want eventfd/osmo_select integration and
+ *  			will manually take care of noticing if and when to dequeue.
+ *  \returns a newly-allocated inter-thread message queue; NULL in case of error */
+struct osmo_it_q *osmo_it_q_alloc(void *ctx, const char *name, unsigned int max_length,
+					void (*read_cb)(struct osmo_it_q *q, struct llist_head *item),
+					void *data)
+{
+	struct osmo_it_q *q;
+
+	q = talloc_zero(ctx, struct osmo_it_q);
+	if (!q)
+		return NULL;
+	return it_q_init(q, name, max_length, read_cb, data);
+}
+
+/*! Allocate a new lock-free multi-producer / single-consumer inter-thread message queue.
+ *
+ *  Any number of threads may enqueue to the returned queue without taking a lock, but only one
+ *  thread (the one registering its event_ofd, if a read_cb is used) may dequeue from it, flush or
+ *  destroy it.  The receiving thread is only signalled through the eventfd if it has not been
+ *  signalled already, so that a burst of items costs a single wake-up.  Each wake-up passes at most
+ *  64 items to \a read_cb; if more are left, the next select loop iteration continues.  The queue
+ *  can hold at most \a max_length items; its memory is allocated up-front.
+ *  \param[in] ctx talloc context from which to allocate the queue
+ *  \param[in] name human-readable string name of the queue; function creates a copy.
+ *  \param[in] max_length maximum number of items in the queue
+ *  \param[in] read_cb call-back function to be called for each de-queued message; may be
+ *  			NULL in case you don't want eventfd/osmo_select integration and
+ *  			will manually take care of noticing if and when to dequeue.
+ *  \returns a newly-allocated inter-thread message queue; NULL in case of error */
+struct osmo_it_q *osmo_it_q_alloc_mpsc(void *ctx, const char *name, unsigned int max_length,
+					void (*read_cb)(struct osmo_it_q *q, struct llist_head *item),
+					void *data)
+{
+	struct osmo_it_q *q;
+	unsigned long i, num_slots = 1;
+
+	if (max_length == 0 || max_length > (1U << 30))
+		return NULL;
+	while (num_slots < max_length)
+		num_slots <<= 1;
+
+	q = talloc_zero(ctx, struct osmo_it_q);
+	if (!q)
+		return NULL;
+	q->ring = talloc_zero_size(q, sizeof(*q->ring) + num_slots * sizeof(q->ring->slots[0]));
+	if (!q->ring) {
+		talloc_free(q);
+		return NULL;
+	}
+	q->ring->mask = num_slots - 1;
+	for (i = 0; i < num_slots; i++)
+		q->ring->slots[i].seq = i;
+
+	return it_q_init(q, name, max_length, read_cb, data);
+}
+
 static void *item_dequeue(struct llist_head *queue)
 {
 	struct llist_head *lh;
@@ -184,13 +334,22 @@ static void *item_dequeue(struct llist_head *queue)
 static void _osmo_it_q_flush(struct osmo_it_q *q)
 {
 	void *item;
+
+	if (q->ring) {
+		while ((item = ring_dequeue(q->ring)))
+			talloc_free(item);
+		return;
+	}
+
 	while ((item = item_dequeue(&q->list))) {
 		talloc_free(item);
 	}
 	q->current_length = 0;
 }
 
-/*! Flush all messages currently present in queue */
+/*! Flush all messages currently present in queue.
+ *  For a queue allocated by osmo_it_q_alloc_mpsc(), this must only be called by the consumer
+ *  thread. */
 void osmo_it_q_flush(struct osmo_it_q *q)
 {
 	OSMO_ASSERT(q);
@@ -228,6 +387,16 @@ int _osmo_it_q_enqueue(struct osmo_it_q *queue, struct llist_head *item)
 	OSMO_ASSERT(queue);
 	OSMO_ASSERT(item);
 
+	if (queue->ring) {
+		int rc = ring_enqueue(queue, item);
+		if (rc < 0)
+			return rc;
+		/* only signal the consumer if it has not been signalled since it last drained the queue */
+		if (queue->event_ofd.fd >= 0 && !__atomic_exchange_n(&queue->ring->signalled, true, __ATOMIC_SEQ_CST))
+			eventfd_increment(queue->event_ofd.fd, 1);
+		return 0;
+	}
+
 	pthread_mutex_lock(&queue->mutex);
 	if (queue->current_length+1 > queue->max_length) {
 		pthread_mutex_unlock(&queue->mutex);
@@ -244,6 +413,7 @@ int _osmo_it_q_enqueue(struct osmo_it_q *queue, struct llist_head *item)
 
 
 /*! Thread-safe de-queue from an inter-thread message queue.
+ *  For a queue allocated by osmo_it_q_alloc_mpsc(), this must only be called by the consumer thread.
  *  \param[in] queue Inter-thread queue from which to dequeue
  *  \returns llist_head of dequeued message; NULL if none available
  */
@@ -252,6 +422,9 @@ struct llist_head *_osmo_it_q_dequeue(struct osmo_it_q *queue)
 	struct llist_head *l;
 	OSMO_ASSERT(queue);
 
+	if (queue->ring)
+		return ring_dequeue(queue->ring);
+
 	pthread_mutex_lock(&queue->mutex);
 
 	l = item_dequeue(&queue->list);
@@ -263,6 +436,40 @@ struct llist_head *_osmo_it_q_dequeue(struct osmo_it_q *queue)
 	return l;
 }
 
+/*! Thread-safe de-queue of several messages at once from an inter-thread message queue.
+ *  The queue's mutex (if any) is taken only once for the whole batch.
+ *  For a queue allocated by osmo_it_q_alloc_mpsc(), this must only be called by the consumer thread.
+ *  \param[in] queue Inter-thread queue from which to dequeue
+ *  \param[out] items list to which the dequeued messages are appended, in queue order
+ *  \param[in] max_items maximum number of messages to dequeue
+ *  \returns number of messages dequeued */
+unsigned int osmo_it_q_dequeue_batch(struct osmo_it_q *queue, struct llist_head *items, unsigned int max_items)
+{
+	struct llist_head *l;
+	unsigned int n = 0;
+
+	OSMO_ASSERT(queue);
+	OSMO_ASSERT(items);
+
+	if (queue->ring) {
+		while (n < max_items && (l = ring_dequeue(queue->ring))) {
+			llist_add_tail(l, items);
+			n++;
+		}
+		return n;
+	}
+
+	pthread_mutex_lock(&queue->mutex);
+	while (n < max_items && (l = item_dequeue(&queue->list))) {
+		llist_add_tail(l, items);
+		n++;
+	}
+	queue->current_length -= n;
+	pthread_mutex_unlock(&queue->mutex);
+
+	return n;
+}
+
 
 #endif /* HAVE_SYS_EVENTFD_H */
 
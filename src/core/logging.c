@@ -63,6 +63,7 @@
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/logging.h>
+#include <osmocom/core/logging_internal.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/thread.h>
 #include <osmocom/core/select.h>
@@ -92,6 +93,31 @@ LLIST_HEAD(osmo_log_target_list);
 
 static __thread long int logging_tid;
 
+/* Time and thread of the log event being output on this thread, if it was
+ * recorded elsewhere (asynchronous logging); NULL means 'now, this thread'. */
+static __thread const struct log_origin *log_cur_origin;
+
+/* Message text of the log statement being output on this thread: formatted
+ * at most once, on behalf of the first target that needs it, and then copied
+ * by all other targets. */
+struct log_shared_msg {
+	const char *format;	/* format string of the log statement */
+	char *buf;		/* MAX_LOG_SIZE bytes */
+	int len;		/* length of the text in buf, -1 if not formatted yet */
+};
+static __thread struct log_shared_msg *log_cur_msg;
+
+/* Timestamp strings of the most recent second this thread has logged in, so
+ * that localtime_r() and ctime_r() only run once per second. */
+static __thread struct {
+	time_t ctime_sec;
+	int ctime_len;		/* 0: not valid */
+	char ctime_str[26];	/* "Thu Jan  1 00:00:00 1970 ", ctime_r() without the '\n' */
+	time_t ext_sec;
+	int ext_len;		/* 0: not valid */
+	char ext_str[32];	/* "19700101000000", milliseconds are added per line */
+} log_ts_cache;
+
 #if (!EMBEDDED)
 /*! One global copy that contains the union of log levels for all targets
 *  for all categories, used for quick lock free checks of log targets. */
@@ -173,6 +199,8 @@ static bool log_cache_check(int mapped_subsys, int level)
   thread is writing to it */
 static pthread_mutex_t osmo_log_tgt_mutex;
 static bool osmo_log_tgt_mutex_on = false;
+/* whether the calling thread holds osmo_log_tgt_mutex */
+static __thread bool osmo_log_tgt_mutex_owner;
 
 /*! Enable multithread support (mutex) in libosmocore logging system.
  * Must be called by processes willing to use logging subsystem from several
@@ -197,16 +225,26 @@ void log_tgt_mutex_lock_impl(void) {
 	return;
 	*/
 
-	if (osmo_log_tgt_mutex_on)
+	if (osmo_log_tgt_mutex_on) {
 		pthread_mutex_lock(&osmo_log_tgt_mutex);
+		osmo_log_tgt_mutex_owner = true;
+	}
 }
 
 /*! Release the osmo_log_tgt_mutex. Don't use this function directly, always use
  *  macro log_tgt_mutex_unlock() instead.
  */
 void log_tgt_mutex_unlock_impl(void) {
-	if (osmo_log_tgt_mutex_on)
+	if (osmo_log_tgt_mutex_on) {
+		osmo_log_tgt_mutex_owner = false;
 		pthread_mutex_unlock(&osmo_log_tgt_mutex);
+	}
+}
+
+/* whether the calling thread holds the osmo_log_tgt_mutex, see log_tgt_mutex_lock() */
+bool log_tgt_mutex_held(void)
+{
+	return osmo_log_tgt_mutex_owner;
 }
 
 #else /* if (!EMBEDDED) */
@@ -214,6 +252,10 @@ void log_tgt_mutex_unlock_impl(void) {
 void log_enable_multithread(void) {}
 void log_tgt_mutex_lock_impl(void) {}
 void log_tgt_mutex_unlock_impl(void) {}
+bool log_tgt_mutex_held(void)
+{
+	return false;
+}
 #endif /* if (!EMBEDDED) */
 
 const struct value_string loglevel_strs[] = {
@@ -548,6 +590,19 @@ static const char *const_basename(const char *path)
 	return bn + 1;
 }
 
+/* Append a string of known length, truncating like snprintf() */
+static int _copy_str(char *buf, size_t buf_len, const char *str, int len)
+{
+	size_t n;
+
+	if (!buf_len)
+		return len;
+	n = OSMO_MIN((size_t)len, buf_len - 1);
+	memcpy(buf, str, n);
+	buf[n] = '\0';
+	return len;
+}
+
 /*! main output formatting function for log lines.
  *  \param[out] buf caller-allocated output buffer for the generated string
  *  \param[in] buf_len number of bytes available in buf
@@ -580,35 +635,64 @@ static int _output_buf(char *buf, int buf_len, struct log_target *target, unsign
 	if (!cont) {
 		if (target->print_ext_timestamp) {
 #ifdef HAVE_LOCALTIME_R
-			struct tm tm;
 			struct timeval tv;
-			osmo_gettimeofday(&tv, NULL);
-			localtime_r(&tv.tv_sec, &tm);
-			OSMO_STRBUF_PRINTF(sb, "%04d%02d%02d%02d%02d%02d%03d ",
-					   tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
-					   tm.tm_hour, tm.tm_min, tm.tm_sec,
-					   (int)(tv.tv_usec / 1000));
+			char ts[sizeof(log_ts_cache.ext_str) + 4];
+			int ms;
+			if (log_cur_origin)
+				tv = log_cur_origin->tv;
+			else
+				osmo_gettimeofday(&tv, NULL);
+			if (!log_ts_cache.ext_len || log_ts_cache.ext_sec != tv.tv_sec) {
+				struct tm tm;
+				localtime_r(&tv.tv_sec, &tm);
+				ret = snprintf(log_ts_cache.ext_str, sizeof(log_ts_cache.ext_str),
+					       "%04d%02d%02d%02d%02d%02d",
+					       tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+					       tm.tm_hour, tm.tm_min, tm.tm_sec);
+				log_ts_cache.ext_len = OSMO_MIN(ret, sizeof(log_ts_cache.ext_str) - 1);
+				log_ts_cache.ext_sec = tv.tv_sec;
+			}
+			ms = tv.tv_usec / 1000;
+			memcpy(ts, log_ts_cache.ext_str, log_ts_cache.ext_len);
+			ret = log_ts_cache.ext_len;
+			ts[ret++] = '0' + ms / 100;
+			ts[ret++] = '0' + ms / 10 % 10;
+			ts[ret++] = '0' + ms % 10;
+			ts[ret++] = ' ';
+			OSMO_STRBUF_APPEND(sb, _copy_str, ts, ret);
 #endif
 		} else if (target->print_timestamp) {
+			struct timeval tv;
 			time_t tm;
-			if ((tm = time(NULL)) == (time_t) -1)
+			if (log_cur_origin)
+				tm = log_cur_origin->tv.tv_sec;
+			else if (osmo_gettimeofday(&tv, NULL) < 0)
 				goto err;
-			/* Get human-readable representation of time.
-			   man ctime: we need at least 26 bytes in buf */
-			if (OSMO_STRBUF_REMAIN(sb) < 26 || !ctime_r(&tm, sb.pos))
-				goto err;
-			ret = strnlen(sb.pos, 26);
-			if (ret <= 0)
-				goto err;
-			OSMO_STRBUF_ADDED_TAIL(sb, ret);
-			/* Get rid of useless final '\n' added by ctime_r. We want a space instead. */
-			OSMO_STRBUF_DROP_TAIL(sb, 1);
-			OSMO_STRBUF_PRINTF(sb, " ");
+			else
+				tm = tv.tv_sec;
+			if (!log_ts_cache.ctime_len || log_ts_cache.ctime_sec != tm) {
+				/* Get human-readable representation of time.
+				   man ctime: we need at least 26 bytes in buf */
+				if (!ctime_r(&tm, log_ts_cache.ctime_str))
+					goto err;
+				ret = strnlen(log_ts_cache.ctime_str, sizeof(log_ts_cache.ctime_str));
+				if (ret <= 0)
+					goto err;
+				/* Get rid of useless final '\n' added by ctime_r. We want a space instead. */
+				log_ts_cache.ctime_str[ret - 1] = ' ';
+				log_ts_cache.ctime_len = ret;
+				log_ts_cache.ctime_sec = tm;
+			}
+			OSMO_STRBUF_APPEND(sb, _copy_str, log_ts_cache.ctime_str, log_ts_cache.ctime_len);
 		}
 		if (target->print_tid) {
-			if (logging_tid == 0)
-				logging_tid = (long int)osmo_gettid();
-			OSMO_STRBUF_PRINTF(sb, "%ld ", logging_tid);
+			if (log_cur_origin) {
+				OSMO_STRBUF_PRINTF(sb, "%ld ", log_cur_origin->tid);
+			} else {
+				if (logging_tid == 0)
+					logging_tid = (long int)osmo_gettid();
+				OSMO_STRBUF_PRINTF(sb, "%ld ", logging_tid);
+			}
 		}
 		if (target->print_category)
 			OSMO_STRBUF_PRINTF(sb, "%s%s%s%s ",
@@ -638,7 +722,16 @@ static int _output_buf(char *buf, int buf_len, struct log_target *target, unsign
 			}
 		}
 	}
-	OSMO_STRBUF_APPEND(sb, vsnprintf, format, ap);
+	if (log_cur_msg && log_cur_msg->format == format) {
+		/* the same text for all targets: format it only once */
+		if (log_cur_msg->len < 0) {
+			ret = vsnprintf(log_cur_msg->buf, MAX_LOG_SIZE, format, ap);
+			log_cur_msg->len = OSMO_MAX(0, OSMO_MIN(ret, MAX_LOG_SIZE - 1));
+		}
+		OSMO_STRBUF_APPEND(sb, _copy_str, log_cur_msg->buf, log_cur_msg->len);
+	} else {
+		OSMO_STRBUF_APPEND(sb, vsnprintf, format, ap);
+	}
 
 	/* For LOG_FILENAME_POS_LAST, print the source file info only when the caller ended the log
 	 * message in '\n'. If so, nip the last '\n' away, insert the source file info and re-append an
@@ -711,7 +804,7 @@ static inline int map_subsys(int subsys)
 }
 
 static inline bool should_log_to_target(struct log_target *tar, int subsys,
-					int level)
+					int level, const struct log_context *ctx)
 {
 	struct log_category *category;
 
@@ -737,7 +830,7 @@ static inline bool should_log_to_target(struct log_target *tar, int subsys,
 		return true;
 
 	if (osmo_log_info->filter_fn)
-		return osmo_log_info->filter_fn(&log_context, tar);
+		return osmo_log_info->filter_fn(ctx, tar);
 
 	/* TODO: Check the filter/selector too? */
 	return true;
@@ -755,20 +848,37 @@ void osmo_vlogp(int subsys, int level, const char *file, int line,
 		int cont, const char *format, va_list ap)
 {
 	struct log_target *tar;
+	struct log_shared_msg *prev_msg;
+	char msg_buf[MAX_LOG_SIZE];
+	struct log_shared_msg msg = {
+		.format = format,
+		.buf = msg_buf,
+		.len = -1,
+	};
 
 	subsys = map_subsys(subsys);
 
 #if !defined(EMBEDDED)
 	if (!log_cache_check(subsys, level))
 		return;
+
+	/* hand over to the writer thread, unless it is not running */
+	if (OSMO_UNLIKELY(log_async_running) &&
+	    log_async_vlogp(subsys, level, file, line, cont, &log_context, format, ap) == 0)
+		return;
 #endif
 
 	log_tgt_mutex_lock();
 
+	/* format the message text once for all targets, see _output_buf(); a
+	 * target's output function may log itself, so restore the outer one */
+	prev_msg = log_cur_msg;
+	log_cur_msg = &msg;
+
 	llist_for_each_entry(tar, &osmo_log_target_list, entry) {
 		va_list bp;
 
-		if (!should_log_to_target(tar, subsys, level))
+		if (!should_log_to_target(tar, subsys, level, &log_context))
 			continue;
 
 		/* According to the manpage, vsnprintf leaves the value of ap
@@ -782,9 +892,76 @@ void osmo_vlogp(int subsys, int level, const char *file, int line,
 		va_end(bp);
 	}
 
+	log_cur_msg = prev_msg;
+
 	log_tgt_mutex_unlock();
 }
 
+/* Output a pre-formatted message to a target, as if it was formatted by the caller */
+static void _output_msg(struct log_target *tar, int subsys, unsigned int level, const char *file,
+			int line, int cont, const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	if (tar->raw_output)
+		tar->raw_output(tar, subsys, level, file, line, cont, format, ap);
+	else
+		_output(tar, subsys, level, file, line, cont, format, ap);
+	va_end(ap);
+}
+
+/*! Output a log message recorded earlier, possibly on another thread.
+ *  Caller must hold osmo_log_tgt_mutex, see log_tgt_mutex_lock.
+ *  \param[in] subsys Mapped logging sub-system
+ *  \param[in] level Log level
+ *  \param[in] file name of source code file
+ *  \param[in] line source code line number
+ *  \param[in] cont continuation (1) or new line (0)
+ *  \param[in] ctx logging context at the time of the log statement
+ *  \param[in] origin time and thread of the log statement
+ *  \param[in] msg the formatted message, without any header */
+void log_output_recorded(int subsys, int level, const char *file, int line, int cont,
+			 const struct log_context *ctx, const struct log_origin *origin,
+			 const char *msg)
+{
+	struct log_target *tar;
+	struct log_shared_msg *prev_msg;
+	struct log_shared_msg shared = {
+		.format = "%s",
+		.buf = (char *)msg,
+		.len = OSMO_MIN(strlen(msg), MAX_LOG_SIZE - 1),
+	};
+
+	log_cur_origin = origin;
+	prev_msg = log_cur_msg;
+	log_cur_msg = &shared;
+
+	llist_for_each_entry(tar, &osmo_log_target_list, entry) {
+		if (!should_log_to_target(tar, subsys, level, ctx))
+			continue;
+		_output_msg(tar, subsys, level, file, line, cont, shared.format, msg);
+	}
+
+	log_cur_msg = prev_msg;
+	log_cur_origin = NULL;
+}
+
+/*! Get time and thread of the log message being output, if it was recorded
+ *  earlier and possibly on another thread; NULL means 'now, this thread'. */
+const struct log_origin *log_current_origin(void)
+{
+	return log_cur_origin;
+}
+
+/*! Map a logging sub-system number like osmo_vlogp() does.
+ *  \param[in] subsys Logging sub-system
+ *  \returns index into osmo_log_info->cat */
+int log_map_subsys(int subsys)
+{
+	return map_subsys(subsys);
+}
+
 /*! logging function used by DEBUGP() macro
  *  \param[in] subsys Logging sub-system
  *  \param[in] file name of source code file
@@ -1381,6 +1558,10 @@ struct log_target *log_target_find(enum log_target_type type, const char *fname)
 			if (!strcmp(fname, tgt->tgt_gsmtap.hostname))
 				return tgt;
 			break;
+		case LOG_TGT_TYPE_BINARY:
+			if (!strcmp(fname, tgt->tgt_binary.fname))
+				return tgt;
+			break;
 		default:
 			return tgt;
 		}
@@ -1595,6 +1776,11 @@ void log_fini(void)
 {
 	struct log_target *tar, *tar2;
 
+#if !defined(EMBEDDED)
+	/* deliver whatever is still queued before the targets go away */
+	log_async_stop();
+#endif
+
 	log_tgt_mutex_lock();
 
 	llist_for_each_entry_safe(tar, tar2, &osmo_log_target_list, entry)
@@ -1621,6 +1807,10 @@ int log_check_level(int subsys, unsigned int level)
 #if !defined(EMBEDDED)
 	if (!log_cache_check(subsys, level))
 		return 0;
+
+	/* the writer thread applies the filters, don't wait for it here */
+	if (OSMO_UNLIKELY(log_async_running))
+		return 1;
 #endif
 
 	/* TODO: The following could/should be cached (update on config) */
@@ -1628,7 +1818,7 @@ int log_check_level(int subsys, unsigned int level)
 	log_tgt_mutex_lock();
 
 	llist_for_each_entry(tar, &osmo_log_target_list, entry) {
-		if (!should_log_to_target(tar, subsys, level))
+		if (!should_log_to_target(tar, subsys, level, &log_context))
 			continue;
 
 		/* This might get logged (ignoring filters) */
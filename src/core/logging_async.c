@@ -0,0 +1,700 @@
+/*! \file logging_async.c
+ * Asynchronous logging via per-thread rings and a writer thread. */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ */
+
+/*! \addtogroup logging
+ *  @{
+ *
+ * Once log_async_start() was called, osmo_vlogp() no longer formats and
+ * writes the log line for every target on the calling thread while holding
+ * the log target mutex. Instead it formats the message text once and puts it
+ * into a single-producer/single-consumer ring owned by the calling thread,
+ * without taking any lock. A dedicated writer thread drains the rings of all
+ * threads into the usual log targets, so a slow disk or a stalled journald
+ * only holds up the writer thread, not the event loop of the program.
+ *
+ * Category and level filters as well as the application's filter_fn are
+ * applied by the writer thread, with a copy of the logging context taken
+ * when the message was logged: a filter_fn may compare, but must not
+ * dereference the context pointers. Timestamps and thread ids in the log
+ * lines are those of the log statement. As log_check_level() no longer
+ * looks at the targets, call log_cache_enable() to skip formatting
+ * messages of disabled categories and levels.
+ *
+ * The writer thread calls the target output functions under the log target
+ * mutex, just like any thread does in log_enable_multithread() mode. File
+ * targets should hence use the blocking stream mode (see
+ * log_target_file_switch_to_stream()); absorbing the blocking writes is
+ * what the writer thread is there for.
+ *
+ * If the ring of a thread is full, the message is dropped or the thread
+ * waits, depending on the \ref log_async_overflow policy. A thread that
+ * holds the log target mutex, like the writer thread itself, never waits:
+ * the writer thread needs the mutex to make room. Dropped messages
+ * are counted, and the writer thread logs how many were lost. Messages of
+ * level FATAL are written out before osmo_vlogp() returns (directly, if the
+ * logging thread holds the log target mutex), and
+ * log_async_stop() (also called by log_fini() and at exit()) writes out
+ * everything still queued.
+ *
+ * \file logging_async.c */
+
+#include "config.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <osmocom/core/linuxlist.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/logging_internal.h>
+#include <osmocom/core/thread.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+/*! Whether osmo_vlogp() hands messages to the writer thread */
+bool log_async_running = false;
+
+#if !defined(EMBEDDED)
+
+/* default size of the ring of each logging thread, in bytes */
+#define LOG_ASYNC_RING_DEFAULT	(256 * 1024)
+#define LOG_ASYNC_RING_MIN	(16 * 1024)
+/* maximum length of a message, like MAX_LOG_SIZE in logging.c */
+#define LOG_ASYNC_MSG_MAX	4096
+/* number of messages output per log target mutex section */
+#define LOG_ASYNC_BATCH		64
+/* the writer thread looks at the rings at least this often, in ms */
+#define LOG_ASYNC_IDLE_MS	100
+
+/* One log statement in a ring. 'len' is the 8-byte aligned size of the
+ * whole record; a 'len' of 0 marks the unused end of the ring before the
+ * next record, which starts again at offset 0. */
+struct log_async_rec {
+	uint32_t len;
+	int16_t subsys;
+	uint8_t level;
+	uint8_t cont;
+	int line;
+	const char *file;
+	struct log_origin origin;
+	struct log_context ctx;
+	char msg[0];
+};
+
+/* Ring of one logging thread, only written by that thread and only read by
+ * the writer thread. 'head' and 'tail' count bytes and never wrap. */
+struct log_async_ring {
+	/* entry in la.rings */
+	struct llist_head list;
+	uint8_t *buf;
+	/* size of buf, power of two */
+	size_t size;
+	long tid;
+
+	/* owned by the logging thread */
+	uint64_t head __attribute__((aligned(64)));
+	uint64_t enqueued;
+	uint64_t dropped;
+	uint64_t waited;
+	/* the logging thread is inside log_async_vlogp() */
+	bool busy;
+	/* the logging thread has exited, free the ring once it is drained */
+	bool dead;
+
+	/* owned by the writer thread */
+	uint64_t tail __attribute__((aligned(64)));
+	uint64_t dropped_reported;
+};
+
+static struct {
+	/* protects everything below, but not the ring contents */
+	pthread_mutex_t lock;
+	/* signalled to wake up the writer thread */
+	pthread_cond_t wake_cond;
+	/* broadcast when flush_done was updated */
+	pthread_cond_t flush_cond;
+	/* all rings, see struct log_async_ring */
+	struct llist_head rings;
+	/* counters of rings which were already freed */
+	struct log_async_stats retired;
+	pthread_key_t key;
+	pthread_t writer;
+	bool writer_alive;
+	size_t ring_size;
+	enum log_async_overflow overflow;
+	/* the writer thread is about to wait for wake_cond */
+	bool sleeping;
+	bool wake;
+	bool stop;
+	unsigned long flush_req;
+	unsigned long flush_done;
+} la = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake_cond = PTHREAD_COND_INITIALIZER,
+	.flush_cond = PTHREAD_COND_INITIALIZER,
+	.rings = LLIST_HEAD_INIT(la.rings),
+};
+
+static pthread_once_t la_once = PTHREAD_ONCE_INIT;
+static bool la_atexit_registered;
+
+static __thread struct log_async_ring *my_ring;
+static __thread bool on_writer;
+
+/* counters are only written by one thread, but read by others */
+static inline void counter_inc(uint64_t *counter)
+{
+	__atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+/* caller must hold la.lock */
+static void ring_free(struct log_async_ring *ring)
+{
+	la.retired.enqueued += ring->enqueued;
+	la.retired.dropped += ring->dropped;
+	la.retired.waited += ring->waited;
+	llist_del(&ring->list);
+	free(ring->buf);
+	free(ring);
+}
+
+/* pthread key destructor, called when a thread with a ring exits */
+static void ring_thread_exit(void *data)
+{
+	struct log_async_ring *ring = data;
+
+	pthread_mutex_lock(&la.lock);
+	if (la.writer_alive)
+		__atomic_store_n(&ring->dead, true, __ATOMIC_RELEASE);
+	else
+		ring_free(ring);
+	pthread_mutex_unlock(&la.lock);
+}
+
+static void la_init(void)
+{
+	pthread_key_create(&la.key, ring_thread_exit);
+}
+
+/* get the ring of the calling thread, allocate it on first use */
+static struct log_async_ring *ring_get(void)
+{
+	struct log_async_ring *ring = my_ring;
+
+	if (OSMO_LIKELY(ring))
+		return ring;
+
+	if (posix_memalign((void **)&ring, 64, sizeof(*ring)))
+		return NULL;
+	memset(ring, 0, sizeof(*ring));
+	ring->tid = (long)osmo_gettid();
+
+	pthread_mutex_lock(&la.lock);
+	ring->size = la.ring_size;
+	ring->buf = ring->size ? malloc(ring->size) : NULL;
+	if (!ring->buf) {
+		pthread_mutex_unlock(&la.lock);
+		free(ring);
+		return NULL;
+	}
+	llist_add_tail(&ring->list, &la.rings);
+	pthread_mutex_unlock(&la.lock);
+
+	pthread_setspecific(la.key, ring);
+	my_ring = ring;
+	return ring;
+}
+
+static void writer_wake(void)
+{
+	pthread_mutex_lock(&la.lock);
+	la.wake = true;
+	pthread_cond_signal(&la.wake_cond);
+	pthread_mutex_unlock(&la.lock);
+}
+
+/* Copy one record into the ring of the calling thread; wait for room or
+ * drop the record if the ring is full, depending on the overflow policy. */
+static int ring_push(struct log_async_ring *ring, const struct log_async_rec *hdr,
+		     const char *msg, int len)
+{
+	const struct timespec pause = { .tv_sec = 0, .tv_nsec = 100000 };
+	uint32_t need = (sizeof(*hdr) + len + 1 + 7) & ~7;
+	uint64_t head = ring->head, tail;
+	size_t off, to_end, total;
+	struct log_async_rec *rec;
+	bool waited = false;
+
+	while (1) {
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		off = head & (ring->size - 1);
+		to_end = ring->size - off;
+		total = need <= to_end ? need : to_end + need;
+		if (ring->size - (head - tail) >= total)
+			break;
+
+		/* the writer thread never waits for itself, nor for a thread that holds the
+		 * log target mutex, e.g. a log target's output function that logs */
+		if (la.overflow == LOG_ASYNC_OVERFLOW_DROP || on_writer || log_tgt_mutex_held() ||
+		    (la.overflow == LOG_ASYNC_OVERFLOW_DROP_LOW && hdr->level < LOGL_NOTICE)) {
+			counter_inc(&ring->dropped);
+			return -ENOSPC;
+		}
+		if (!waited) {
+			counter_inc(&ring->waited);
+			waited = true;
+		}
+		writer_wake();
+		nanosleep(&pause, NULL);
+	}
+
+	if (need > to_end) {
+		((struct log_async_rec *)&ring->buf[off])->len = 0;
+		head += to_end;
+		off = 0;
+	}
+
+	rec = (struct log_async_rec *)&ring->buf[off];
+	*rec = *hdr;
+	rec->len = need;
+	memcpy(rec->msg, msg, len);
+	rec->msg[len] = '\0';
+
+	counter_inc(&ring->enqueued);
+	__atomic_store_n(&ring->head, head + need, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+/*! Queue a log message for the writer thread, called by osmo_vlogp().
+ *  \returns 0 if the message was taken care of (queued or dropped);
+ *	     negative if the caller should output it itself */
+int log_async_vlogp(int subsys, int level, const char *file, int line, int cont,
+		    const struct log_context *ctx, const char *format, va_list ap)
+{
+	struct log_async_ring *ring;
+	struct log_async_rec hdr;
+	char msg[LOG_ASYNC_MSG_MAX];
+	va_list bp;
+	int len, rc;
+
+	ring = ring_get();
+	if (!ring)
+		return -ENOMEM;
+
+	/* log_async_stop() waits for us to leave the ring alone */
+	__atomic_store_n(&ring->busy, true, __ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&log_async_running, __ATOMIC_SEQ_CST)) {
+		__atomic_store_n(&ring->busy, false, __ATOMIC_RELEASE);
+		return -ENODEV;
+	}
+
+	va_copy(bp, ap);
+	len = vsnprintf(msg, sizeof(msg), format, bp);
+	va_end(bp);
+	if (len < 0)
+		len = 0;
+	else if (len >= sizeof(msg))
+		len = sizeof(msg) - 1;
+
+	hdr.subsys = subsys;
+	hdr.level = level;
+	hdr.cont = cont;
+	hdr.line = line;
+	hdr.file = file;
+	osmo_gettimeofday(&hdr.origin.tv, NULL);
+	hdr.origin.tid = ring->tid;
+	hdr.ctx = *ctx;
+
+	/* The program is likely about to end, make sure this gets out. If we hold the log target
+	 * mutex, the writer thread cannot make progress: output the message ourselves instead of
+	 * waiting for it in log_async_flush(). */
+	if (level >= LOGL_FATAL && log_tgt_mutex_held()) {
+		log_output_recorded(subsys, level, file, line, cont, ctx, &hdr.origin, msg);
+		__atomic_store_n(&ring->busy, false, __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	rc = ring_push(ring, &hdr, msg, len);
+	__atomic_store_n(&ring->busy, false, __ATOMIC_RELEASE);
+
+	if (rc == 0 && __atomic_load_n(&la.sleeping, __ATOMIC_SEQ_CST))
+		writer_wake();
+
+	/* the program is likely about to end, make sure this gets out */
+	if (level >= LOGL_FATAL)
+		log_async_flush();
+
+	return 0;
+}
+
+static void ring_report_drops(struct log_async_ring *ring, uint64_t dropped)
+{
+	struct log_origin origin = { .tid = ring->tid };
+	struct log_context ctx = {};
+	char msg[128];
+
+	osmo_gettimeofday(&origin.tv, NULL);
+	snprintf(msg, sizeof(msg), "log_async: dropped %" PRIu64 " messages, ring full\n", dropped);
+
+	log_tgt_mutex_lock();
+	log_output_recorded(log_map_subsys(DLGLOBAL), LOGL_NOTICE, __FILE__, __LINE__, 0,
+			    &ctx, &origin, msg);
+	log_tgt_mutex_unlock();
+}
+
+/* Output all records currently in the ring, returns the number of records */
+static unsigned int ring_drain(struct log_async_ring *ring)
+{
+	struct log_async_rec *rec;
+	uint64_t head, tail = ring->tail, dropped;
+	unsigned int n = 0, batch;
+	size_t off;
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+	while (tail != head) {
+		log_tgt_mutex_lock();
+		for (batch = 0; tail != head && batch < LOG_ASYNC_BATCH;) {
+			off = tail & (ring->size - 1);
+			rec = (struct log_async_rec *)&ring->buf[off];
+			if (rec->len == 0) {
+				tail += ring->size - off;
+				continue;
+			}
+			log_output_recorded(rec->subsys, rec->level, rec->file, rec->line, rec->cont,
+					    &rec->ctx, &rec->origin, rec->msg);
+			tail += rec->len;
+			batch++;
+		}
+		log_tgt_mutex_unlock();
+
+		/* make room for the logging thread after each batch */
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		n += batch;
+	}
+
+	dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+	if (dropped != ring->dropped_reported) {
+		ring_report_drops(ring, dropped - ring->dropped_reported);
+		ring->dropped_reported = dropped;
+	}
+
+	return n;
+}
+
+/* Drain all rings, free those of exited threads. Returns the number of records. */
+static unsigned int rings_drain(void)
+{
+	struct llist_head *pos;
+	struct log_async_ring *ring;
+	unsigned int n = 0;
+
+	/* Rings are only freed by this thread, so it is safe to drop the lock
+	 * while draining one: only la.rings itself needs protection against
+	 * threads registering new rings. */
+	pthread_mutex_lock(&la.lock);
+	pos = la.rings.next;
+	while (pos != &la.rings) {
+		ring = llist_entry(pos, struct log_async_ring, list);
+		pthread_mutex_unlock(&la.lock);
+		n += ring_drain(ring);
+		pthread_mutex_lock(&la.lock);
+		pos = pos->next;
+		if (__atomic_load_n(&ring->dead, __ATOMIC_ACQUIRE) &&
+		    ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+			ring_free(ring);
+	}
+	pthread_mutex_unlock(&la.lock);
+
+	return n;
+}
+
+/* caller must hold la.lock */
+static bool rings_pending(void)
+{
+	struct log_async_ring *ring;
+
+	llist_for_each_entry(ring, &la.rings, list) {
+		if (ring->tail != __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST))
+			return true;
+	}
+	return false;
+}
+
+/* caller must hold la.lock */
+static bool rings_busy(void)
+{
+	struct log_async_ring *ring;
+
+	llist_for_each_entry(ring, &la.rings, list) {
+		if (__atomic_load_n(&ring->busy, __ATOMIC_SEQ_CST))
+			return true;
+	}
+	return false;
+}
+
+static void writer_sleep(unsigned long flush_req)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += LOG_ASYNC_IDLE_MS * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	/* Pairs with the check in log_async_vlogp(): either the logging thread
+	 * sees 'sleeping' and wakes us up, or we see its record here. */
+	__atomic_store_n(&la.sleeping, true, __ATOMIC_SEQ_CST);
+
+	pthread_mutex_lock(&la.lock);
+	while (!la.wake && !la.stop && la.flush_req == flush_req && !rings_pending()) {
+		if (pthread_cond_timedwait(&la.wake_cond, &la.lock, &ts) != 0)
+			break;
+	}
+	la.wake = false;
+	pthread_mutex_unlock(&la.lock);
+
+	__atomic_store_n(&la.sleeping, false, __ATOMIC_RELAXED);
+}
+
+static void *writer_main(void *arg)
+{
+	unsigned long flush_req;
+	unsigned int n;
+	bool stop, idle;
+
+	on_writer = true;
+
+	while (1) {
+		pthread_mutex_lock(&la.lock);
+		flush_req = la.flush_req;
+		stop = la.stop;
+		pthread_mutex_unlock(&la.lock);
+
+		/* everything logged before flush_req was read is output now */
+		n = rings_drain();
+
+		pthread_mutex_lock(&la.lock);
+		if (la.flush_done != flush_req) {
+			la.flush_done = flush_req;
+			pthread_cond_broadcast(&la.flush_cond);
+		}
+		/* on stop, wait for threads still writing to their rings */
+		idle = !rings_busy() && !rings_pending();
+		pthread_mutex_unlock(&la.lock);
+
+		if (n)
+			continue;
+		if (stop) {
+			if (idle)
+				break;
+			sched_yield();
+			continue;
+		}
+		writer_sleep(flush_req);
+	}
+
+	return NULL;
+}
+
+static void log_async_atexit(void)
+{
+	log_async_stop();
+}
+
+/*! Start asynchronous logging.
+ *  \param[in] ring_size size of the ring of each logging thread in bytes, 0 for the default (256 KiB)
+ *  \param[in] overflow what a thread does when its ring is full
+ *  \returns 0 on success; negative on error
+ *
+ *  From now on log messages are formatted by the logging thread, but output
+ *  to the log targets by a writer thread. This also enables
+ *  log_enable_multithread(). */
+int log_async_start(size_t ring_size, enum log_async_overflow overflow)
+{
+	struct log_async_ring *ring;
+	size_t size = LOG_ASYNC_RING_MIN;
+	uint8_t *buf;
+	int rc;
+
+	if (on_writer)
+		return -EINVAL;
+
+	pthread_once(&la_once, la_init);
+
+	if (ring_size == 0)
+		ring_size = LOG_ASYNC_RING_DEFAULT;
+	while (size < ring_size)
+		size <<= 1;
+
+	log_enable_multithread();
+
+	pthread_mutex_lock(&la.lock);
+	if (la.writer_alive) {
+		pthread_mutex_unlock(&la.lock);
+		return -EALREADY;
+	}
+
+	/* no thread uses its ring while we are stopped, they are all empty */
+	llist_for_each_entry(ring, &la.rings, list) {
+		if (ring->size == size)
+			continue;
+		buf = malloc(size);
+		if (!buf) {
+			pthread_mutex_unlock(&la.lock);
+			return -ENOMEM;
+		}
+		free(ring->buf);
+		ring->buf = buf;
+		ring->size = size;
+	}
+
+	la.ring_size = size;
+	la.overflow = overflow;
+	la.stop = false;
+	la.wake = false;
+	rc = pthread_create(&la.writer, NULL, writer_main, NULL);
+	if (rc) {
+		pthread_mutex_unlock(&la.lock);
+		return -rc;
+	}
+	la.writer_alive = true;
+	pthread_mutex_unlock(&la.lock);
+
+	if (!la_atexit_registered) {
+		atexit(log_async_atexit);
+		la_atexit_registered = true;
+	}
+
+	__atomic_store_n(&log_async_running, true, __ATOMIC_SEQ_CST);
+	return 0;
+}
+
+/*! Stop asynchronous logging.
+ *  All messages queued so far are output to the log targets before this
+ *  returns; log messages are output by the logging thread again afterwards. */
+void log_async_stop(void)
+{
+	struct log_async_ring *ring, *ring2;
+
+	if (on_writer)
+		return;
+
+	pthread_mutex_lock(&la.lock);
+	if (!la.writer_alive) {
+		pthread_mutex_unlock(&la.lock);
+		return;
+	}
+	/* new messages go the synchronous way from now on, the writer thread
+	 * drains what is queued and waits for threads busy queueing */
+	__atomic_store_n(&log_async_running, false, __ATOMIC_SEQ_CST);
+	la.stop = true;
+	pthread_cond_signal(&la.wake_cond);
+	pthread_mutex_unlock(&la.lock);
+
+	pthread_join(la.writer, NULL);
+
+	pthread_mutex_lock(&la.lock);
+	la.writer_alive = false;
+	la.stop = false;
+	llist_for_each_entry_safe(ring, ring2, &la.rings, list) {
+		if (ring->dead)
+			ring_free(ring);
+	}
+	pthread_cond_broadcast(&la.flush_cond);
+	pthread_mutex_unlock(&la.lock);
+}
+
+/*! Wait until all messages queued so far by any thread were output.
+ *  Does nothing if asynchronous logging is not running, or if the calling thread
+ *  holds the log target mutex (which the writer thread needs to make progress). */
+void log_async_flush(void)
+{
+	unsigned long gen;
+
+	if (on_writer || log_tgt_mutex_held())
+		return;
+
+	pthread_mutex_lock(&la.lock);
+	if (!la.writer_alive) {
+		pthread_mutex_unlock(&la.lock);
+		return;
+	}
+	gen = ++la.flush_req;
+	pthread_cond_signal(&la.wake_cond);
+	while (la.writer_alive && (long)(la.flush_done - gen) < 0)
+		pthread_cond_wait(&la.flush_cond, &la.lock);
+	pthread_mutex_unlock(&la.lock);
+}
+
+/*! Get the counters of asynchronous logging.
+ *  \param[out] stats counters summed over all threads since the program started */
+void log_async_get_stats(struct log_async_stats *stats)
+{
+	struct log_async_ring *ring;
+
+	pthread_mutex_lock(&la.lock);
+	*stats = la.retired;
+	llist_for_each_entry(ring, &la.rings, list) {
+		stats->enqueued += __atomic_load_n(&ring->enqueued, __ATOMIC_RELAXED);
+		stats->dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		stats->waited += __atomic_load_n(&ring->waited, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&la.lock);
+}
+
+#else /* if !defined(EMBEDDED) */
+
+int log_async_vlogp(int subsys, int level, const char *file, int line, int cont,
+		    const struct log_context *ctx, const char *format, va_list ap)
+{
+	return -ENOTSUP;
+}
+
+int log_async_start(size_t ring_size, enum log_async_overflow overflow)
+{
+	return -ENOTSUP;
+}
+
+void log_async_stop(void) {}
+void log_async_flush(void) {}
+
+void log_async_get_stats(struct log_async_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+#endif /* if !defined(EMBEDDED) */
+
+/*! Whether log messages are currently output by the writer thread.
+ *  \returns true between log_async_start() and log_async_stop() */
+bool log_async_is_running(void)
+{
+	return __atomic_load_n(&log_async_running, __ATOMIC_RELAXED);
+}
+
+/*! @} */
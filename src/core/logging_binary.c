@@ -0,0 +1,780 @@
+/*! \file logging_binary.c
+ * Binary logging target with deferred formatting. */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*! \addtogroup logging_binary
+ *  @{
+ * The binary log target does not format log messages at all. For each log
+ * statement it stores the address of the format string and of the source
+ * file name as small dictionary ids, the time, thread, sub-system and level,
+ * and the raw printf arguments, into a ring in a memory mapped file. The
+ * text is only produced when the file is read, e.g. by osmo-log-decode.
+ *
+ * Format strings and source file names are recorded in the dictionary the
+ * first time their address is seen, so they must be string constants, which
+ * is what LOGP() and friends pass. Strings passed for a "%s" are copied.
+ * Conversions that cannot be recorded (like "%n", "%ls" or positional
+ * arguments) fall back to storing the formatted text.
+ *
+ * Since the file is a shared memory mapping, the records of the last moments
+ * of a crashed program survive in the page cache.
+ *
+ * \file logging_binary.c */
+
+#include "config.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/logging_binary.h>
+#include <osmocom/core/logging_internal.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/thread.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+/* printf length modifiers */
+enum fmt_lmod {
+	LM_NONE,
+	LM_HH,
+	LM_H,
+	LM_L,
+	LM_LL,
+	LM_J,
+	LM_Z,
+	LM_T,
+	LM_LD,
+};
+
+/* One conversion specification of a printf format string */
+struct fmt_spec {
+	const char *start;	/* the '%' */
+	const char *end;	/* after the conversion character */
+	char conv;		/* conversion character, '%' for "%%" */
+	enum fmt_lmod lmod;
+	bool width_star;
+	bool prec_star;
+	int prec;		/* precision, -1 if none or '*' */
+};
+
+/* Find the next conversion specification at or after *p; on success, set
+ * *p to the first character after it. */
+static bool fmt_next(const char **p, struct fmt_spec *spec)
+{
+	const char *s = *p;
+
+	while (*s && *s != '%')
+		s++;
+	if (!*s)
+		return false;
+
+	memset(spec, 0, sizeof(*spec));
+	spec->start = s++;
+	spec->prec = -1;
+
+	while (*s && strchr("-+ #0'", *s))
+		s++;
+
+	if (*s == '*') {
+		spec->width_star = true;
+		s++;
+	} else {
+		while (isdigit((unsigned char)*s))
+			s++;
+	}
+
+	if (*s == '.') {
+		s++;
+		if (*s == '*') {
+			spec->prec_star = true;
+			s++;
+		} else {
+			spec->prec = 0;
+			while (isdigit((unsigned char)*s))
+				spec->prec = spec->prec * 10 + (*s++ - '0');
+		}
+	}
+
+	switch (*s) {
+	case 'h':
+		if (*++s == 'h') {
+			spec->lmod = LM_HH;
+			s++;
+		} else
+			spec->lmod = LM_H;
+		break;
+	case 'l':
+		if (*++s == 'l') {
+			spec->lmod = LM_LL;
+			s++;
+		} else
+			spec->lmod = LM_L;
+		break;
+	case 'q':
+		spec->lmod = LM_LL;
+		s++;
+		break;
+	case 'j':
+		spec->lmod = LM_J;
+		s++;
+		break;
+	case 'z':
+		spec->lmod = LM_Z;
+		s++;
+		break;
+	case 't':
+		spec->lmod = LM_T;
+		s++;
+		break;
+	case 'L':
+		spec->lmod = LM_LD;
+		s++;
+		break;
+	}
+
+	spec->conv = *s;
+	if (*s)
+		s++;
+	spec->end = s;
+	*p = s;
+	return true;
+}
+
+/*! Render the text of a binary log record.
+ *  \param[out] buf output buffer, always NUL terminated
+ *  \param[in] buf_len size of buf
+ *  \param[in] fmt the format string of the record
+ *  \param[in] args the arguments of the record (log_binary_rec.args)
+ *  \param[in] args_len length of args (log_binary_rec.args_len)
+ *  \returns number of characters of the complete text like snprintf(); negative if args are malformed
+ *
+ *  The arguments are stored in the order in which the conversions of the
+ *  format string consume them, each in the byte order of the writer:
+ *  - a '*' field width or precision: 8 bytes, int64_t;
+ *  - a signed integer conversion: 8 bytes, int64_t;
+ *  - an unsigned integer or character conversion, or "%p": 8 bytes, uint64_t;
+ *  - a floating point conversion: 8 bytes, double;
+ *  - "%s": 4 bytes uint32_t length, the characters and a NUL, padded to a
+ *    multiple of 8 bytes. A length of UINT32_MAX stands for a NULL pointer.
+ */
+int log_binary_render(char *buf, size_t buf_len, const char *fmt,
+		      const uint8_t *args, size_t args_len)
+{
+	struct osmo_strbuf sb = { .buf = buf, .len = buf_len };
+	const uint8_t *pos = args, *end = args + args_len;
+	const char *p = fmt, *lit = fmt, *s;
+	struct fmt_spec spec;
+	char conv[64];
+	int64_t i64;
+	uint64_t u64;
+	double d;
+	uint32_t slen;
+	size_t n;
+
+#define GET64(var) do { \
+		if (end - pos < 8) \
+			return -EINVAL; \
+		memcpy(&var, pos, 8); \
+		pos += 8; \
+	} while (0)
+
+	if (buf && buf_len)
+		buf[0] = '\0';
+
+	while (fmt_next(&p, &spec)) {
+		OSMO_STRBUF_PRINTF(sb, "%.*s", (int)(spec.start - lit), lit);
+		lit = spec.end;
+
+		if (spec.conv == '%') {
+			OSMO_STRBUF_PRINTF(sb, "%%");
+			continue;
+		}
+
+		/* copy the specification, with the recorded '*' values filled in */
+		n = 0;
+		for (s = spec.start; s < spec.end; s++) {
+			if (n > sizeof(conv) - 24)
+				return -EINVAL;
+			if (*s == '*') {
+				GET64(i64);
+				n += snprintf(&conv[n], sizeof(conv) - n, "%d", (int)i64);
+			} else
+				conv[n++] = *s;
+		}
+		conv[n] = '\0';
+
+		switch (spec.conv) {
+		case 'd':
+		case 'i':
+			GET64(i64);
+			switch (spec.lmod) {
+			case LM_L:
+				OSMO_STRBUF_PRINTF(sb, conv, (long)i64);
+				break;
+			case LM_LL:
+				OSMO_STRBUF_PRINTF(sb, conv, (long long)i64);
+				break;
+			case LM_J:
+				OSMO_STRBUF_PRINTF(sb, conv, (intmax_t)i64);
+				break;
+			case LM_Z:
+				OSMO_STRBUF_PRINTF(sb, conv, (ssize_t)i64);
+				break;
+			case LM_T:
+				OSMO_STRBUF_PRINTF(sb, conv, (ptrdiff_t)i64);
+				break;
+			default:
+				OSMO_STRBUF_PRINTF(sb, conv, (int)i64);
+				break;
+			}
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		case 'c':
+			GET64(u64);
+			switch (spec.lmod) {
+			case LM_L:
+				OSMO_STRBUF_PRINTF(sb, conv, (unsigned long)u64);
+				break;
+			case LM_LL:
+				OSMO_STRBUF_PRINTF(sb, conv, (unsigned long long)u64);
+				break;
+			case LM_J:
+				OSMO_STRBUF_PRINTF(sb, conv, (uintmax_t)u64);
+				break;
+			case LM_Z:
+				OSMO_STRBUF_PRINTF(sb, conv, (size_t)u64);
+				break;
+			case LM_T:
+				OSMO_STRBUF_PRINTF(sb, conv, (ptrdiff_t)u64);
+				break;
+			default:
+				OSMO_STRBUF_PRINTF(sb, conv, (unsigned int)u64);
+				break;
+			}
+			break;
+		case 'p':
+			GET64(u64);
+			OSMO_STRBUF_PRINTF(sb, conv, (void *)(uintptr_t)u64);
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			GET64(d);
+			if (spec.lmod == LM_LD)
+				OSMO_STRBUF_PRINTF(sb, conv, (long double)d);
+			else
+				OSMO_STRBUF_PRINTF(sb, conv, d);
+			break;
+		case 's':
+			if (end - pos < 4)
+				return -EINVAL;
+			memcpy(&slen, pos, 4);
+			if (slen == UINT32_MAX) {
+				if (end - pos < 8)
+					return -EINVAL;
+				OSMO_STRBUF_PRINTF(sb, conv, "(null)");
+				pos += 8;
+				break;
+			}
+			n = (4 + slen + 1 + 7) & ~7;
+			if (end - pos < n || pos[4 + slen] != '\0')
+				return -EINVAL;
+			OSMO_STRBUF_PRINTF(sb, conv, (const char *)pos + 4);
+			pos += n;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+	OSMO_STRBUF_PRINTF(sb, "%s", lit);
+
+#undef GET64
+
+	return sb.chars_needed;
+}
+
+#if (!EMBEDDED)
+
+#include <sys/mman.h>
+
+/* default and minimum size of the record ring, in bytes */
+#define LOG_BINARY_RING_DEFAULT	(8 * 1024 * 1024)
+#define LOG_BINARY_RING_MIN	(64 * 1024)
+/* maximum length of the arguments of one record, like MAX_LOG_SIZE */
+#define LOG_BINARY_ARGS_MAX	(4096 - sizeof(struct log_binary_rec))
+
+/* State of one binary log target, allocated as talloc child of the target */
+struct log_binary {
+	int fd;
+	uint8_t *map;
+	size_t map_len;
+	struct log_binary_hdr *hdr;
+	uint8_t *dict;
+	uint8_t *ring;
+	uint32_t next_id;
+	/* format string and file name address -> dictionary id, open addressing */
+	struct {
+		const char *str;
+		uint32_t id;
+	} *ids;
+	unsigned int ids_mask;
+	unsigned int ids_used;
+};
+
+static __thread uint32_t log_binary_tid;
+
+static int log_binary_free(struct log_binary *lb)
+{
+	if (lb->map)
+		munmap(lb->map, lb->map_len);
+	if (lb->fd >= 0)
+		close(lb->fd);
+	return 0;
+}
+
+/* Append a string to the dictionary of the file */
+static int dict_add(struct log_binary *lb, enum log_binary_str_kind kind, uint32_t id, const char *str)
+{
+	struct log_binary_hdr *hdr = lb->hdr;
+	struct log_binary_str *ent;
+	size_t len = strlen(str), need;
+
+	need = (sizeof(*ent) + len + 1 + 7) & ~7;
+	if (len > UINT16_MAX || hdr->dict_used + need > hdr->dict_size)
+		return -ENOSPC;
+
+	ent = (struct log_binary_str *)&lb->dict[hdr->dict_used];
+	ent->id = id;
+	ent->kind = kind;
+	ent->len = len;
+	memcpy(ent->str, str, len + 1);
+
+	/* readers of a live file only look at complete entries */
+	__atomic_store_n(&hdr->dict_used, hdr->dict_used + need, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static inline unsigned int str_hash(const char *str)
+{
+	return ((uintptr_t)str >> 3) * 2654435761u;
+}
+
+static int ids_grow(struct log_binary *lb)
+{
+	unsigned int i, h, size = (lb->ids_mask + 1) * 2;
+	typeof(lb->ids) ids;
+
+	ids = talloc_zero_array(lb, typeof(*lb->ids), size);
+	if (!ids)
+		return -ENOMEM;
+
+	for (i = 0; i <= lb->ids_mask; i++) {
+		if (!lb->ids[i].str)
+			continue;
+		for (h = str_hash(lb->ids[i].str) & (size - 1); ids[h].str; h = (h + 1) & (size - 1));
+		ids[h] = lb->ids[i];
+	}
+
+	talloc_free(lb->ids);
+	lb->ids = ids;
+	lb->ids_mask = size - 1;
+	return 0;
+}
+
+/* Get the dictionary id of a format string or file name, add it on first use */
+static uint32_t str_id(struct log_binary *lb, const char *str)
+{
+	unsigned int h;
+	uint32_t id;
+
+	if (!str)
+		return LOG_BINARY_ID_NONE;
+
+	for (h = str_hash(str) & lb->ids_mask; lb->ids[h].str; h = (h + 1) & lb->ids_mask) {
+		if (lb->ids[h].str == str)
+			return lb->ids[h].id;
+	}
+
+	if (lb->ids_used + 1 > (lb->ids_mask + 1) / 2) {
+		if (ids_grow(lb) < 0)
+			return LOG_BINARY_ID_NONE;
+		for (h = str_hash(str) & lb->ids_mask; lb->ids[h].str; h = (h + 1) & lb->ids_mask);
+	}
+
+	/* remember a full dictionary, too, so that we don't try again */
+	id = lb->next_id;
+	if (dict_add(lb, LOG_BINARY_STR_ID, id, str) == 0)
+		lb->next_id++;
+	else
+		id = LOG_BINARY_ID_NONE;
+
+	lb->ids[h].str = str;
+	lb->ids[h].id = id;
+	lb->ids_used++;
+	return id;
+}
+
+/* Record the arguments of a format string, see log_binary_render() */
+static int encode_args(uint8_t *buf, size_t buf_len, const char *fmt, va_list ap)
+{
+	uint8_t *pos = buf, *end = buf + buf_len;
+	const char *p = fmt, *str;
+	struct fmt_spec spec;
+	int64_t i64;
+	uint64_t u64;
+	double d;
+	uint32_t slen;
+	size_t need;
+	int prec;
+
+#define PUT64(var) do { \
+		if (end - pos < 8) \
+			return -ENOSPC; \
+		memcpy(pos, &var, 8); \
+		pos += 8; \
+	} while (0)
+
+	while (fmt_next(&p, &spec)) {
+		if (spec.conv == '%')
+			continue;
+
+		prec = spec.prec;
+		if (spec.width_star) {
+			i64 = va_arg(ap, int);
+			PUT64(i64);
+		}
+		if (spec.prec_star) {
+			prec = va_arg(ap, int);
+			i64 = prec;
+			PUT64(i64);
+		}
+
+		switch (spec.conv) {
+		case 'd':
+		case 'i':
+			switch (spec.lmod) {
+			case LM_NONE:
+			case LM_HH:
+			case LM_H:
+				i64 = va_arg(ap, int);
+				break;
+			case LM_L:
+				i64 = va_arg(ap, long);
+				break;
+			case LM_LL:
+				i64 = va_arg(ap, long long);
+				break;
+			case LM_J:
+				i64 = va_arg(ap, intmax_t);
+				break;
+			case LM_Z:
+				i64 = va_arg(ap, ssize_t);
+				break;
+			case LM_T:
+				i64 = va_arg(ap, ptrdiff_t);
+				break;
+			default:
+				return -EINVAL;
+			}
+			PUT64(i64);
+			break;
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		case 'c':
+			switch (spec.lmod) {
+			case LM_NONE:
+			case LM_HH:
+			case LM_H:
+				u64 = va_arg(ap, unsigned int);
+				break;
+			case LM_L:
+				if (spec.conv == 'c')
+					return -EINVAL;
+				u64 = va_arg(ap, unsigned long);
+				break;
+			case LM_LL:
+				u64 = va_arg(ap, unsigned long long);
+				break;
+			case LM_J:
+				u64 = va_arg(ap, uintmax_t);
+				break;
+			case LM_Z:
+				u64 = va_arg(ap, size_t);
+				break;
+			case LM_T:
+				u64 = va_arg(ap, ptrdiff_t);
+				break;
+			default:
+				return -EINVAL;
+			}
+			PUT64(u64);
+			break;
+		case 'p':
+			u64 = (uintptr_t)va_arg(ap, void *);
+			PUT64(u64);
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':
+			if (spec.lmod == LM_LD)
+				d = va_arg(ap, long double);
+			else
+				d = va_arg(ap, double);
+			PUT64(d);
+			break;
+		case 's':
+			if (spec.lmod != LM_NONE)
+				return -EINVAL;
+			str = va_arg(ap, const char *);
+			if (end - pos < 8)
+				return -ENOSPC;
+			if (!str) {
+				slen = UINT32_MAX;
+				memcpy(pos, &slen, 4);
+				pos += 8;
+				break;
+			}
+			/* with a precision, the string need not be NUL terminated */
+			slen = prec >= 0 ? strnlen(str, prec) : strlen(str);
+			/* truncate rather than lose the whole record */
+			if (4 + slen + 1 > end - pos)
+				slen = end - pos - 4 - 1;
+			need = (4 + slen + 1 + 7) & ~7;
+			memcpy(pos, &slen, 4);
+			memcpy(pos + 4, str, slen);
+			memset(pos + 4 + slen, 0, need - 4 - slen);
+			pos += need;
+			break;
+		default:
+			/* "%n", "%m", positional arguments, ... */
+			return -EINVAL;
+		}
+	}
+
+#undef PUT64
+
+	return pos - buf;
+}
+
+/* Record the formatted text as the single argument of a "%s" format */
+static int encode_text(uint8_t *buf, size_t buf_len, const char *fmt, va_list ap)
+{
+	uint32_t slen;
+	int rc;
+
+	rc = vsnprintf((char *)buf + 4, buf_len - 4, fmt, ap);
+	if (rc < 0)
+		rc = 0;
+	slen = OSMO_MIN(rc, buf_len - 4 - 1);
+	memcpy(buf, &slen, 4);
+	rc = (4 + slen + 1 + 7) & ~7;
+	memset(buf + 4 + slen, 0, rc - 4 - slen);
+	return rc;
+}
+
+/* Make room for a record of 'len' bytes at the head of the ring, dropping
+ * the oldest records as required. */
+static struct log_binary_rec *ring_reserve(struct log_binary *lb, uint32_t len)
+{
+	struct log_binary_hdr *hdr = lb->hdr;
+	uint64_t mask = hdr->ring_size - 1;
+	uint64_t head = hdr->head, tail = hdr->tail;
+	size_t off = head & mask, to_end = hdr->ring_size - off;
+	size_t total = len <= to_end ? len : to_end + len;
+	struct log_binary_rec *rec;
+
+	while (head + total - tail > hdr->ring_size) {
+		rec = (struct log_binary_rec *)&lb->ring[tail & mask];
+		if (rec->len == 0)
+			tail += hdr->ring_size - (tail & mask);
+		else
+			tail += rec->len;
+	}
+	__atomic_store_n(&hdr->tail, tail, __ATOMIC_RELEASE);
+
+	if (len > to_end) {
+		((struct log_binary_rec *)&lb->ring[off])->len = 0;
+		__atomic_store_n(&hdr->head, head + to_end, __ATOMIC_RELEASE);
+		off = 0;
+	}
+
+	return (struct log_binary_rec *)&lb->ring[off];
+}
+
+static void _binary_raw_output(struct log_target *target, int subsys,
+			       unsigned int level, const char *file, int line,
+			       int cont, const char *format, va_list ap)
+{
+	struct log_binary *lb = target->tgt_binary.priv;
+	const struct log_origin *origin = log_current_origin();
+	uint8_t args[LOG_BINARY_ARGS_MAX];
+	struct log_binary_rec *rec;
+	struct timeval tv;
+	uint32_t fmt_id;
+	va_list bp;
+	int len;
+
+	fmt_id = str_id(lb, format);
+	len = -1;
+	if (fmt_id != LOG_BINARY_ID_NONE) {
+		va_copy(bp, ap);
+		len = encode_args(args, sizeof(args), format, bp);
+		va_end(bp);
+	}
+	if (len < 0) {
+		/* not recordable or dictionary full: keep the text */
+		fmt_id = LOG_BINARY_ID_NONE;
+		len = encode_text(args, sizeof(args), format, ap);
+	}
+
+	rec = ring_reserve(lb, sizeof(*rec) + len);
+	rec->len = sizeof(*rec) + len;
+	rec->level = level;
+	rec->cont = cont;
+	rec->subsys = subsys;
+	rec->args_len = len;
+	rec->fmt_id = fmt_id;
+	rec->file_id = str_id(lb, file);
+	rec->line = line;
+	if (origin) {
+		tv = origin->tv;
+		rec->tid = origin->tid;
+	} else {
+		osmo_gettimeofday(&tv, NULL);
+		if (log_binary_tid == 0)
+			log_binary_tid = (uint32_t)osmo_gettid();
+		rec->tid = log_binary_tid;
+	}
+	rec->time_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+	memcpy(rec->args, args, len);
+
+	__atomic_store_n(&lb->hdr->head, lb->hdr->head + rec->len, __ATOMIC_RELEASE);
+}
+
+/*! Create a new binary logging target writing to a memory mapped file.
+ *  \param[in] fname file name of the new target, truncated if it exists
+ *  \param[in] size size of the record ring in bytes (rounded up to a power of two), 0 for the default of 8 MiB
+ *  \returns Log target in case of success, NULL otherwise
+ *
+ *  Log messages are stored without being formatted, use osmo-log-decode or
+ *  log_binary_render() to get the text. The log level, category and filter
+ *  settings of the target apply as usual; the print settings have no effect. */
+struct log_target *log_target_create_binary(const char *fname, size_t size)
+{
+	struct log_target *target;
+	struct log_binary *lb;
+	struct log_binary_hdr *hdr;
+	size_t ring_size = LOG_BINARY_RING_MIN, dict_size;
+	int i;
+
+	assert_loginfo(__func__);
+
+	if (size == 0)
+		size = LOG_BINARY_RING_DEFAULT;
+	while (ring_size < size)
+		ring_size <<= 1;
+	dict_size = OSMO_MIN(OSMO_MAX(ring_size / 8, 64 * 1024), 4 * 1024 * 1024);
+
+	target = log_target_create();
+	if (!target)
+		return NULL;
+
+	lb = talloc_zero(target, struct log_binary);
+	if (!lb)
+		goto err;
+	lb->fd = -1;
+	talloc_set_destructor(lb, log_binary_free);
+	target->tgt_binary.priv = lb;
+
+	lb->ids = talloc_zero_array(lb, typeof(*lb->ids), 1024);
+	if (!lb->ids)
+		goto err;
+	lb->ids_mask = 1024 - 1;
+	lb->next_id = LOG_BINARY_ID_NONE + 1;
+
+	target->tgt_binary.fname = talloc_strdup(target, fname);
+	if (!target->tgt_binary.fname)
+		goto err;
+	target->tgt_binary.size = ring_size;
+
+	lb->fd = open(fname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+	if (lb->fd < 0)
+		goto err;
+
+	lb->map_len = 4096 + dict_size + ring_size;
+	if (ftruncate(lb->fd, lb->map_len) < 0)
+		goto err;
+	lb->map = mmap(NULL, lb->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, lb->fd, 0);
+	if (lb->map == MAP_FAILED) {
+		lb->map = NULL;
+		goto err;
+	}
+
+	hdr = lb->hdr = (struct log_binary_hdr *)lb->map;
+	memcpy(hdr->magic, LOG_BINARY_MAGIC, sizeof(hdr->magic));
+	hdr->version = LOG_BINARY_VERSION;
+	hdr->byte_order = LOG_BINARY_BYTE_ORDER;
+	hdr->dict_off = 4096;
+	hdr->dict_size = dict_size;
+	hdr->ring_off = hdr->dict_off + dict_size;
+	hdr->ring_size = ring_size;
+	lb->dict = lb->map + hdr->dict_off;
+	lb->ring = lb->map + hdr->ring_off;
+
+	for (i = 0; i < osmo_log_info->num_cat; i++) {
+		if (osmo_log_info->cat[i].name)
+			dict_add(lb, LOG_BINARY_STR_CAT, i, osmo_log_info->cat[i].name);
+	}
+
+	target->type = LOG_TGT_TYPE_BINARY;
+	target->raw_output = _binary_raw_output;
+
+	return target;
+
+err:
+	log_target_destroy(target);
+	return NULL;
+}
+
+#endif /* (!EMBEDDED) */
+
+/*! @} */
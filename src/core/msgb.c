@@ -59,6 +59,149 @@
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/logging.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stats.h>
+
+#include "config.h"
+
+#if !defined(EMBEDDED) && !defined(OSMO_FREERTOS)
+#define MSGB_POOL_SUPPORTED
+#endif
+
+/* one size class of a msgb pool */
+struct msgb_pool_class {
+	/* payload size (data_len) of all msgb in this class */
+	uint16_t size;
+	/* number of msgb in the free list */
+	unsigned int num_cached;
+	/* free list of msgb, linked via msg->list.next */
+	struct msgb *cached;
+};
+
+/* per-thread msgb pool, see msgb_pool_init() */
+struct msgb_pool {
+	/* talloc context to which cached msgb are re-parented while in the free list */
+	void *ctx;
+	/* size classes, sorted by ascending size */
+	struct msgb_pool_class classes[MSGB_POOL_MAX_CLASSES];
+	unsigned int num_classes;
+	/* maximum number of msgb kept in the free list of each class */
+	unsigned int max_cached;
+	struct rate_ctr_group *ctrg;
+	/* msgb currently being released by msgb_free(), see msgb_pool_destructor() */
+	struct msgb *freeing;
+};
+
+/* msgb are allocated and free'd on the same thread (talloc is not thread-safe), so a per-thread pool
+ * with plain singly-linked free lists needs neither locks nor atomics. */
+static __thread struct msgb_pool *g_msgb_pool;
+
+/* initialize header of a (possibly recycled) msgb, leaving the payload untouched */
+static void msgb_init_hdr(struct msgb *msg, uint16_t size)
+{
+	memset(msg, 0x00, sizeof(*msg));
+
+	msg->data_len = size;
+	msg->len = 0;
+	msg->data = msg->_data;
+	msg->head = msg->_data;
+	msg->tail = msg->_data;
+}
+
+#ifdef MSGB_POOL_SUPPORTED
+static const struct rate_ctr_desc msgb_pool_ctr_desc[] = {
+	[MSGB_POOL_CTR_ALLOC_HIT]	= { "alloc:hit",	"msgb allocations served from the pool" },
+	[MSGB_POOL_CTR_ALLOC_MISS]	= { "alloc:miss",	"msgb allocations not served from the pool" },
+	[MSGB_POOL_CTR_FREE_CACHED]	= { "free:cached",	"msgb returned to the pool" },
+	[MSGB_POOL_CTR_FREE_RELEASED]	= { "free:released",	"msgb released as the pool was full" },
+};
+
+static const struct rate_ctr_group_desc msgb_pool_ctrg_desc = {
+	.group_name_prefix = "msgb:pool",
+	.group_description = "msgb pool allocator statistics",
+	.num_ctr = ARRAY_SIZE(msgb_pool_ctr_desc),
+	.ctr_desc = msgb_pool_ctr_desc,
+	.class_id = OSMO_STATS_CLASS_GLOBAL,
+};
+
+/* find the smallest size class fitting a msgb of given size */
+static struct msgb_pool_class *msgb_pool_class_find(struct msgb_pool *pool, uint16_t size)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool->num_classes; i++) {
+		if (pool->classes[i].size >= size)
+			return &pool->classes[i];
+	}
+	return NULL;
+}
+
+/* try to put a msgb into the free list of its size class; returns true if it was taken */
+static bool msgb_pool_recycle(struct msgb_pool *pool, struct msgb *msg)
+{
+	struct msgb_pool_class *cls = msgb_pool_class_find(pool, msg->data_len);
+
+	/* only take back what was allocated by the pool and is not referenced by other talloc chunks */
+	if (!cls || talloc_get_size(msg) != sizeof(*msg) + cls->size)
+		return false;
+	if (talloc_total_blocks(msg) != 1 || talloc_reference_count(msg) != 0)
+		return false;
+
+	if (cls->num_cached >= pool->max_cached) {
+		rate_ctr_inc2(pool->ctrg, MSGB_POOL_CTR_FREE_RELEASED);
+		return false;
+	}
+
+	talloc_steal(pool->ctx, msg);
+	talloc_set_name_const(msg, "msgb_pool_cached");
+	msg->list.next = (struct llist_head *)cls->cached;
+	cls->cached = msg;
+	cls->num_cached++;
+	rate_ctr_inc2(pool->ctrg, MSGB_POOL_CTR_FREE_CACHED);
+	return true;
+}
+
+/* talloc destructor of all msgb allocated by the pool: a msgb released via msgb_free() is taken back into
+ * the free list instead of being freed.  Any other talloc_free() (directly or via a parent) frees it.  A
+ * destructor set by the user replaces this one, so that such a msgb is never recycled. */
+static int msgb_pool_destructor(struct msgb *msg)
+{
+	struct msgb_pool *pool = g_msgb_pool;
+
+	if (!pool || pool->freeing != msg)
+		return 0;
+	/* returning -1 makes talloc keep the chunk (and this destructor) */
+	return msgb_pool_recycle(pool, msg) ? -1 : 0;
+}
+
+static struct msgb *msgb_pool_alloc(struct msgb_pool *pool, const void *ctx, uint16_t size, const char *name)
+{
+	struct msgb_pool_class *cls = msgb_pool_class_find(pool, size);
+	struct msgb *msg;
+
+	if (!cls)
+		return NULL;
+
+	if (cls->cached) {
+		msg = cls->cached;
+		cls->cached = (struct msgb *)msg->list.next;
+		cls->num_cached--;
+		talloc_steal(ctx, msg);
+		talloc_set_name_const(msg, name);
+		rate_ctr_inc2(pool->ctrg, MSGB_POOL_CTR_ALLOC_HIT);
+	} else {
+		/* allocate with the full class size, so that it can be recycled later on */
+		msg = talloc_named_const(ctx, sizeof(*msg) + cls->size, name);
+		if (!msg)
+			return NULL;
+		talloc_set_destructor(msg, msgb_pool_destructor);
+		rate_ctr_inc2(pool->ctrg, MSGB_POOL_CTR_ALLOC_MISS);
+	}
+
+	msgb_init_hdr(msg, size);
+	return msg;
+}
+#endif /* MSGB_POOL_SUPPORTED */
 
 /*! Allocate a new message buffer from given talloc context
  * \param[in] ctx talloc context from which to allocate
@@ -74,6 +217,14 @@ struct msgb *msgb_alloc_c(const void *ctx, uint16_t size, const char *name)
 {
 	struct msgb *msg;
 
+#ifdef MSGB_POOL_SUPPORTED
+	if (g_msgb_pool) {
+		msg = msgb_pool_alloc(g_msgb_pool, ctx, size, name);
+		if (msg)
+			return msg;
+	}
+#endif
+
 	msg = talloc_named_const(ctx, sizeof(*msg) + size, name);
 	if (!msg) {
 		LOGP(DLGLOBAL, LOGL_FATAL, "Unable to allocate a msgb: "
@@ -82,13 +233,8 @@ struct msgb *msgb_alloc_c(const void *ctx, uint16_t size, const char *name)
 	}
 
 	/* Manually zero-initialize allocated memory */
-	memset(msg, 0x00, sizeof(*msg) + size);
-
-	msg->data_len = size;
-	msg->len = 0;
-	msg->data = msg->_data;
-	msg->head = msg->_data;
-	msg->tail = msg->_data;
+	memset(msg->_data, 0x00, size);
+	msgb_init_hdr(msg, size);
 
 	return msg;
 }
@@ -116,9 +262,97 @@ struct msgb *msgb_alloc(uint16_t size, const char *name)
  */
 void msgb_free(struct msgb *m)
 {
+#ifdef MSGB_POOL_SUPPORTED
+	if (g_msgb_pool && m) {
+		g_msgb_pool->freeing = m;
+		talloc_free(m);
+		/* a user's talloc destructor may have destroyed the pool meanwhile */
+		if (g_msgb_pool)
+			g_msgb_pool->freeing = NULL;
+		return;
+	}
+#endif
 	talloc_free(m);
 }
 
+/*! Enable the msgb pool allocator for the current thread.
+ *  \param[in] ctx talloc context from which the pool and the cached msgb are allocated
+ *  \param[in] sizes payload sizes of the size classes (at most \ref MSGB_POOL_MAX_CLASSES); NULL for a default set
+ *  \param[in] num_sizes number of entries in \a sizes
+ *  \param[in] max_cached maximum number of free msgb kept per size class
+ *  \param[in] ctrg_idx index of the "msgb:pool" rate counter group, e.g. to distinguish threads
+ *  \returns 0 on success; negative on error
+ *
+ * Once enabled, msgb_alloc_c() (and hence msgb_alloc(), msgb_alloc_headroom() and the msgb allocated by
+ * osmo_io) serves requests up to the largest size class from per-size-class free lists, which are re-filled
+ * by msgb_free().  Only the msgb header is initialized on allocation; unlike without the pool, the payload is
+ * NOT zero-initialized.  A msgb is only recycled if it has no talloc children or references left and if no
+ * talloc destructor was set on it; otherwise it is free'd as usual, running its destructor and freeing its
+ * children.  msgb released via talloc_free() are simply not recycled. */
+int msgb_pool_init(void *ctx, const uint16_t *sizes, unsigned int num_sizes, unsigned int max_cached,
+		   unsigned int ctrg_idx)
+{
+#ifdef MSGB_POOL_SUPPORTED
+	static const uint16_t default_sizes[] = { 256, 512, 1024, 2048, 4096 };
+	struct msgb_pool *pool;
+	unsigned int i;
+
+	if (g_msgb_pool)
+		return -EALREADY;
+	if (!sizes) {
+		sizes = default_sizes;
+		num_sizes = ARRAY_SIZE(default_sizes);
+	}
+	if (num_sizes == 0 || num_sizes > MSGB_POOL_MAX_CLASSES)
+		return -EINVAL;
+	for (i = 1; i < num_sizes; i++) {
+		if (sizes[i] <= sizes[i - 1])
+			return -EINVAL;
+	}
+
+	pool = talloc_zero(ctx, struct msgb_pool);
+	if (!pool)
+		return -ENOMEM;
+	pool->ctx = pool;
+	pool->max_cached = max_cached;
+	pool->num_classes = num_sizes;
+	for (i = 0; i < num_sizes; i++)
+		pool->classes[i].size = sizes[i];
+
+	pool->ctrg = rate_ctr_group_alloc(pool, &msgb_pool_ctrg_desc, ctrg_idx);
+	if (!pool->ctrg) {
+		talloc_free(pool);
+		return -ENOMEM;
+	}
+
+	g_msgb_pool = pool;
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*! Disable the msgb pool allocator of the current thread and release all cached msgb.
+ *  msgb allocated from the pool and still in use remain valid and can be free'd as usual. */
+void msgb_pool_destroy(void)
+{
+	struct msgb_pool *pool = g_msgb_pool;
+
+	if (!pool)
+		return;
+	g_msgb_pool = NULL;
+	rate_ctr_group_free(pool->ctrg);
+	/* all cached msgb are children of the pool */
+	talloc_free(pool);
+}
+
+/*! Return the rate counter group of the msgb pool of the current thread.
+ *  \returns rate counter group (see enum msgb_pool_ctr); NULL if no pool is enabled */
+struct rate_ctr_group *msgb_pool_get_ctrg(void)
+{
+	return g_msgb_pool ? g_msgb_pool->ctrg : NULL;
+}
+
 /*! Enqueue message buffer to tail of a queue
  * \param[in] queue linked list header of queue
  * \param[in] msg message buffer to be added to the queue
@@ -153,7 +153,7 @@ struct iofd_msghdr *iofd_msghdr_alloc(struct osmo_io_fd *iofd, enum iofd_msg_act
 	hdr = talloc_zero_size(iofd, sizeof(struct iofd_msghdr) + cmsg_size);
 	if (!hdr) {
 		if (free_msg)
-			talloc_free(msg);
+			msgb_free(msg);
 		return NULL;
 	}
 
@@ -721,6 +721,7 @@ struct osmo_io_fd *osmo_iofd_setup(const void *ctx, int fd, const char *name, en
 
 	iofd->tx_queue.max_length = 1024;
 	INIT_LLIST_HEAD(&iofd->tx_queue.msg_queue);
+	iofd->batch_size = 1;
 
 	return iofd;
 }
@@ -739,6 +740,28 @@ int osmo_iofd_set_cmsg_size(struct osmo_io_fd *iofd, size_t cmsg_size)
 	return 0;
 }
 
+/*! Set the maximum number of datagrams to receive/transmit per system call.
+ *
+ * With a batch size larger than 1, the poll back-end receives up to \a batch_size datagrams with a single
+ * recvmmsg() whenever the socket becomes readable, and transmits up to \a batch_size queued messages with a
+ * single sendmmsg() whenever it becomes writable.  Each message is still passed to recvfrom_cb / sendto_cb
+ * individually.  The io_uring back-end batches its I/O by itself and ignores this setting.
+ *
+ * Only supported in OSMO_IO_FD_MODE_RECVFROM_SENDTO.
+ *  \param[in] iofd the file descriptor
+ *  \param[in] batch_size maximum number of datagrams per system call (1..OSMO_IO_BATCH_SIZE_MAX); 1 disables batching
+ *  \returns 0 on success; negative on error */
+int osmo_iofd_set_batch_size(struct osmo_io_fd *iofd, unsigned int batch_size)
+{
+	if (iofd->mode != OSMO_IO_FD_MODE_RECVFROM_SENDTO)
+		return -EINVAL;
+	if (batch_size < 1 || batch_size > OSMO_IO_BATCH_SIZE_MAX)
+		return -EINVAL;
+
+	iofd->batch_size = batch_size;
+	return 0;
+}
+
 /*! Register the osmo_io_fd for active I/O.
  *
  *  Calling this function will register a previously initialized osmo_io_fd for performing I/O.
@@ -19,11 +19,15 @@
 #define OSMO_IO_DEFAULT_MSGB_SIZE 1024
 #define OSMO_IO_DEFAULT_MSGB_HEADROOM 128
 
+/*! maximum number of concurrent read requests per iofd in the io_uring backend */
+#define IOFD_URING_MAX_READ_SQES 8
+
 extern const struct iofd_backend_ops iofd_poll_ops;
 #define OSMO_IO_BACKEND_DEFAULT "POLL"
 
 #if defined(HAVE_URING)
 extern const struct iofd_backend_ops iofd_uring_ops;
+void osmo_iofd_uring_submit_pending(void);
 #endif
 
 struct iofd_backend_ops {
@@ -78,6 +82,9 @@ struct osmo_io_fd {
 	/*! size of iofd_msghdr.cmsg[] when allocated in recvmsg path */
 	size_t cmsg_size;
 
+	/*! max. number of datagrams per recvmmsg()/sendmmsg() in the poll back-end, 1 = no batching */
+	unsigned int batch_size;
+
 	struct {
 		/*! talloc context from which to allocate msgb when reading */
 		const void *ctx;
@@ -99,11 +106,14 @@ struct osmo_io_fd {
 	union {
 		struct {
 			struct osmo_fd ofd;
+			/*! receive msgbs left unused by the previous recvmmsg() */
+			struct llist_head rx_spare;
 		} poll;
 		struct {
 			bool read_enabled;
 			bool write_enabled;
-			void *read_msghdr;
+			/*! outstanding read requests; several of them on datagram sockets */
+			void *read_msghdr[IOFD_URING_MAX_READ_SQES];
 			void *write_msghdr;
 			/* TODO: index into array of registered fd's? */
 			/* osmo_fd for non-blocking connect handling */
@@ -141,6 +151,8 @@ struct iofd_msghdr {
 	struct msgb *msg;
 	/*! I/O file descriptor on which we perform this I/O operation */
 	struct osmo_io_fd *iofd;
+	/*! provided buffer ring of a multishot receive (io_uring backend only) */
+	void *buf_ring;
 
 	/*! control message buffer for passing sctp_sndrcvinfo along */
 	char cmsg[0]; /* size is determined by iofd->cmsg_size on recvmsg, and by mcghdr->msg_controllen on sendmsg */
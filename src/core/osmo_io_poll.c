@@ -20,6 +20,10 @@
  *  GNU General Public License for more details.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for recvmmsg() / sendmmsg() */
+#endif
+
 #include "../config.h"
 #ifndef EMBEDDED
 
@@ -41,12 +45,137 @@
 
 #include "osmo_io_internal.h"
 
+#if defined(HAVE_RECVMMSG)
+/*! get a receive msgb, preferably one left over from the previous recvmmsg() */
+static struct msgb *iofd_poll_rx_msgb(struct osmo_io_fd *iofd)
+{
+	struct msgb *msg;
+
+	while (!llist_empty(&iofd->u.poll.rx_spare)) {
+		msg = llist_first_entry(&iofd->u.poll.rx_spare, struct msgb, list);
+		llist_del(&msg->list);
+		/* osmo_iofd_set_alloc_info() may have been called meanwhile */
+		if (msg->data_len == iofd->msgb_alloc.size + iofd->msgb_alloc.headroom)
+			return msg;
+		msgb_free(msg);
+	}
+	return iofd_msgb_alloc(iofd);
+}
+
+/*! receive up to iofd->batch_size datagrams with one recvmmsg() and hand them to the user one by one */
+static void iofd_poll_recvmmsg(struct osmo_io_fd *iofd)
+{
+	struct iofd_msghdr hdr[OSMO_IO_BATCH_SIZE_MAX];
+	struct mmsghdr mmsg[OSMO_IO_BATCH_SIZE_MAX];
+	unsigned int i, n = 0;
+	int rc;
+
+	for (i = 0; i < iofd->batch_size; i++) {
+		struct msgb *msg = iofd_poll_rx_msgb(iofd);
+		if (!msg)
+			break;
+		hdr[i].msg = msg;
+		hdr[i].iov[0].iov_base = msg->tail;
+		hdr[i].iov[0].iov_len = msgb_tailroom(msg);
+		hdr[i].hdr = (struct msghdr) {
+			.msg_iov = &hdr[i].iov[0],
+			.msg_iovlen = 1,
+			.msg_name = &hdr[i].osa.u.sa,
+			.msg_namelen = sizeof(struct osmo_sockaddr),
+		};
+		mmsg[i].msg_hdr = hdr[i].hdr;
+		n++;
+	}
+	if (n == 0) {
+		LOGPIO(iofd, LOGL_ERROR, "Could not allocate msgb for reading\n");
+		OSMO_ASSERT(0);
+	}
+
+	/* We know at least one datagram is waiting; don't block for the others */
+	rc = recvmmsg(iofd->fd, mmsg, n, MSG_WAITFORONE, NULL);
+	if (rc <= 0) {
+		iofd_handle_recv(iofd, hdr[0].msg, (rc < 0 && errno > 0) ? -errno : rc, &hdr[0]);
+		i = 1;
+	} else {
+		for (i = 0; i < rc; i++) {
+			/* stop delivering if the user closed or unregistered the iofd from within the call-back */
+			if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED) || !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_FD_REGISTERED))
+				break;
+			msgb_put(hdr[i].msg, mmsg[i].msg_len);
+			hdr[i].hdr.msg_namelen = mmsg[i].msg_hdr.msg_namelen;
+			iofd_handle_recv(iofd, hdr[i].msg, mmsg[i].msg_len, &hdr[i]);
+		}
+	}
+
+	for (; i < n; i++) {
+		/* keep the buffers that received nothing for the next time, unless the iofd is going away */
+		if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED) || !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_FD_REGISTERED))
+			msgb_free(hdr[i].msg);
+		else
+			llist_add_tail(&hdr[i].msg->list, &iofd->u.poll.rx_spare);
+	}
+}
+#endif /* HAVE_RECVMMSG */
+
+#if defined(HAVE_SENDMMSG)
+/*! transmit up to iofd->batch_size queued messages with one sendmmsg() */
+static void iofd_poll_sendmmsg(struct osmo_io_fd *iofd)
+{
+	struct iofd_msghdr *msghdr[OSMO_IO_BATCH_SIZE_MAX];
+	struct mmsghdr mmsg[OSMO_IO_BATCH_SIZE_MAX];
+	unsigned int i, n, sent;
+	int rc, err = 0;
+
+	for (n = 0; n < iofd->batch_size; n++) {
+		msghdr[n] = iofd_txqueue_dequeue(iofd);
+		if (!msghdr[n])
+			break;
+		mmsg[n].msg_hdr = msghdr[n]->hdr;
+		/* sendmmsg() has no per-message flags, so a message with its own flags ends the batch */
+		if (msghdr[n]->flags != msghdr[0]->flags) {
+			iofd_txqueue_enqueue_front(iofd, msghdr[n]);
+			break;
+		}
+	}
+	OSMO_ASSERT(n > 0);
+
+	rc = sendmmsg(iofd->fd, mmsg, n, msghdr[0]->flags);
+	if (rc < 0) {
+		err = errno > 0 ? -errno : rc;
+		sent = 0;
+	} else
+		sent = rc;
+
+	/* Put back what was not sent (in order), before any call-back can enqueue new messages. If nothing
+	 * was sent at all, the first message is completed with the error like after a failed sendto(). */
+	for (i = n; i > (err ? 1 : sent); i--)
+		iofd_txqueue_enqueue_front(iofd, msghdr[i - 1]);
+
+	for (i = 0; i < sent; i++) {
+		if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED)) {
+			msgb_free(msghdr[i]->msg);
+			iofd_msghdr_free(msghdr[i]);
+			continue;
+		}
+		iofd_handle_send_completion(iofd, mmsg[i].msg_len, msghdr[i]);
+	}
+	if (err)
+		iofd_handle_send_completion(iofd, err, msghdr[0]);
+}
+#endif /* HAVE_SENDMMSG */
+
 static void iofd_poll_ofd_cb_recvmsg_sendmsg(struct osmo_fd *ofd, unsigned int what)
 {
 	struct osmo_io_fd *iofd = ofd->data;
 	struct msgb *msg;
 	int rc, flags = 0;
 
+#if defined(HAVE_RECVMMSG)
+	if ((what & OSMO_FD_READ) && iofd->batch_size > 1) {
+		iofd_poll_recvmmsg(iofd);
+		what &= ~OSMO_FD_READ;
+	}
+#endif
 	if (what & OSMO_FD_READ) {
 		struct iofd_msghdr hdr;
 
@@ -91,6 +220,12 @@ static void iofd_poll_ofd_cb_recvmsg_sendmsg(struct osmo_fd *ofd, unsigned int w
 	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED))
 		return;
 
+#if defined(HAVE_SENDMMSG)
+	if ((what & OSMO_FD_WRITE) && iofd->batch_size > 1 && osmo_iofd_txqueue_len(iofd) > 1) {
+		iofd_poll_sendmmsg(iofd);
+		return;
+	}
+#endif
 	if (what & OSMO_FD_WRITE) {
 		struct iofd_msghdr *msghdr = iofd_txqueue_dequeue(iofd);
 		if (msghdr) {
@@ -150,6 +285,8 @@ static int iofd_poll_register(struct osmo_io_fd *iofd)
 	int rc;
 
 	osmo_fd_setup(ofd, iofd->fd, 0, &iofd_poll_ofd_cb_dispatch, iofd, 0);
+	if (!iofd->u.poll.rx_spare.next)
+		INIT_LLIST_HEAD(&iofd->u.poll.rx_spare);
 	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_NOTIFY_CONNECTED))
 		osmo_fd_write_enable(&iofd->u.poll.ofd);
 
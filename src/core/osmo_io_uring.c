@@ -20,16 +20,20 @@
  *  GNU General Public License for more details.
  */
 
-/* TODO:
- * Parameters:
- * - number of simultaneous read/write in uring for given fd
+/* Reads in RECVFROM mode are kept outstanding several at a time (see LIBOSMO_IO_URING_READ_SQES), or a
+ * single multishot recvmsg is used instead if the kernel supports it: it picks its buffers
+ * from a per-iofd provided buffer ring whose entries are the data areas of pre-allocated msgbs, so each
+ * completion is handed to the user without copying.
  *
+ * SQEs are not submitted one by one; they are collected during an event loop iteration and submitted in one
+ * io_uring_submit() call by osmo_iofd_uring_submit_pending() before the loop blocks again.
  */
 
 #include "../config.h"
 #if defined(__linux__)
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <talloc.h>
 #include <unistd.h>
 #include <string.h>
@@ -54,9 +58,28 @@
 
 #define IOFD_URING_ENTRIES 4096
 
+/*! environment variable: number of concurrent read requests per RECVFROM iofd (1..IOFD_URING_MAX_READ_SQES) */
+#define IOFD_URING_READ_SQES_ENV "LIBOSMO_IO_URING_READ_SQES"
+#define IOFD_URING_READ_SQES_DEFAULT 4
+/*! environment variable: set to 0 to disable multishot receive in RECVFROM mode */
+#define IOFD_URING_MULTISHOT_ENV "LIBOSMO_IO_URING_MULTISHOT"
+
+/*! number of msgbs provided to the kernel for one multishot receive (power of two) */
+#define IOFD_URING_BUF_RING_ENTRIES 64
+/*! maximum number of provided buffer groups (i.e. multishot iofds) per thread */
+#define IOFD_URING_MAX_BUF_GROUPS 1024
+
 struct osmo_io_uring {
 	struct osmo_fd event_ofd;
 	struct io_uring ring;
+	/*! whether the ring has been set up in this thread */
+	bool initialized;
+	/*! number of concurrent read requests per RECVFROM iofd */
+	unsigned int read_sqes;
+	/*! whether to use multishot receive in RECVFROM mode */
+	bool multishot;
+	/*! bitmap of provided buffer group ids in use */
+	uint32_t bgid_used[IOFD_URING_MAX_BUF_GROUPS / 32];
 };
 
 static __thread struct osmo_io_uring g_ring;
@@ -88,8 +111,27 @@ static int iofd_uring_poll_cb(struct osmo_fd *ofd, unsigned int what)
 /*! initialize the uring and tie it into our event loop */
 void osmo_iofd_uring_init(void)
 {
+	const char *env;
 	int rc, evfd;
 
+	g_ring.read_sqes = IOFD_URING_READ_SQES_DEFAULT;
+	env = getenv(IOFD_URING_READ_SQES_ENV);
+	if (env) {
+		rc = atoi(env);
+		if (rc < 1 || rc > IOFD_URING_MAX_READ_SQES) {
+			fprintf(stderr, "Invalid value \"%s\" in environment variable %s (range 1..%d)\n",
+				env, IOFD_URING_READ_SQES_ENV, IOFD_URING_MAX_READ_SQES);
+			exit(1);
+		}
+		g_ring.read_sqes = rc;
+	}
+#if defined(HAVE_URING_BUF_RING)
+	env = getenv(IOFD_URING_MULTISHOT_ENV);
+	g_ring.multishot = !env || strcmp(env, "0");
+#else
+	g_ring.multishot = false;
+#endif
+
 	rc = io_uring_queue_init(IOFD_URING_ENTRIES, &g_ring.ring, 0);
 	if (rc < 0)
 		osmo_panic("failure during io_uring_queue_init(): %s\n", strerror(-rc));
@@ -115,10 +157,62 @@ void osmo_iofd_uring_init(void)
 		io_uring_queue_exit(&g_ring.ring);
 		osmo_panic("failure registering eventfd with io_uring: %s\n", strerror(-rc));
 	}
+	g_ring.initialized = true;
+}
+
+/*! submit all SQEs prepared since the last call to the kernel in a single syscall.
+ *  Called by the osmo_select_main() loop before it waits for new events. */
+void osmo_iofd_uring_submit_pending(void)
+{
+	if (!g_ring.initialized)
+		return;
+	if (io_uring_sq_ready(&g_ring.ring) > 0)
+		io_uring_submit(&g_ring.ring);
+}
+
+/*! obtain a SQE, flushing the pending ones to the kernel if the submission queue is full */
+static struct io_uring_sqe *iofd_uring_get_sqe(struct osmo_io_fd *iofd)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = io_uring_get_sqe(&g_ring.ring);
+	if (OSMO_UNLIKELY(!sqe)) {
+		io_uring_submit(&g_ring.ring);
+		sqe = io_uring_get_sqe(&g_ring.ring);
+	}
+	if (!sqe) {
+		LOGPIO(iofd, LOGL_ERROR, "Could not get io_uring_sqe\n");
+		OSMO_ASSERT(0);
+	}
+	return sqe;
 }
 
+/*! return whether any read request is outstanding for the given iofd */
+static bool iofd_uring_read_pending(const struct osmo_io_fd *iofd)
+{
+	unsigned int i;
 
-static void iofd_uring_submit_recv(struct osmo_io_fd *iofd, enum iofd_msg_action action)
+	for (i = 0; i < ARRAY_SIZE(iofd->u.uring.read_msghdr); i++) {
+		if (iofd->u.uring.read_msghdr[i])
+			return true;
+	}
+	return false;
+}
+
+/*! return the read_msghdr[] slot of the given msghdr, or -1 if it is not attached to its iofd (anymore) */
+static int iofd_uring_read_slot(const struct osmo_io_fd *iofd, const struct iofd_msghdr *msghdr)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(iofd->u.uring.read_msghdr); i++) {
+		if (iofd->u.uring.read_msghdr[i] == msghdr)
+			return i;
+	}
+	return -1;
+}
+
+
+static void iofd_uring_submit_recv(struct osmo_io_fd *iofd, enum iofd_msg_action action, unsigned int slot)
 {
 	struct msgb *msg;
 	struct iofd_msghdr *msghdr;
@@ -156,11 +250,7 @@ static void iofd_uring_submit_recv(struct osmo_io_fd *iofd, enum iofd_msg_action
 		OSMO_ASSERT(0);
 	}
 
-	sqe = io_uring_get_sqe(&g_ring.ring);
-	if (!sqe) {
-		LOGPIO(iofd, LOGL_ERROR, "Could not get io_uring_sqe\n");
-		OSMO_ASSERT(0);
-	}
+	sqe = iofd_uring_get_sqe(iofd);
 
 	switch (action) {
 	case IOFD_ACT_READ:
@@ -175,28 +265,250 @@ static void iofd_uring_submit_recv(struct osmo_io_fd *iofd, enum iofd_msg_action
 	}
 	io_uring_sqe_set_data(sqe, msghdr);
 
-	io_uring_submit(&g_ring.ring);
-	/* NOTE: This only works if we have one read per fd */
-	iofd->u.uring.read_msghdr = msghdr;
+	iofd->u.uring.read_msghdr[slot] = msghdr;
+}
+
+/*! make sure all read requests of the given RECVFROM iofd are outstanding */
+static void iofd_uring_submit_recv_all(struct osmo_io_fd *iofd, enum iofd_msg_action action)
+{
+	unsigned int i;
+
+	for (i = 0; i < g_ring.read_sqes; i++) {
+		if (!iofd->u.uring.read_msghdr[i])
+			iofd_uring_submit_recv(iofd, action, i);
+	}
+}
+
+#if defined(HAVE_URING_BUF_RING)
+/*! provided buffer ring backing a multishot receive. Allocated as talloc child of the multishot msghdr, as the
+ *  kernel may write into its buffers until the final completion of that msghdr has been seen. */
+struct iofd_uring_buf_ring {
+	struct io_uring_buf_ring *br;
+	/*! buffer group id the ring is registered under */
+	int bgid;
+	/*! offset of the payload in each buffer: struct io_uring_recvmsg_out followed by the peer address */
+	unsigned int payload_offset;
+	/*! msgb whose data area currently backs each buffer id */
+	struct msgb *msg[IOFD_URING_BUF_RING_ENTRIES];
+};
+
+static int iofd_uring_buf_ring_destructor(struct iofd_uring_buf_ring *bufr)
+{
+	/* the msgbs are talloc children of bufr and are released by talloc after this */
+	io_uring_free_buf_ring(&g_ring.ring, bufr->br, IOFD_URING_BUF_RING_ENTRIES, bufr->bgid);
+	g_ring.bgid_used[bufr->bgid / 32] &= ~(1U << (bufr->bgid % 32));
+	return 0;
+}
+
+/*! allocate a msgb for buffer id \a bid and add its data area to the ring (without advancing the tail) */
+static int iofd_uring_buf_ring_provide(struct iofd_uring_buf_ring *bufr, struct osmo_io_fd *iofd,
+				       unsigned int bid, unsigned int idx)
+{
+	uint16_t headroom = iofd->msgb_alloc.headroom + bufr->payload_offset;
+	struct msgb *msg;
+
+	OSMO_ASSERT(iofd->msgb_alloc.size <= 0xffff - headroom);
+	msg = msgb_alloc_headroom_c(bufr, iofd->msgb_alloc.size + headroom, headroom, "osmo_io_msgb");
+	if (!msg)
+		return -ENOMEM;
+	bufr->msg[bid] = msg;
+
+	/* The kernel puts the recvmsg header and peer address in front of the payload, so the payload ends up
+	 * exactly at msg->data and the msgb can be passed on as-is. */
+	io_uring_buf_ring_add(bufr->br, msg->data - bufr->payload_offset, bufr->payload_offset + msgb_tailroom(msg),
+			      bid, io_uring_buf_ring_mask(IOFD_URING_BUF_RING_ENTRIES), idx);
+	return 0;
+}
+
+/*! set up the msghdr and provided buffer ring for a multishot receive on the given iofd */
+static struct iofd_msghdr *iofd_uring_multishot_alloc(struct osmo_io_fd *iofd)
+{
+	struct iofd_uring_buf_ring *bufr;
+	struct iofd_msghdr *msghdr;
+	unsigned int bid;
+	int bgid, rc;
+
+	for (bgid = 0; bgid < IOFD_URING_MAX_BUF_GROUPS; bgid++) {
+		if (!(g_ring.bgid_used[bgid / 32] & (1U << (bgid % 32))))
+			break;
+	}
+	if (bgid == IOFD_URING_MAX_BUF_GROUPS)
+		return NULL;
+
+	msghdr = talloc_zero(iofd, struct iofd_msghdr);
+	if (!msghdr)
+		return NULL;
+	msghdr->action = IOFD_ACT_RECVFROM;
+	msghdr->iofd = iofd;
+	msghdr->hdr.msg_name = &msghdr->osa.u.sa;
+	msghdr->hdr.msg_namelen = sizeof(msghdr->osa.u.sas);
+
+	bufr = talloc_zero(msghdr, struct iofd_uring_buf_ring);
+	if (!bufr)
+		goto free_msghdr;
+	bufr->br = io_uring_setup_buf_ring(&g_ring.ring, IOFD_URING_BUF_RING_ENTRIES, bgid, 0, &rc);
+	if (!bufr->br) {
+		LOGPIO(iofd, LOGL_NOTICE, "Cannot set up provided buffer ring (%s), not using multishot receive\n",
+		       strerror(-rc));
+		g_ring.multishot = false;
+		goto free_msghdr;
+	}
+	bufr->bgid = bgid;
+	g_ring.bgid_used[bgid / 32] |= 1U << (bgid % 32);
+	talloc_set_destructor(bufr, iofd_uring_buf_ring_destructor);
+	bufr->payload_offset = sizeof(struct io_uring_recvmsg_out) + msghdr->hdr.msg_namelen;
+
+	for (bid = 0; bid < IOFD_URING_BUF_RING_ENTRIES; bid++) {
+		if (iofd_uring_buf_ring_provide(bufr, iofd, bid, bid) < 0)
+			goto free_msghdr;
+	}
+	io_uring_buf_ring_advance(bufr->br, IOFD_URING_BUF_RING_ENTRIES);
+
+	msghdr->buf_ring = bufr;
+	return msghdr;
+
+free_msghdr:
+	talloc_free(msghdr);
+	return NULL;
+}
+
+/*! (re-)submit the multishot receive described by msghdr */
+static void iofd_uring_submit_recv_multishot(struct osmo_io_fd *iofd, struct iofd_msghdr *msghdr)
+{
+	struct iofd_uring_buf_ring *bufr = msghdr->buf_ring;
+	struct io_uring_sqe *sqe;
+
+	sqe = iofd_uring_get_sqe(iofd);
+	io_uring_prep_recvmsg_multishot(sqe, iofd->fd, &msghdr->hdr, msghdr->flags);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = bufr->bgid;
+	io_uring_sqe_set_data(sqe, msghdr);
+
+	iofd->u.uring.read_msghdr[0] = msghdr;
+}
+
+/*! completion call-back for a multishot RECVFROM */
+static void iofd_uring_handle_recv_multishot(struct iofd_msghdr *msghdr, int rc, unsigned int cqe_flags)
+{
+	struct osmo_io_fd *iofd = msghdr->iofd;
+	struct iofd_uring_buf_ring *bufr = msghdr->buf_ring;
+	struct io_uring_recvmsg_out *out;
+	struct msgb *msg;
+	unsigned int bid;
+
+	if (cqe_flags & IORING_CQE_F_BUFFER) {
+		bid = cqe_flags >> IORING_CQE_BUFFER_SHIFT;
+		msg = bufr->msg[bid];
+		bufr->msg[bid] = NULL;
+
+		/* replace the buffer before handing out the msgb, the kernel may keep receiving meanwhile */
+		if (iofd_uring_buf_ring_provide(bufr, iofd, bid, 0) == 0)
+			io_uring_buf_ring_advance(bufr->br, 1);
+		else
+			LOGPIO(iofd, LOGL_ERROR, "Could not allocate msgb for reading\n");
+
+		out = io_uring_recvmsg_validate(msg->data - bufr->payload_offset, rc, &msghdr->hdr);
+		if (!out) {
+			LOGPIO(iofd, LOGL_ERROR, "Dropping malformed multishot completion\n");
+			msgb_free(msg);
+		} else {
+			rc = io_uring_recvmsg_payload_length(out, rc, &msghdr->hdr);
+			msgb_put(msg, rc);
+			memcpy(&msghdr->osa, io_uring_recvmsg_name(out),
+			       OSMO_MIN(out->namelen, sizeof(msghdr->osa)));
+			if (!IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED))
+				iofd_handle_recv(iofd, msg, rc, msghdr);
+			else
+				msgb_free(msg);
+		}
+		/* the user may have unregistered the iofd; msghdr then lives on until its final completion */
+		if (!msghdr->iofd)
+			goto detached;
+	}
+
+	if (cqe_flags & IORING_CQE_F_MORE)
+		return;
+
+	/* The multishot request has terminated. We re-arm it unless we cancelled it or the error is permanent. */
+	switch (rc) {
+	case -EINVAL:
+		LOGPIO(iofd, LOGL_NOTICE, "Multishot receive not supported by kernel, falling back to single reads\n");
+		g_ring.multishot = false;
+		break;
+	case -ENOBUFS:
+	case -ECANCELED:
+		break;
+	default:
+		if (rc < 0 && !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED)) {
+			msg = iofd_msgb_alloc(iofd);
+			if (msg)
+				iofd_handle_recv(iofd, msg, rc, msghdr);
+			if (!msghdr->iofd)
+				goto detached;
+		}
+		break;
+	}
+
+	if (iofd->u.uring.read_enabled && !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED) && g_ring.multishot) {
+		iofd_uring_submit_recv_multishot(iofd, msghdr);
+		return;
+	}
+
+	iofd->u.uring.read_msghdr[0] = NULL;
+	iofd_msghdr_free(msghdr);
+	if (iofd->u.uring.read_enabled && !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED))
+		iofd_uring_submit_recv_all(iofd, IOFD_ACT_RECVFROM);
+	return;
+
+detached:
+	if (!(cqe_flags & IORING_CQE_F_MORE))
+		iofd_msghdr_free(msghdr);
 }
 
+/*! arm a multishot receive on the given RECVFROM iofd; returns false if single reads have to be used instead */
+static bool iofd_uring_read_enable_multishot(struct osmo_io_fd *iofd)
+{
+	struct iofd_msghdr *msghdr = iofd->u.uring.read_msghdr[0];
+
+	/* already armed (or being cancelled, in which case the final completion re-arms it) */
+	if (msghdr && msghdr->buf_ring)
+		return true;
+	if (!g_ring.multishot || iofd_uring_read_pending(iofd))
+		return false;
+
+	msghdr = iofd_uring_multishot_alloc(iofd);
+	if (!msghdr)
+		return false;
+	iofd_uring_submit_recv_multishot(iofd, msghdr);
+	return true;
+}
+#endif /* HAVE_URING_BUF_RING */
+
 /*! completion call-back for READ/RECVFROM */
 static void iofd_uring_handle_recv(struct iofd_msghdr *msghdr, int rc)
 {
 	struct osmo_io_fd *iofd = msghdr->iofd;
 	struct msgb *msg = msghdr->msg;
+	int slot;
 
 	if (rc > 0)
 		msgb_put(msg, rc);
 
+	/* The msgb is handed on (or freed) now; a cancellation from within the call-back must not take it over */
+	msghdr->msg = NULL;
 	if (!IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED))
 		iofd_handle_recv(iofd, msg, rc, msghdr);
-
-	if (iofd->u.uring.read_enabled && !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED))
-		iofd_uring_submit_recv(iofd, msghdr->action);
 	else
-		iofd->u.uring.read_msghdr = NULL;
-
+		msgb_free(msg);
+
+	/* The msghdr is not attached anymore if the user unregistered the iofd during the call-back */
+	slot = iofd_uring_read_slot(iofd, msghdr);
+	if (slot >= 0) {
+		if (iofd->u.uring.read_enabled && !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED))
+			iofd_uring_submit_recv(iofd, msghdr->action, slot);
+		else
+			iofd->u.uring.read_msghdr[slot] = NULL;
+	}
 
 	iofd_msghdr_free(msghdr);
 }
@@ -230,7 +542,7 @@ static void iofd_uring_handle_tx(struct iofd_msghdr *msghdr, int rc)
 }
 
 /*! handle completion of a single I/O message */
-static void iofd_uring_handle_completion(struct iofd_msghdr *msghdr, int res)
+static void iofd_uring_handle_completion(struct iofd_msghdr *msghdr, int res, unsigned int cqe_flags)
 {
 	struct osmo_io_fd *iofd = msghdr->iofd;
 
@@ -240,6 +552,12 @@ static void iofd_uring_handle_completion(struct iofd_msghdr *msghdr, int res)
 	case IOFD_ACT_READ:
 	case IOFD_ACT_RECVFROM:
 	case IOFD_ACT_RECVMSG:
+#if defined(HAVE_URING_BUF_RING)
+		if (msghdr->buf_ring) {
+			iofd_uring_handle_recv_multishot(msghdr, res, cqe_flags);
+			break;
+		}
+#endif
 		iofd_uring_handle_recv(msghdr, res);
 		break;
 	case IOFD_ACT_WRITE:
@@ -253,7 +571,7 @@ static void iofd_uring_handle_completion(struct iofd_msghdr *msghdr, int res)
 
 	IOFD_FLAG_UNSET(iofd, IOFD_FLAG_IN_CALLBACK);
 
-	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_TO_FREE) && !iofd->u.uring.read_msghdr && !iofd->u.uring.write_msghdr)
+	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_TO_FREE) && !iofd_uring_read_pending(iofd) && !iofd->u.uring.write_msghdr)
 		talloc_free(iofd);
 }
 
@@ -261,6 +579,7 @@ static void iofd_uring_handle_completion(struct iofd_msghdr *msghdr, int res)
 static void iofd_uring_cqe(struct io_uring *ring)
 {
 	int rc;
+	unsigned int flags;
 	struct io_uring_cqe *cqe;
 	struct iofd_msghdr *msghdr;
 
@@ -273,16 +592,19 @@ static void iofd_uring_cqe(struct io_uring *ring)
 			continue;
 		}
 		if (!msghdr->iofd) {
+			/* a multishot request keeps its msghdr (and buffers) in use until the final completion */
+			if (!(cqe->flags & IORING_CQE_F_MORE))
+				iofd_msghdr_free(msghdr);
 			io_uring_cqe_seen(ring, cqe);
-			iofd_msghdr_free(msghdr);
 			continue;
 		}
 
 		rc = cqe->res;
+		flags = cqe->flags;
 		/* Hand the entry back to the kernel before */
 		io_uring_cqe_seen(ring, cqe);
 
-		iofd_uring_handle_completion(msghdr, rc);
+		iofd_uring_handle_completion(msghdr, rc, flags);
 
 	}
 }
@@ -297,11 +619,7 @@ static int iofd_uring_submit_tx(struct osmo_io_fd *iofd)
 	if (!msghdr)
 		return -ENODATA;
 
-	sqe = io_uring_get_sqe(&g_ring.ring);
-	if (!sqe) {
-		LOGPIO(iofd, LOGL_ERROR, "Could not get io_uring_sqe\n");
-		OSMO_ASSERT(0);
-	}
+	sqe = iofd_uring_get_sqe(iofd);
 
 	io_uring_sqe_set_data(sqe, msghdr);
 
@@ -317,7 +635,6 @@ static int iofd_uring_submit_tx(struct osmo_io_fd *iofd)
 		OSMO_ASSERT(0);
 	}
 
-	io_uring_submit(&g_ring.ring);
 	iofd->u.uring.write_msghdr = msghdr;
 
 	return 0;
@@ -362,7 +679,7 @@ static int iofd_uring_connected_cb(struct osmo_fd *ofd, unsigned int what)
 	if (iofd->u.uring.read_enabled && !IOFD_FLAG_ISSET(iofd, IOFD_FLAG_CLOSED))
 		iofd_uring_read_enable(iofd);
 
-	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_TO_FREE) && !iofd->u.uring.read_msghdr && !iofd->u.uring.write_msghdr)
+	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_TO_FREE) && !iofd_uring_read_pending(iofd) && !iofd->u.uring.write_msghdr)
 		talloc_free(iofd);
 	return 0;
 }
@@ -392,23 +709,27 @@ static int iofd_uring_unregister(struct osmo_io_fd *iofd)
 {
 	struct io_uring_sqe *sqe;
 	struct iofd_msghdr *msghdr;
+	unsigned int i;
 
-	if (iofd->u.uring.read_msghdr) {
-		msghdr = iofd->u.uring.read_msghdr;
-		sqe = io_uring_get_sqe(&g_ring.ring);
-		OSMO_ASSERT(sqe != NULL);
+	for (i = 0; i < ARRAY_SIZE(iofd->u.uring.read_msghdr); i++) {
+		msghdr = iofd->u.uring.read_msghdr[i];
+		if (!msghdr)
+			continue;
+		sqe = iofd_uring_get_sqe(iofd);
 		io_uring_sqe_set_data(sqe, NULL);
 		LOGPIO(iofd, LOGL_DEBUG, "Cancelling read\n");
-		iofd->u.uring.read_msghdr = NULL;
+		iofd->u.uring.read_msghdr[i] = NULL;
 		talloc_steal(OTC_GLOBAL, msghdr);
+		/* the kernel may still write into the msgb until the cancellation has completed */
+		if (msghdr->msg)
+			talloc_steal(msghdr, msghdr->msg);
 		msghdr->iofd = NULL;
 		io_uring_prep_cancel(sqe, msghdr, 0);
 	}
 
 	if (iofd->u.uring.write_msghdr) {
 		msghdr = iofd->u.uring.write_msghdr;
-		sqe = io_uring_get_sqe(&g_ring.ring);
-		OSMO_ASSERT(sqe != NULL);
+		sqe = iofd_uring_get_sqe(iofd);
 		io_uring_sqe_set_data(sqe, NULL);
 		LOGPIO(iofd, LOGL_DEBUG, "Cancelling write\n");
 		iofd->u.uring.write_msghdr = NULL;
@@ -417,7 +738,6 @@ static int iofd_uring_unregister(struct osmo_io_fd *iofd)
 		msghdr->iofd = NULL;
 		io_uring_prep_cancel(sqe, msghdr, 0);
 	}
-	io_uring_submit(&g_ring.ring);
 
 	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_NOTIFY_CONNECTED)) {
 		osmo_fd_unregister(&iofd->u.uring.connect_ofd);
@@ -458,15 +778,10 @@ static void iofd_uring_write_enable(struct osmo_io_fd *iofd)
 		msghdr->iov[0].iov_base = msgb_data(msg);
 		msghdr->iov[0].iov_len = msgb_length(msg);
 
-		sqe = io_uring_get_sqe(&g_ring.ring);
-		if (!sqe) {
-			LOGPIO(iofd, LOGL_ERROR, "Could not get io_uring_sqe\n");
-			OSMO_ASSERT(0);
-		}
+		sqe = iofd_uring_get_sqe(iofd);
 		io_uring_prep_writev(sqe, iofd->fd, msghdr->iov, 1, 0);
 		io_uring_sqe_set_data(sqe, msghdr);
 
-		io_uring_submit(&g_ring.ring);
 		iofd->u.uring.write_msghdr = msghdr;
 	}
 }
@@ -480,22 +795,28 @@ static void iofd_uring_read_enable(struct osmo_io_fd *iofd)
 {
 	iofd->u.uring.read_enabled = true;
 
-	if (iofd->u.uring.read_msghdr)
-		return;
-
 	/* This function is called again, once the socket is connected. */
 	if (IOFD_FLAG_ISSET(iofd, IOFD_FLAG_NOTIFY_CONNECTED))
 		return;
 
 	switch (iofd->mode) {
 	case OSMO_IO_FD_MODE_READ_WRITE:
-		iofd_uring_submit_recv(iofd, IOFD_ACT_READ);
-		break;
-	case OSMO_IO_FD_MODE_RECVFROM_SENDTO:
-		iofd_uring_submit_recv(iofd, IOFD_ACT_RECVFROM);
+		/* only one read at a time, stream data must be processed in order */
+		if (!iofd->u.uring.read_msghdr[0])
+			iofd_uring_submit_recv(iofd, IOFD_ACT_READ, 0);
 		break;
 	case OSMO_IO_FD_MODE_RECVMSG_SENDMSG:
-		iofd_uring_submit_recv(iofd, IOFD_ACT_RECVMSG);
+		/* likewise, this mode serves ordered sockets like SCTP, where parallel reads could complete out of
+		 * order */
+		if (!iofd->u.uring.read_msghdr[0])
+			iofd_uring_submit_recv(iofd, IOFD_ACT_RECVMSG, 0);
+		break;
+	case OSMO_IO_FD_MODE_RECVFROM_SENDTO:
+#if defined(HAVE_URING_BUF_RING)
+		if (iofd_uring_read_enable_multishot(iofd))
+			break;
+#endif
+		iofd_uring_submit_recv_all(iofd, IOFD_ACT_RECVFROM);
 		break;
 	default:
 		OSMO_ASSERT(0);
@@ -504,7 +825,18 @@ static void iofd_uring_read_enable(struct osmo_io_fd *iofd)
 
 static void iofd_uring_read_disable(struct osmo_io_fd *iofd)
 {
+	struct iofd_msghdr *msghdr = iofd->u.uring.read_msghdr[0];
+	struct io_uring_sqe *sqe;
+
 	iofd->u.uring.read_enabled = false;
+
+	/* A multishot receive would go on delivering, so cancel it. It stays attached until its final
+	 * completion, which re-arms it if reading was enabled again meanwhile. */
+	if (msghdr && msghdr->buf_ring) {
+		sqe = iofd_uring_get_sqe(iofd);
+		io_uring_sqe_set_data(sqe, NULL);
+		io_uring_prep_cancel(sqe, msghdr, 0);
+	}
 }
 
 static int iofd_uring_close(struct osmo_io_fd *iofd)
@@ -51,6 +51,15 @@
  *  introspection, as well as by any application-specific code accessing
  *  the \ref rate_ctr.intv array directly.
  *
+ *  Groups that are incremented from several threads can be allocated by
+ *  \ref rate_ctr_group_alloc_sharded. Each thread then increments its own
+ *  cache-line aligned row of counters without any locked instruction, and
+ *  the rows are folded into \ref rate_ctr.current lazily whenever the
+ *  counters are read: by the interval timer, by \ref
+ *  rate_ctr_for_each_counter (VTY, stats reporters) and by the CTRL
+ *  interface. Worker threads must only use \ref rate_ctr_add2 and \ref
+ *  rate_ctr_inc2 on such groups.
+ *
  * \file rate_ctr.c */
 
 #include <errno.h>
@@ -67,10 +76,31 @@
 #include <osmocom/core/rate_ctr.h>
 #include <osmocom/core/logging.h>
 
+#include <stats_internal.h>
+
 static LLIST_HEAD(rate_ctr_groups);
 
 static void *tall_rate_ctr_ctx;
 
+/* one row of counters per thread slot, each row starting on its own cache line */
+#define RATE_CTR_SHARD_ALIGN	64
+#define RATE_CTR_SHARD_ROW_CTRS	(RATE_CTR_SHARD_ALIGN / sizeof(uint64_t))
+
+struct rate_ctr_shards {
+	/* number of single-writer rows; row num_shards is the shared, atomic overflow row */
+	unsigned int num_shards;
+	/* number of uint64_t per row, num_ctr rounded up to a full cache line */
+	unsigned int row_len;
+	/* per counter: sum over all rows at the time of the last rate_ctr_group_sync() */
+	uint64_t *synced;
+	/* (num_shards + 1) * row_len counters */
+	uint64_t *rows;
+};
+
+/* process-wide thread slot, assigned on the first sharded increment of each thread */
+static __thread unsigned int rate_ctr_thread_slot;
+static unsigned int rate_ctr_next_slot;
+
 
 static bool rate_ctrl_group_desc_validate(const struct rate_ctr_group_desc *desc)
 {
@@ -247,8 +277,109 @@ struct rate_ctr_group *rate_ctr_group_alloc(void *ctx,
 	group->idx = idx;
 
 	llist_add(&group->list, &rate_ctr_groups);
+	osmo_stats_layout_gen++;
+
+	return group;
+}
+
+/*! Allocate a new group of counters that may be incremented from multiple threads
+ *
+ *  Other than for rate_ctr_group_alloc(), increments done through rate_ctr_add2() and
+ *  rate_ctr_inc2() go to a per-thread row of counters and only show up in
+ *  \ref rate_ctr.current after rate_ctr_group_sync(), which the library calls itself
+ *  whenever it reads the group. The first \a num_shards threads incrementing any sharded
+ *  group get a row of their own; all further threads share one row using atomic adds.
+ *
+ *  Reading, syncing, resetting and freeing the group must happen from the thread
+ *  running the osmo_select_main() loop, like for any other counter group.
+ *  \param[in] ctx parent talloc context
+ *  \param[in] desc Rate counter group description
+ *  \param[in] idx Index of new counter group
+ *  \param[in] num_shards Number of threads expected to increment the group
+ *  \returns newly allocated counter group or NULL on error
+ */
+struct rate_ctr_group *rate_ctr_group_alloc_sharded(void *ctx,
+						    const struct rate_ctr_group_desc *desc,
+						    unsigned int idx, unsigned int num_shards)
+{
+	struct rate_ctr_group *group;
+	struct rate_ctr_shards *shards;
+	unsigned int row_len;
+	void *rows;
+
+	if (num_shards == 0)
+		num_shards = 1;
+
+	group = rate_ctr_group_alloc(ctx, desc, idx);
+	if (!group)
+		return NULL;
 
+	row_len = (desc->num_ctr + RATE_CTR_SHARD_ROW_CTRS - 1) / RATE_CTR_SHARD_ROW_CTRS * RATE_CTR_SHARD_ROW_CTRS;
+	if (row_len == 0)
+		row_len = RATE_CTR_SHARD_ROW_CTRS;
+
+	shards = talloc_zero(group, struct rate_ctr_shards);
+	if (!shards)
+		goto free_group;
+	shards->num_shards = num_shards;
+	shards->row_len = row_len;
+	shards->synced = talloc_zero_array(shards, uint64_t, desc->num_ctr ? : 1);
+	rows = talloc_zero_size(shards, (num_shards + 1) * row_len * sizeof(uint64_t) + RATE_CTR_SHARD_ALIGN);
+	if (!shards->synced || !rows)
+		goto free_group;
+	shards->rows = (uint64_t *)(((uintptr_t)rows + RATE_CTR_SHARD_ALIGN - 1) & ~(uintptr_t)(RATE_CTR_SHARD_ALIGN - 1));
+
+	group->shards = shards;
 	return group;
+
+free_group:
+	rate_ctr_group_free(group);
+	return NULL;
+}
+
+/*! Add to a counter of a sharded group; use rate_ctr_add2() instead of calling this directly */
+void _rate_ctr_shard_add(struct rate_ctr_group *ctrg, unsigned int idx, int inc)
+{
+	struct rate_ctr_shards *shards = ctrg->shards;
+	unsigned int slot = rate_ctr_thread_slot;
+	uint64_t *ctr;
+
+	if (OSMO_UNLIKELY(slot == 0))
+		slot = rate_ctr_thread_slot = __atomic_add_fetch(&rate_ctr_next_slot, 1, __ATOMIC_RELAXED);
+
+	if (OSMO_LIKELY(slot <= shards->num_shards)) {
+		/* this thread is the only writer of its row, no locked instruction needed */
+		ctr = &shards->rows[(slot - 1) * shards->row_len + idx];
+		__atomic_store_n(ctr, __atomic_load_n(ctr, __ATOMIC_RELAXED) + inc, __ATOMIC_RELAXED);
+	} else {
+		ctr = &shards->rows[shards->num_shards * shards->row_len + idx];
+		__atomic_fetch_add(ctr, inc, __ATOMIC_RELAXED);
+	}
+}
+
+/*! Fold the per-thread rows of a sharded counter group into its counters
+ *
+ *  This is a no-op for groups not allocated by rate_ctr_group_alloc_sharded(). The
+ *  library calls this before reading a group, applications only need to call it when
+ *  accessing \ref rate_ctr.current directly.
+ *  \param[in] grp Rate counter group
+ */
+void rate_ctr_group_sync(struct rate_ctr_group *grp)
+{
+	struct rate_ctr_shards *shards = grp->shards;
+	unsigned int i, s;
+
+	if (!shards)
+		return;
+
+	for (i = 0; i < grp->desc->num_ctr; i++) {
+		uint64_t sum = 0;
+
+		for (s = 0; s <= shards->num_shards; s++)
+			sum += __atomic_load_n(&shards->rows[s * shards->row_len + i], __ATOMIC_RELAXED);
+		grp->ctr[i].current += sum - shards->synced[i];
+		shards->synced[i] = sum;
+	}
 }
 
 /*! Free the memory for the specified group of counters */
@@ -257,8 +388,10 @@ void rate_ctr_group_free(struct rate_ctr_group *grp)
 	if (!grp)
 		return;
 
-	if (!llist_empty(&grp->list))
+	if (!llist_empty(&grp->list)) {
 		llist_del(&grp->list);
+		osmo_stats_layout_gen++;
+	}
 	talloc_free(grp);
 }
 
@@ -280,6 +413,7 @@ struct rate_ctr *rate_ctr_group_get_ctr(struct rate_ctr_group *grp, unsigned int
 void rate_ctr_group_set_name(struct rate_ctr_group *grp, const char *name)
 {
 	osmo_talloc_replace_string(grp, &grp->name, name);
+	osmo_stats_layout_gen++;
 }
 
 /*! Add a number to the counter */
@@ -316,6 +450,8 @@ static void rate_ctr_group_intv(struct rate_ctr_group *grp)
 {
 	unsigned int i;
 
+	rate_ctr_group_sync(grp);
+
 	for (i = 0; i < grp->desc->num_ctr; i++) {
 		struct rate_ctr *ctr = &grp->ctr[i];
 
@@ -445,6 +581,8 @@ int rate_ctr_for_each_counter(struct rate_ctr_group *ctrg,
 	int rc = 0;
 	int i;
 
+	rate_ctr_group_sync(ctrg);
+
 	for (i = 0; i < ctrg->desc->num_ctr; i++) {
 		struct rate_ctr *ctr = &ctrg->ctr[i];
 		rc = handle_counter(ctrg,
@@ -22,6 +22,7 @@
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
@@ -38,9 +39,16 @@
 
 #include "config.h"
 
+#if defined(HAVE_URING)
+#include "osmo_io_internal.h"
+#endif
+
 #if defined(HAVE_SYS_SELECT_H) && defined(HAVE_POLL_H)
 #include <sys/select.h>
 #include <poll.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 /*! \addtogroup select
  *  @{
@@ -54,12 +62,27 @@ static __thread int maxfd = 0;
 static __thread struct llist_head osmo_fds; /* TLS cannot use LLIST_HEAD() */
 static __thread int unregistered_count;
 
+/*! This environment variable can be set to manually set the backend used in osmo_select_main() */
+#define OSMO_SELECT_BACKEND_ENV "LIBOSMO_SELECT_BACKEND"
+#define OSMO_SELECT_BACKEND_DEFAULT "POLL"
+
+const struct value_string osmo_select_backend_names[] = {
+	{ OSMO_SELECT_BACKEND_POLL, "poll" },
+	{ OSMO_SELECT_BACKEND_EPOLL, "epoll" },
+	{ 0, NULL }
+};
+
+/* the back-end is chosen once per process; each thread has its own state for it */
+static enum osmo_select_backend g_select_backend;
+
 /* Array of struct osmo_fd * (size "max_fd") ordered by "ofd->fd" */
 static __thread struct {
 	struct osmo_fd **table;
 	unsigned int size;
 } osmo_fd_lookup;
 
+static void epoll_armed_extend(unsigned int new_size);
+
 static void osmo_fd_lookup_table_extend(unsigned int new_max_fd)
 {
 	unsigned int min_new_size;
@@ -84,6 +107,7 @@ static void osmo_fd_lookup_table_extend(unsigned int new_max_fd)
 		memset(ptr + osmo_fd_lookup.size, 0, new_size - osmo_fd_lookup.size);
 		osmo_fd_lookup.table = (struct osmo_fd **)ptr;
 		osmo_fd_lookup.size = new_size;
+		epoll_armed_extend(new_size / sizeof(struct osmo_fd *));
 	}
 }
 
@@ -97,6 +121,33 @@ struct poll_state {
 	unsigned int num_registered;
 };
 static __thread struct poll_state g_poll;
+
+#ifdef HAVE_SYS_EPOLL_H
+/* maximum number of events retrieved by one epoll_wait(); more ready fds are served in the next iteration */
+#define EPOLL_MAX_EVENTS	1024
+/* marker in epoll_state.armed for fds which epoll(7) refuses to watch (regular files, /dev/null, ...) */
+#define EPOLL_ARMED_UNPOLLABLE	0x80
+
+struct epoll_state {
+	/* epoll instance of this thread */
+	int epfd;
+	/* whether epfd was created for this thread */
+	bool initialized;
+	/* array of epoll_event filled by epoll_wait() */
+	struct epoll_event *events;
+	/* OSMO_FD_* flags currently armed in the kernel interest set, indexed by fd */
+	uint8_t *armed;
+	/* number of entries in armed allocated */
+	unsigned int armed_size;
+	/* fds which cannot be added to the interest set; like poll(2), we consider them always ready */
+	int *unpollable;
+	/* number of entries in unpollable used */
+	unsigned int num_unpollable;
+	/* number of entries in unpollable allocated */
+	unsigned int unpollable_size;
+};
+static __thread struct epoll_state g_epoll;
+#endif /* HAVE_SYS_EPOLL_H */
 #endif /* FORCE_IO_SELECT */
 
 /*! See osmo_select_shutdown_request() */
@@ -104,6 +155,131 @@ static int _osmo_select_shutdown_requested = 0;
 /*! See osmo_select_shutdown_request() */
 static bool _osmo_select_shutdown_done = false;
 
+#if !defined(FORCE_IO_SELECT) && defined(HAVE_SYS_EPOLL_H)
+static void epoll_armed_extend(unsigned int new_size)
+{
+	uint8_t *ptr;
+
+	if (g_select_backend != OSMO_SELECT_BACKEND_EPOLL || new_size <= g_epoll.armed_size)
+		return;
+
+	ptr = talloc_realloc_size(OTC_GLOBAL, g_epoll.armed, new_size);
+	OSMO_ASSERT(ptr);
+	memset(ptr + g_epoll.armed_size, 0, new_size - g_epoll.armed_size);
+	g_epoll.armed = ptr;
+	g_epoll.armed_size = new_size;
+}
+
+static int epoll_unpollable_add(int fd)
+{
+	if (g_epoll.num_unpollable + 1 > g_epoll.unpollable_size) {
+		int *p;
+		unsigned int new_size = g_epoll.unpollable_size ? g_epoll.unpollable_size * 2 : 16;
+		p = talloc_realloc(OTC_GLOBAL, g_epoll.unpollable, int, new_size);
+		if (!p)
+			return -ENOMEM;
+		g_epoll.unpollable = p;
+		g_epoll.unpollable_size = new_size;
+	}
+	g_epoll.unpollable[g_epoll.num_unpollable++] = fd;
+	return 0;
+}
+
+static void epoll_unpollable_del(int fd)
+{
+	unsigned int i;
+
+	for (i = 0; i < g_epoll.num_unpollable; i++) {
+		if (g_epoll.unpollable[i] != fd)
+			continue;
+		g_epoll.unpollable[i] = g_epoll.unpollable[--g_epoll.num_unpollable];
+		return;
+	}
+}
+
+/* whether any of the unpollable fds currently has a non-empty 'when' */
+static bool epoll_unpollable_pending(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < g_epoll.num_unpollable; i++) {
+		if (g_epoll.armed[g_epoll.unpollable[i]] & ~EPOLL_ARMED_UNPOLLABLE)
+			return true;
+	}
+	return false;
+}
+
+/* bring the kernel interest set in sync with ofd->when; no-op if nothing changed */
+static int epoll_sync(struct osmo_fd *ofd)
+{
+	unsigned int when = ofd->when & (OSMO_FD_READ | OSMO_FD_WRITE | OSMO_FD_EXCEPT);
+	uint8_t armed = g_epoll.armed[ofd->fd];
+	struct epoll_event ev = { .data.fd = ofd->fd };
+	int op, rc;
+
+	if (armed & EPOLL_ARMED_UNPOLLABLE) {
+		g_epoll.armed[ofd->fd] = EPOLL_ARMED_UNPOLLABLE | when;
+		return 0;
+	}
+	if (when == armed)
+		return 0;
+
+	/* use the same mapping as the poll() based implementation; EPOLLHUP and EPOLLERR are always reported.
+	 * A fd without any 'when' is removed from the interest set, as otherwise a hang-up would wake us up
+	 * over and over again while the user is not interested in that fd. */
+	if (when & OSMO_FD_READ)
+		ev.events |= EPOLLIN;
+	if (when & OSMO_FD_WRITE)
+		ev.events |= EPOLLOUT;
+	if (when & OSMO_FD_EXCEPT)
+		ev.events |= EPOLLPRI;
+
+	if (!when)
+		op = EPOLL_CTL_DEL;
+	else if (!armed)
+		op = EPOLL_CTL_ADD;
+	else
+		op = EPOLL_CTL_MOD;
+
+	rc = epoll_ctl(g_epoll.epfd, op, ofd->fd, &ev);
+	if (rc < 0 && op == EPOLL_CTL_ADD && errno == EPERM) {
+		/* regular files and some character devices don't support epoll, but poll() reports them as
+		 * always ready. Do the same by serving them on every iteration of osmo_select_main(). */
+		rc = epoll_unpollable_add(ofd->fd);
+		if (rc < 0)
+			return rc;
+		g_epoll.armed[ofd->fd] = EPOLL_ARMED_UNPOLLABLE | when;
+		return 0;
+	}
+	if (rc < 0 && op == EPOLL_CTL_DEL && (errno == ENOENT || errno == EBADF))
+		rc = 0;
+	if (rc < 0) {
+		rc = -errno;
+		LOGP(DLGLOBAL, LOGL_ERROR, "epoll_ctl(op=%d, fd=%d) failed: %s\n", op, ofd->fd, strerror(-rc));
+		return rc;
+	}
+
+	g_epoll.armed[ofd->fd] = when;
+	return 0;
+}
+
+static void epoll_unregister(int fd)
+{
+	uint8_t armed = g_epoll.armed[fd];
+
+	g_epoll.armed[fd] = 0;
+	if (armed & EPOLL_ARMED_UNPOLLABLE)
+		epoll_unpollable_del(fd);
+	else if (armed)
+		/* the fd may have been closed already, in which case the kernel removed it for us */
+		epoll_ctl(g_epoll.epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+#else
+static void epoll_armed_extend(unsigned int new_size)
+{
+}
+#endif /* !FORCE_IO_SELECT && HAVE_SYS_EPOLL_H */
+
 /*! Set up an osmo-fd. Will not register it.
  *  \param[inout] ofd Osmo FD to be set-up
  *  \param[in] fd OS-level file descriptor number
@@ -130,6 +306,11 @@ void osmo_fd_update_when(struct osmo_fd *ofd, unsigned int when_mask, unsigned i
 {
 	ofd->when &= when_mask;
 	ofd->when |= when;
+#if !defined(FORCE_IO_SELECT) && defined(HAVE_SYS_EPOLL_H)
+	if (g_select_backend == OSMO_SELECT_BACKEND_EPOLL &&
+	    ofd->fd >= 0 && ofd->fd <= maxfd && osmo_fd_lookup.table[ofd->fd] == ofd)
+		epoll_sync(ofd);
+#endif
 }
 
 /*! Check if a file descriptor is already registered
@@ -190,17 +371,31 @@ int osmo_fd_register(struct osmo_fd *fd)
 	}
 #endif
 #ifndef FORCE_IO_SELECT
-	if (g_poll.num_registered + 1 > g_poll.poll_size) {
-		struct pollfd *p;
-		unsigned int new_size = g_poll.poll_size ? g_poll.poll_size * 2 : 1024;
-		p = talloc_realloc(OTC_GLOBAL, g_poll.poll, struct pollfd, new_size);
-		if (!p)
-			return -ENOMEM;
-		memset(p + g_poll.poll_size, 0, new_size - g_poll.poll_size);
-		g_poll.poll = p;
-		g_poll.poll_size = new_size;
+#ifdef HAVE_SYS_EPOLL_H
+	if (g_select_backend == OSMO_SELECT_BACKEND_EPOLL) {
+		int rc;
+		osmo_fd_lookup.table[fd->fd] = fd;
+		rc = epoll_sync(fd);
+		if (rc < 0) {
+			osmo_fd_lookup.table[fd->fd] = NULL;
+			return rc;
+		}
+	} else
+#endif
+	{
+		/* the poll array is only used (and counted) by the poll backend */
+		if (g_poll.num_registered + 1 > g_poll.poll_size) {
+			struct pollfd *p;
+			unsigned int new_size = g_poll.poll_size ? g_poll.poll_size * 2 : 1024;
+			p = talloc_realloc(OTC_GLOBAL, g_poll.poll, struct pollfd, new_size);
+			if (!p)
+				return -ENOMEM;
+			memset(p + g_poll.poll_size, 0, new_size - g_poll.poll_size);
+			g_poll.poll = p;
+			g_poll.poll_size = new_size;
+		}
+		g_poll.num_registered++;
 	}
-	g_poll.num_registered++;
 #endif /* FORCE_IO_SELECT */
 
 	llist_add_tail(&fd->list, &osmo_fds);
@@ -224,7 +419,10 @@ void osmo_fd_unregister(struct osmo_fd *fd)
 	unregistered_count++;
 	llist_del(&fd->list);
 #ifndef FORCE_IO_SELECT
-	g_poll.num_registered--;
+#ifdef HAVE_SYS_EPOLL_H
+	if (g_select_backend != OSMO_SELECT_BACKEND_EPOLL)
+#endif
+		g_poll.num_registered--;
 #endif /* FORCE_IO_SELECT */
 
 	if (OSMO_UNLIKELY(fd->fd < 0  || fd->fd > maxfd)) {
@@ -242,6 +440,10 @@ void osmo_fd_unregister(struct osmo_fd *fd)
 	}
 
 	osmo_fd_lookup.table[fd->fd] = NULL;
+#if !defined(FORCE_IO_SELECT) && defined(HAVE_SYS_EPOLL_H)
+	if (g_select_backend == OSMO_SELECT_BACKEND_EPOLL)
+		epoll_unregister(fd->fd);
+#endif
 	/* If existent, free any statistical data */
 	osmo_stats_tcp_osmo_fd_unregister(fd);
 }
@@ -426,7 +628,7 @@ static int poll_disp_fds(unsigned int n_fd)
 	return work;
 }
 
-static int _osmo_select_main(int polling)
+static int _osmo_select_main_poll(int polling)
 {
 	unsigned int n_poll;
 	int rc;
@@ -456,10 +658,136 @@ static int _osmo_select_main(int polling)
 	/* call registered callback functions */
 	return poll_disp_fds(n_poll);
 }
+
+#ifdef HAVE_SYS_EPOLL_H
+/* dispatch one (ready) fd, as reported by epoll_wait() or from the list of unpollable fds */
+static int epoll_disp_fd(struct osmo_fd *ufd, unsigned int flags, int *shutdown_pending_writes)
+{
+	int fd = ufd->fd;
+
+	/* make sure we never report more than the user requested */
+	flags &= ufd->when;
+
+	if (_osmo_select_shutdown_requested > 0) {
+		if (ufd->when & OSMO_FD_WRITE)
+			(*shutdown_pending_writes)++;
+	}
+
+	if (!flags)
+		return 0;
+
+	/* make sure to clear any log context before processing the next incoming message
+	 * as part of some file descriptor callback.  This effectively prevents "context
+	 * leaking" from processing of one message into processing of the next message as part
+	 * of one iteration through the list of file descriptors here.  See OS#3813 */
+	log_reset_context();
+	ufd->cb(ufd, flags);
+
+	/* Some users still modify ofd->when directly from within their call-back instead of using
+	 * osmo_fd_update_when(). Catch those here, ufd might have been free'd meanwhile. */
+	ufd = osmo_fd_get_by_fd(fd);
+	if (ufd)
+		epoll_sync(ufd);
+
+	return 1;
+}
+
+/* iterate over first n_ev entries of g_epoll.events + the unpollable fds and dispatch */
+static int epoll_disp_fds(int n_ev)
+{
+	struct osmo_fd *ufd;
+	unsigned int j;
+	int i;
+	int work = 0;
+	int shutdown_pending_writes = 0;
+
+	for (i = 0; i < n_ev; i++) {
+		struct epoll_event *ev = &g_epoll.events[i];
+		unsigned int flags = 0;
+
+		ufd = osmo_fd_get_by_fd(ev->data.fd);
+		if (!ufd) {
+			/* FD might have been unregistered meanwhile */
+			continue;
+		}
+		/* use the same mapping as the Linux kernel does in fs/select.c */
+		if (ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			flags |= OSMO_FD_READ;
+		if (ev->events & (EPOLLOUT | EPOLLERR))
+			flags |= OSMO_FD_WRITE;
+		if (ev->events & EPOLLPRI)
+			flags |= OSMO_FD_EXCEPT;
+
+		work |= epoll_disp_fd(ufd, flags, &shutdown_pending_writes);
+	}
+
+	/* iterate backwards, as call-backs may unregister the current entry by moving the last one into its place */
+	for (j = g_epoll.num_unpollable; j > 0; j--) {
+		if (j > g_epoll.num_unpollable)
+			continue;
+		ufd = osmo_fd_get_by_fd(g_epoll.unpollable[j - 1]);
+		if (!ufd)
+			continue;
+		work |= epoll_disp_fd(ufd, OSMO_FD_READ | OSMO_FD_WRITE, &shutdown_pending_writes);
+	}
+
+	if (_osmo_select_shutdown_requested > 0 && !shutdown_pending_writes)
+		_osmo_select_shutdown_done = true;
+
+	return work;
+}
+
+static int _osmo_select_main_epoll(int polling)
+{
+	int rc;
+	int timeout = 0;
+
+	if (!polling) {
+		osmo_timers_prepare();
+		timeout = osmo_timers_nearest_ms();
+
+		if (_osmo_select_shutdown_requested && timeout == -1)
+			timeout = 0;
+		/* don't block while there are always-ready fds to be served */
+		if (epoll_unpollable_pending())
+			timeout = 0;
+	}
+
+	rc = epoll_wait(g_epoll.epfd, g_epoll.events, EPOLL_MAX_EVENTS, timeout);
+	if (rc < 0)
+		return 0;
+
+	/* fire timers */
+	if (!_osmo_select_shutdown_requested)
+		osmo_timers_update();
+
+	OSMO_ASSERT(osmo_ctx->select);
+
+	/* call registered callback functions */
+	return epoll_disp_fds(rc);
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+static int _osmo_select_main(int polling)
+{
+#if defined(HAVE_URING)
+	/* hand everything osmo_io queued up during the previous iteration to the kernel in one go */
+	osmo_iofd_uring_submit_pending();
+#endif
+#ifdef HAVE_SYS_EPOLL_H
+	if (g_select_backend == OSMO_SELECT_BACKEND_EPOLL)
+		return _osmo_select_main_epoll(polling);
+#endif
+	return _osmo_select_main_poll(polling);
+}
 #else /* FORCE_IO_SELECT */
 /* the old implementation based on select, used 2008-2020 */
 static int _osmo_select_main(int polling)
 {
+#if defined(HAVE_URING)
+	/* hand everything osmo_io queued up during the previous iteration to the kernel in one go */
+	osmo_iofd_uring_submit_pending();
+#endif
 	fd_set readset, writeset, exceptset;
 	int rc;
 	struct timeval no_time = {0, 0};
@@ -527,10 +855,27 @@ struct osmo_fd *osmo_fd_get_by_fd(int fd)
 	return osmo_fd_lookup.table[fd];
 }
 
+/*! Obtain the osmo_select_backend in use by the process
+ *  \returns The select back-end which was configured at startup time */
+enum osmo_select_backend osmo_select_get_backend(void)
+{
+	return g_select_backend;
+}
+
 /*! initialize the osmocom select abstraction for the current thread */
 void osmo_select_init(void)
 {
 	INIT_LLIST_HEAD(&osmo_fds);
+#if !defined(FORCE_IO_SELECT) && defined(HAVE_SYS_EPOLL_H)
+	if (g_select_backend == OSMO_SELECT_BACKEND_EPOLL && !g_epoll.initialized) {
+		g_epoll.epfd = epoll_create1(EPOLL_CLOEXEC);
+		OSMO_ASSERT(g_epoll.epfd >= 0);
+		g_epoll.events = talloc_array(OTC_GLOBAL, struct epoll_event, EPOLL_MAX_EVENTS);
+		OSMO_ASSERT(g_epoll.events);
+		g_epoll.initialized = true;
+		epoll_armed_extend(osmo_fd_lookup.size / sizeof(struct osmo_fd *));
+	}
+#endif
 	osmo_fd_lookup_table_extend(0);
 }
 
@@ -538,6 +883,22 @@ void osmo_select_init(void)
  * priority 102: must run after on_dso_load_ctx */
 static __attribute__((constructor(102))) void on_dso_load_select(void)
 {
+	char *backend = getenv(OSMO_SELECT_BACKEND_ENV);
+	if (backend == NULL)
+		backend = OSMO_SELECT_BACKEND_DEFAULT;
+
+	if (!strcmp("POLL", backend)) {
+		g_select_backend = OSMO_SELECT_BACKEND_POLL;
+#if !defined(FORCE_IO_SELECT) && defined(HAVE_SYS_EPOLL_H)
+	} else if (!strcmp("EPOLL", backend)) {
+		g_select_backend = OSMO_SELECT_BACKEND_EPOLL;
+#endif
+	} else {
+		fprintf(stderr, "Invalid osmo_select backend requested: \"%s\"\nCheck the environment variable %s\n",
+			backend, OSMO_SELECT_BACKEND_ENV);
+		exit(1);
+	}
+
 	osmo_select_init();
 }
 
@@ -162,6 +162,7 @@
 #include <osmocom/core/stat_item.h>
 
 #include <stat_item_internal.h>
+#include <stats_internal.h>
 
 /*! global list of stat_item groups */
 static LLIST_HEAD(osmo_stat_item_groups);
@@ -218,6 +219,7 @@ struct osmo_stat_item_group *osmo_stat_item_group_alloc(void *ctx,
 	}
 
 	llist_add(&group->list, &osmo_stat_item_groups);
+	osmo_stats_layout_gen++;
 	return group;
 }
 
@@ -228,6 +230,7 @@ void osmo_stat_item_group_free(struct osmo_stat_item_group *grp)
 		return;
 
 	llist_del(&grp->list);
+	osmo_stats_layout_gen++;
 	talloc_free(grp);
 }
 
@@ -249,6 +252,7 @@ struct osmo_stat_item *osmo_stat_item_group_get_item(struct osmo_stat_item_group
 void osmo_stat_item_group_set_name(struct osmo_stat_item_group *statg, const char *name)
 {
 	osmo_talloc_replace_string(statg, &statg->name, name);
+	osmo_stats_layout_gen++;
 }
 
 /*! Increase the stat_item to the given value.
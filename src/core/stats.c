@@ -421,6 +421,8 @@ int osmo_stats_reporter_set_name_prefix(struct osmo_stats_reporter *srep, const
 	talloc_free(srep->name_prefix);
 	srep->name_prefix = prefix && strlen(prefix) > 0 ?
 		talloc_strdup(srep, prefix) : NULL;
+	/* the names are rendered including the prefix */
+	TALLOC_FREE(srep->statsd_names);
 
 	return update_srep_config(srep);
 }
@@ -0,0 +1,14 @@
+/*! \file stats_internal.h
+ * internal definitions shared by the stats modules */
+#pragma once
+
+/*! \addtogroup stats
+ *  @{
+ */
+
+/*! Incremented whenever a rate_ctr_group or osmo_stat_item_group is allocated, freed or renamed,
+ *  i.e. whenever names derived from the set of groups (like the index of the shared memory stats
+ *  file) may be stale. */
+extern unsigned int osmo_stats_layout_gen;
+
+/*! @} */
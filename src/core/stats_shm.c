@@ -0,0 +1,461 @@
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*! \addtogroup stats
+ *  @{
+ *
+ * Export of all \ref rate_ctr and \ref osmo_stat_item values to a memory
+ * mapped file, e.g. below /dev/shm. Monitoring agents map the file and read
+ * the values at any rate they like, without a syscall and without any work
+ * in the osmo_select_main() loop of the process; the process itself only
+ * copies the values into the file once per interval.
+ *
+ * The file layout is described at struct osmo_stats_shm_hdr. Each value is
+ * named like in the statsd reporter, i.e. "<group prefix>.<group index or
+ * name>.<counter name>".
+ *
+ *  \file stats_shm.c */
+
+#include "config.h"
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <osmocom/core/stats_shm.h>
+
+#include <stats_internal.h>
+
+unsigned int osmo_stats_layout_gen;
+
+/* give up on a writer that never finishes an update (e.g. it died in the middle of one) */
+#define STATS_SHM_READ_RETRIES	100000
+
+/*! Copy a consistent snapshot of the values of a mapped shared memory stats file
+ *  \param[in] hdr Start of the mapped file
+ *  \param[out] values Array of hdr->num_entries values to fill
+ *  \param[out] time_us Time of the snapshot (microseconds since the epoch), may be NULL
+ *  \returns 0 on success; -ESTALE if the file was replaced and has to be mapped again;
+ *	     -EAGAIN if no consistent snapshot could be read */
+int osmo_stats_shm_read_values(const struct osmo_stats_shm_hdr *hdr, int64_t *values, int64_t *time_us)
+{
+	const int64_t *v = (const int64_t *)((const uint8_t *)hdr + hdr->values_off);
+	unsigned int i, retries;
+	uint32_t seq;
+
+	for (retries = 0; retries < STATS_SHM_READ_RETRIES; retries++) {
+		if (__atomic_load_n(&hdr->obsolete, __ATOMIC_ACQUIRE))
+			return -ESTALE;
+		seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		for (i = 0; i < hdr->num_entries; i++)
+			values[i] = __atomic_load_n(&v[i], __ATOMIC_RELAXED);
+		if (time_us)
+			*time_us = __atomic_load_n(&hdr->time_us, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+
+	return -EAGAIN;
+}
+
+#if !defined(EMBEDDED)
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+#include <stat_item_internal.h>
+
+static struct osmo_stats_shm_config s_stats_shm_config = {
+	.interval = STATS_SHM_DEFAULT_INTERVAL,
+};
+
+struct osmo_stats_shm_config *osmo_stats_shm_config = &s_stats_shm_config;
+
+/* a group as it was when the index was built, in the order of the group lists */
+struct stats_shm_group {
+	const void *grp;
+	unsigned int idx;
+};
+
+/* the file currently in place */
+static struct {
+	uint8_t *map;
+	size_t map_len;
+	struct osmo_stats_shm_hdr *hdr;
+	int64_t *values;
+	/* osmo_stats_layout_gen the index was built for */
+	unsigned int layout_gen;
+	/* rate_ctr groups first, then osmo_stat_item groups */
+	struct stats_shm_group *groups;
+	unsigned int num_groups;
+} stats_shm;
+
+static struct osmo_timer_list stats_shm_timer;
+
+/* state of a walk over all groups */
+struct stats_shm_walk {
+	unsigned int num_entries;
+	unsigned int num_groups;
+	size_t names_size;
+	/* set when filling an index, NULL when counting */
+	struct osmo_stats_shm_hdr *hdr;
+	struct stats_shm_group *groups;
+	/* set when writing values */
+	int64_t *values;
+	bool mismatch;
+};
+
+static int fmt_name(char *buf, size_t buf_len, const char *prefix, const char *grp_name,
+		    unsigned int grp_idx, const char *name)
+{
+	if (grp_name)
+		return snprintf(buf, buf_len, "%s.%s.%s", prefix, grp_name, name);
+	return snprintf(buf, buf_len, "%s.%u.%s", prefix, grp_idx, name);
+}
+
+/* count (w->hdr == NULL) or fill in (w->hdr != NULL) the index entry of one value */
+static void walk_entry(struct stats_shm_walk *w, enum osmo_stats_shm_kind kind, int class_id,
+		       const char *prefix, const char *grp_name, unsigned int grp_idx, const char *name)
+{
+	struct osmo_stats_shm_entry *e;
+	char *names;
+	int len;
+
+	if (!w->hdr) {
+		len = fmt_name(NULL, 0, prefix, grp_name, grp_idx, name);
+		w->names_size += len + 1;
+		w->num_entries++;
+		return;
+	}
+
+	e = (struct osmo_stats_shm_entry *)((uint8_t *)w->hdr + w->hdr->entries_off) + w->num_entries++;
+	names = (char *)w->hdr + w->hdr->names_off;
+	len = fmt_name(names + w->names_size, w->hdr->names_size - w->names_size, prefix, grp_name, grp_idx, name);
+	e->name_off = w->names_size;
+	e->name_len = len;
+	e->kind = kind;
+	e->class_id = class_id;
+	w->names_size += len + 1;
+}
+
+static void walk_group(struct stats_shm_walk *w, const void *grp, unsigned int idx)
+{
+	if (w->groups)
+		w->groups[w->num_groups] = (struct stats_shm_group){ .grp = grp, .idx = idx };
+	w->num_groups++;
+}
+
+static int index_ctrg(struct rate_ctr_group *ctrg, void *data)
+{
+	struct stats_shm_walk *w = data;
+	unsigned int i;
+
+	walk_group(w, ctrg, ctrg->idx);
+	for (i = 0; i < ctrg->desc->num_ctr; i++)
+		walk_entry(w, OSMO_STATS_SHM_RATE_CTR, ctrg->desc->class_id, ctrg->desc->group_name_prefix,
+			   ctrg->name, ctrg->idx, ctrg->desc->ctr_desc[i].name);
+	return 0;
+}
+
+static int index_statg(struct osmo_stat_item_group *statg, void *data)
+{
+	struct stats_shm_walk *w = data;
+	unsigned int i;
+
+	walk_group(w, statg, statg->idx);
+	for (i = 0; i < statg->desc->num_items; i++)
+		walk_entry(w, OSMO_STATS_SHM_STAT_ITEM, statg->desc->class_id, statg->desc->group_name_prefix,
+			   statg->name, statg->idx, statg->desc->item_desc[i].name);
+	return 0;
+}
+
+/* compare a group to the index, in the same order as the index was built */
+static bool check_group(struct stats_shm_walk *w, const void *grp, unsigned int idx)
+{
+	const struct stats_shm_group *g;
+
+	if (w->num_groups >= stats_shm.num_groups) {
+		w->mismatch = true;
+		return false;
+	}
+	g = &stats_shm.groups[w->num_groups++];
+	if (g->grp != grp || g->idx != idx) {
+		/* the index of a group was changed by rate_ctr_group_upd_idx() or
+		 * osmo_stat_item_group_udp_idx(), which osmo_stats_layout_gen misses */
+		w->mismatch = true;
+		return false;
+	}
+	return true;
+}
+
+static int check_ctrg(struct rate_ctr_group *ctrg, void *data)
+{
+	return check_group(data, ctrg, ctrg->idx) ? 0 : -1;
+}
+
+static int check_statg(struct osmo_stat_item_group *statg, void *data)
+{
+	return check_group(data, statg, statg->idx) ? 0 : -1;
+}
+
+static int values_ctrg(struct rate_ctr_group *ctrg, void *data)
+{
+	struct stats_shm_walk *w = data;
+	unsigned int i;
+
+	rate_ctr_group_sync(ctrg);
+	for (i = 0; i < ctrg->desc->num_ctr; i++)
+		__atomic_store_n(&w->values[w->num_entries++], ctrg->ctr[i].current, __ATOMIC_RELAXED);
+	return 0;
+}
+
+static int values_statg(struct osmo_stat_item_group *statg, void *data)
+{
+	struct stats_shm_walk *w = data;
+	unsigned int i;
+
+	for (i = 0; i < statg->desc->num_items; i++)
+		__atomic_store_n(&w->values[w->num_entries++], statg->items[i]->value.last, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/* copy all values into the file, under the sequence lock */
+static void write_values(struct osmo_stats_shm_hdr *hdr, int64_t *values)
+{
+	struct stats_shm_walk w = { .values = values };
+	uint32_t seq = hdr->seq;
+	struct timeval tv;
+
+	__atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	rate_ctr_for_each_group(values_ctrg, &w);
+	osmo_stat_item_for_each_group(values_statg, &w);
+	osmo_gettimeofday(&tv, NULL);
+	__atomic_store_n(&hdr->time_us, (int64_t)tv.tv_sec * 1000000 + tv.tv_usec, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void unmap(uint8_t *map, size_t map_len)
+{
+	struct osmo_stats_shm_hdr *hdr = (struct osmo_stats_shm_hdr *)map;
+
+	__atomic_store_n(&hdr->obsolete, 1, __ATOMIC_RELEASE);
+	munmap(map, map_len);
+}
+
+/* write a file with a new index and the current values, and move it in place of the current one */
+static int build(void)
+{
+	const char *path = osmo_stats_shm_config->path;
+	struct stats_shm_walk w = {};
+	struct osmo_stats_shm_hdr *hdr;
+	struct stats_shm_group *groups;
+	uint64_t entries_off, names_off, values_off, file_size;
+	char *tmp_path;
+	uint8_t *map;
+	int fd, rc;
+
+	rate_ctr_for_each_group(index_ctrg, &w);
+	osmo_stat_item_for_each_group(index_statg, &w);
+
+	entries_off = (sizeof(*hdr) + 7) & ~7;
+	names_off = entries_off + w.num_entries * sizeof(struct osmo_stats_shm_entry);
+	values_off = (names_off + w.names_size + 63) & ~63;
+	file_size = values_off + w.num_entries * sizeof(int64_t);
+
+	groups = talloc_array(OTC_GLOBAL, struct stats_shm_group, w.num_groups ? : 1);
+	tmp_path = talloc_asprintf(OTC_GLOBAL, "%s.tmp", path);
+	if (!groups || !tmp_path) {
+		rc = -ENOMEM;
+		goto free;
+	}
+
+	fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		rc = -errno;
+		goto free;
+	}
+	if (ftruncate(fd, file_size) < 0) {
+		rc = -errno;
+		close(fd);
+		goto unlink;
+	}
+	map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		rc = -errno;
+		close(fd);
+		goto unlink;
+	}
+	close(fd);
+
+	hdr = (struct osmo_stats_shm_hdr *)map;
+	memcpy(hdr->magic, OSMO_STATS_SHM_MAGIC, sizeof(hdr->magic));
+	hdr->version = OSMO_STATS_SHM_VERSION;
+	hdr->byte_order = OSMO_STATS_SHM_BYTE_ORDER;
+	hdr->pid = getpid();
+	hdr->num_entries = w.num_entries;
+	hdr->entries_off = entries_off;
+	hdr->names_off = names_off;
+	hdr->names_size = w.names_size;
+	hdr->values_off = values_off;
+	hdr->file_size = file_size;
+
+	w = (struct stats_shm_walk){ .hdr = hdr, .groups = groups };
+	rate_ctr_for_each_group(index_ctrg, &w);
+	osmo_stat_item_for_each_group(index_statg, &w);
+	write_values(hdr, (int64_t *)(map + values_off));
+
+	if (rename(tmp_path, path) < 0) {
+		rc = -errno;
+		munmap(map, file_size);
+		goto unlink;
+	}
+
+	if (stats_shm.map)
+		unmap(stats_shm.map, stats_shm.map_len);
+	talloc_free(stats_shm.groups);
+	stats_shm.map = map;
+	stats_shm.map_len = file_size;
+	stats_shm.hdr = hdr;
+	stats_shm.values = (int64_t *)(map + values_off);
+	stats_shm.layout_gen = osmo_stats_layout_gen;
+	stats_shm.groups = groups;
+	stats_shm.num_groups = w.num_groups;
+
+	talloc_free(tmp_path);
+	return 0;
+
+unlink:
+	unlink(tmp_path);
+free:
+	LOGP(DLSTATS, LOGL_ERROR, "Failed to export stats to '%s': %s\n", path, strerror(-rc));
+	talloc_free(tmp_path);
+	talloc_free(groups);
+	return rc;
+}
+
+/*! Copy all counter and stat item values into the shared memory stats file
+ *
+ *  This is called every osmo_stats_shm_config->interval milliseconds, call it
+ *  directly to publish values right away. Groups allocated, freed or renamed
+ *  since the last update make this write a new file to the path.
+ *  \returns 0 on success; -ENODEV if no file is open; negative errno on error */
+int osmo_stats_shm_update(void)
+{
+	struct stats_shm_walk w = {};
+
+	if (!osmo_stats_shm_config->path)
+		return -ENODEV;
+
+	if (!stats_shm.map || stats_shm.layout_gen != osmo_stats_layout_gen)
+		return build();
+
+	rate_ctr_for_each_group(check_ctrg, &w);
+	osmo_stat_item_for_each_group(check_statg, &w);
+	if (w.mismatch || w.num_groups != stats_shm.num_groups)
+		return build();
+
+	write_values(stats_shm.hdr, stats_shm.values);
+	return 0;
+}
+
+static void stats_shm_timer_cb(void *data)
+{
+	osmo_stats_shm_update();
+	if (osmo_stats_shm_config->path && osmo_stats_shm_config->interval)
+		osmo_timer_schedule(&stats_shm_timer, osmo_stats_shm_config->interval / 1000,
+				    (osmo_stats_shm_config->interval % 1000) * 1000);
+}
+
+/*! Start exporting all counter and stat item values to a shared memory file
+ *
+ *  The file is replaced if it exists and removed by osmo_stats_shm_close().
+ *  Values are updated every osmo_stats_shm_config->interval milliseconds.
+ *  \param[in] path File to export to, typically below /dev/shm
+ *  \returns 0 on success; negative errno on error */
+int osmo_stats_shm_open(const char *path)
+{
+	int rc;
+
+	osmo_stats_shm_close();
+	osmo_stats_shm_config->path = talloc_strdup(OTC_GLOBAL, path);
+	if (!osmo_stats_shm_config->path)
+		return -ENOMEM;
+
+	rc = build();
+	if (rc < 0) {
+		TALLOC_FREE(osmo_stats_shm_config->path);
+		return rc;
+	}
+
+	osmo_stats_shm_set_interval(osmo_stats_shm_config->interval);
+	return 0;
+}
+
+/*! Stop exporting values and remove the shared memory stats file */
+void osmo_stats_shm_close(void)
+{
+	osmo_timer_del(&stats_shm_timer);
+
+	if (stats_shm.map) {
+		unlink(osmo_stats_shm_config->path);
+		unmap(stats_shm.map, stats_shm.map_len);
+	}
+	TALLOC_FREE(stats_shm.groups);
+	memset(&stats_shm, 0, sizeof(stats_shm));
+	TALLOC_FREE(osmo_stats_shm_config->path);
+}
+
+/*! Set the update interval of the shared memory stats file
+ *  \param[in] interval Interval in milliseconds, 0 to only update by osmo_stats_shm_update()
+ *  \returns 0 */
+int osmo_stats_shm_set_interval(unsigned int interval)
+{
+	osmo_stats_shm_config->interval = interval;
+	if (osmo_stats_shm_config->path && interval)
+		osmo_timer_schedule(&stats_shm_timer, interval / 1000, (interval % 1000) * 1000);
+	else
+		osmo_timer_del(&stats_shm_timer);
+	return 0;
+}
+
+static __attribute__((constructor))
+void on_dso_load_stats_shm(void)
+{
+	osmo_timer_setup(&stats_shm_timer, stats_shm_timer_cb, NULL);
+}
+
+#endif /* !EMBEDDED */
+
+/*! @} */
@@ -26,6 +26,7 @@
 
 #include <osmocom/core/stats.h>
 
+#include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
@@ -37,6 +38,9 @@
 #include <osmocom/core/stat_item.h>
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/stats.h>
+#include <osmocom/core/talloc.h>
+
+#include <stats_internal.h>
 
 static int osmo_stats_reporter_statsd_send_counter(struct osmo_stats_reporter *srep,
 	const struct rate_ctr_group *ctrg,
@@ -67,87 +71,206 @@ struct osmo_stats_reporter *osmo_stats_reporter_create_statsd(const char *name)
 	return srep;
 }
 
-/*! Replace all illegal ':' in the stats name, but not when used as value seperator.
- *  ':' is used as seperator between the name and the value in the statsd protocol.
- *  \param[inout] buf is a null terminated string containing name, value, unit. */
-static void osmo_stats_reporter_sanitize_name(char *buf)
+/* Metric names of the values of one group, rendered once as "<reporter prefix>.<group prefix>.<group index
+ * or name>.<value name>", with every ':' replaced by '.': statsd uses ':' to separate name and value. */
+struct statsd_group_names {
+	const void *grp;
+	unsigned int idx;
+	unsigned int num;
+	/* name i is buf[off[i]] to buf[off[i + 1]] */
+	uint32_t *off;
+	char *buf;
+};
+
+/* All group names of one reporter, valid as long as osmo_stats_layout_gen does not change */
+struct osmo_stats_statsd_names {
+	unsigned int layout_gen;
+	/* open addressing hash table by group pointer */
+	struct statsd_group_names **tab;
+	unsigned int mask;
+	unsigned int used;
+	/* the group of the previous lookup, values of a group are reported one after the other */
+	struct statsd_group_names *last;
+};
+
+#define STATSD_NAMES_MIN_TAB	64
+
+typedef const char *(*statsd_value_name_t)(const void *grp, unsigned int i);
+
+static const char *ctr_name(const void *grp, unsigned int i)
 {
-	/* e.g. msc.loc_update_type:normal:1|c -> msc.loc_update_type.normal:1|c
-	 * last is the seperator between name and value */
-	char *last = strrchr(buf, ':');
-	char *tmp = strchr(buf, ':');
+	return ((const struct rate_ctr_group *)grp)->desc->ctr_desc[i].name;
+}
 
-	if (!last)
-		return;
+static const char *item_name(const void *grp, unsigned int i)
+{
+	return ((const struct osmo_stat_item_group *)grp)->desc->item_desc[i].name;
+}
+
+static unsigned int hash_grp(const void *grp, unsigned int mask)
+{
+	return (((uintptr_t)grp >> 4) * 0x9e3779b1U) & mask;
+}
 
-	while (tmp < last) {
-		*tmp = '.';
-		tmp = strchr(buf, ':');
+static struct statsd_group_names **tab_slot(struct osmo_stats_statsd_names *names, const void *grp)
+{
+	unsigned int i = hash_grp(grp, names->mask);
+
+	while (names->tab[i] && names->tab[i]->grp != grp)
+		i = (i + 1) & names->mask;
+	return &names->tab[i];
+}
+
+static int tab_grow(struct osmo_stats_statsd_names *names)
+{
+	struct statsd_group_names **old_tab = names->tab;
+	unsigned int i, old_size = names->mask + 1;
+
+	names->tab = talloc_zero_array(names, struct statsd_group_names *, old_size * 2);
+	if (!names->tab) {
+		names->tab = old_tab;
+		return -ENOMEM;
+	}
+	names->mask = old_size * 2 - 1;
+	for (i = 0; i < old_size; i++) {
+		if (old_tab[i])
+			*tab_slot(names, old_tab[i]->grp) = old_tab[i];
 	}
+	talloc_free(old_tab);
+	return 0;
 }
 
-static int osmo_stats_reporter_statsd_send(struct osmo_stats_reporter *srep,
-	const char *name1, const char *index1, const char *name2, int64_t value,
-	const char *unit)
+/* render the names of all values of a group */
+static int render_names(struct osmo_stats_reporter *srep, struct statsd_group_names *gn,
+			const char *grp_prefix, const char *grp_name, unsigned int num, statsd_value_name_t value_name)
 {
-	char *buf;
-	int buf_size;
-	int nchars, rc = 0;
-	char *fmt = NULL;
-	char *prefix = srep->name_prefix;
-	int old_len = msgb_length(srep->buffer);
-
-	if (prefix) {
-		if (name1)
-			fmt = "%1$s.%2$s.%6$s.%3$s:%4$" PRId64 "|%5$s";
-		else
-			fmt = "%1$s.%2$0.0s%3$s:%4$" PRId64 "|%5$s";
-	} else {
-		prefix = "";
-		if (name1)
-			fmt = "%1$s%2$s.%6$s.%3$s:%4$" PRId64 "|%5$s";
-		else
-			fmt = "%1$s%2$0.0s%3$s:%4$" PRId64 "|%5$s";
+	char idx_buf[16];
+	size_t base_len, len = 0;
+	unsigned int i;
+	char *p;
+
+	if (!grp_name) {
+		snprintf(idx_buf, sizeof(idx_buf), "%u", gn->idx);
+		grp_name = idx_buf;
 	}
+	base_len = (srep->name_prefix ? strlen(srep->name_prefix) + 1 : 0) + strlen(grp_prefix) + 1
+		   + strlen(grp_name) + 1;
+	for (i = 0; i < num; i++)
+		len += base_len + strlen(value_name(gn->grp, i));
 
-	if (srep->agg_enabled) {
-		if (msgb_length(srep->buffer) > 0 &&
-			msgb_tailroom(srep->buffer) > 0)
-		{
-			msgb_put_u8(srep->buffer, '\n');
+	TALLOC_FREE(gn->off);
+	TALLOC_FREE(gn->buf);
+	gn->off = talloc_array(gn, uint32_t, num + 1);
+	gn->buf = talloc_size(gn, len + 1);
+	if (!gn->off || !gn->buf)
+		return -ENOMEM;
+	gn->num = num;
+
+	p = gn->buf;
+	for (i = 0; i < num; i++) {
+		char *name = p;
+
+		gn->off[i] = p - gn->buf;
+		if (srep->name_prefix)
+			p += sprintf(p, "%s.", srep->name_prefix);
+		p += sprintf(p, "%s.%s.%s", grp_prefix, grp_name, value_name(gn->grp, i));
+		for (; name < p; name++) {
+			if (*name == ':')
+				*name = '.';
 		}
 	}
+	gn->off[num] = p - gn->buf;
+	return 0;
+}
 
-	buf = (char *)msgb_put(srep->buffer, 0);
-	buf_size = msgb_tailroom(srep->buffer);
+/* find or render the names of the values of a group, NULL on error */
+static const struct statsd_group_names *group_names(struct osmo_stats_reporter *srep, const void *grp,
+						    unsigned int idx, const char *grp_prefix, const char *grp_name,
+						    unsigned int num, statsd_value_name_t value_name)
+{
+	struct osmo_stats_statsd_names *names = srep->statsd_names;
+	struct statsd_group_names **slot, *gn;
 
-	nchars = snprintf(buf, buf_size, fmt,
-		prefix, name1, name2,
-		value, unit, index1);
+	if (names && names->layout_gen != osmo_stats_layout_gen)
+		TALLOC_FREE(srep->statsd_names);
+	if (!srep->statsd_names) {
+		names = srep->statsd_names = talloc_zero(srep, struct osmo_stats_statsd_names);
+		if (!names)
+			return NULL;
+		names->layout_gen = osmo_stats_layout_gen;
+		names->tab = talloc_zero_array(names, struct statsd_group_names *, STATSD_NAMES_MIN_TAB);
+		if (!names->tab) {
+			TALLOC_FREE(srep->statsd_names);
+			return NULL;
+		}
+		names->mask = STATSD_NAMES_MIN_TAB - 1;
+	}
 
-	if (nchars >= buf_size) {
-		/* Truncated */
-		/* Restore original buffer (without trailing LF) */
-		msgb_trim(srep->buffer, old_len);
-		/* Send it */
-		rc = osmo_stats_reporter_send_buffer(srep);
+	gn = names->last;
+	if (!gn || gn->grp != grp) {
+		slot = tab_slot(names, grp);
+		gn = *slot;
+		if (!gn) {
+			if ((names->used + 1) * 2 > names->mask + 1) {
+				if (tab_grow(names) < 0)
+					return NULL;
+				slot = tab_slot(names, grp);
+			}
+			gn = talloc_zero(names, struct statsd_group_names);
+			if (!gn)
+				return NULL;
+			gn->grp = grp;
+			*slot = gn;
+			names->used++;
+		}
+		names->last = gn;
+	}
+
+	/* rate_ctr_group_upd_idx() and osmo_stat_item_group_udp_idx() are not seen by osmo_stats_layout_gen */
+	if (!gn->buf || gn->idx != idx || gn->num != num) {
+		gn->idx = idx;
+		if (render_names(srep, gn, grp_prefix, grp_name, num, value_name) < 0) {
+			TALLOC_FREE(gn->buf);
+			return NULL;
+		}
+	}
 
-		/* Try again */
-		buf = (char *)msgb_put(srep->buffer, 0);
-		buf_size = msgb_tailroom(srep->buffer);
+	return gn;
+}
 
-		nchars = snprintf(buf, buf_size, fmt,
-			prefix, name1, name2,
-			value, unit, index1);
+/* append "<name>:<value>|<unit>" to the buffer, sending the buffer first if the line does not fit */
+static int osmo_stats_reporter_statsd_send(struct osmo_stats_reporter *srep,
+	const char *name, size_t name_len, int64_t value, char unit)
+{
+	char val[24], digits[20];
+	uint64_t v = value < 0 ? -(uint64_t)value : value;
+	int val_len = 0, num_digits = 0, rc = 0;
+	int sep;
 
-		if (nchars >= buf_size)
+	do {
+		digits[num_digits++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	val[val_len++] = ':';
+	if (value < 0)
+		val[val_len++] = '-';
+	while (num_digits)
+		val[val_len++] = digits[--num_digits];
+	val[val_len++] = '|';
+	val[val_len++] = unit;
+
+	sep = srep->agg_enabled && msgb_length(srep->buffer) > 0;
+	if (sep + name_len + val_len > (size_t)msgb_tailroom(srep->buffer)) {
+		rc = osmo_stats_reporter_send_buffer(srep);
+		sep = 0;
+		if (name_len + val_len > (size_t)msgb_tailroom(srep->buffer))
 			return -EMSGSIZE;
 	}
 
-	if (nchars > 0) {
-		osmo_stats_reporter_sanitize_name(buf);
-		msgb_trim(srep->buffer, msgb_length(srep->buffer) + nchars);
-	}
+	if (sep)
+		msgb_put_u8(srep->buffer, '\n');
+	memcpy(msgb_put(srep->buffer, name_len), name, name_len);
+	memcpy(msgb_put(srep->buffer, val_len), val, val_len);
 
 	if (!srep->agg_enabled)
 		rc = osmo_stats_reporter_send_buffer(srep);
@@ -155,47 +278,89 @@ static int osmo_stats_reporter_statsd_send(struct osmo_stats_reporter *srep,
 	return rc;
 }
 
+/* Find the index of desc in the descriptor array at base. desc may point anywhere, e.g. to a descriptor that is
+ * not part of the array, so compare plain addresses: subtracting pointers into different arrays is undefined. */
+static bool desc_index(const void *desc, const void *base, size_t size, unsigned int num, unsigned int *i)
+{
+	uintptr_t d = (uintptr_t)desc, b = (uintptr_t)base;
+
+	if (d < b || d - b >= (uintptr_t)num * size || (d - b) % size)
+		return false;
+	*i = (d - b) / size;
+	return true;
+}
+
+/* render a name that is not cached, for osmo_counter and as fallback */
+static int osmo_stats_reporter_statsd_send_uncached(struct osmo_stats_reporter *srep,
+	const char *name1, const char *index1, const char *name2, int64_t value, char unit)
+{
+	char buf[256];
+	struct osmo_strbuf sb = { .buf = buf, .len = sizeof(buf) };
+	char *c;
+
+	if (srep->name_prefix)
+		OSMO_STRBUF_PRINTF(sb, "%s.", srep->name_prefix);
+	if (name1)
+		OSMO_STRBUF_PRINTF(sb, "%s.%s.", name1, index1);
+	OSMO_STRBUF_PRINTF(sb, "%s", name2);
+	if (sb.chars_needed >= sizeof(buf))
+		return -EMSGSIZE;
+
+	for (c = buf; *c; c++) {
+		if (*c == ':')
+			*c = '.';
+	}
+
+	return osmo_stats_reporter_statsd_send(srep, buf, sb.chars_needed, value, unit);
+}
+
 static int osmo_stats_reporter_statsd_send_counter(struct osmo_stats_reporter *srep,
 	const struct rate_ctr_group *ctrg,
 	const struct rate_ctr_desc *desc,
 	int64_t value, int64_t delta)
 {
+	const struct statsd_group_names *gn;
 	char buf_idx[64];
-	const char *idx_name = buf_idx;
-	const char *prefix;
-
-	if (ctrg) {
-		prefix = ctrg->desc->group_name_prefix;
-		if (ctrg->name)
-			idx_name = ctrg->name;
-		else
-			snprintf(buf_idx, sizeof(buf_idx), "%u", ctrg->idx);
-	} else {
-		prefix = NULL;
-		buf_idx[0] = '0';
-		buf_idx[1] = '\n';
+	unsigned int i;
+
+	if (!ctrg)
+		return osmo_stats_reporter_statsd_send_uncached(srep, NULL, NULL, desc->name, delta, 'c');
+
+	if (desc_index(desc, ctrg->desc->ctr_desc, sizeof(*desc), ctrg->desc->num_ctr, &i)) {
+		gn = group_names(srep, ctrg, ctrg->idx, ctrg->desc->group_name_prefix, ctrg->name,
+				 ctrg->desc->num_ctr, ctr_name);
+		if (gn)
+			return osmo_stats_reporter_statsd_send(srep, gn->buf + gn->off[i], gn->off[i + 1] - gn->off[i],
+							       delta, 'c');
 	}
-	return osmo_stats_reporter_statsd_send(srep, prefix, idx_name, desc->name, delta, "c");
+
+	snprintf(buf_idx, sizeof(buf_idx), "%u", ctrg->idx);
+	return osmo_stats_reporter_statsd_send_uncached(srep, ctrg->desc->group_name_prefix,
+							ctrg->name ? : buf_idx, desc->name, delta, 'c');
 }
 
 static int osmo_stats_reporter_statsd_send_item(struct osmo_stats_reporter *srep,
 	const struct osmo_stat_item_group *statg,
 	const struct osmo_stat_item_desc *desc, int64_t value)
 {
+	const struct statsd_group_names *gn;
 	char buf_idx[64];
-	char *idx_name;
-	if (statg->name)
-		idx_name = statg->name;
-	else {
-		snprintf(buf_idx, sizeof(buf_idx), "%u", statg->idx);
-		idx_name = buf_idx;
-	}
+	unsigned int i;
 
 	if (value < 0)
 		value = 0;
 
-	return osmo_stats_reporter_statsd_send(srep, statg->desc->group_name_prefix,
-					       idx_name, desc->name, value, "g");
+	if (desc_index(desc, statg->desc->item_desc, sizeof(*desc), statg->desc->num_items, &i)) {
+		gn = group_names(srep, statg, statg->idx, statg->desc->group_name_prefix, statg->name,
+				 statg->desc->num_items, item_name);
+		if (gn)
+			return osmo_stats_reporter_statsd_send(srep, gn->buf + gn->off[i], gn->off[i + 1] - gn->off[i],
+							       value, 'g');
+	}
+
+	snprintf(buf_idx, sizeof(buf_idx), "%u", statg->idx);
+	return osmo_stats_reporter_statsd_send_uncached(srep, statg->desc->group_name_prefix,
+							statg->name ? : buf_idx, desc->name, value, 'g');
 }
 #endif /* !EMBEDDED */
 
@@ -30,19 +30,323 @@
 
 #include <assert.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include <limits.h>
 #include <osmocom/core/timer.h>
 #include <osmocom/core/timer_compat.h>
 #include <osmocom/core/linuxlist.h>
 
+#include "config.h"
+
+/*! This environment variable can be set to manually set the backend used for osmo_timer_list */
+#define OSMO_TIMER_BACKEND_ENV "LIBOSMO_TIMER_BACKEND"
+#ifdef OSMO_TIMER_WHEEL_DEFAULT
+#define OSMO_TIMER_BACKEND_DEFAULT "WHEEL"
+#else
+#define OSMO_TIMER_BACKEND_DEFAULT "RBTREE"
+#endif
+
+const struct value_string osmo_timer_backend_names[] = {
+	{ OSMO_TIMER_BACKEND_RBTREE, "rbtree" },
+	{ OSMO_TIMER_BACKEND_WHEEL, "wheel" },
+	{ 0, NULL }
+};
+
+/* the back-end is chosen once per process; each thread has its own timers */
+static enum osmo_timer_backend g_timer_backend;
+
 /* These store the amount of time that we wait until next timer expires. */
 static __thread struct timeval nearest;
 static __thread struct timeval *nearest_p;
 
 static __thread struct rb_root timer_root = RB_ROOT;
 
+/* Hashed hierarchical timing wheel with a granularity of 1ms (one tick).  Level 0 has one slot per tick for
+ * the next 256 ticks, each of the upper levels covers 64 slots of the full range of the level below.  Timers
+ * in an upper level are cascaded (re-inserted) into the lower levels once the wheel reaches the start of
+ * their slot.  In total, the wheel spans 2^32 ms (~49 days); timers further in the future are parked in the
+ * last slot and cascaded again later. */
+#define TW_L0_BITS	8
+#define TW_LN_BITS	6
+#define TW_L0_SIZE	(1 << TW_L0_BITS)
+#define TW_LN_SIZE	(1 << TW_LN_BITS)
+#define TW_LEVELS	4
+#define TW_MAX_DELTA	((1ULL << (TW_L0_BITS + TW_LEVELS * TW_LN_BITS)) - 1)
+#define TW_LN_SHIFT(lvl) (TW_L0_BITS + (lvl) * TW_LN_BITS)
+
+struct timer_wheel {
+	/* whether the slots have been initialized for this thread */
+	bool initialized;
+	/* current tick; all timers of earlier ticks have been moved to the eviction list */
+	uint64_t now;
+	/* whether the upper levels have been cascaded for the current tick */
+	bool cascaded;
+	/* number of active timers in the wheel */
+	unsigned int count;
+	/* bitmaps of possibly non-empty slots, bits are cleared lazily */
+	uint64_t l0_map[TW_L0_SIZE / 64];
+	uint64_t ln_map[TW_LEVELS];
+	struct llist_head l0[TW_L0_SIZE];
+	struct llist_head ln[TW_LEVELS][TW_LN_SIZE];
+};
+static __thread struct timer_wheel wheel;
+
+static uint64_t timeval_to_tick(const struct timeval *tv)
+{
+	if (tv->tv_sec < 0)
+		return 0;
+	/* avoid overflows for 'infinite' timeouts, the wheel parks those anyway */
+	if (tv->tv_sec >= (1LL << 40))
+		return (1ULL << 40) * 1000;
+	return (uint64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000;
+}
+
+static void tick_to_timeval(uint64_t tick, struct timeval *tv)
+{
+	tv->tv_sec = tick / 1000;
+	tv->tv_usec = (tick % 1000) * 1000;
+}
+
+static void wheel_insert(struct osmo_timer_list *timer)
+{
+	uint64_t tick = timeval_to_tick(&timer->timeout);
+	uint64_t delta;
+	unsigned int lvl, idx;
+
+	/* expired timers go into the current slot, from which they are evicted on the next update */
+	if (tick < wheel.now)
+		tick = wheel.now;
+	delta = tick - wheel.now;
+
+	if (delta < TW_L0_SIZE) {
+		idx = tick & (TW_L0_SIZE - 1);
+		wheel.l0_map[idx / 64] |= 1ULL << (idx % 64);
+		llist_add_tail(&timer->list, &wheel.l0[idx]);
+		return;
+	}
+
+	if (delta > TW_MAX_DELTA) {
+		delta = TW_MAX_DELTA;
+		tick = wheel.now + delta;
+	}
+	for (lvl = 0; lvl < TW_LEVELS - 1; lvl++) {
+		if (delta < (1ULL << TW_LN_SHIFT(lvl + 1)))
+			break;
+	}
+	idx = (tick >> TW_LN_SHIFT(lvl)) & (TW_LN_SIZE - 1);
+	wheel.ln_map[lvl] |= 1ULL << idx;
+	llist_add_tail(&timer->list, &wheel.ln[lvl][idx]);
+}
+
+static void wheel_init(uint64_t now)
+{
+	unsigned int lvl, i;
+
+	for (i = 0; i < TW_L0_SIZE; i++)
+		INIT_LLIST_HEAD(&wheel.l0[i]);
+	for (lvl = 0; lvl < TW_LEVELS; lvl++) {
+		for (i = 0; i < TW_LN_SIZE; i++)
+			INIT_LLIST_HEAD(&wheel.ln[lvl][i]);
+	}
+	wheel.now = now;
+	wheel.initialized = true;
+}
+
+static void wheel_init_now(void)
+{
+	struct timeval current;
+
+	osmo_gettimeofday(&current, NULL);
+	wheel_init(timeval_to_tick(&current));
+}
+
+/* re-insert all timers relative to a new current tick, e.g. after the clock went backwards */
+static void wheel_rebase(uint64_t now)
+{
+	struct osmo_timer_list *this, *tmp;
+	struct llist_head all;
+	unsigned int lvl, i;
+
+	INIT_LLIST_HEAD(&all);
+	for (i = 0; i < TW_L0_SIZE; i++)
+		llist_splice_init(&wheel.l0[i], all.prev);
+	for (lvl = 0; lvl < TW_LEVELS; lvl++) {
+		for (i = 0; i < TW_LN_SIZE; i++)
+			llist_splice_init(&wheel.ln[lvl][i], all.prev);
+	}
+	memset(wheel.l0_map, 0, sizeof(wheel.l0_map));
+	memset(wheel.ln_map, 0, sizeof(wheel.ln_map));
+
+	wheel.now = now;
+	wheel.cascaded = false;
+	llist_for_each_entry_safe(this, tmp, &all, list) {
+		llist_del(&this->list);
+		wheel_insert(this);
+	}
+}
+
+/* move the timers of those upper level slots starting at the current tick down to the lower levels */
+static void wheel_cascade(void)
+{
+	struct osmo_timer_list *this, *tmp;
+	struct llist_head cascade;
+	unsigned int lvl, idx;
+
+	for (lvl = 0; lvl < TW_LEVELS; lvl++) {
+		if (wheel.now & ((1ULL << TW_LN_SHIFT(lvl)) - 1))
+			break;
+		idx = (wheel.now >> TW_LN_SHIFT(lvl)) & (TW_LN_SIZE - 1);
+		wheel.ln_map[lvl] &= ~(1ULL << idx);
+		INIT_LLIST_HEAD(&cascade);
+		llist_splice_init(&wheel.ln[lvl][idx], &cascade);
+		llist_for_each_entry_safe(this, tmp, &cascade, list) {
+			llist_del(&this->list);
+			wheel_insert(this);
+		}
+	}
+	wheel.cascaded = true;
+}
+
+/* find the next possibly non-empty level 0 slot at or after idx (without wrapping); TW_L0_SIZE if none */
+static unsigned int wheel_l0_next(unsigned int idx)
+{
+	while (idx < TW_L0_SIZE) {
+		uint64_t word = wheel.l0_map[idx / 64] >> (idx % 64);
+		if (word) {
+			idx += __builtin_ctzll(word);
+			if (!llist_empty(&wheel.l0[idx]))
+				return idx;
+			/* lazily clear the bit of a slot which became empty meanwhile */
+			wheel.l0_map[idx / 64] &= ~(1ULL << (idx % 64));
+			continue;
+		}
+		idx = (idx | 63) + 1;
+	}
+	return TW_L0_SIZE;
+}
+
+/* move all expired timers into the eviction list, in the same order as the rbtree implementation does */
+static void wheel_update(struct llist_head *eviction_list, const struct timeval *current)
+{
+	uint64_t now = timeval_to_tick(current);
+	struct osmo_timer_list *this, *tmp;
+	struct llist_head *slot;
+
+	if (!wheel.initialized)
+		wheel_init(now);
+	if (now < wheel.now)
+		wheel_rebase(now);
+
+	while (true) {
+		uint64_t next;
+		unsigned int idx;
+
+		if (!wheel.cascaded)
+			wheel_cascade();
+
+		slot = &wheel.l0[wheel.now & (TW_L0_SIZE - 1)];
+		if (wheel.now == now) {
+			/* the current tick: only evict what has expired with sub-millisecond precision */
+			llist_for_each_entry_safe(this, tmp, slot, list) {
+				if (timercmp(&this->timeout, current, >))
+					continue;
+				llist_del(&this->list);
+				llist_add(&this->list, eviction_list);
+			}
+			break;
+		}
+
+		llist_for_each_entry_safe(this, tmp, slot, list) {
+			llist_del(&this->list);
+			llist_add(&this->list, eviction_list);
+		}
+
+		/* skip ahead to the next non-empty slot, but never beyond the next cascade */
+		if (!wheel.count) {
+			next = now;
+		} else {
+			idx = wheel_l0_next((wheel.now & (TW_L0_SIZE - 1)) + 1);
+			next = (wheel.now & ~((uint64_t)TW_L0_SIZE - 1)) + idx;
+			if (next > now)
+				next = now;
+		}
+		wheel.now = next;
+		wheel.cascaded = false;
+	}
+}
+
+/* determine the earliest point in time at which wheel_update() may have work to do */
+static bool wheel_nearest(struct timeval *cand)
+{
+	struct osmo_timer_list *this;
+	uint64_t best = UINT64_MAX;
+	unsigned int lvl, cur, idx;
+	bool exact = false;
+
+	if (!wheel.count)
+		return false;
+
+	/* a cascade is pending for the current tick */
+	if (!wheel.cascaded && !(wheel.now & (TW_L0_SIZE - 1)))
+		best = wheel.now;
+
+	/* timers in the current slot may expire with sub-millisecond precision */
+	cur = wheel.now & (TW_L0_SIZE - 1);
+	llist_for_each_entry(this, &wheel.l0[cur], list) {
+		if (!exact || timercmp(&this->timeout, cand, <)) {
+			*cand = this->timeout;
+			exact = true;
+		}
+	}
+
+	/* the remaining level 0 slots each hold the timers of exactly one tick */
+	idx = wheel_l0_next(cur + 1);
+	if (idx < TW_L0_SIZE) {
+		best = OSMO_MIN(best, (wheel.now - cur) + idx);
+	} else {
+		idx = wheel_l0_next(0);
+		if (idx < cur)
+			best = OSMO_MIN(best, (wheel.now - cur) + TW_L0_SIZE + idx);
+	}
+
+	/* the upper levels need to be cascaded once the wheel reaches the start of a non-empty slot */
+	for (lvl = 0; lvl < TW_LEVELS; lvl++) {
+		uint64_t map = wheel.ln_map[lvl];
+		unsigned int shift = TW_LN_SHIFT(lvl);
+		unsigned int d;
+
+		if (!map)
+			continue;
+		/* rotate the bitmap so that bit 0 corresponds to the slot following the current one */
+		cur = (wheel.now >> shift) & (TW_LN_SIZE - 1);
+		cur = (cur + 1) & (TW_LN_SIZE - 1);
+		map = (map >> cur) | (cur ? map << (TW_LN_SIZE - cur) : 0);
+		d = __builtin_ctzll(map) + 1;
+		best = OSMO_MIN(best, ((wheel.now >> shift) + d) << shift);
+	}
+
+	if (best != UINT64_MAX) {
+		struct timeval tv;
+		tick_to_timeval(best, &tv);
+		if (!exact || timercmp(&tv, cand, <))
+			*cand = tv;
+		exact = true;
+	}
+
+	return exact;
+}
+
 static void __add_timer(struct osmo_timer_list *timer)
 {
+	if (g_timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		if (!wheel.initialized)
+			wheel_init_now();
+		wheel_insert(timer);
+		wheel.count++;
+		return;
+	}
+
 	struct rb_node **new = &(timer_root.rb_node);
 	struct rb_node *parent = NULL;
 
@@ -117,6 +421,12 @@ void osmo_timer_del(struct osmo_timer_list *timer)
 {
 	if (timer->active) {
 		timer->active = 0;
+		if (g_timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+			/* either in a slot of the wheel, or already in the eviction list */
+			llist_del_init(&timer->list);
+			wheel.count--;
+			return;
+		}
 		rb_erase(&timer->node, &timer_root);
 		/* make sure this is not already scheduled for removal. */
 		if (!llist_empty(&timer->list))
@@ -228,6 +538,15 @@ void osmo_timers_prepare(void)
 
 	osmo_gettimeofday(&current, NULL);
 
+	if (g_timer_backend == OSMO_TIMER_BACKEND_WHEEL) {
+		struct timeval cand;
+		if (wheel_nearest(&cand))
+			update_nearest(&cand, &current);
+		else
+			nearest_p = NULL;
+		return;
+	}
+
 	node = rb_first(&timer_root);
 	if (node) {
 		struct osmo_timer_list *this;
@@ -250,7 +569,9 @@ int osmo_timers_update(void)
 	osmo_gettimeofday(&current_time, NULL);
 
 	INIT_LLIST_HEAD(&timer_eviction_list);
-	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
+	if (g_timer_backend == OSMO_TIMER_BACKEND_WHEEL)
+		wheel_update(&timer_eviction_list, &current_time);
+	else for (node = rb_first(&timer_root); node; node = rb_next(node)) {
 		this = container_of(node, struct osmo_timer_list, node);
 
 		if (timercmp(&this->timeout, &current_time, >))
@@ -290,10 +611,37 @@ int osmo_timers_check(void)
 	struct rb_node *node;
 	int i = 0;
 
+	if (g_timer_backend == OSMO_TIMER_BACKEND_WHEEL)
+		return wheel.count;
+
 	for (node = rb_first(&timer_root); node; node = rb_next(node)) {
 		i++;
 	}
 	return i;
 }
 
+/*! Obtain the osmo_timer_backend in use by the process
+ *  \returns The timer back-end which was configured at startup time */
+enum osmo_timer_backend osmo_timers_get_backend(void)
+{
+	return g_timer_backend;
+}
+
+static __attribute__((constructor(102))) void on_dso_load_timer(void)
+{
+	char *backend = getenv(OSMO_TIMER_BACKEND_ENV);
+	if (backend == NULL)
+		backend = OSMO_TIMER_BACKEND_DEFAULT;
+
+	if (!strcmp("RBTREE", backend)) {
+		g_timer_backend = OSMO_TIMER_BACKEND_RBTREE;
+	} else if (!strcmp("WHEEL", backend)) {
+		g_timer_backend = OSMO_TIMER_BACKEND_WHEEL;
+	} else {
+		fprintf(stderr, "Invalid osmo_timer backend requested: \"%s\"\nCheck the environment variable %s\n",
+			backend, OSMO_TIMER_BACKEND_ENV);
+		exit(1);
+	}
+}
+
 /*! @} */
@@ -58,7 +58,7 @@ int osmo_wqueue_bfd_cb(struct osmo_fd *fd, unsigned int what)
 	if (what & OSMO_FD_WRITE) {
 		struct msgb *msg;
 
-		fd->when &= ~OSMO_FD_WRITE;
+		osmo_fd_write_disable(fd);
 
 		msg = msgb_dequeue_count(&queue->msg_queue, &queue->current_length);
 		/* the queue might have been emptied */
@@ -75,7 +75,7 @@ int osmo_wqueue_bfd_cb(struct osmo_fd *fd, unsigned int what)
 				msgb_free(msg);
 
 			if (!llist_empty(&queue->msg_queue))
-				fd->when |= OSMO_FD_WRITE;
+				osmo_fd_write_enable(fd);
 		}
 	}
 
@@ -110,7 +110,7 @@ int osmo_wqueue_enqueue_quiet(struct osmo_wqueue *queue, struct msgb *data)
 		return -ENOSPC;
 
 	msgb_enqueue_count(&queue->msg_queue, data, &queue->current_length);
-	queue->bfd.when |= OSMO_FD_WRITE;
+	osmo_fd_write_enable(&queue->bfd);
 
 	return 0;
 }
@@ -144,7 +144,7 @@ void osmo_wqueue_clear(struct osmo_wqueue *queue)
 	}
 
 	queue->current_length = 0;
-	queue->bfd.when &= ~OSMO_FD_WRITE;
+	osmo_fd_write_disable(&queue->bfd);
 }
 
 /*! Update write queue length & drop excess messages.
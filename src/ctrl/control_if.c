@@ -698,6 +698,7 @@ static int get_rate_ctr(struct ctrl_cmd *cmd, void *data)
 		cmd->reply = "Counter group with given name and index not found";
 		goto err;
 	}
+	rate_ctr_group_sync(ctrg);
 
 	if (!strlen(saveptr)) {
 		talloc_free(dup);
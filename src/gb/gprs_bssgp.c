@@ -29,6 +29,7 @@
 #include <stdint.h>
 
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/hash.h>
 #include <osmocom/core/byteswap.h>
 #include <osmocom/core/bit16gen.h>
 #include <osmocom/gsm/tlv.h>
@@ -70,6 +71,70 @@ static const struct rate_ctr_group_desc bssgp_ctrg_desc = {
 
 LLIST_HEAD(bssgp_bvc_ctxts);
 
+/* hashed indexes over bssgp_bvc_ctxts, grown along with the number of BVCs */
+#define BVC_HASH_MIN_BITS	6
+static struct {
+	struct hlist_head *by_bvci_nsei;
+	struct hlist_head *by_raid_cid;
+	unsigned int bits;
+	unsigned int count;
+} bvc_hash;
+
+static inline uint32_t bvci_nsei_key(uint16_t bvci, uint16_t nsei)
+{
+	return ((uint32_t)nsei << 16) | bvci;
+}
+
+static inline uint32_t raid_cid_key(const struct gprs_ra_id *raid, uint16_t cid)
+{
+	return (((uint32_t)raid->lac << 16) | cid) ^ ((uint32_t)raid->rac << 24)
+		^ ((uint32_t)raid->mcc << 4) ^ raid->mnc;
+}
+
+static void btsctx_rehash_raid_cid(struct bssgp_bvc_ctx *bctx)
+{
+	hlist_del_init(&bctx->node_by_raid_cid);
+	hlist_add_head(&bctx->node_by_raid_cid,
+		       &bvc_hash.by_raid_cid[hash_32(raid_cid_key(&bctx->ra_id, bctx->cell_id), bvc_hash.bits)]);
+}
+
+/* make room for one more BVC: keep the load factor of both indexes at or below 1 */
+static int btsctx_hash_grow(void)
+{
+	struct hlist_head *by_bvci_nsei, *by_raid_cid;
+	struct bssgp_bvc_ctx *bctx;
+	unsigned int bits;
+
+	if (bvc_hash.by_bvci_nsei && bvc_hash.count < (1U << bvc_hash.bits))
+		return 0;
+
+	bits = bvc_hash.by_bvci_nsei ? bvc_hash.bits + 1 : BVC_HASH_MIN_BITS;
+	by_bvci_nsei = talloc_zero_array(bssgp_tall_ctx, struct hlist_head, 1U << bits);
+	by_raid_cid = talloc_zero_array(bssgp_tall_ctx, struct hlist_head, 1U << bits);
+	if (!by_bvci_nsei || !by_raid_cid) {
+		/* keep using the old tables (if any), only with longer chains */
+		talloc_free(by_bvci_nsei);
+		talloc_free(by_raid_cid);
+		return bvc_hash.by_bvci_nsei ? 0 : -ENOMEM;
+	}
+
+	talloc_free(bvc_hash.by_bvci_nsei);
+	talloc_free(bvc_hash.by_raid_cid);
+	bvc_hash.by_bvci_nsei = by_bvci_nsei;
+	bvc_hash.by_raid_cid = by_raid_cid;
+	bvc_hash.bits = bits;
+
+	llist_for_each_entry(bctx, &bssgp_bvc_ctxts, list) {
+		INIT_HLIST_NODE(&bctx->node_by_bvci_nsei);
+		INIT_HLIST_NODE(&bctx->node_by_raid_cid);
+		hlist_add_head(&bctx->node_by_bvci_nsei,
+			       &bvc_hash.by_bvci_nsei[hash_32(bvci_nsei_key(bctx->bvci, bctx->nsei), bits)]);
+		btsctx_rehash_raid_cid(bctx);
+	}
+
+	return 0;
+}
+
 static int _bssgp_tx_dl_ud(struct bssgp_flow_control *fc, struct msgb *msg,
 			   uint32_t llc_pdu_len, void *priv);
 
@@ -86,7 +151,11 @@ struct bssgp_bvc_ctx *btsctx_by_raid_cid(const struct gprs_ra_id *raid, uint16_t
 {
 	struct bssgp_bvc_ctx *bctx;
 
-	llist_for_each_entry(bctx, &bssgp_bvc_ctxts, list) {
+	if (!bvc_hash.count)
+		return NULL;
+
+	hlist_for_each_entry(bctx, &bvc_hash.by_raid_cid[hash_32(raid_cid_key(raid, cid), bvc_hash.bits)],
+			     node_by_raid_cid) {
 		if (!memcmp(&bctx->ra_id, raid, sizeof(bctx->ra_id)) &&
 		    bctx->cell_id == cid)
 			return bctx;
@@ -94,6 +163,18 @@ struct bssgp_bvc_ctx *btsctx_by_raid_cid(const struct gprs_ra_id *raid, uint16_t
 	return NULL;
 }
 
+/*! Set the RA ID and Cell ID of a BTS context.
+ *  btsctx_by_raid_cid() only finds a context by the values set here.
+ *  \param[in] ctx BTS context to modify
+ *  \param[in] raid Routing Area ID of the cell
+ *  \param[in] cid Cell ID of the cell */
+void bssgp_bvc_ctx_set_raid_cid(struct bssgp_bvc_ctx *ctx, const struct gprs_ra_id *raid, uint16_t cid)
+{
+	ctx->ra_id = *raid;
+	ctx->cell_id = cid;
+	btsctx_rehash_raid_cid(ctx);
+}
+
 /* Transmit a BVC-RESET or BVC-RESET-ACK with a given nsei and bvci (Chapter 10.4.12)
  *  \param[in] pdu Either BSSGP_PDUT_BVC_RESET or BSSGP_PDUT_BVC_RESET_ACK
  *  \param[in] nsei The NSEI to transmit over
@@ -193,7 +274,11 @@ struct bssgp_bvc_ctx *btsctx_by_bvci_nsei(uint16_t bvci, uint16_t nsei)
 {
 	struct bssgp_bvc_ctx *bctx;
 
-	llist_for_each_entry(bctx, &bssgp_bvc_ctxts, list) {
+	if (!bvc_hash.count)
+		return NULL;
+
+	hlist_for_each_entry(bctx, &bvc_hash.by_bvci_nsei[hash_32(bvci_nsei_key(bvci, nsei), bvc_hash.bits)],
+			     node_by_bvci_nsei) {
 		if (bctx->nsei == nsei && bctx->bvci == bvci)
 			return bctx;
 	}
@@ -228,7 +313,15 @@ struct bssgp_bvc_ctx *btsctx_alloc(uint16_t bvci, uint16_t nsei)
 	/* cofigure for 2Mbit, 30 packets in queue */
 	bssgp_fc_init(ctx->fc, 100000, 2*1024*1024/8, 30, &_bssgp_tx_dl_ud);
 
+	if (btsctx_hash_grow() < 0)
+		goto err_fc;
+
 	llist_add(&ctx->list, &bssgp_bvc_ctxts);
+	hlist_add_head(&ctx->node_by_bvci_nsei,
+		       &bvc_hash.by_bvci_nsei[hash_32(bvci_nsei_key(bvci, nsei), bvc_hash.bits)]);
+	/* index the (still unset) RA ID and Cell ID */
+	bssgp_bvc_ctx_set_raid_cid(ctx, &ctx->ra_id, ctx->cell_id);
+	bvc_hash.count++;
 
 	return ctx;
 
@@ -247,6 +340,9 @@ void bssgp_bvc_ctx_free(struct bssgp_bvc_ctx *ctx)
 	osmo_timer_del(&ctx->fc->timer);
 	rate_ctr_group_free(ctx->ctrg);
 	llist_del(&ctx->list);
+	hlist_del(&ctx->node_by_bvci_nsei);
+	hlist_del(&ctx->node_by_raid_cid);
+	bvc_hash.count--;
 	talloc_free(ctx);
 }
 
@@ -406,8 +502,9 @@ static int bssgp_rx_bvc_reset(struct msgb *msg, struct tlv_parsed *tp,
 {
 	struct osmo_bssgp_prim nmp;
 	struct bssgp_bvc_ctx *bctx;
+	struct gprs_ra_id ra_id;
 	uint16_t nsei = msgb_nsei(msg);
-	uint16_t bvci;
+	uint16_t bvci, cell_id;
 
 	bvci = tlvp_val16be(tp, BSSGP_IE_BVCI);
 	DEBUGP(DLBSSGP, "BSSGP BVCI=%u Rx RESET cause=%s\n", bvci,
@@ -430,8 +527,8 @@ static int bssgp_rx_bvc_reset(struct msgb *msg, struct tlv_parsed *tp,
 			return -EINVAL;
 		}
 		/* actually extract RAC / CID */
-		bctx->cell_id = bssgp_parse_cell_id(&bctx->ra_id,
-						TLVP_VAL(tp, BSSGP_IE_CELL_ID));
+		cell_id = bssgp_parse_cell_id(&ra_id, TLVP_VAL(tp, BSSGP_IE_CELL_ID));
+		bssgp_bvc_ctx_set_raid_cid(bctx, &ra_id, cell_id);
 		LOGP(DLBSSGP, LOGL_NOTICE, "Cell %s CI %u on BVCI %u\n",
 		     osmo_rai_name(&bctx->ra_id), bctx->cell_id, bvci);
 	}
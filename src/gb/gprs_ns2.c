@@ -647,6 +647,7 @@ void gprs_ns2_free_nsvc(struct gprs_ns2_vc *nsvc)
 
 	llist_del(&nsvc->list);
 	llist_del(&nsvc->blist);
+	ns2_vc_clear_nsvci(nsvc);
 
 	/* notify nse this nsvc is unavailable */
 	ns2_nse_notify_unblocked(nsvc, false);
@@ -771,7 +772,7 @@ struct gprs_ns2_nse *gprs_ns2_nse_by_nsei(struct gprs_ns2_inst *nsi, uint16_t ns
 {
 	struct gprs_ns2_nse *nse;
 
-	llist_for_each_entry(nse, &nsi->nse, list) {
+	hash_for_each_possible(nsi->nse_by_nsei, nse, node_by_nsei, nsei) {
 		if (nse->nsei == nsei)
 			return nse;
 	}
@@ -785,19 +786,35 @@ struct gprs_ns2_nse *gprs_ns2_nse_by_nsei(struct gprs_ns2_inst *nsi, uint16_t ns
  *  \return NS-VC Entity in successful case; NULL if none found */
 struct gprs_ns2_vc *gprs_ns2_nsvc_by_nsvci(struct gprs_ns2_inst *nsi, uint16_t nsvci)
 {
-	struct gprs_ns2_nse *nse;
 	struct gprs_ns2_vc *nsvc;
 
-	llist_for_each_entry(nse, &nsi->nse, list) {
-		llist_for_each_entry(nsvc, &nse->nsvc, list) {
-			if (nsvc->nsvci_is_valid && nsvc->nsvci == nsvci)
-				return nsvc;
-		}
+	hash_for_each_possible(nsi->nsvc_by_nsvci, nsvc, node_by_nsvci, nsvci) {
+		if (nsvc->nsvci_is_valid && nsvc->nsvci == nsvci)
+			return nsvc;
 	}
 
 	return NULL;
 }
 
+/*! Assign a NSVCI to a NS-VC and index it for gprs_ns2_nsvc_by_nsvci().
+ *  \param[in] nsvc NS-VC to modify
+ *  \param[in] nsvci NS-VCI to assign */
+void ns2_vc_set_nsvci(struct gprs_ns2_vc *nsvc, uint16_t nsvci)
+{
+	ns2_vc_clear_nsvci(nsvc);
+	nsvc->nsvci = nsvci;
+	nsvc->nsvci_is_valid = true;
+	hash_add(nsvc->bind->nsi->nsvc_by_nsvci, &nsvc->node_by_nsvci, nsvci);
+}
+
+/*! Mark the NSVCI of a NS-VC as invalid and remove it from the NSVCI index.
+ *  \param[in] nsvc NS-VC to modify */
+void ns2_vc_clear_nsvci(struct gprs_ns2_vc *nsvc)
+{
+	nsvc->nsvci_is_valid = false;
+	hash_del(&nsvc->node_by_nsvci);
+}
+
 /*! Create a NS Entity within given NS instance.
  *  \param[in] nsi NS instance in which to create NS Entity
  *  \param[in] nsei NS Entity Identifier of to-be-created NSE
@@ -838,6 +855,7 @@ struct gprs_ns2_nse *gprs_ns2_create_nse2(struct gprs_ns2_inst *nsi, uint16_t ns
 	nse->first = true;
 	nse->mtu = 0;
 	llist_add_tail(&nse->list, &nsi->nse);
+	hash_add(nsi->nse_by_nsei, &nse->node_by_nsei, nsei);
 	INIT_LLIST_HEAD(&nse->nsvc);
 	osmo_clock_gettime(CLOCK_MONOTONIC, &nse->ts_alive_change);
 
@@ -918,6 +936,7 @@ void gprs_ns2_free_nse(struct gprs_ns2_nse *nse)
 	ns2_free_nsvcs(nse);
 
 	llist_del(&nse->list);
+	hash_del(&nse->node_by_nsei);
 	talloc_free(nse);
 }
 
@@ -987,7 +1006,7 @@ static enum ns2_cs ns2_create_vc_sns(struct gprs_ns2_vc_bind *bind,
 	if (!nsvc)
 		return NS2_CS_SKIPPED;
 
-	nsvc->nsvci_is_valid = false;
+	ns2_vc_clear_nsvci(nsvc);
 
 	*success = nsvc;
 
@@ -1161,8 +1180,7 @@ enum ns2_cs ns2_create_vc(struct gprs_ns2_vc_bind *bind,
 	if (!nsvc)
 		return NS2_CS_SKIPPED;
 
-	nsvc->nsvci = nsvci;
-	nsvc->nsvci_is_valid = true;
+	ns2_vc_set_nsvci(nsvc, nsvci);
 
 	*success = nsvc;
 
@@ -1186,10 +1204,8 @@ struct gprs_ns2_vc *gprs_ns2_ip_connect_inactive(struct gprs_ns2_vc_bind *bind,
 	if (!nsvc)
 		return NULL;
 
-	if (nsvc->mode == GPRS_NS2_VC_MODE_BLOCKRESET) {
-		nsvc->nsvci = nsvci;
-		nsvc->nsvci_is_valid = true;
-	}
+	if (nsvc->mode == GPRS_NS2_VC_MODE_BLOCKRESET)
+		ns2_vc_set_nsvci(nsvc, nsvci);
 
 	return nsvc;
 }
@@ -1438,6 +1454,8 @@ struct gprs_ns2_inst *gprs_ns2_instantiate(void *ctx, osmo_prim_cb cb, void *cb_
 	nsi->cb_data = cb_data;
 	INIT_LLIST_HEAD(&nsi->binding);
 	INIT_LLIST_HEAD(&nsi->nse);
+	hash_init(nsi->nse_by_nsei);
+	hash_init(nsi->nsvc_by_nsvci);
 
 	nsi->timeout[NS_TOUT_TNS_BLOCK] = 3;
 	nsi->timeout[NS_TOUT_TNS_BLOCK_RETRIES] = 3;
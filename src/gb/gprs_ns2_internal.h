@@ -5,6 +5,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include <osmocom/core/hashtable.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/rate_ctr.h>
 #include <osmocom/gprs/protocol/gsm_08_16.h>
@@ -176,6 +177,12 @@ struct gprs_ns2_inst {
 	/*! linked lists of all NSVC in this instance */
 	struct llist_head nse;
 
+	/*! all NSE of this instance, hashed by NSEI */
+	DECLARE_HASHTABLE(nse_by_nsei, 10);
+
+	/*! all NS-VC of this instance with a valid NSVCI, hashed by NSVCI */
+	DECLARE_HASHTABLE(nsvc_by_nsvci, 10);
+
 	uint16_t timeout[NS_TIMERS_COUNT];
 
 	/*! workaround for rate counter until rate counter accepts char str as index */
@@ -196,6 +203,9 @@ struct gprs_ns2_nse {
 	/*! llist entry for gprs_ns2_inst */
 	struct llist_head list;
 
+	/*! entry in gprs_ns2_inst.nse_by_nsei */
+	struct hlist_node node_by_nsei;
+
 	/*! llist head to hold all nsvc */
 	struct llist_head nsvc;
 
@@ -250,6 +260,9 @@ struct gprs_ns2_vc {
 	/*! list of NS-VCs within bind, bind is the owner! */
 	struct llist_head blist;
 
+	/*! entry in gprs_ns2_inst.nsvc_by_nsvci, only hashed while nsvci_is_valid */
+	struct hlist_node node_by_nsvci;
+
 	/*! pointer to NS Instance */
 	struct gprs_ns2_nse *nse;
 
@@ -377,6 +390,9 @@ enum ns2_cs ns2_create_vc(struct gprs_ns2_vc_bind *bind,
 int ns2_recv_vc(struct gprs_ns2_vc *nsvc,
 		struct msgb *msg);
 
+void ns2_vc_set_nsvci(struct gprs_ns2_vc *nsvc, uint16_t nsvci);
+void ns2_vc_clear_nsvci(struct gprs_ns2_vc *nsvc);
+
 struct gprs_ns2_vc *ns2_vc_alloc(struct gprs_ns2_vc_bind *bind,
 				 struct gprs_ns2_nse *nse,
 				 bool initiater,
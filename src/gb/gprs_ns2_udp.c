@@ -51,12 +51,34 @@ struct priv_bind {
 	struct osmo_sockaddr addr;
 	int dscp;
 	uint8_t priority;
+	/*! all NS-VC of this bind, hashed by remote address */
+	DECLARE_HASHTABLE(vc_by_remote, 10);
 };
 
 struct priv_vc {
 	struct osmo_sockaddr remote;
+	/*! entry in priv_bind.vc_by_remote */
+	struct hlist_node node;
+	/*! back pointer for the hash lookup */
+	struct gprs_ns2_vc *nsvc;
 };
 
+/* fold IP address and port of a remote peer into a hash key */
+static uint32_t sockaddr_hash_key(const struct osmo_sockaddr *addr)
+{
+	const uint32_t *a6;
+
+	switch (addr->u.sa.sa_family) {
+	case AF_INET:
+		return addr->u.sin.sin_addr.s_addr ^ addr->u.sin.sin_port;
+	case AF_INET6:
+		a6 = (const uint32_t *)&addr->u.sin6.sin6_addr;
+		return a6[0] ^ a6[1] ^ a6[2] ^ a6[3] ^ addr->u.sin6.sin6_port;
+	default:
+		return 0;
+	}
+}
+
 /*! clean up all private driver state. Should be only called by gprs_ns2_free_bind() */
 static void free_bind(struct gprs_ns2_vc_bind *bind)
 {
@@ -83,6 +105,7 @@ static void free_vc(struct gprs_ns2_vc *nsvc)
 		return;
 
 	OSMO_ASSERT(gprs_ns2_is_ip_bind(nsvc->bind));
+	hash_del(&((struct priv_vc *)nsvc->priv)->node);
 	talloc_free(nsvc->priv);
 	nsvc->priv = NULL;
 }
@@ -125,19 +148,19 @@ static void dump_vty(const struct gprs_ns2_vc_bind *bind,
 struct gprs_ns2_vc *gprs_ns2_nsvc_by_sockaddr_bind(struct gprs_ns2_vc_bind *bind,
 						   const struct osmo_sockaddr *rem_addr)
 {
-	struct gprs_ns2_vc *nsvc;
+	struct priv_bind *priv;
 	struct priv_vc *vcpriv;
 
 	OSMO_ASSERT(gprs_ns2_is_ip_bind(bind));
 
-	llist_for_each_entry(nsvc, &bind->nsvc, blist) {
-		vcpriv = nsvc->priv;
+	priv = bind->priv;
+	hash_for_each_possible(priv->vc_by_remote, vcpriv, node, sockaddr_hash_key(rem_addr)) {
 		if (vcpriv->remote.u.sa.sa_family != rem_addr->u.sa.sa_family)
 			continue;
 		if (osmo_sockaddr_cmp(&vcpriv->remote, rem_addr))
 			continue;
 
-		return nsvc;
+		return vcpriv->nsvc;
 	}
 
 	return NULL;
@@ -169,12 +192,15 @@ static int nsip_vc_sendmsg(struct gprs_ns2_vc *nsvc, struct msgb *msg)
 
 static struct priv_vc *ns2_driver_alloc_vc(struct gprs_ns2_vc_bind *bind, struct gprs_ns2_vc *nsvc, const struct osmo_sockaddr *remote)
 {
+	struct priv_bind *bpriv = bind->priv;
 	struct priv_vc *priv = talloc_zero(bind, struct priv_vc);
 	if (!priv)
 		return NULL;
 
 	nsvc->priv = priv;
+	priv->nsvc = nsvc;
 	priv->remote = *remote;
+	hash_add(bpriv->vc_by_remote, &priv->node, sockaddr_hash_key(remote));
 
 	return priv;
 }
@@ -324,6 +350,7 @@ int gprs_ns2_ip_bind(struct gprs_ns2_inst *nsi,
 
 	priv->addr = *local;
 	priv->dscp = dscp;
+	hash_init(priv->vc_by_remote);
 
 	rc = osmo_sock_init_osa(SOCK_DGRAM, IPPROTO_UDP,
 				 local, NULL,
@@ -337,6 +364,8 @@ int gprs_ns2_ip_bind(struct gprs_ns2_inst *nsi,
 	osmo_iofd_register(priv->iofd, rc);
 	osmo_iofd_set_alloc_info(priv->iofd, 4096, 128);
 	osmo_iofd_set_txqueue_max_length(priv->iofd, nsi->txqueue_max_length);
+	/* drain bursts of NS-UDP datagrams with as few syscalls as possible */
+	osmo_iofd_set_batch_size(priv->iofd, 16);
 
 	/* IPv4: max fragmented payload can be (13 bit) * 8 byte => 65535.
 	 * IPv6: max payload can be 65535 (RFC 2460).
@@ -386,15 +415,12 @@ struct gprs_ns2_vc *ns2_ip_bind_connect(struct gprs_ns2_vc_bind *bind,
 	if (!nsvc)
 		return NULL;
 
-	nsvc->priv = talloc_zero(bind, struct priv_vc);
-	if (!nsvc->priv) {
+	priv = ns2_driver_alloc_vc(bind, nsvc, remote);
+	if (!priv) {
 		gprs_ns2_free_nsvc(nsvc);
 		return NULL;
 	}
 
-	priv = nsvc->priv;
-	priv->remote = *remote;
-
 	return nsvc;
 }
 
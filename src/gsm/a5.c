@@ -31,6 +31,10 @@
 #include <string.h>
 #include <stdbool.h>
 
+#include "config.h"
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
 #include <osmocom/gsm/a5.h>
 #include <osmocom/gsm/kasumi.h>
 #include <osmocom/crypt/auth.h>
@@ -439,4 +443,96 @@ osmo_a5(int n, const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul)
 	return 0;
 }
 
+/* ------------------------------------------------------------------------ */
+/* Batch A5/1&2 (bit-sliced)                                                */
+/* ------------------------------------------------------------------------ */
+
+/* Portable bit-sliced implementation, 64 requests per pass */
+#define A5_SLICE_T	uint64_t
+#define A5_LANES	64
+#define A5_SFX		gen
+#include "a5_batch_impl.h"
+#undef A5_SLICE_T
+#undef A5_LANES
+#undef A5_SFX
+
+#ifdef HAVE_AVX2
+/* See a5_batch_avx2.c, 256 requests per pass */
+#define A5_BATCH_AVX2_LANES	256
+void osmo_a5_1_batch_avx2(const struct osmo_a5_batch_req *req, unsigned int num);
+void osmo_a5_2_batch_avx2(const struct osmo_a5_batch_req *req, unsigned int num);
+static int a5_batch_avx2_supported = -1;
+#endif
+
+/* Below this many requests, the per-request A5/1 and A5/2 code is faster */
+#define A5_BATCH_MIN	8
+
+/*! Generate the A5/x cipher streams of several (key, frame number) pairs.
+ *  \param[in] n Which A5/x method to use
+ *  \param[in] req array of requests: key, frame number, and where to store
+ *		   the keystreams, see osmo_a5()
+ *  \param[in] num number of requests in \a req
+ *  \returns 0 for success, -ENOTSUP for invalid cipher selection.
+ *
+ * The result is the same as calling osmo_a5() for each request. A5/1 and
+ * A5/2 are bit-sliced: the registers of up to 64 requests (256 with AVX2)
+ * are clocked at once in one pass, so this is considerably faster than
+ * separate osmo_a5() calls for batches of more than a few requests, e.g.
+ * all ciphered bursts of a TDMA frame.
+ */
+int osmo_a5_batch(int n, const struct osmo_a5_batch_req *req, unsigned int num)
+{
+	void (*batch)(const struct osmo_a5_batch_req *req, unsigned int num);
+	unsigned int i, chunk;
+	int rc;
+
+	if (n < 0 || n > 4)
+		return -ENOTSUP;
+
+	if (n != 1 && n != 2) {
+		for (i = 0; i < num; i++) {
+			rc = osmo_a5(n, req[i].key, req[i].fn, req[i].dl, req[i].ul);
+			if (rc < 0)
+				return rc;
+		}
+		return 0;
+	}
+
+#ifdef HAVE_AVX2
+	if (OSMO_UNLIKELY(a5_batch_avx2_supported < 0)) {
+#ifdef HAVE___BUILTIN_CPU_SUPPORTS
+		a5_batch_avx2_supported = __builtin_cpu_supports("avx2");
+#else
+		a5_batch_avx2_supported = 0;
+#endif
+	}
+#endif
+
+	while (num > 0) {
+		if (num < A5_BATCH_MIN) {
+			for (i = 0; i < num; i++) {
+				if (n == 1)
+					_a5_1(req[i].key, req[i].fn, req[i].dl, req[i].ul);
+				else
+					_a5_2(req[i].key, req[i].fn, req[i].dl, req[i].ul);
+			}
+			break;
+		}
+
+		chunk = OSMO_MIN(num, 64);
+		batch = n == 1 ? osmo_a5_1_batch_gen : osmo_a5_2_batch_gen;
+#ifdef HAVE_AVX2
+		if (a5_batch_avx2_supported && num > 64) {
+			chunk = OSMO_MIN(num, A5_BATCH_AVX2_LANES);
+			batch = n == 1 ? osmo_a5_1_batch_avx2 : osmo_a5_2_batch_avx2;
+		}
+#endif
+		batch(req, chunk);
+		req += chunk;
+		num -= chunk;
+	}
+
+	return 0;
+}
+
 /*! @} */
@@ -0,0 +1,39 @@
+/*! \file a5_batch_avx2.c
+ * Bit-sliced A5/1 and A5/2 keystream generation
+ * for architectures with AVX2 support (256 requests per pass). */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+
+#include <immintrin.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/a5.h>
+
+/* GCC and clang define the bitwise operators on vector types like __m256i */
+#define A5_SLICE_T	__m256i
+#define A5_LANES	256
+#define A5_SFX		avx2
+
+/**
+ * Include common batch implementation
+ */
+#include "a5_batch_impl.h"
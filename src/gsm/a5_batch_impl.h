@@ -0,0 +1,213 @@
+/*! \file a5_batch_impl.h
+ * Bit-sliced A5/1 and A5/2 keystream generation, common implementation.
+ *
+ * Each bit of each LFSR is kept in its own A5_SLICE_T, whose bit 'l' belongs
+ * to request 'l' of the batch: clocking all lanes at once then only takes
+ * bitwise operations on whole slices, and the per-lane majority clocking
+ * becomes a bitwise select. The including file defines:
+ *
+ *   A5_SLICE_T	type of a slice, supporting the C bitwise operators
+ *   A5_LANES	number of bits (requests) in a slice, a multiple of 64
+ *   A5_SFX	suffix of the generated function names
+ */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define A5_WORDS	(A5_LANES / 64)
+
+#define _A5_NAME(name, sfx)	osmo_a5_##name##_##sfx
+#define A5_NAME(name, sfx)	_A5_NAME(name, sfx)
+
+/* Register lengths and taps, see A5_Rx_LEN and A5_Rx_TAPS in a5.c */
+#define A5B_R1_LEN	19
+#define A5B_R2_LEN	22
+#define A5B_R3_LEN	23
+#define A5B_R4_LEN	17
+
+/* State of all lanes: slice r1[i] holds bit i of R1 of each lane */
+struct A5_NAME(state, A5_SFX) {
+	A5_SLICE_T r1[A5B_R1_LEN];
+	A5_SLICE_T r2[A5B_R2_LEN];
+	A5_SLICE_T r3[A5B_R3_LEN];
+	A5_SLICE_T r4[A5B_R4_LEN];
+	/* key (bits 0..63) and frame count (bits 64..85), transposed */
+	A5_SLICE_T load[64 + 22];
+};
+
+static inline A5_SLICE_T A5_NAME(maj, A5_SFX)(A5_SLICE_T a, A5_SLICE_T b, A5_SLICE_T c)
+{
+	return (a & b) | (a & c) | (b & c);
+}
+
+/* Clock all lanes of a register */
+static inline void A5_NAME(shift, A5_SFX)(A5_SLICE_T *r, int len, A5_SLICE_T fb)
+{
+	int i;
+
+	for (i = len - 1; i > 0; i--)
+		r[i] = r[i - 1];
+	r[0] = fb;
+}
+
+/* Clock the lanes of a register whose bit is set in clk */
+static inline void A5_NAME(shift_cond, A5_SFX)(A5_SLICE_T *r, int len, A5_SLICE_T fb, A5_SLICE_T clk)
+{
+	int i;
+
+	for (i = len - 1; i > 0; i--)
+		r[i] ^= (r[i] ^ r[i - 1]) & clk;
+	r[0] ^= (r[0] ^ fb) & clk;
+}
+
+#define A5B_R1_FB(r)	((r)[13] ^ (r)[16] ^ (r)[17] ^ (r)[18])
+#define A5B_R2_FB(r)	((r)[20] ^ (r)[21])
+#define A5B_R3_FB(r)	((r)[7] ^ (r)[20] ^ (r)[21] ^ (r)[22])
+#define A5B_R4_FB(r)	((r)[11] ^ (r)[16])
+
+/* Transpose keys and frame counts of up to A5_LANES requests into st->load */
+static void A5_NAME(load, A5_SFX)(struct A5_NAME(state, A5_SFX) *st,
+				  const struct osmo_a5_batch_req *req, unsigned int num)
+{
+	uint64_t w[64 + 22][A5_WORDS];
+	unsigned int l, i;
+
+	memset(w, 0, sizeof(w));
+	for (l = 0; l < num; l++) {
+		/* bit i is bit (i & 7) of key[7 - (i >> 3)], like in _a5_1() */
+		uint64_t key = osmo_load64be(req[l].key);
+		uint64_t count = osmo_a5_fn_count(req[l].fn);
+		uint64_t *lane_w = &w[0][l / 64];
+		unsigned int shift = l % 64;
+
+		for (i = 0; i < 64; i++)
+			lane_w[i * A5_WORDS] |= ((key >> i) & 1) << shift;
+		for (i = 0; i < 22; i++)
+			lane_w[(64 + i) * A5_WORDS] |= ((count >> i) & 1) << shift;
+	}
+	for (i = 0; i < ARRAY_SIZE(st->load); i++)
+		memcpy(&st->load[i], w[i], sizeof(st->load[i]));
+}
+
+/* Scatter one output slice into the ubit_t arrays of the requests */
+static inline void A5_NAME(store, A5_SFX)(const struct osmo_a5_batch_req *req, unsigned int num,
+					  A5_SLICE_T out, unsigned int pos, bool ul)
+{
+	uint64_t w[A5_WORDS];
+	unsigned int l;
+
+	memcpy(w, &out, sizeof(w));
+	for (l = 0; l < num; l++) {
+		ubit_t *dst = ul ? req[l].ul : req[l].dl;
+		if (dst)
+			dst[pos] = (w[l / 64] >> (l % 64)) & 1;
+	}
+}
+
+/*! Generate the A5/1 keystreams of up to A5_LANES requests */
+__attribute__ ((visibility("hidden")))
+void A5_NAME(1_batch, A5_SFX)(const struct osmo_a5_batch_req *req, unsigned int num)
+{
+	struct A5_NAME(state, A5_SFX) st;
+	A5_SLICE_T fb1, fb2, fb3, m, out;
+	unsigned int i;
+
+	memset(&st, 0, sizeof(st));
+	A5_NAME(load, A5_SFX)(&st, req, num);
+
+	/* Key and frame count load, with forced clocking */
+	for (i = 0; i < 64 + 22; i++) {
+		fb1 = A5B_R1_FB(st.r1);
+		fb2 = A5B_R2_FB(st.r2);
+		fb3 = A5B_R3_FB(st.r3);
+		A5_NAME(shift, A5_SFX)(st.r1, A5B_R1_LEN, fb1 ^ st.load[i]);
+		A5_NAME(shift, A5_SFX)(st.r2, A5B_R2_LEN, fb2 ^ st.load[i]);
+		A5_NAME(shift, A5_SFX)(st.r3, A5B_R3_LEN, fb3 ^ st.load[i]);
+	}
+
+	/* Mix (100 clocks), then 2 * 114 clocks of output */
+	for (i = 0; i < 100 + 2 * 114; i++) {
+		/* a register is clocked if its clocking bit agrees with the majority */
+		m = A5_NAME(maj, A5_SFX)(st.r1[8], st.r2[10], st.r3[10]);
+		fb1 = A5B_R1_FB(st.r1);
+		fb2 = A5B_R2_FB(st.r2);
+		fb3 = A5B_R3_FB(st.r3);
+		A5_NAME(shift_cond, A5_SFX)(st.r1, A5B_R1_LEN, fb1, ~(st.r1[8] ^ m));
+		A5_NAME(shift_cond, A5_SFX)(st.r2, A5B_R2_LEN, fb2, ~(st.r2[10] ^ m));
+		A5_NAME(shift_cond, A5_SFX)(st.r3, A5B_R3_LEN, fb3, ~(st.r3[10] ^ m));
+		if (i < 100)
+			continue;
+
+		out = st.r1[A5B_R1_LEN - 1] ^ st.r2[A5B_R2_LEN - 1] ^ st.r3[A5B_R3_LEN - 1];
+		if (i < 100 + 114)
+			A5_NAME(store, A5_SFX)(req, num, out, i - 100, false);
+		else
+			A5_NAME(store, A5_SFX)(req, num, out, i - 100 - 114, true);
+	}
+}
+
+/*! Generate the A5/2 keystreams of up to A5_LANES requests */
+__attribute__ ((visibility("hidden")))
+void A5_NAME(2_batch, A5_SFX)(const struct osmo_a5_batch_req *req, unsigned int num)
+{
+	struct A5_NAME(state, A5_SFX) st;
+	A5_SLICE_T fb1, fb2, fb3, fb4, m, out;
+	unsigned int i;
+
+	memset(&st, 0, sizeof(st));
+	A5_NAME(load, A5_SFX)(&st, req, num);
+
+	/* Key and frame count load, with forced clocking */
+	for (i = 0; i < 64 + 22; i++) {
+		fb1 = A5B_R1_FB(st.r1);
+		fb2 = A5B_R2_FB(st.r2);
+		fb3 = A5B_R3_FB(st.r3);
+		fb4 = A5B_R4_FB(st.r4);
+		A5_NAME(shift, A5_SFX)(st.r1, A5B_R1_LEN, fb1 ^ st.load[i]);
+		A5_NAME(shift, A5_SFX)(st.r2, A5B_R2_LEN, fb2 ^ st.load[i]);
+		A5_NAME(shift, A5_SFX)(st.r3, A5B_R3_LEN, fb3 ^ st.load[i]);
+		A5_NAME(shift, A5_SFX)(st.r4, A5B_R4_LEN, fb4 ^ st.load[i]);
+	}
+
+	memset(&st.r1[15], 0xff, sizeof(st.r1[15]));
+	memset(&st.r2[16], 0xff, sizeof(st.r2[16]));
+	memset(&st.r3[18], 0xff, sizeof(st.r3[18]));
+	memset(&st.r4[10], 0xff, sizeof(st.r4[10]));
+
+	/* Mix (99 clocks), then 2 * 114 clocks of output */
+	for (i = 0; i < 99 + 2 * 114; i++) {
+		/* R4 decides which of the other registers are clocked */
+		m = A5_NAME(maj, A5_SFX)(st.r4[10], st.r4[3], st.r4[7]);
+		fb1 = A5B_R1_FB(st.r1);
+		fb2 = A5B_R2_FB(st.r2);
+		fb3 = A5B_R3_FB(st.r3);
+		fb4 = A5B_R4_FB(st.r4);
+		A5_NAME(shift_cond, A5_SFX)(st.r1, A5B_R1_LEN, fb1, ~(st.r4[10] ^ m));
+		A5_NAME(shift_cond, A5_SFX)(st.r2, A5B_R2_LEN, fb2, ~(st.r4[3] ^ m));
+		A5_NAME(shift_cond, A5_SFX)(st.r3, A5B_R3_LEN, fb3, ~(st.r4[7] ^ m));
+		A5_NAME(shift, A5_SFX)(st.r4, A5B_R4_LEN, fb4);
+		if (i < 99)
+			continue;
+
+		out = st.r1[A5B_R1_LEN - 1] ^ st.r2[A5B_R2_LEN - 1] ^ st.r3[A5B_R3_LEN - 1] ^
+		      A5_NAME(maj, A5_SFX)(st.r1[15], ~st.r1[14], st.r1[12]) ^
+		      A5_NAME(maj, A5_SFX)(~st.r2[16], st.r2[13], st.r2[9]) ^
+		      A5_NAME(maj, A5_SFX)(st.r3[18], st.r3[16], ~st.r3[13]);
+		if (i < 99 + 114)
+			A5_NAME(store, A5_SFX)(req, num, out, i - 99, false);
+		else
+			A5_NAME(store, A5_SFX)(req, num, out, i - 99 - 114, true);
+	}
+}
@@ -202,6 +202,56 @@ int osmo_auth_gen_vec2(struct osmo_auth_vector *vec,
 	return 0;
 }
 
+/*! Generate several authentication vectors of one subscriber
+ *  \param[out] vec Array of \a num generated authentication vectors
+ *  \param[in] num Number of vectors to generate
+ *  \param[in] aud Subscriber-specific key material
+ *  \param[in] _rand \a num random challenges of 16 bytes each
+ *  \returns 0 on success, negative error on failure
+ *
+ * The result is the same as calling osmo_auth_gen_vec2() for each vector
+ * in turn: as there, the caller must specify the desired RES length in
+ * vec[i].res_len, and for UMTS each vector gets the next SQN.  Algorithms
+ * that implement it (e.g. MILENAGE and TUAK) derive the per-subscriber
+ * state like the expanded key or OPc once for all vectors, and compute the
+ * vectors in parallel, which is what an AUC handing out several vectors per
+ * request wants.
+ *
+ * On failure, the content of \a vec is undefined; the SQN in \a aud is
+ * only updated if all vectors were generated.
+ */
+int osmo_auth_gen_vecs2(struct osmo_auth_vector *vec, unsigned int num,
+			struct osmo_sub_auth_data2 *aud,
+			const uint8_t *_rand)
+{
+	struct osmo_auth_impl *impl = selected_auths[aud->algo];
+	struct osmo_sub_auth_data2 aud_tmp;
+	unsigned int i;
+	int rc;
+
+	if (!impl)
+		return -ENOENT;
+
+	if (impl->gen_vecs) {
+		rc = impl->gen_vecs(vec, num, aud, _rand);
+		if (rc < 0)
+			return rc;
+	} else {
+		aud_tmp = *aud;
+		for (i = 0; i < num; i++) {
+			rc = impl->gen_vec(&vec[i], &aud_tmp, &_rand[i * 16]);
+			if (rc < 0)
+				return rc;
+		}
+		*aud = aud_tmp;
+	}
+
+	for (i = 0; i < num; i++)
+		memcpy(vec[i].rand, &_rand[i * 16], sizeof(vec[i].rand));
+
+	return 0;
+}
+
 /*! Generate authentication vector
  *  \param[out] vec Generated authentication vector
  *  \param[in] aud Subscriber-specific key material
@@ -43,17 +43,21 @@ static const uint8_t *gen_opc_if_needed(const struct osmo_sub_auth_data2 *aud, u
 		return aud->u.umts.opc;
 }
 
-static int milenage_gen_vec(struct osmo_auth_vector *vec,
-			    struct osmo_sub_auth_data2 *aud,
-			    const uint8_t *_rand)
+/* Vectors per milenage_generate_batch() call of milenage_gen_vecs() */
+#define MILENAGE_GEN_VECS_CHUNK	32
+
+static int milenage_gen_vecs(struct osmo_auth_vector *vec, unsigned int num,
+			     struct osmo_sub_auth_data2 *aud,
+			     const uint8_t *_rand)
 {
-	size_t res_len = sizeof(vec->res);
+	struct milenage_vec v[MILENAGE_GEN_VECS_CHUNK];
+	uint8_t sqn[MILENAGE_GEN_VECS_CHUNK][6];
 	uint64_t next_sqn;
 	uint8_t gen_opc[16];
 	const uint8_t *opc;
-	uint8_t sqn[6];
 	uint64_t ind_mask;
 	uint64_t seq_1;
+	unsigned int i, j, n;
 
 	OSMO_ASSERT(aud->algo == OSMO_AUTH_ALG_MILENAGE);
 
@@ -61,8 +65,10 @@ static int milenage_gen_vec(struct osmo_auth_vector *vec,
 		return -EINVAL;
 	if (aud->u.umts.opc_len != 16)
 		return -EINVAL;
-	if (vec->res_len != 4 && vec->res_len != 8)
-		return -EINVAL;
+	for (i = 0; i < num; i++) {
+		if (vec[i].res_len != 4 && vec[i].res_len != 8)
+			return -EINVAL;
+	}
 
 	opc = gen_opc_if_needed(aud, gen_opc);
 	if (!opc)
@@ -130,17 +136,31 @@ static int milenage_gen_vec(struct osmo_auth_vector *vec,
 		return -3;
 
 	/* keep the incremented SQN local until gsm_milenage() succeeded. */
-	next_sqn = ((aud->u.umts.sqn + seq_1) & ind_mask) + aud->u.umts.ind;
-
-	osmo_store64be_ext(next_sqn, sqn, 6);
-	milenage_generate(opc, aud->u.umts.amf, aud->u.umts.k,
-			  sqn, _rand,
-			  vec->autn, vec->ik, vec->ck, vec->res, &res_len);
-
-	osmo_auth_c3(vec->kc, vec->ck, vec->ik);
-	osmo_auth_c2(vec->sres, vec->res, vec->res_len, 1);
-
-	vec->auth_types = OSMO_AUTH_TYPE_UMTS | OSMO_AUTH_TYPE_GSM;
+	next_sqn = aud->u.umts.sqn;
+
+	/* each vector gets the next SQN, like from consecutive milenage_gen_vec() */
+	for (i = 0; i < num; i += n) {
+		n = OSMO_MIN(num - i, MILENAGE_GEN_VECS_CHUNK);
+		for (j = 0; j < n; j++) {
+			next_sqn = ((next_sqn + seq_1) & ind_mask) + aud->u.umts.ind;
+			osmo_store64be_ext(next_sqn, sqn[j], 6);
+			v[j] = (struct milenage_vec) {
+				._rand = &_rand[(i + j) * 16],
+				.sqn = sqn[j],
+				.autn = vec[i + j].autn,
+				.ik = vec[i + j].ik,
+				.ck = vec[i + j].ck,
+				.res = vec[i + j].res,
+			};
+		}
+		milenage_generate_batch(opc, aud->u.umts.amf, aud->u.umts.k, v, n);
+	}
+
+	for (i = 0; i < num; i++) {
+		osmo_auth_c3(vec[i].kc, vec[i].ck, vec[i].ik);
+		osmo_auth_c2(vec[i].sres, vec[i].res, vec[i].res_len, 1);
+		vec[i].auth_types = OSMO_AUTH_TYPE_UMTS | OSMO_AUTH_TYPE_GSM;
+	}
 
 	/* for storage in the caller's AUC database */
 	aud->u.umts.sqn = next_sqn;
@@ -148,6 +168,13 @@ static int milenage_gen_vec(struct osmo_auth_vector *vec,
 	return 0;
 }
 
+static int milenage_gen_vec(struct osmo_auth_vector *vec,
+			    struct osmo_sub_auth_data2 *aud,
+			    const uint8_t *_rand)
+{
+	return milenage_gen_vecs(vec, 1, aud, _rand);
+}
+
 static int milenage_gen_vec_auts(struct osmo_auth_vector *vec,
 				 struct osmo_sub_auth_data2 *aud,
 				 const uint8_t *auts, const uint8_t *rand_auts,
@@ -185,6 +212,7 @@ static struct osmo_auth_impl milenage_alg = {
 	.priority = 1000,
 	.gen_vec = &milenage_gen_vec,
 	.gen_vec_auts = &milenage_gen_vec_auts,
+	.gen_vecs = &milenage_gen_vecs,
 };
 
 static __attribute__((constructor)) void on_dso_load_milenage(void)
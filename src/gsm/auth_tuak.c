@@ -47,25 +47,32 @@ static const uint8_t *gen_opc_if_needed(const struct osmo_sub_auth_data2 *aud, u
 	return aud->u.umts.opc;
 }
 
-static int tuak_gen_vec(struct osmo_auth_vector *vec,
-			struct osmo_sub_auth_data2 *aud,
-			const uint8_t *_rand)
+/* Vectors per tuak_generate_batch() call of tuak_gen_vecs() */
+#define TUAK_GEN_VECS_CHUNK	32
+
+static int tuak_gen_vecs(struct osmo_auth_vector *vec, unsigned int num,
+			 struct osmo_sub_auth_data2 *aud,
+			 const uint8_t *_rand)
 {
-	size_t res_len = vec->res_len;
+	struct tuak_vec v[TUAK_GEN_VECS_CHUNK];
+	uint8_t sqn[TUAK_GEN_VECS_CHUNK][6];
 	uint64_t next_sqn;
 	uint8_t gen_opc[32];
 	const uint8_t *opc;
-	uint8_t sqn[6];
 	uint64_t ind_mask;
 	uint64_t seq_1;
+	unsigned int i, j, n;
+	int rc;
 
-	switch (vec->res_len) {
-	case 4:
-	case 8:
-	case 16:
-		break;
-	default:
-		return -EINVAL;
+	for (i = 0; i < num; i++) {
+		switch (vec[i].res_len) {
+		case 4:
+		case 8:
+		case 16:
+			break;
+		default:
+			return -EINVAL;
+		}
 	}
 
 	OSMO_ASSERT(aud->algo == OSMO_AUTH_ALG_TUAK);
@@ -141,18 +148,35 @@ static int tuak_gen_vec(struct osmo_auth_vector *vec,
 		return -3;
 
 	/* keep the incremented SQN local until gsm_milenage() succeeded. */
-	next_sqn = ((aud->u.umts.sqn + seq_1) & ind_mask) + aud->u.umts.ind;
-
-	osmo_store64be_ext(next_sqn, sqn, 6);
-
-	tuak_generate(opc, aud->u.umts.amf, aud->u.umts.k, aud->u.umts.k_len,
-		      sqn, _rand, vec->autn, vec->ik, vec->ck, vec->res, &res_len);
-
-	/* generate the GSM Kc + SRES values using C2 + C3 functions */
-	osmo_auth_c3(vec->kc, vec->ck, vec->ik);
-	osmo_auth_c2(vec->sres, vec->res, vec->res_len, 1);
+	next_sqn = aud->u.umts.sqn;
+
+	/* each vector gets the next SQN, like from consecutive tuak_gen_vec() */
+	for (i = 0; i < num; i += n) {
+		n = OSMO_MIN(num - i, TUAK_GEN_VECS_CHUNK);
+		for (j = 0; j < n; j++) {
+			next_sqn = ((next_sqn + seq_1) & ind_mask) + aud->u.umts.ind;
+			osmo_store64be_ext(next_sqn, sqn[j], 6);
+			v[j] = (struct tuak_vec) {
+				._rand = &_rand[(i + j) * 16],
+				.sqn = sqn[j],
+				.autn = vec[i + j].autn,
+				.ik = vec[i + j].ik,
+				.ck = vec[i + j].ck,
+				.res = vec[i + j].res,
+				.res_len = vec[i + j].res_len,
+			};
+		}
+		rc = tuak_generate_batch(opc, aud->u.umts.amf, aud->u.umts.k, aud->u.umts.k_len, v, n);
+		if (rc < 0)
+			return rc;
+	}
 
-	vec->auth_types = OSMO_AUTH_TYPE_UMTS | OSMO_AUTH_TYPE_GSM;
+	for (i = 0; i < num; i++) {
+		/* generate the GSM Kc + SRES values using C2 + C3 functions */
+		osmo_auth_c3(vec[i].kc, vec[i].ck, vec[i].ik);
+		osmo_auth_c2(vec[i].sres, vec[i].res, vec[i].res_len, 1);
+		vec[i].auth_types = OSMO_AUTH_TYPE_UMTS | OSMO_AUTH_TYPE_GSM;
+	}
 
 	/* for storage in the caller's AUC database */
 	aud->u.umts.sqn = next_sqn;
@@ -160,6 +184,13 @@ static int tuak_gen_vec(struct osmo_auth_vector *vec,
 	return 0;
 }
 
+static int tuak_gen_vec(struct osmo_auth_vector *vec,
+			struct osmo_sub_auth_data2 *aud,
+			const uint8_t *_rand)
+{
+	return tuak_gen_vecs(vec, 1, aud, _rand);
+}
+
 static int tuak_gen_vec_auts(struct osmo_auth_vector *vec,
 			     struct osmo_sub_auth_data2 *aud,
 			     const uint8_t *auts, const uint8_t *rand_auts,
@@ -197,6 +228,7 @@ static struct osmo_auth_impl tuak_alg = {
 	.priority = 1000,
 	.gen_vec = &tuak_gen_vec,
 	.gen_vec_auts = &tuak_gen_vec_auts,
+	.gen_vecs = &tuak_gen_vecs,
 };
 
 static __attribute__((constructor)) void on_dso_load_tuak(void)
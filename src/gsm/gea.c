@@ -14,11 +14,19 @@
  * GNU General Public License for more details.
  */
 
+#include "config.h"
+
 #include <osmocom/core/bits.h>
+#include <osmocom/core/byteswap.h>
+#include <osmocom/core/msgb.h>
+#include <osmocom/core/utils.h>
 #include <osmocom/crypt/gprs_cipher.h>
 #include <osmocom/crypt/auth.h>
+#include <osmocom/gsm/gea.h>
 #include <osmocom/gsm/kasumi.h>
 
+#include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -56,4 +64,169 @@ int gea3(uint8_t *out, uint16_t len, uint8_t *kc, uint32_t iv,
 	return gea4(out, len, ck, iv, direction);
 }
 
+/*! Set up a GEA3/GEA4 ciphering context for a key
+ *  \param[out] ctx Context to initialize
+ *  \param[in] algo GPRS_ALGO_GEA3 or GPRS_ALGO_GEA4
+ *  \param[in] kc Ciphering key, gprs_cipher_key_length() bytes
+ *  \returns 0 on success, -ENOTSUP for other algorithms
+ *
+ * The KASUMI key schedules are expanded here once, instead of twice for
+ * every frame as in gea3() and gea4(), so a context should be kept for as
+ * long as the key of an LLC entity does not change.
+ */
+int osmo_gea_ctx_init(struct osmo_gea_ctx *ctx, enum gprs_ciph_algo algo, const uint8_t *kc)
+{
+	uint8_t ck_km[16];
+	unsigned int i;
+
+	switch (algo) {
+	case GPRS_ALGO_GEA3:
+		osmo_c4(ctx->key, kc);
+		break;
+	case GPRS_ALGO_GEA4:
+		memcpy(ctx->key, kc, sizeof(ctx->key));
+		break;
+	default:
+		return -ENOTSUP;
+	}
+	ctx->algo = algo;
+
+	/* KM = 0x55..55, see _kasumi_kgcore() */
+	for (i = 0; i < sizeof(ck_km); i++)
+		ck_km[i] = ctx->key[i] ^ 0x55;
+	osmo_kasumi_key_expand(&ctx->ck_km, ck_km);
+	osmo_kasumi_key_expand(&ctx->ck, ctx->key);
+	memset(ck_km, 0, sizeof(ck_km));
+
+	return 0;
+}
+
+/*! Wipe the key material of a GEA3/GEA4 ciphering context
+ *  \param[inout] ctx Context from osmo_gea_ctx_init()
+ */
+void osmo_gea_ctx_clear(struct osmo_gea_ctx *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+/*! Cipher or decipher data in place with GEA3/GEA4
+ *  \param[in] ctx Context from osmo_gea_ctx_init()
+ *  \param[inout] data Data to cipher/decipher
+ *  \param[in] len Length of data, in bytes
+ *  \param[in] iv Init vector, see gprs_cipher_gen_input_ui()
+ *  \param[in] direction Direction: 0 (MS -> SGSN) or 1 (SGSN -> MS)
+ *
+ * Same as XORing data with the keystream of gea3() or gea4(), without the
+ * key expansion and keystream buffer of those.
+ */
+void osmo_gea_xor(const struct osmo_gea_ctx *ctx, uint8_t *data, uint16_t len, uint32_t iv,
+		  enum gprs_cipher_direction direction)
+{
+	/* register A of TS 55.216 section 3.2, CA = 0xff, cb = 0, see _kasumi_kgcore() */
+	uint64_t A = ((uint64_t)iv << 32) | (0xffULL << 16) | ((uint64_t)(direction << 2) << 24);
+	uint64_t BLK = 0;
+	uint16_t i, j;
+
+	A = osmo_kasumi(&ctx->ck_km, A);
+
+	for (i = 0; len >= 8; i++, len -= 8, data += 8) {
+		BLK = osmo_kasumi(&ctx->ck, A ^ i ^ BLK);
+		osmo_store64be(osmo_load64be(data) ^ BLK, data);
+	}
+	if (len) {
+		BLK = osmo_kasumi(&ctx->ck, A ^ i ^ BLK);
+		for (j = 0; j < len; j++)
+			data[j] ^= BLK >> (56 - 8 * j);
+	}
+}
+
+/*! Cipher or decipher the data of a msgb in place with GEA3/GEA4
+ *  \param[in] ctx Context from osmo_gea_ctx_init()
+ *  \param[inout] msg Message buffer, e.g. an LLC frame
+ *  \param[in] offset Offset in msgb_data() of the first ciphered byte
+ *  \param[in] iv Init vector, see gprs_cipher_gen_input_ui()
+ *  \param[in] direction Direction: 0 (MS -> SGSN) or 1 (SGSN -> MS)
+ *  \returns 0 on success, -EINVAL if \a offset is beyond the data
+ */
+int osmo_gea_msgb(const struct osmo_gea_ctx *ctx, struct msgb *msg, unsigned int offset, uint32_t iv,
+		  enum gprs_cipher_direction direction)
+{
+	if (offset > msgb_length(msg))
+		return -EINVAL;
+
+	osmo_gea_xor(ctx, msgb_data(msg) + offset, msgb_length(msg) - offset, iv, direction);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+/* Batch GEA3/GEA4 (bit-sliced)                                             */
+/* ------------------------------------------------------------------------ */
+
+/* Portable bit-sliced implementation, 64 frames per pass */
+typedef uint64_t gea_slice_gen_t __attribute__ ((vector_size(8)));
+
+#define KB_SLICE_T	gea_slice_gen_t
+#define KB_LANES	64
+#define KB_SFX		gen
+#define KB_MIN_ACTIVE	48
+#include "kasumi_batch_impl.h"
+#undef KB_SLICE_T
+#undef KB_LANES
+#undef KB_SFX
+#undef KB_MIN_ACTIVE
+
+#ifdef HAVE_AVX2
+/* See gea_batch_avx2.c, 256 frames at a time */
+void osmo_gea_batch_avx2(const struct osmo_gea_batch_req *req, unsigned int num);
+static int gea_batch_avx2_supported = -1;
+#endif
+
+/* Below this many frames, osmo_gea_xor() per frame is faster */
+#define GEA_BATCH_MIN	48
+
+/*! Cipher or decipher several frames in place with GEA3/GEA4
+ *  \param[in] req Array of frames, each with its context, see osmo_gea_xor()
+ *  \param[in] num Number of frames in \a req
+ *  \returns 0 on success, -ENOTSUP if a context is not initialized
+ *
+ * The result is the same as calling osmo_gea_xor() for each frame. The
+ * blocks of one frame depend on each other (KASUMI in OFB mode), so the
+ * frames are processed in parallel instead: KASUMI is bit-sliced without
+ * S-box tables, for 64 frames (256 with AVX2) at a time, each of which
+ * continues with the next frame of \a req when done. This is considerably
+ * faster for many frames, e.g. all LLC frames of a scheduling round.
+ */
+int osmo_gea_batch(const struct osmo_gea_batch_req *req, unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		if (req[i].ctx->algo != GPRS_ALGO_GEA3 && req[i].ctx->algo != GPRS_ALGO_GEA4)
+			return -ENOTSUP;
+	}
+
+	if (num < GEA_BATCH_MIN) {
+		for (i = 0; i < num; i++)
+			osmo_gea_xor(req[i].ctx, req[i].data, req[i].len, req[i].iv, req[i].direction);
+		return 0;
+	}
+
+#ifdef HAVE_AVX2
+	if (OSMO_UNLIKELY(gea_batch_avx2_supported < 0)) {
+#ifdef HAVE___BUILTIN_CPU_SUPPORTS
+		gea_batch_avx2_supported = __builtin_cpu_supports("avx2");
+#else
+		gea_batch_avx2_supported = 0;
+#endif
+	}
+	if (gea_batch_avx2_supported && num > 64) {
+		osmo_gea_batch_avx2(req, num);
+		return 0;
+	}
+#endif
+
+	osmo_gea_batch_gen(req, num);
+	return 0;
+}
+
 /*! @} */
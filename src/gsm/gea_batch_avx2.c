@@ -0,0 +1,41 @@
+/*! \file gea_batch_avx2.c
+ * Bit-sliced GEA3/GEA4 ciphering
+ * for architectures with AVX2 support (256 frames per pass). */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/byteswap.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gea.h>
+
+/* GCC and clang define the bitwise and shift operators on vector types */
+typedef uint64_t gea_slice_avx2_t __attribute__ ((vector_size(32)));
+
+#define KB_SLICE_T	gea_slice_avx2_t
+#define KB_LANES	256
+#define KB_SFX		avx2
+#define KB_MIN_ACTIVE	48
+
+/**
+ * Include common batch implementation
+ */
+#include "kasumi_batch_impl.h"
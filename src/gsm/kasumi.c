@@ -155,6 +155,27 @@ void _kasumi_key_expand(const uint8_t *key, uint16_t *KLi1, uint16_t *KLi2, uint
 	}
 }
 
+/*! Expand a KASUMI key, to run osmo_kasumi() with it repeatedly
+ *  \param[out] key Expanded key
+ *  \param[in] k Key (128 bits) as array of bytes
+ */
+void osmo_kasumi_key_expand(struct osmo_kasumi_key *key, const uint8_t *k)
+{
+	_kasumi_key_expand(k, key->KLi1, key->KLi2, key->KOi1, key->KOi2, key->KOi3,
+			   key->KIi1, key->KIi2, key->KIi3);
+}
+
+/*! Encrypt one block with an expanded KASUMI key
+ *  \param[in] key Key from osmo_kasumi_key_expand()
+ *  \param[in] P Block of 64 bits
+ *  \returns encrypted block
+ */
+uint64_t osmo_kasumi(const struct osmo_kasumi_key *key, uint64_t P)
+{
+	return _kasumi(P, key->KLi1, key->KLi2, key->KOi1, key->KOi2, key->KOi3,
+		       key->KIi1, key->KIi2, key->KIi3);
+}
+
 /* if cl is not multiple of 8 (a byte), co needs to be sized on the upper bound so the entire byte can be written. */
 void _kasumi_kgcore(uint8_t CA, uint8_t cb, uint32_t cc, uint8_t cd, const uint8_t *ck, uint8_t *co, uint16_t cl)
 {
@@ -0,0 +1,496 @@
+/*! \file kasumi_batch_impl.h
+ * Bit-sliced KASUMI KGCORE keystream generation for GEA3/GEA4, common
+ * implementation.
+ *
+ * Each bit of the 64 bit KASUMI block and of the 128 bit key is kept in
+ * its own KB_SLICE_T, whose bit 'l' belongs to the frame in lane 'l', so
+ * that one pass encrypts the next block of every lane. The S-boxes S7 and
+ * S9 are computed from their equations in TS 135 202 section 4.5 (the
+ * algebraic normal form of the tables in kasumi.c) instead of looked up,
+ * and the key schedule is a mere selection and rotation of key slices.
+ * The including file defines:
+ *
+ *   KB_SLICE_T	type of a slice, a GCC vector of KB_LANES / 64 uint64_t,
+ *		which supports the C bitwise and shift operators
+ *   KB_LANES	number of bits (frames) in a slice, a multiple of 64
+ *   KB_MIN_ACTIVE	number of busy lanes below which a pass is slower than
+ *		ciphering their frames with osmo_kasumi() one by one
+ *   KB_SFX	suffix of the generated function names
+ */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#define _KB_NAME(name, sfx)	osmo_gea_##name##_##sfx
+#define KB_NAME(name, sfx)	_KB_NAME(name, sfx)
+
+/* Slices of one KASUMI key: bit b of 16 bit key word w (big endian, as
+ * in _kasumi_key_expand()) in k[w * 16 + b], and the same of the key
+ * XORed with the constants C in kp[] (K' of TS 135 202 section 4.4) */
+struct KB_NAME(key, KB_SFX) {
+	KB_SLICE_T k[128];
+	KB_SLICE_T kp[128];
+};
+
+/* bit b of key word w rotated left by r */
+#define KB_ROL(k, w, r, b)	((k)[((w) & 7) * 16 + (((b) - (r)) & 15)])
+
+/* Big endian load of 8 bytes, like osmo_load64be() but as one load */
+static inline uint64_t KB_NAME(load64be, KB_SFX)(const uint8_t *p)
+{
+	uint64_t x;
+
+	memcpy(&x, p, sizeof(x));
+#if OSMO_IS_LITTLE_ENDIAN == 1
+	x = ((uint64_t)osmo_swab32(x) << 32) | osmo_swab32(x >> 32);
+#endif
+	return x;
+}
+
+/* XOR 8 bytes with a big endian value, like osmo_store64be() of their
+ * osmo_load64be() XOR x */
+static inline void KB_NAME(xor64be, KB_SFX)(uint8_t *p, uint64_t x)
+{
+	uint64_t y;
+
+	memcpy(&y, p, sizeof(y));
+#if OSMO_IS_LITTLE_ENDIAN == 1
+	x = ((uint64_t)osmo_swab32(x) << 32) | osmo_swab32(x >> 32);
+#endif
+	y ^= x;
+	memcpy(p, &y, sizeof(y));
+}
+
+/* Transpose the 64x64 bit matrix in each 64 bit word of 64 slices: bit j of
+ * word q of a[i] becomes bit i of word q of a[j]. Converts between slices
+ * and one 64 bit value per lane, that of lane 'l' in word l / 64 of a[l % 64] */
+static void KB_NAME(transpose, KB_SFX)(KB_SLICE_T a[64])
+{
+	uint64_t m = 0x00000000ffffffffULL;
+	KB_SLICE_T t;
+	unsigned int j, k;
+
+	for (j = 32; j != 0; j >>= 1, m ^= m << j) {
+		for (k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+			t = ((a[k] >> j) ^ a[k | j]) & m;
+			a[k] ^= t << j;
+			a[k | j] ^= t;
+		}
+	}
+}
+
+/* S7 of TS 135 202 section 4.5.2, y = S7(x) */
+static inline void KB_NAME(s7, KB_SFX)(KB_SLICE_T y[7], const KB_SLICE_T x[7])
+{
+	KB_SLICE_T x13, x25, x06, x16, x36, x01, x014, x34, x345, x24, x246, x15, x156, x45, x456,
+		   x04, x12, x125, x03, x035, x02, x026, x23, x26, x46, x124, x034, x025, x016, x14, x05,
+		   x012, x015, x235, x145, x136, x56, x234, x135, x045, x036, x123, x024, x126, x346,
+		   x256, x35, x013, x236, x146, x056;
+
+	x13 = x[1] & x[3];
+	x25 = x[2] & x[5];
+	x06 = x[0] & x[6];
+	x16 = x[1] & x[6];
+	x36 = x[3] & x[6];
+	x01 = x[0] & x[1];
+	x014 = x01 & x[4];
+	x34 = x[3] & x[4];
+	x345 = x34 & x[5];
+	x24 = x[2] & x[4];
+	x246 = x24 & x[6];
+	x15 = x[1] & x[5];
+	x156 = x15 & x[6];
+	x45 = x[4] & x[5];
+	x456 = x45 & x[6];
+	x04 = x[0] & x[4];
+	x12 = x[1] & x[2];
+	x125 = x12 & x[5];
+	x03 = x[0] & x[3];
+	x035 = x03 & x[5];
+	x02 = x[0] & x[2];
+	x026 = x02 & x[6];
+	x23 = x[2] & x[3];
+	x26 = x[2] & x[6];
+	x46 = x[4] & x[6];
+	x124 = x12 & x[4];
+	x034 = x03 & x[4];
+	x025 = x02 & x[5];
+	x016 = x01 & x[6];
+	x14 = x[1] & x[4];
+	x05 = x[0] & x[5];
+	x012 = x01 & x[2];
+	x015 = x01 & x[5];
+	x235 = x23 & x[5];
+	x145 = x14 & x[5];
+	x136 = x13 & x[6];
+	x56 = x[5] & x[6];
+	x234 = x23 & x[4];
+	x135 = x13 & x[5];
+	x045 = x04 & x[5];
+	x036 = x03 & x[6];
+	x123 = x12 & x[3];
+	x024 = x02 & x[4];
+	x126 = x12 & x[6];
+	x346 = x34 & x[6];
+	x256 = x25 & x[6];
+	x35 = x[3] & x[5];
+	x013 = x01 & x[3];
+	x236 = x23 & x[6];
+	x146 = x14 & x[6];
+	x056 = x05 & x[6];
+
+	y[0] = x[4] ^ x[5] ^ x[6] ^ x13 ^ x25 ^ x06 ^ x16 ^ x36 ^ x014 ^ x345 ^ x246 ^ x156 ^
+	       x456;
+	y[1] = ~(x[5] ^ x[6] ^ x01 ^ x04 ^ x24 ^ x36 ^ x125 ^ x035 ^ x026 ^ x456);
+	y[2] = ~(x[0] ^ x03 ^ x23 ^ x15 ^ x06 ^ x26 ^ x46 ^ x124 ^ x034 ^ x025 ^ x016);
+	y[3] = x[1] ^ x14 ^ x34 ^ x05 ^ x26 ^ x012 ^ x015 ^ x235 ^ x145 ^ x136;
+	y[4] = ~(x[3] ^ x02 ^ x13 ^ x14 ^ x05 ^ x16 ^ x36 ^ x56 ^ x014 ^ x234 ^ x135 ^ x045 ^
+	       x036);
+	y[5] = ~(x[2] ^ x02 ^ x03 ^ x05 ^ x25 ^ x45 ^ x16 ^ x123 ^ x024 ^ x126 ^ x036 ^ x346 ^
+	       x256);
+	y[6] = x[6] ^ x12 ^ x04 ^ x15 ^ x35 ^ x013 ^ x016 ^ x236 ^ x146 ^ x056;
+}
+
+/* S9 of TS 135 202 section 4.5.3, y = S9(x) */
+static inline void KB_NAME(s9, KB_SFX)(KB_SLICE_T y[9], const KB_SLICE_T x[9])
+{
+	KB_SLICE_T x02, x25, x56, x07, x17, x27, x48, x58, x78, x01, x23, x04, x14, x05, x35, x03,
+		   x34, x26, x36, x47, x57, x67, x08, x12, x24, x06, x16, x18, x13, x28, x38, x45, x37,
+		   x68, x15, x46;
+
+	x02 = x[0] & x[2];
+	x25 = x[2] & x[5];
+	x56 = x[5] & x[6];
+	x07 = x[0] & x[7];
+	x17 = x[1] & x[7];
+	x27 = x[2] & x[7];
+	x48 = x[4] & x[8];
+	x58 = x[5] & x[8];
+	x78 = x[7] & x[8];
+	x01 = x[0] & x[1];
+	x23 = x[2] & x[3];
+	x04 = x[0] & x[4];
+	x14 = x[1] & x[4];
+	x05 = x[0] & x[5];
+	x35 = x[3] & x[5];
+	x03 = x[0] & x[3];
+	x34 = x[3] & x[4];
+	x26 = x[2] & x[6];
+	x36 = x[3] & x[6];
+	x47 = x[4] & x[7];
+	x57 = x[5] & x[7];
+	x67 = x[6] & x[7];
+	x08 = x[0] & x[8];
+	x12 = x[1] & x[2];
+	x24 = x[2] & x[4];
+	x06 = x[0] & x[6];
+	x16 = x[1] & x[6];
+	x18 = x[1] & x[8];
+	x13 = x[1] & x[3];
+	x28 = x[2] & x[8];
+	x38 = x[3] & x[8];
+	x45 = x[4] & x[5];
+	x37 = x[3] & x[7];
+	x68 = x[6] & x[8];
+	x15 = x[1] & x[5];
+	x46 = x[4] & x[6];
+
+	y[0] = ~(x[3] ^ x02 ^ x25 ^ x56 ^ x07 ^ x17 ^ x27 ^ x48 ^ x58 ^ x78);
+	y[1] = ~(x[1] ^ x[6] ^ x01 ^ x23 ^ x04 ^ x14 ^ x05 ^ x35 ^ x17 ^ x27 ^ x58);
+	y[2] = ~(x[1] ^ x[8] ^ x03 ^ x34 ^ x05 ^ x26 ^ x36 ^ x56 ^ x47 ^ x57 ^ x67 ^ x08);
+	y[3] = x[0] ^ x[5] ^ x12 ^ x03 ^ x24 ^ x06 ^ x16 ^ x47 ^ x08 ^ x18 ^ x78;
+	y[4] = x[4] ^ x01 ^ x13 ^ x05 ^ x36 ^ x07 ^ x67 ^ x18 ^ x28 ^ x38;
+	y[5] = ~(x[2] ^ x14 ^ x45 ^ x06 ^ x16 ^ x37 ^ x47 ^ x67 ^ x58 ^ x68 ^ x78);
+	y[6] = x[0] ^ x[7] ^ x23 ^ x15 ^ x25 ^ x45 ^ x36 ^ x46 ^ x56 ^ x18 ^ x38 ^ x58 ^ x78;
+	y[7] = ~(x[3] ^ x[8] ^ x01 ^ x02 ^ x12 ^ x03 ^ x23 ^ x45 ^ x26 ^ x36 ^ x27 ^ x57);
+	y[8] = x[2] ^ x[7] ^ x01 ^ x12 ^ x34 ^ x15 ^ x25 ^ x16 ^ x46 ^ x28 ^ x38;
+}
+
+/* Function FI on 16 slices, see kasumi_FI() */
+static inline void KB_NAME(fi, KB_SFX)(KB_SLICE_T x[16], const KB_SLICE_T *ki)
+{
+	KB_SLICE_T l[9], r[7], y[9];
+	unsigned int j;
+
+	/* 9 bit left and 7 bit right half */
+	for (j = 0; j < 9; j++)
+		l[j] = x[7 + j];
+	for (j = 0; j < 7; j++)
+		r[j] = x[j];
+
+	KB_NAME(s9, KB_SFX)(y, l);
+	for (j = 0; j < 7; j++)
+		l[j] = y[j] ^ r[j];
+	l[7] = y[7];
+	l[8] = y[8];
+	KB_NAME(s7, KB_SFX)(y, r);
+	for (j = 0; j < 7; j++)
+		r[j] = y[j] ^ l[j];
+
+	for (j = 0; j < 9; j++)
+		l[j] ^= ki[j];
+	for (j = 0; j < 7; j++)
+		r[j] ^= ki[9 + j];
+
+	KB_NAME(s9, KB_SFX)(y, l);
+	for (j = 0; j < 7; j++)
+		l[j] = y[j] ^ r[j];
+	l[7] = y[7];
+	l[8] = y[8];
+	KB_NAME(s7, KB_SFX)(y, r);
+	for (j = 0; j < 7; j++)
+		r[j] = y[j] ^ l[j];
+
+	for (j = 0; j < 9; j++)
+		x[j] = l[j];
+	for (j = 0; j < 7; j++)
+		x[9 + j] = r[j];
+}
+
+/* Function FO of round i on 32 slices (left half in x[16..31]), see kasumi_FO() */
+static inline void KB_NAME(fo, KB_SFX)(KB_SLICE_T x[32], const struct KB_NAME(key, KB_SFX) *key, unsigned int i)
+{
+	KB_SLICE_T *l = &x[16], *r = &x[0], t;
+	unsigned int b;
+
+	for (b = 0; b < 16; b++)
+		l[b] ^= KB_ROL(key->k, i + 1, 5, b);		/* KOi1 */
+	KB_NAME(fi, KB_SFX)(l, &key->kp[((i + 4) & 7) * 16]);	/* KIi1 */
+	for (b = 0; b < 16; b++)
+		l[b] ^= r[b];
+
+	for (b = 0; b < 16; b++)
+		r[b] ^= KB_ROL(key->k, i + 5, 8, b);		/* KOi2 */
+	KB_NAME(fi, KB_SFX)(r, &key->kp[((i + 3) & 7) * 16]);	/* KIi2 */
+	for (b = 0; b < 16; b++)
+		r[b] ^= l[b];
+
+	for (b = 0; b < 16; b++)
+		l[b] ^= KB_ROL(key->k, i + 6, 13, b);		/* KOi3 */
+	KB_NAME(fi, KB_SFX)(l, &key->kp[((i + 7) & 7) * 16]);	/* KIi3 */
+	for (b = 0; b < 16; b++)
+		l[b] ^= r[b];
+
+	/* swap the halves */
+	for (b = 0; b < 16; b++) {
+		t = l[b];
+		l[b] = r[b];
+		r[b] = t;
+	}
+}
+
+/* Function FL of round i on 32 slices (left half in x[16..31]), see kasumi_FL() */
+static inline void KB_NAME(fl, KB_SFX)(KB_SLICE_T x[32], const struct KB_NAME(key, KB_SFX) *key, unsigned int i)
+{
+	KB_SLICE_T *l = &x[16], *r = &x[0], t[16];
+	unsigned int b;
+
+	for (b = 0; b < 16; b++)
+		t[b] = l[b] & KB_ROL(key->k, i, 1, b);		/* KLi1 */
+	for (b = 0; b < 16; b++)
+		r[b] ^= t[(b + 15) & 15];
+	for (b = 0; b < 16; b++)
+		t[b] = r[b] | key->kp[((i + 2) & 7) * 16 + b];	/* KLi2 */
+	for (b = 0; b < 16; b++)
+		l[b] ^= t[(b + 15) & 15];
+}
+
+/* KASUMI on 64 slices (left half in p[32..63]), see _kasumi() */
+static void KB_NAME(kasumi, KB_SFX)(KB_SLICE_T p[64], const struct KB_NAME(key, KB_SFX) *key)
+{
+	KB_SLICE_T *l = &p[32], *r = &p[0], t[32];
+	unsigned int i, b;
+
+	for (i = 0; i < 8; i += 2) {
+		/* odd round */
+		memcpy(t, l, sizeof(t));
+		KB_NAME(fl, KB_SFX)(t, key, i);
+		KB_NAME(fo, KB_SFX)(t, key, i);
+		for (b = 0; b < 32; b++)
+			r[b] ^= t[b];
+		/* even round */
+		memcpy(t, r, sizeof(t));
+		KB_NAME(fo, KB_SFX)(t, key, i + 1);
+		KB_NAME(fl, KB_SFX)(t, key, i + 1);
+		for (b = 0; b < 32; b++)
+			l[b] ^= t[b];
+	}
+}
+
+/* Transpose the keys CK of the frames in the lanes */
+static void KB_NAME(load_key, KB_SFX)(struct KB_NAME(key, KB_SFX) *key,
+				      const struct osmo_gea_batch_req * const lane[KB_LANES])
+{
+	static const uint16_t C[] = { 0x0123, 0x4567, 0x89AB, 0xCDEF, 0xFEDC, 0xBA98, 0x7654, 0x3210 };
+	uint64_t v[64][KB_LANES / 64];
+	KB_SLICE_T s[64], ones;
+	unsigned int l, half, w, b;
+
+	memset(&ones, 0xff, sizeof(ones));
+	for (half = 0; half < 2; half++) {
+		memset(v, 0, sizeof(v));
+		for (l = 0; l < KB_LANES; l++) {
+			if (lane[l])
+				v[l % 64][l / 64] = KB_NAME(load64be, KB_SFX)(&lane[l]->ctx->key[half * 8]);
+		}
+		memcpy(s, v, sizeof(s));
+		KB_NAME(transpose, KB_SFX)(s);
+		/* key word w is bits 48 - 16 * w .. 63 - 16 * w of its half */
+		for (w = 0; w < 4; w++) {
+			for (b = 0; b < 16; b++) {
+				key->k[(half * 4 + w) * 16 + b] = s[48 - 16 * w + b];
+				key->kp[(half * 4 + w) * 16 + b] = s[48 - 16 * w + b];
+				if ((C[half * 4 + w] >> b) & 1)
+					key->kp[(half * 4 + w) * 16 + b] ^= ones;
+			}
+		}
+	}
+}
+
+/* XOR the key slices of the lanes in 'mask' with KM = 0x55..55, to switch
+ * them between CK and the modified key of the preliminary round */
+static void KB_NAME(key_xor_km, KB_SFX)(struct KB_NAME(key, KB_SFX) *key, KB_SLICE_T mask)
+{
+	unsigned int i;
+
+	for (i = 0; i < 128; i += 2) {
+		key->k[i] ^= mask;
+		key->kp[i] ^= mask;
+	}
+}
+
+/*! Cipher/decipher frames in place, up to KB_LANES at a time
+ *
+ * Every lane runs the preliminary round of its frame and then ciphers it
+ * block by block, one per pass, and takes the next frame of \a req when
+ * done, so that frames of different lengths keep all lanes busy. Once
+ * fewer than KB_MIN_ACTIVE lanes are left, the rest of their frames are
+ * ciphered one by one.
+ */
+__attribute__ ((visibility("hidden")))
+void KB_NAME(batch, KB_SFX)(const struct osmo_gea_batch_req *req, unsigned int num)
+{
+	const struct osmo_gea_batch_req *lane[KB_LANES];
+	uint64_t a[KB_LANES], blk[KB_LANES], v[64][KB_LANES / 64], fm[KB_LANES / 64], x;
+	uint16_t pos[KB_LANES];
+	bool first[KB_LANES];
+	struct KB_NAME(key, KB_SFX) key;
+	KB_SLICE_T p[64], mask;
+	unsigned int l, j, left, next = 0, active = 0, n_first;
+	bool key_changed = false;
+	uint8_t *data;
+
+	memset(lane, 0, sizeof(lane));
+
+	while (true) {
+		/* give idle lanes the next frames */
+		for (l = 0; l < KB_LANES && next < num; l++) {
+			if (lane[l])
+				continue;
+			while (next < num && req[next].len == 0)
+				next++;
+			if (next == num)
+				break;
+			lane[l] = &req[next++];
+			/* register A of TS 55.216 section 3.2, CA = 0xff, cb = 0, see osmo_gea_xor() */
+			a[l] = ((uint64_t)lane[l]->iv << 32) | (0xffULL << 16) |
+			       ((uint64_t)(lane[l]->direction << 2) << 24);
+			blk[l] = 0;
+			pos[l] = 0;
+			first[l] = true;
+			active++;
+			key_changed = true;
+		}
+
+		if (active < KB_MIN_ACTIVE)
+			break;
+
+		if (key_changed) {
+			KB_NAME(load_key, KB_SFX)(&key, lane);
+			key_changed = false;
+		}
+
+		/* A = KASUMI[CK XOR KM](A) in the first pass of a frame,
+		 * BLKm = KASUMI[CK](A XOR BLKCNT XOR BLKm-1) in the others */
+		memset(v, 0, sizeof(v));
+		memset(fm, 0, sizeof(fm));
+		n_first = 0;
+		for (l = 0; l < KB_LANES; l++) {
+			if (!lane[l])
+				continue;
+			if (first[l]) {
+				v[l % 64][l / 64] = a[l];
+				fm[l / 64] |= 1ULL << (l % 64);
+				n_first++;
+			} else {
+				v[l % 64][l / 64] = a[l] ^ (pos[l] / 8) ^ blk[l];
+			}
+		}
+		memcpy(p, v, sizeof(p));
+		memcpy(&mask, fm, sizeof(mask));
+		KB_NAME(transpose, KB_SFX)(p);
+		if (n_first)
+			KB_NAME(key_xor_km, KB_SFX)(&key, mask);
+		KB_NAME(kasumi, KB_SFX)(p, &key);
+		if (n_first)
+			KB_NAME(key_xor_km, KB_SFX)(&key, mask);
+		KB_NAME(transpose, KB_SFX)(p);
+		memcpy(v, p, sizeof(v));
+
+		for (l = 0; l < KB_LANES; l++) {
+			if (!lane[l])
+				continue;
+			x = v[l % 64][l / 64];
+			if (first[l]) {
+				a[l] = x;
+				first[l] = false;
+				continue;
+			}
+			blk[l] = x;
+			data = &lane[l]->data[pos[l]];
+			left = lane[l]->len - pos[l];
+			if (left > 8) {
+				KB_NAME(xor64be, KB_SFX)(data, x);
+				pos[l] += 8;
+				continue;
+			}
+			for (j = 0; j < left; j++)
+				data[j] ^= x >> (56 - 8 * j);
+			lane[l] = NULL;
+			active--;
+		}
+	}
+
+	/* the remaining blocks of the last frames */
+	for (l = 0; l < KB_LANES && active > 0; l++) {
+		if (!lane[l])
+			continue;
+		if (first[l])
+			a[l] = osmo_kasumi(&lane[l]->ctx->ck_km, a[l]);
+		x = blk[l];
+		while (true) {
+			x = osmo_kasumi(&lane[l]->ctx->ck, a[l] ^ (pos[l] / 8) ^ x);
+			data = &lane[l]->data[pos[l]];
+			left = lane[l]->len - pos[l];
+			if (left <= 8)
+				break;
+			KB_NAME(xor64be, KB_SFX)(data, x);
+			pos[l] += 8;
+		}
+		for (j = 0; j < left; j++)
+			data[j] ^= x >> (56 - 8 * j);
+		active--;
+	}
+}
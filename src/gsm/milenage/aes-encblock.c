@@ -30,11 +30,9 @@
  */
 int aes_128_encrypt_block(const u8 *key, const u8 *in, u8 *out)
 {
-	void *ctx;
-	ctx = aes_encrypt_init(key, 16);
-	if (ctx == NULL)
-		return -1;
-	aes_encrypt(ctx, in, out);
-	aes_encrypt_deinit(ctx);
+	struct aes_128_enc_key k;
+	aes_128_enc_key_setup(&k, key);
+	aes_128_encrypt_blocks(&k, in, out, 1);
+	aes_128_enc_key_clear(&k);
 	return 0;
 }
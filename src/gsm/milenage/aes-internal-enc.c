@@ -24,6 +24,7 @@
  * See README and COPYING for more details.
  */
 
+#include "config.h"
 #include "includes.h"
 
 #include "common.h"
@@ -122,3 +123,84 @@ void aes_encrypt_deinit(void *ctx)
 	os_memset(ctx, 0, AES_PRIV_SIZE);
 	os_free(ctx);
 }
+
+
+/* Fastest backend of this CPU, detected on the first key setup */
+static int aes_128_backend = -1;
+
+static int aes_128_detect_backend(void)
+{
+	int backend = AES_BACKEND_PORTABLE;
+
+#if defined(HAVE_AESNI) && defined(HAVE___BUILTIN_CPU_SUPPORTS)
+	if (__builtin_cpu_supports("aes") && __builtin_cpu_supports("sse2"))
+		backend = AES_BACKEND_AESNI;
+#ifdef HAVE_VAES
+	if (backend == AES_BACKEND_AESNI && __builtin_cpu_supports("vaes")
+	    && __builtin_cpu_supports("avx2"))
+		backend = AES_BACKEND_VAES;
+#endif
+#endif
+	return backend;
+}
+
+/**
+ * aes_128_enc_key_setup - Expand an AES-128 key for aes_128_encrypt_blocks()
+ * @key: Expanded key (output)
+ * @k: Key for AES (16 bytes)
+ */
+void aes_128_enc_key_setup(struct aes_128_enc_key *key, const u8 *k)
+{
+	if (aes_128_backend < 0)
+		aes_128_backend = aes_128_detect_backend();
+
+	key->backend = aes_128_backend;
+	switch (key->backend) {
+#ifdef HAVE_AESNI
+	case AES_BACKEND_AESNI:
+	case AES_BACKEND_VAES:
+		aes_ni_128_key_setup(key->rk, k);
+		break;
+#endif
+	default:
+		rijndaelKeySetupEnc(key->rk, k);
+		break;
+	}
+}
+
+/**
+ * aes_128_encrypt_blocks - Encrypt blocks with an expanded AES-128 key
+ * @key: Key from aes_128_enc_key_setup()
+ * @in: Input blocks (16 bytes each)
+ * @out: Output blocks, may be the same as @in
+ * @num: Number of blocks
+ */
+void aes_128_encrypt_blocks(const struct aes_128_enc_key *key, const u8 *in,
+			    u8 *out, size_t num)
+{
+	switch (key->backend) {
+#ifdef HAVE_VAES
+	case AES_BACKEND_VAES:
+		aes_vaes_128_encrypt_blocks(key->rk, in, out, num);
+		break;
+#endif
+#ifdef HAVE_AESNI
+	case AES_BACKEND_AESNI:
+		aes_ni_128_encrypt_blocks(key->rk, in, out, num);
+		break;
+#endif
+	default:
+		for (; num > 0; num--, in += 16, out += 16)
+			rijndaelEncrypt(key->rk, in, out);
+		break;
+	}
+}
+
+/**
+ * aes_128_enc_key_clear - Wipe an expanded AES-128 key
+ * @key: Key from aes_128_enc_key_setup()
+ */
+void aes_128_enc_key_clear(struct aes_128_enc_key *key)
+{
+	os_memset(key->rk, 0, sizeof(key->rk));
+}
@@ -0,0 +1,102 @@
+/*! \file aes-ni.c
+ * AES-128 encryption for architectures with AES-NI support. */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+#include "common.h"
+#include "aes_i.h"
+
+static inline __m128i key_expand(__m128i k, __m128i kg)
+{
+	kg = _mm_shuffle_epi32(kg, 0xff);
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+	k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+	return _mm_xor_si128(k, kg);
+}
+
+/* The round constant is an immediate operand of AESKEYGENASSIST */
+#define KEY_EXP(rk, i, rcon) \
+	rk[i] = key_expand(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+/*! Expand an AES-128 key into the 11 round keys used by the AES-NI code
+ *  \param[out] rk Round keys, 16 byte aligned
+ *  \param[in] k Key (16 bytes)
+ */
+__attribute__ ((visibility("hidden")))
+void aes_ni_128_key_setup(u32 rk[44], const u8 *k)
+{
+	__m128i *r = (__m128i *) rk;
+
+	r[0] = _mm_loadu_si128((const __m128i *) k);
+	KEY_EXP(r, 1, 0x01);
+	KEY_EXP(r, 2, 0x02);
+	KEY_EXP(r, 3, 0x04);
+	KEY_EXP(r, 4, 0x08);
+	KEY_EXP(r, 5, 0x10);
+	KEY_EXP(r, 6, 0x20);
+	KEY_EXP(r, 7, 0x40);
+	KEY_EXP(r, 8, 0x80);
+	KEY_EXP(r, 9, 0x1b);
+	KEY_EXP(r, 10, 0x36);
+}
+
+/*! Encrypt blocks with round keys from aes_ni_128_key_setup()
+ *  \param[in] rk Round keys, 16 byte aligned
+ *  \param[in] in Input blocks (16 bytes each)
+ *  \param[out] out Output blocks, may be the same as \a in
+ *  \param[in] num Number of blocks
+ *
+ * Four blocks are encrypted at once, to hide the latency of AESENC.
+ */
+__attribute__ ((visibility("hidden")))
+void aes_ni_128_encrypt_blocks(const u32 rk[44], const u8 *in, u8 *out, size_t num)
+{
+	const __m128i *r = (const __m128i *) rk;
+	__m128i b0, b1, b2, b3;
+	int i;
+
+	for (; num >= 4; num -= 4, in += 64, out += 64) {
+		b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &in[0]), r[0]);
+		b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &in[16]), r[0]);
+		b2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &in[32]), r[0]);
+		b3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) &in[48]), r[0]);
+		for (i = 1; i < 10; i++) {
+			b0 = _mm_aesenc_si128(b0, r[i]);
+			b1 = _mm_aesenc_si128(b1, r[i]);
+			b2 = _mm_aesenc_si128(b2, r[i]);
+			b3 = _mm_aesenc_si128(b3, r[i]);
+		}
+		_mm_storeu_si128((__m128i *) &out[0], _mm_aesenclast_si128(b0, r[10]));
+		_mm_storeu_si128((__m128i *) &out[16], _mm_aesenclast_si128(b1, r[10]));
+		_mm_storeu_si128((__m128i *) &out[32], _mm_aesenclast_si128(b2, r[10]));
+		_mm_storeu_si128((__m128i *) &out[48], _mm_aesenclast_si128(b3, r[10]));
+	}
+
+	for (; num > 0; num--, in += 16, out += 16) {
+		b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *) in), r[0]);
+		for (i = 1; i < 10; i++)
+			b0 = _mm_aesenc_si128(b0, r[i]);
+		_mm_storeu_si128((__m128i *) out, _mm_aesenclast_si128(b0, r[10]));
+	}
+}
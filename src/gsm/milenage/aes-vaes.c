@@ -0,0 +1,69 @@
+/*! \file aes-vaes.c
+ * AES-128 encryption of many blocks
+ * for architectures with VAES and AVX2 support (two blocks per register). */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#include <immintrin.h>
+
+#include "common.h"
+#include "aes_i.h"
+
+/*! Encrypt blocks with round keys from aes_ni_128_key_setup()
+ *  \param[in] rk Round keys, 16 byte aligned
+ *  \param[in] in Input blocks (16 bytes each)
+ *  \param[out] out Output blocks, may be the same as \a in
+ *  \param[in] num Number of blocks
+ *
+ * Eight blocks are encrypted at once in four 256 bit registers, the
+ * remaining ones by aes_ni_128_encrypt_blocks().
+ */
+__attribute__ ((visibility("hidden")))
+void aes_vaes_128_encrypt_blocks(const u32 rk[44], const u8 *in, u8 *out, size_t num)
+{
+	const __m128i *r = (const __m128i *) rk;
+	__m256i k[11], b0, b1, b2, b3;
+	int i;
+
+	if (num >= 8) {
+		for (i = 0; i < 11; i++)
+			k[i] = _mm256_broadcastsi128_si256(r[i]);
+	}
+
+	for (; num >= 8; num -= 8, in += 128, out += 128) {
+		b0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) &in[0]), k[0]);
+		b1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) &in[32]), k[0]);
+		b2 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) &in[64]), k[0]);
+		b3 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) &in[96]), k[0]);
+		for (i = 1; i < 10; i++) {
+			b0 = _mm256_aesenc_epi128(b0, k[i]);
+			b1 = _mm256_aesenc_epi128(b1, k[i]);
+			b2 = _mm256_aesenc_epi128(b2, k[i]);
+			b3 = _mm256_aesenc_epi128(b3, k[i]);
+		}
+		_mm256_storeu_si256((__m256i *) &out[0], _mm256_aesenclast_epi128(b0, k[10]));
+		_mm256_storeu_si256((__m256i *) &out[32], _mm256_aesenclast_epi128(b1, k[10]));
+		_mm256_storeu_si256((__m256i *) &out[64], _mm256_aesenclast_epi128(b2, k[10]));
+		_mm256_storeu_si256((__m256i *) &out[96], _mm256_aesenclast_epi128(b3, k[10]));
+	}
+
+	if (num > 0)
+		aes_ni_128_encrypt_blocks(rk, in, out, num);
+}
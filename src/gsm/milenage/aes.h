@@ -25,3 +25,16 @@ void aes_encrypt_deinit(void *ctx);
 void * aes_decrypt_init(const u8 *key, size_t len);
 void aes_decrypt(void *ctx, const u8 *crypt, u8 *plain);
 void aes_decrypt_deinit(void *ctx);
+
+/* Expanded AES-128 encryption key, kept by the caller to encrypt many
+ * blocks without repeating the key expansion. The layout of the round
+ * keys depends on the backend picked at key setup. */
+struct aes_128_enc_key {
+	u32 rk[44] __attribute__ ((aligned(16)));
+	int backend;
+};
+
+void aes_128_enc_key_setup(struct aes_128_enc_key *key, const u8 *k);
+void aes_128_encrypt_blocks(const struct aes_128_enc_key *key, const u8 *in,
+			    u8 *out, size_t num);
+void aes_128_enc_key_clear(struct aes_128_enc_key *key);
@@ -119,4 +119,16 @@ static inline u32 rotr(u32 val, int bits)
 
 #define AES_PRIV_SIZE (4 * 44)
 
+/* Backends of struct aes_128_enc_key, see aes-internal-enc.c */
+enum aes_128_backend {
+	AES_BACKEND_PORTABLE = 0,
+	AES_BACKEND_AESNI,
+	AES_BACKEND_VAES,
+};
+
+/* See aes-ni.c and aes-vaes.c */
+void aes_ni_128_key_setup(u32 rk[44], const u8 *k);
+void aes_ni_128_encrypt_blocks(const u32 rk[44], const u8 *in, u8 *out, size_t num);
+void aes_vaes_128_encrypt_blocks(const u32 rk[44], const u8 *in, u8 *out, size_t num);
+
 void rijndaelKeySetupEnc(u32 rk[/*44*/], const u8 cipherKey[]);
@@ -27,6 +27,7 @@
 #include "includes.h"
 
 #include "common.h"
+#include "aes.h"
 #include "aes_wrap.h"
 #include "milenage.h"
 #include <osmocom/crypt/auth.h>
@@ -45,14 +46,16 @@
 int milenage_f1(const u8 *opc, const u8 *k, const u8 *_rand,
 		const u8 *sqn, const u8 *amf, u8 *mac_a, u8 *mac_s)
 {
+	struct aes_128_enc_key key;
 	u8 tmp1[16], tmp2[16], tmp3[16];
 	int i;
 
+	aes_128_enc_key_setup(&key, k);
+
 	/* tmp1 = TEMP = E_K(RAND XOR OP_C) */
 	for (i = 0; i < 16; i++)
 		tmp1[i] = _rand[i] ^ opc[i];
-	if (aes_128_encrypt_block(k, tmp1, tmp1))
-		return -1;
+	aes_128_encrypt_blocks(&key, tmp1, tmp1, 1);
 
 	/* tmp2 = IN1 = SQN || AMF || SQN || AMF */
 	os_memcpy(tmp2, sqn, 6);
@@ -70,8 +73,8 @@ int milenage_f1(const u8 *opc, const u8 *k, const u8 *_rand,
 	/* XOR with c1 (= ..00, i.e., NOP) */
 
 	/* f1 || f1* = E_K(tmp3) XOR OP_c */
-	if (aes_128_encrypt_block(k, tmp3, tmp1))
-		return -1;
+	aes_128_encrypt_blocks(&key, tmp3, tmp1, 1);
+	aes_128_enc_key_clear(&key);
 	for (i = 0; i < 16; i++)
 		tmp1[i] ^= opc[i];
 	if (mac_a)
@@ -97,14 +100,16 @@ int milenage_f1(const u8 *opc, const u8 *k, const u8 *_rand,
 int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		   u8 *res, u8 *ck, u8 *ik, u8 *ak, u8 *akstar)
 {
+	struct aes_128_enc_key key;
 	u8 tmp1[16], tmp2[16], tmp3[16];
 	int i;
 
+	aes_128_enc_key_setup(&key, k);
+
 	/* tmp2 = TEMP = E_K(RAND XOR OP_C) */
 	for (i = 0; i < 16; i++)
 		tmp1[i] = _rand[i] ^ opc[i];
-	if (aes_128_encrypt_block(k, tmp1, tmp2))
-		return -1;
+	aes_128_encrypt_blocks(&key, tmp1, tmp2, 1);
 
 	/* OUT2 = E_K(rot(TEMP XOR OP_C, r2) XOR c2) XOR OP_C */
 	/* OUT3 = E_K(rot(TEMP XOR OP_C, r3) XOR c3) XOR OP_C */
@@ -117,8 +122,7 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		tmp1[i] = tmp2[i] ^ opc[i];
 	tmp1[15] ^= 1; /* XOR c2 (= ..01) */
 	/* f5 || f2 = E_K(tmp1) XOR OP_c */
-	if (aes_128_encrypt_block(k, tmp1, tmp3))
-		return -1;
+	aes_128_encrypt_blocks(&key, tmp1, tmp3, 1);
 	for (i = 0; i < 16; i++)
 		tmp3[i] ^= opc[i];
 	if (res)
@@ -132,8 +136,7 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		for (i = 0; i < 16; i++)
 			tmp1[(i + 12) % 16] = tmp2[i] ^ opc[i];
 		tmp1[15] ^= 2; /* XOR c3 (= ..02) */
-		if (aes_128_encrypt_block(k, tmp1, ck))
-			return -1;
+		aes_128_encrypt_blocks(&key, tmp1, ck, 1);
 		for (i = 0; i < 16; i++)
 			ck[i] ^= opc[i];
 	}
@@ -144,8 +147,7 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		for (i = 0; i < 16; i++)
 			tmp1[(i + 8) % 16] = tmp2[i] ^ opc[i];
 		tmp1[15] ^= 4; /* XOR c4 (= ..04) */
-		if (aes_128_encrypt_block(k, tmp1, ik))
-			return -1;
+		aes_128_encrypt_blocks(&key, tmp1, ik, 1);
 		for (i = 0; i < 16; i++)
 			ik[i] ^= opc[i];
 	}
@@ -156,12 +158,12 @@ int milenage_f2345(const u8 *opc, const u8 *k, const u8 *_rand,
 		for (i = 0; i < 16; i++)
 			tmp1[(i + 4) % 16] = tmp2[i] ^ opc[i];
 		tmp1[15] ^= 8; /* XOR c5 (= ..08) */
-		if (aes_128_encrypt_block(k, tmp1, tmp1))
-			return -1;
+		aes_128_encrypt_blocks(&key, tmp1, tmp1, 1);
 		for (i = 0; i < 6; i++)
 			akstar[i] = tmp1[i] ^ opc[i];
 	}
 
+	aes_128_enc_key_clear(&key);
 	return 0;
 }
 
@@ -183,25 +185,103 @@ void milenage_generate(const u8 *opc, const u8 *amf, const u8 *k,
 		       const u8 *sqn, const u8 *_rand, u8 *autn, u8 *ik,
 		       u8 *ck, u8 *res, size_t *res_len)
 {
-	int i;
-	u8 mac_a[8], ak[6];
+	u8 ik_buf[16], ck_buf[16], res_buf[8];
+	struct milenage_vec v = {
+		._rand = _rand,
+		.sqn = sqn,
+		.autn = autn,
+		.ik = ik ? : ik_buf,
+		.ck = ck ? : ck_buf,
+		.res = res ? : res_buf,
+	};
 
 	if (*res_len < 8) {
 		*res_len = 0;
 		return;
 	}
-	if (milenage_f1(opc, k, _rand, sqn, amf, mac_a, NULL) ||
-	    milenage_f2345(opc, k, _rand, res, ck, ik, ak, NULL)) {
-		*res_len = 0;
-		return;
-	}
+	milenage_generate_batch(opc, amf, k, &v, 1);
 	*res_len = 8;
+}
 
-	/* AUTN = (SQN ^ AK) || AMF || MAC */
-	for (i = 0; i < 6; i++)
-		autn[i] = sqn[i] ^ ak[i];
-	os_memcpy(autn + 6, amf, 2);
-	os_memcpy(autn + 8, mac_a, 8);
+
+/* Vectors per pass of milenage_generate_batch(), i.e. 8 blocks for TEMP and
+ * 32 for OUT1..OUT4, so that a wide AES backend gets full batches */
+#define MILENAGE_BATCH	8
+
+/**
+ * milenage_generate_batch - Generate AKA AUTN,IK,CK,RES of several vectors
+ * @opc: OPc = 128-bit operator variant algorithm configuration field (encr.)
+ * @amf: AMF = 16-bit authentication management field
+ * @k: K = 128-bit subscriber key
+ * @v: Vectors: SQN and RAND, and the buffers for AUTN, IK, CK and RES (8 bytes)
+ * @num: Number of vectors
+ *
+ * Same as calling milenage_generate() for each vector, but the key is only
+ * expanded once and the AES blocks of several vectors are encrypted in one
+ * call, which lets the AES-NI/VAES backends work on independent blocks.
+ */
+void milenage_generate_batch(const u8 *opc, const u8 *amf, const u8 *k,
+			     struct milenage_vec *v, size_t num)
+{
+	u8 temp[MILENAGE_BATCH][16], out[MILENAGE_BATCH][4][16];
+	struct aes_128_enc_key key;
+	size_t n, j;
+	int i;
+
+	aes_128_enc_key_setup(&key, k);
+
+	for (; num > 0; num -= n, v += n) {
+		n = num < MILENAGE_BATCH ? num : MILENAGE_BATCH;
+
+		/* TEMP = E_K(RAND XOR OP_C) */
+		for (j = 0; j < n; j++) {
+			for (i = 0; i < 16; i++)
+				temp[j][i] = v[j]._rand[i] ^ opc[i];
+		}
+		aes_128_encrypt_blocks(&key, temp[0], temp[0], n);
+
+		/* The inputs of OUT1..OUT4, see milenage_f1() and milenage_f2345() */
+		for (j = 0; j < n; j++) {
+			u8 in1[16];
+
+			/* IN1 = SQN || AMF || SQN || AMF */
+			os_memcpy(in1, v[j].sqn, 6);
+			os_memcpy(in1 + 6, amf, 2);
+			os_memcpy(in1 + 8, in1, 8);
+			for (i = 0; i < 16; i++) {
+				out[j][0][(i + 8) % 16] = in1[i] ^ opc[i];
+				out[j][1][i] = temp[j][i] ^ opc[i];
+				out[j][2][(i + 12) % 16] = temp[j][i] ^ opc[i];
+				out[j][3][(i + 8) % 16] = temp[j][i] ^ opc[i];
+			}
+			for (i = 0; i < 16; i++)
+				out[j][0][i] ^= temp[j][i];
+			out[j][1][15] ^= 1; /* XOR c2 (= ..01) */
+			out[j][2][15] ^= 2; /* XOR c3 (= ..02) */
+			out[j][3][15] ^= 4; /* XOR c4 (= ..04) */
+		}
+		aes_128_encrypt_blocks(&key, out[0][0], out[0][0], 4 * n);
+
+		for (j = 0; j < n; j++) {
+			for (i = 0; i < 16; i++) {
+				out[j][0][i] ^= opc[i];
+				out[j][1][i] ^= opc[i];
+				v[j].ck[i] = out[j][2][i] ^ opc[i]; /* f3 */
+				v[j].ik[i] = out[j][3][i] ^ opc[i]; /* f4 */
+			}
+			os_memcpy(v[j].res, out[j][1] + 8, 8); /* f2 */
+
+			/* AUTN = (SQN ^ AK) || AMF || MAC */
+			for (i = 0; i < 6; i++)
+				v[j].autn[i] = v[j].sqn[i] ^ out[j][1][i]; /* f5 */
+			os_memcpy(v[j].autn + 6, amf, 2);
+			os_memcpy(v[j].autn + 8, out[j][0], 8); /* f1 */
+		}
+	}
+
+	aes_128_enc_key_clear(&key);
+	os_memset(temp, 0, sizeof(temp));
+	os_memset(out, 0, sizeof(out));
 }
 
 
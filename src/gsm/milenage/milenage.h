@@ -18,9 +18,21 @@
 
 #pragma once
 
+/* One vector of milenage_generate_batch() */
+struct milenage_vec {
+	const u8 *_rand;
+	const u8 *sqn;
+	u8 *autn;
+	u8 *ik;
+	u8 *ck;
+	u8 *res;
+};
+
 void milenage_generate(const u8 *opc, const u8 *amf, const u8 *k,
 		       const u8 *sqn, const u8 *_rand, u8 *autn, u8 *ik,
 		       u8 *ck, u8 *res, size_t *res_len);
+void milenage_generate_batch(const u8 *opc, const u8 *amf, const u8 *k,
+			     struct milenage_vec *v, size_t num);
 int milenage_auts(const u8 *opc, const u8 *k, const u8 *_rand, const u8 *auts,
 		  u8 *sqn);
 int gsm_milenage(const u8 *opc, const u8 *k, const u8 *_rand, u8 *sres,
@@ -443,6 +443,96 @@ int tlv_parse2(struct tlv_parsed *dec, int dec_multiples,
 	return num_parsed;
 }
 
+/* Store an IE in a \ref tlv_parsed_sparse, unless the tag is already present */
+static int tlvps_add(struct tlv_parsed_sparse *dec, uint8_t tag, uint16_t len, const uint8_t *val)
+{
+	unsigned int idx;
+
+	if (TLVPS_PRESENT(dec, tag))
+		return 0;
+	if (dec->num >= ARRAY_SIZE(dec->ie))
+		return OSMO_TLVP_ERR_TOO_MANY_IES;
+
+	idx = dec->num++;
+	dec->idx[tag] = idx;
+	dec->tag[idx] = tag;
+	dec->ie[idx].val = val;
+	dec->ie[idx].len = len;
+	dec->present[tag / 64] |= 1ULL << (tag % 64);
+	return 0;
+}
+
+/*! Like tlv_parse(), but store the result in a compact \ref tlv_parsed_sparse.
+ * Only the presence bitmap needs to be cleared before parsing, instead of all
+ * 256 entries of a \ref tlv_parsed, which makes this the cheaper choice for
+ * parsing messages on hot paths. In case of multiple occurences of an IE, keep
+ * only the first occurence.
+ *  \param[out] dec caller-allocated pointer to \ref tlv_parsed_sparse
+ *  \param[in] def structure defining the valid TLV tags / configurations
+ *  \param[in] buf the input data buffer to be parsed
+ *  \param[in] buf_len length of the input data buffer
+ *  \param[in] lv_tag an initial LV tag at the start of the buffer
+ *  \param[in] lv_tag2 a second initial LV tag following the \a lv_tag
+ *  \returns number of TLV entries parsed; negative in case of error, e.g.
+ *	      OSMO_TLVP_ERR_TOO_MANY_IES if there are more than
+ *	      TLV_PARSED_SPARSE_MAX_IE different IEs
+ */
+int tlv_parse_sparse(struct tlv_parsed_sparse *dec, const struct tlv_definition *def,
+		     const uint8_t *buf, int buf_len, uint8_t lv_tag, uint8_t lv_tag2)
+{
+	const uint8_t lv_tags[] = { lv_tag, lv_tag2 };
+	int ofs = 0, num_parsed = 0;
+	const uint8_t *val;
+	uint16_t len;
+	unsigned int i;
+	uint8_t tag;
+	int rc;
+
+	memset(dec->present, 0, sizeof(dec->present));
+	dec->num = 0;
+
+	for (i = 0; i < ARRAY_SIZE(lv_tags); i++) {
+		if (!lv_tags[i])
+			continue;
+		if (ofs >= buf_len)
+			return OSMO_TLVP_ERR_OFS_BEYOND_BUFFER;
+		val = &buf[ofs+1];
+		len = buf[ofs];
+		if (ofs + len + 1 > buf_len)
+			return OSMO_TLVP_ERR_OFS_LEN_BEYOND_BUFFER;
+		rc = tlvps_add(dec, lv_tags[i], len, val);
+		if (rc < 0)
+			return rc;
+		num_parsed++;
+		ofs += len + 1;
+	}
+
+	while (ofs < buf_len) {
+		rc = tlv_parse_one(&tag, &len, &val, def, &buf[ofs], buf_len-ofs);
+		if (rc < 0)
+			return rc;
+		ofs += rc;
+		rc = tlvps_add(dec, tag, len, val);
+		if (rc < 0)
+			return rc;
+		num_parsed++;
+	}
+	return num_parsed;
+}
+
+/*! Convert a \ref tlv_parsed_sparse to a \ref tlv_parsed, to pass the result
+ *  of tlv_parse_sparse() to functions that have not been converted yet.
+ *  \param[out] dst caller-allocated \ref tlv_parsed, overwritten completely
+ *  \param[in] src result of tlv_parse_sparse() */
+void tlv_parsed_sparse_to_full(struct tlv_parsed *dst, const struct tlv_parsed_sparse *src)
+{
+	unsigned int i;
+
+	memset(dst, 0, sizeof(*dst));
+	for (i = 0; i < src->num; i++)
+		dst->lv[src->tag[i]] = src->ie[i];
+}
+
 /*! take a master (src) tlv_definition and fill up all empty slots in 'dst'
  *  \param dst TLV parser definition that is to be patched
  *  \param[in] src TLV parser definition whose content is patched into \a dst */
@@ -0,0 +1,97 @@
+/*! \file KeccakP-1600-times4-avx2.c
+ * Keccak-f[1600] permutation of four independent states at once
+ * for architectures with AVX2 support (one state per 64 bit lane). */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include "config.h"
+
+#include <immintrin.h>
+
+/* Round constants of the Iota step, see Iota[] in KeccakP-1600-3gpp.c */
+static const uint64_t keccak_rc[24] = {
+	0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+	0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+	0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+	0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+	0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+	0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+	0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+	0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL,
+};
+
+/* Rotation offsets of the Rho step, lane x + 5 * y */
+static const uint8_t keccak_rho[25] = {
+	0, 1, 62, 28, 27, 36, 44, 6, 55, 20, 3, 10, 43, 25, 39,
+	41, 45, 15, 21, 8, 18, 2, 61, 56, 14,
+};
+
+/* Destination of lane x + 5 * y in the Pi step: y + 5 * ((2 * x + 3 * y) % 5) */
+static const uint8_t keccak_pi[25] = {
+	0, 10, 20, 5, 15, 16, 1, 11, 21, 6, 7, 17, 2, 12, 22,
+	23, 8, 18, 3, 13, 14, 24, 9, 19, 4,
+};
+
+static inline __m256i rol64(__m256i x, unsigned int n)
+{
+	return _mm256_or_si256(_mm256_sllv_epi64(x, _mm256_set1_epi64x(n)),
+			       _mm256_srlv_epi64(x, _mm256_set1_epi64x(64 - n)));
+}
+
+/*! Apply Keccak-f[1600] to four states
+ *  \param[inout] s States, lane i of state l in s[i][l], 32 byte aligned
+ *
+ * Same as calling Keccak_f_64() on each state.
+ */
+__attribute__ ((visibility("hidden")))
+void Keccak_f_64_x4(uint64_t s[25][4])
+{
+	__m256i a[25], b[25], c[5], d;
+	unsigned int round, x, y, i;
+
+	for (i = 0; i < 25; i++)
+		a[i] = _mm256_load_si256((const __m256i *) s[i]);
+
+	for (round = 0; round < 24; round++) {
+		/* Theta */
+		for (x = 0; x < 5; x++)
+			c[x] = _mm256_xor_si256(_mm256_xor_si256(a[x], a[x + 5]),
+						_mm256_xor_si256(_mm256_xor_si256(a[x + 10], a[x + 15]), a[x + 20]));
+		for (x = 0; x < 5; x++) {
+			d = _mm256_xor_si256(c[(x + 4) % 5], rol64(c[(x + 1) % 5], 1));
+			for (y = 0; y < 25; y += 5)
+				a[x + y] = _mm256_xor_si256(a[x + y], d);
+		}
+
+		/* Rho and Pi */
+		for (i = 0; i < 25; i++)
+			b[keccak_pi[i]] = rol64(a[i], keccak_rho[i]);
+
+		/* Chi */
+		for (y = 0; y < 25; y += 5) {
+			for (x = 0; x < 5; x++)
+				a[x + y] = _mm256_xor_si256(b[x + y], _mm256_andnot_si256(b[(x + 1) % 5 + y],
+											  b[(x + 2) % 5 + y]));
+		}
+
+		/* Iota */
+		a[0] = _mm256_xor_si256(a[0], _mm256_set1_epi64x(keccak_rc[round]));
+	}
+
+	for (i = 0; i < 25; i++)
+		_mm256_store_si256((__m256i *) s[i], a[i]);
+}
@@ -19,10 +19,12 @@
 #include <string.h>
 #include <string.h>
 #include <errno.h>
+#include "config.h"
 
 #include <osmocom/core/utils.h>
 
 #include "KeccakP-1600-3gpp.h"
+#include "tuak.h"
 
 /* TUAK authentication algorithm
  * as proposed by 3GPP as an alternative to Milenage
@@ -51,9 +53,15 @@ void memcpy_reverse(uint8_t *dst, const uint8_t *src, size_t len)
 		dst[i] = src[len-i-1];
 }
 
-static void tuak_core(uint8_t buf[200], const uint8_t *opc, uint8_t instance, const uint8_t *_rand,
-		      const uint8_t *amf, const uint8_t *sqn, const uint8_t *k, uint8_t k_len_bytes,
-		      unsigned int keccac_iterations)
+#ifdef HAVE_AVX2
+/* See KeccakP-1600-times4-avx2.c */
+void Keccak_f_64_x4(uint64_t s[25][4]);
+static int keccak_avx2_supported = -1;
+#endif
+
+/* fill the Keccak input of one TUAK function into 'buf' */
+static void tuak_fill(uint8_t buf[200], const uint8_t *opc, uint8_t instance, const uint8_t *_rand,
+		      const uint8_t *amf, const uint8_t *sqn, const uint8_t *k, uint8_t k_len_bytes)
 {
 	unsigned int idx = 0;
 
@@ -70,11 +78,61 @@ static void tuak_core(uint8_t buf[200], const uint8_t *opc, uint8_t instance, co
 	buf[idx++] = 0x80;
 	memset(buf+idx, 0, 64); idx += 64;
 	OSMO_ASSERT(idx == 200);
+}
+
+static void tuak_core(uint8_t buf[200], const uint8_t *opc, uint8_t instance, const uint8_t *_rand,
+		      const uint8_t *amf, const uint8_t *sqn, const uint8_t *k, uint8_t k_len_bytes,
+		      unsigned int keccac_iterations)
+{
+	tuak_fill(buf, opc, instance, _rand, amf, sqn, k, k_len_bytes);
 
 	for (unsigned int i = 0; i < keccac_iterations; i++)
 		Keccak_f_64((uint64_t *) buf);
 }
 
+/* apply the Keccak permutation 'keccac_iterations' times to each of 'num'
+ * independent states, four at a time if the CPU supports AVX2 */
+static void keccak_multi(uint64_t (*s)[25], unsigned int num, unsigned int keccac_iterations)
+{
+	unsigned int i = 0;
+
+#ifdef HAVE_AVX2
+	if (OSMO_UNLIKELY(keccak_avx2_supported < 0)) {
+#ifdef HAVE___BUILTIN_CPU_SUPPORTS
+		keccak_avx2_supported = __builtin_cpu_supports("avx2");
+#else
+		keccak_avx2_supported = 0;
+#endif
+	}
+
+	if (keccak_avx2_supported) {
+		uint64_t x4[25][4] __attribute__ ((aligned(32)));
+		unsigned int n, l, j, it;
+
+		/* with two states, the four lanes are still faster than two scalar calls */
+		for (; num - i >= 2; i += n) {
+			n = OSMO_MIN(num - i, 4);
+			memset(x4, 0, sizeof(x4));
+			for (l = 0; l < n; l++) {
+				for (j = 0; j < 25; j++)
+					x4[j][l] = s[i + l][j];
+			}
+			for (it = 0; it < keccac_iterations; it++)
+				Keccak_f_64_x4(x4);
+			for (l = 0; l < n; l++) {
+				for (j = 0; j < 25; j++)
+					s[i + l][j] = x4[j][l];
+			}
+		}
+	}
+#endif
+
+	for (; i < num; i++) {
+		for (unsigned int it = 0; it < keccac_iterations; it++)
+			Keccak_f_64(s[i]);
+	}
+}
+
 /**
  * tuak_f1 - TUAK f1 algorithm
  * @opc: OPc = 256-bit value derived from OP and K
@@ -322,6 +380,90 @@ void tuak_generate(const uint8_t *opc, const uint8_t *amf, const uint8_t *k, uin
 }
 
 
+/* Vectors per pass of tuak_generate_batch(), two Keccak states each */
+#define TUAK_BATCH	8
+
+/**
+ * tuak_generate_batch - Generate AKA AUTN,IK,CK,RES of several vectors
+ * @opc: OPc = 256-bit operator variant algorithm configuration field (encr.)
+ * @amf: AMF = 16-bit authentication management field
+ * @k: K = 128/256-bit subscriber key
+ * @v: Vectors: SQN and RAND, the buffers for AUTN, IK and CK (16 bytes) and
+ *     RES (res_len = 4, 8, 16 or 32 bytes)
+ * @num: Number of vectors
+ * Returns: 0 on success, -EINVAL on invalid key or RES length
+ *
+ * Same as calling tuak_generate() for each vector, but the f1 and f2345
+ * permutations of all vectors are computed together, which lets the AVX2
+ * code work on four independent states.
+ */
+int tuak_generate_batch(const uint8_t *opc, const uint8_t *amf, const uint8_t *k, uint8_t k_len_bytes,
+			struct tuak_vec *v, size_t num)
+{
+	uint64_t s[2 * TUAK_BATCH][25];
+	uint8_t instance_k, instance_res, ak[6];
+	size_t n, j;
+	int i;
+
+	switch (k_len_bytes) {
+	case 16:
+		instance_k = 0x00;
+		break;
+	case 32:
+		instance_k = 0x01;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	for (j = 0; j < num; j++) {
+		switch (v[j].res_len) {
+		case 4:
+		case 8:
+		case 16:
+		case 32:
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	for (; num > 0; num -= n, v += n) {
+		n = OSMO_MIN(num, TUAK_BATCH);
+
+		for (j = 0; j < n; j++) {
+			/* see tuak_f1() and tuak_f2345(): 64 bit MAC-A, 128 bit CK and IK */
+			instance_res = v[j].res_len == 4 ? 0x00 : v[j].res_len;
+			tuak_fill((uint8_t *) s[2 * j], opc, 0x08 | instance_k, v[j]._rand, amf,
+				  v[j].sqn, k, k_len_bytes);
+			tuak_fill((uint8_t *) s[2 * j + 1], opc, 0x40 | instance_res | instance_k,
+				  v[j]._rand, zero16, zero16, k, k_len_bytes);
+		}
+
+		keccak_multi(s, 2 * n, g_keccak_iterations);
+
+		for (j = 0; j < n; j++) {
+			const uint8_t *f1 = (const uint8_t *) s[2 * j];
+			const uint8_t *f2345 = (const uint8_t *) s[2 * j + 1];
+
+			memcpy_reverse(v[j].res, f2345, v[j].res_len);
+			memcpy_reverse(v[j].ck, f2345 + 32, 16);
+			memcpy_reverse(v[j].ik, f2345 + 64, 16);
+			memcpy_reverse(ak, f2345 + 96, 6);
+
+			/* AUTN = (SQN ^ AK) || AMF || MAC */
+			for (i = 0; i < 6; i++)
+				v[j].autn[i] = v[j].sqn[i] ^ ak[i];
+			memcpy(v[j].autn + 6, amf, 2);
+			memcpy_reverse(v[j].autn + 8, f1, 8);
+		}
+	}
+
+	memset(s, 0, sizeof(s));
+	return 0;
+}
+
+
 /**
  * tuak_auts - Milenage AUTS validation
  * @opc: OPc = 256-bit operator variant algorithm configuration field (encr.)
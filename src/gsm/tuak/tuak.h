@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 
 /* low-level functions */
 
@@ -27,6 +28,20 @@ void tuak_generate(const uint8_t *opc, const uint8_t *amf, const uint8_t *k, uin
 		   const uint8_t *sqn, const uint8_t *_rand, uint8_t *autn, uint8_t *ik,
 		   uint8_t *ck, uint8_t *res, size_t *res_len);
 
+/* One vector of tuak_generate_batch() */
+struct tuak_vec {
+	const uint8_t *_rand;
+	const uint8_t *sqn;
+	uint8_t *autn;
+	uint8_t *ik;
+	uint8_t *ck;
+	uint8_t *res;
+	uint8_t res_len;
+};
+
+int tuak_generate_batch(const uint8_t *opc, const uint8_t *amf, const uint8_t *k, uint8_t k_len_bytes,
+			struct tuak_vec *v, size_t num);
+
 int tuak_auts(const uint8_t *opc, const uint8_t *k, uint8_t k_len_bytes,
 	      const uint8_t *_rand, const uint8_t *auts, uint8_t *sqn);
 
@@ -206,6 +206,9 @@ void install_node(struct cmd_node *node, int (*func) (struct vty *))
 	install_basic_node_commands(node->node);
 }
 
+static void cmd_trie_invalidate(int ntype);
+static struct cmd_trie *cmd_trie_get(int ntype);
+
 /* Compare two command's string.  Used in sort_node (). */
 static int cmp_node(const void *p, const void *q)
 {
@@ -223,7 +226,8 @@ static int cmp_desc(const void *p, const void *q)
 	return strcmp(a->cmd, b->cmd);
 }
 
-/*! Sort each node's command element according to command string. */
+/*! Sort each node's command element according to command string, and compile the commands of each node into the
+ * trie used to match input lines against them. */
 void sort_node(void)
 {
 	unsigned int i, j;
@@ -250,6 +254,9 @@ void sort_node(void)
 					      vector_active(descvec),
 					      sizeof(void *), cmp_desc);
 				}
+
+			cmd_trie_invalidate(i);
+			cmd_trie_get(i);
 		}
 }
 
@@ -1008,6 +1015,8 @@ void install_element(int ntype, struct cmd_element *cmd)
 
 	cmd->strvec = cmd_make_descvec(cmd->string, cmd->doc);
 	cmd->cmdsize = cmd_cmdsize(cmd->strvec);
+
+	cmd_trie_invalidate(ntype);
 }
 
 /*! Install a library command into a node
@@ -1929,6 +1938,239 @@ free_and_return:
 	return ret;
 }
 
+/* Compiled index of the commands of one node: a prefix trie over the keywords of the commands. The commands of a
+ * trie node are those whose first words are keywords (or optional keywords) equal to the path to the trie node, in
+ * the order of the node's cmd_vector. Walking the trie along an input line replaces the cmd_filter() and
+ * is_cmd_ambiguous() passes for the words that are matched by a keyword alone; the remaining words are still checked
+ * by these, but only against the commands of the trie node reached. */
+struct cmd_trie {
+	/*! commands matching the path to this trie node */
+	struct cmd_element **cmds;
+	unsigned int num_cmds;
+	/*! child trie nodes by the keyword at the next word, sorted by keyword */
+	struct cmd_trie_edge *edges;
+	unsigned int num_edges;
+};
+
+struct cmd_trie_edge {
+	const char *keyword;
+	struct cmd_trie *child;
+};
+
+/* one keyword of one command at a given word, while building a trie node */
+struct cmd_trie_kw {
+	const char *keyword;
+	unsigned int cmd_idx;
+};
+
+/* Root trie node of each node, by node type; NULL until built by cmd_trie_get() or sort_node(). */
+static vector cmd_tries;
+
+static int cmp_trie_kw(const void *p, const void *q)
+{
+	const struct cmd_trie_kw *a = p;
+	const struct cmd_trie_kw *b = q;
+	int rc = strcmp(a->keyword, b->keyword);
+
+	if (rc)
+		return rc;
+	return (a->cmd_idx > b->cmd_idx) - (a->cmd_idx < b->cmd_idx);
+}
+
+/* Return what an input word needs to equal for cmd_match() to return EXACT_MATCH for the command word str, or NULL if
+ * str is an argument. */
+static const char *cmd_trie_keyword(void *ctx, const char *str)
+{
+	if (CMD_OPTION(str)) {
+		str = cmd_deopt(ctx, str);
+		if (!str)
+			return NULL;
+	}
+	if (!*str || CMD_VARARG(str) || CMD_VARIABLE(str))
+		return NULL;
+	return str;
+}
+
+/* Build the trie node for the given commands (taking ownership of the cmds array), which all match the path to the
+ * trie node up to word index depth. */
+static struct cmd_trie *cmd_trie_build(void *ctx, struct cmd_element **cmds, unsigned int num_cmds,
+				       unsigned int depth)
+{
+	struct cmd_trie *t;
+	struct cmd_trie_kw *kws;
+	unsigned int i, j, num_kws = 0;
+
+	t = talloc_zero(ctx, struct cmd_trie);
+	OSMO_ASSERT(t);
+	t->cmds = talloc_steal(t, cmds);
+	t->num_cmds = num_cmds;
+
+	/* a single command is checked quickly by cmd_filter(), there is nothing left to narrow down */
+	if (num_cmds < 2)
+		return t;
+
+	for (i = 0; i < num_cmds; i++) {
+		if (depth < vector_active(cmds[i]->strvec))
+			num_kws += vector_active((vector)vector_slot(cmds[i]->strvec, depth));
+	}
+	if (!num_kws)
+		return t;
+
+	kws = talloc_array(t, struct cmd_trie_kw, num_kws);
+	OSMO_ASSERT(kws);
+	num_kws = 0;
+	for (i = 0; i < num_cmds; i++) {
+		vector descvec;
+
+		if (depth >= vector_active(cmds[i]->strvec))
+			continue;
+		descvec = vector_slot(cmds[i]->strvec, depth);
+		for (j = 0; j < vector_active(descvec); j++) {
+			struct desc *desc = vector_slot(descvec, j);
+			const char *keyword;
+
+			if (!desc || !(keyword = cmd_trie_keyword(t, desc->cmd)))
+				continue;
+			kws[num_kws++] = (struct cmd_trie_kw){ .keyword = keyword, .cmd_idx = i };
+		}
+	}
+	qsort(kws, num_kws, sizeof(*kws), cmp_trie_kw);
+
+	for (i = 0; i < num_kws; i = j) {
+		for (j = i + 1; j < num_kws && !strcmp(kws[j].keyword, kws[i].keyword); j++);
+		t->num_edges++;
+	}
+	t->edges = talloc_zero_array(t, struct cmd_trie_edge, t->num_edges);
+	OSMO_ASSERT(t->edges || !t->num_edges);
+
+	t->num_edges = 0;
+	for (i = 0; i < num_kws; i = j) {
+		struct cmd_element **child_cmds;
+		unsigned int num_child_cmds = 0;
+
+		for (j = i + 1; j < num_kws && !strcmp(kws[j].keyword, kws[i].keyword); j++);
+
+		child_cmds = talloc_array(t, struct cmd_element *, j - i);
+		OSMO_ASSERT(child_cmds);
+		for (unsigned int k = i; k < j; k++) {
+			/* the same keyword may appear twice in one word, e.g. "(foo|[foo])" */
+			if (k > i && kws[k].cmd_idx == kws[k - 1].cmd_idx)
+				continue;
+			child_cmds[num_child_cmds++] = cmds[kws[k].cmd_idx];
+		}
+		t->edges[t->num_edges++] = (struct cmd_trie_edge){
+			.keyword = kws[i].keyword,
+			.child = cmd_trie_build(t, child_cmds, num_child_cmds, depth + 1),
+		};
+	}
+
+	talloc_free(kws);
+	return t;
+}
+
+/* Drop the trie of a node, e.g. because a command was installed into it. */
+static void cmd_trie_invalidate(int ntype)
+{
+	struct cmd_trie *t;
+
+	if (!cmd_tries || ntype >= vector_active(cmd_tries))
+		return;
+	t = vector_slot(cmd_tries, ntype);
+	if (!t)
+		return;
+	vector_slot(cmd_tries, ntype) = NULL;
+	talloc_free(t);
+}
+
+/* Return the trie of a node, building it first if needed. */
+static struct cmd_trie *cmd_trie_get(int ntype)
+{
+	vector cmd_vector = cmd_node_vector(cmdvec, ntype);
+	struct cmd_element **cmds;
+	struct cmd_trie *t;
+	unsigned int i, num_cmds = 0;
+
+	if (!cmd_tries)
+		cmd_tries = vector_init(VECTOR_MIN_SIZE);
+	t = vector_lookup_ensure(cmd_tries, ntype);
+	if (t)
+		return t;
+
+	cmds = talloc_array(tall_vty_cmd_ctx, struct cmd_element *, vector_active(cmd_vector));
+	OSMO_ASSERT(cmds || !vector_active(cmd_vector));
+	for (i = 0; i < vector_active(cmd_vector); i++) {
+		if (vector_slot(cmd_vector, i))
+			cmds[num_cmds++] = vector_slot(cmd_vector, i);
+	}
+	t = cmd_trie_build(tall_vty_cmd_ctx, cmds, num_cmds, 0);
+	talloc_set_name_const(t, "cmd_trie");
+	vector_set_index(cmd_tries, ntype, t);
+	return t;
+}
+
+/* Return the child trie node of t that the input word command selects. With partial, command may be an abbreviation
+ * of a keyword, as long as it is not one of several keywords. */
+static const struct cmd_trie *cmd_trie_step(const struct cmd_trie *t, const char *command, bool partial)
+{
+	unsigned int lo = 0, hi = t->num_edges;
+	size_t len;
+
+	/* find the first keyword that is not less than command */
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		if (strcmp(t->edges[mid].keyword, command) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == t->num_edges)
+		return NULL;
+	if (!strcmp(t->edges[lo].keyword, command))
+		return t->edges[lo].child;
+	if (!partial)
+		return NULL;
+
+	/* all keywords starting with command follow each other */
+	len = strlen(command);
+	if (strncmp(t->edges[lo].keyword, command, len))
+		return NULL;
+	if (lo + 1 < t->num_edges && !strncmp(t->edges[lo + 1].keyword, command, len))
+		return NULL;
+	return t->edges[lo].child;
+}
+
+/* Return a new vector of the commands of a node that may match vline, filtered by the first *index words of vline
+ * (at most max_words) like cmd_filter() and is_cmd_ambiguous() would, returning the number of words filtered in
+ * *index. partial selects the ANY_MATCH level, where keywords may be abbreviated, over the EXACT_MATCH level.
+ *
+ * A word is filtered via the trie if it is equal to a keyword of one of the commands left, or with partial, is the
+ * beginning of exactly one keyword. cmd_filter() would then find an exact or partial match, so that only the commands
+ * having this keyword in this word remain, and is_cmd_ambiguous() has no other keyword to find ambiguous. */
+static vector cmd_trie_filter(vector vline, unsigned int max_words, enum node_type ntype, bool partial,
+			      unsigned int *index)
+{
+	const struct cmd_trie *t = cmd_trie_get(ntype);
+	const struct cmd_trie *child;
+	vector v;
+	unsigned int i;
+
+	for (i = 0; i < max_words && i < vector_active(vline); i++) {
+		const char *command = vector_slot(vline, i);
+
+		if (!command || !(child = cmd_trie_step(t, command, partial)))
+			break;
+		t = child;
+	}
+	*index = i;
+
+	v = vector_init(t->num_cmds);
+	OSMO_ASSERT(v);
+	if (t->num_cmds)
+		memcpy(v->index, t->cmds, t->num_cmds * sizeof(t->cmds[0]));
+	v->active = t->num_cmds;
+	return v;
+}
+
 /* If src matches dst return dst string, otherwise return NULL */
 static const char *cmd_entry_function(const char *src, const char *dst)
 {
@@ -2067,15 +2309,15 @@ cmd_describe_command_real(vector vline, struct vty *vty, int *status)
 	} else
 		index = vector_active(vline) - 1;
 
-	/* Make copy vector of current node's command vector. */
-	cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	/* Make vector of current node's commands, filtered by the leading keywords. */
+	cmd_vector = cmd_trie_filter(vline, index, vty->node, true, &i);
 
 	/* Prepare match vector */
 	matchvec = vector_init(INIT_MATCHVEC_SIZE);
 
 	/* Filter commands. */
 	/* Only words precedes current word will be checked in this loop. */
-	for (i = 0; i < index; i++) {
+	for (; i < index; i++) {
 		command = vector_slot(vline, i);
 		if (!command)
 			continue;
@@ -2259,7 +2501,7 @@ static char **cmd_complete_command_real(vector vline, struct vty *vty,
 					int *status)
 {
 	unsigned int i;
-	vector cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	vector cmd_vector;
 #define INIT_MATCHVEC_SIZE 10
 	vector matchvec;
 	struct cmd_element *cmd_element;
@@ -2272,13 +2514,13 @@ static char **cmd_complete_command_real(vector vline, struct vty *vty,
 
 	if (vector_active(vline) == 0) {
 		*status = CMD_ERR_NO_MATCH;
-		vector_free(cmd_vector);
 		return NULL;
 	} else
 		index = vector_active(vline) - 1;
 
-	/* First, filter by preceeding command string */
-	for (i = 0; i < index; i++)
+	/* First, filter by preceeding command string, the leading keywords via the trie */
+	cmd_vector = cmd_trie_filter(vline, index, vty->node, true, &i);
+	for (; i < index; i++)
 		if ((command = vector_slot(vline, i))) {
 			enum match_type match;
 			int ret;
@@ -2527,10 +2769,10 @@ cmd_execute_command_real(vector vline, struct vty *vty,
 	   argv[] generation */
 	void *cmd_deopt_ctx = NULL;
 
-	/* Make copy of command elements. */
-	cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	/* Make vector of the command elements, filtered by the leading keywords. */
+	cmd_vector = cmd_trie_filter(vline, vector_active(vline), vty->node, true, &index);
 
-	for (index = 0; index < vector_active(vline); index++) {
+	for (; index < vector_active(vline); index++) {
 		if ((command = vector_slot(vline, index))) {
 			int ret;
 
@@ -2740,10 +2982,10 @@ cmd_execute_command_strict(vector vline, struct vty *vty,
 	enum match_type match = 0;
 	char *command;
 
-	/* Make copy of command element */
-	cmd_vector = vector_copy(cmd_node_vector(cmdvec, vty->node));
+	/* Make vector of the command elements, filtered by the leading keywords. */
+	cmd_vector = cmd_trie_filter(vline, vector_active(vline), vty->node, false, &index);
 
-	for (index = 0; index < vector_active(vline); index++)
+	for (; index < vector_active(vline); index++)
 		if ((command = vector_slot(vline, index))) {
 			int ret;
 
@@ -18,6 +18,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include "config.h"
 
@@ -158,6 +159,82 @@ DEFUN(show_fsm, show_fsm_cmd,
 	return CMD_SUCCESS;
 }
 
+/* print a duration in nanoseconds in a unit that fits */
+static const char *fmt_ns(char *buf, size_t buf_len, uint64_t ns)
+{
+	if (ns < 1000)
+		snprintf(buf, buf_len, "%" PRIu64 "ns", ns);
+	else if (ns < 1000000)
+		snprintf(buf, buf_len, "%.1fus", ns / 1e3);
+	else if (ns < 1000000000)
+		snprintf(buf, buf_len, "%.1fms", ns / 1e6);
+	else
+		snprintf(buf, buf_len, "%.1fs", ns / 1e9);
+	return buf;
+}
+
+static void vty_out_fsm_hist(struct vty *vty, const char *what, const struct osmo_fsm_hist *h)
+{
+	char buf1[32], buf2[32];
+	unsigned int i;
+
+	if (!h->count)
+		return;
+	vty_out(vty, "  %s: %" PRIu64 " times, avg %s, max %s%s", what, h->count,
+		fmt_ns(buf1, sizeof(buf1), h->sum_ns / h->count), fmt_ns(buf2, sizeof(buf2), h->max_ns),
+		VTY_NEWLINE);
+	for (i = 0; i < OSMO_FSM_HIST_BUCKETS; i++) {
+		if (!h->buckets[i])
+			continue;
+		if (i == OSMO_FSM_HIST_BUCKETS - 1)
+			vty_out(vty, "   >= %-8s %" PRIu64 "%s", fmt_ns(buf1, sizeof(buf1), 1ULL << (i - 1)),
+				h->buckets[i], VTY_NEWLINE);
+		else
+			vty_out(vty, "   <  %-8s %" PRIu64 "%s", fmt_ns(buf1, sizeof(buf1), 1ULL << i),
+				h->buckets[i], VTY_NEWLINE);
+	}
+}
+
+DEFUN(show_fsm_stats, show_fsm_stats_cmd,
+	"show fsm NAME statistics",
+	SH_FSM_STR
+	"Name of the finite state machine\n"
+	"Display the time spent in each state and the events dispatched in it\n")
+{
+	struct osmo_fsm *fsm;
+	unsigned int i, e;
+
+	fsm = osmo_fsm_find_by_name(argv[0]);
+	if (!fsm) {
+		vty_out(vty, "Error: FSM with name '%s' doesn't exist!%s",
+			argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	if (!osmo_fsm_state_stats(fsm, 0)) {
+		vty_out(vty, "Error: statistics are not enabled for FSM '%s'%s",
+			fsm->name, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	vty_out(vty, "FSM Name: '%s'%s", fsm->name, VTY_NEWLINE);
+	for (i = 0; i < fsm->num_states; i++) {
+		const struct osmo_fsm_state_stats *st = osmo_fsm_state_stats(fsm, i);
+
+		vty_out(vty, " State %s%s", osmo_fsm_state_name(fsm, i), VTY_NEWLINE);
+		vty_out_fsm_hist(vty, "Residency", &st->residency);
+		vty_out_fsm_hist(vty, "Action CPU time", &st->action);
+		for (e = 0; e < ARRAY_SIZE(st->events); e++) {
+			if (st->events[e])
+				vty_out(vty, "  Event %s: %" PRIu64 "%s", osmo_fsm_event_name(fsm, e),
+					st->events[e], VTY_NEWLINE);
+		}
+		if (st->rejected)
+			vty_out(vty, "  Events not permitted: %" PRIu64 "%s", st->rejected, VTY_NEWLINE);
+	}
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(show_fsm_state_graph, show_fsm_state_graph_cmd,
 	"show fsm-state-graph NAME",
 	SHOW_STR "Generate a state transition graph (using DOT language)\n"
@@ -233,6 +310,39 @@ DEFUN(show_fsm_inst, show_fsm_inst_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(show_fsm_inst_by, show_fsm_inst_by_cmd,
+	"show fsm-instances NAME (id|name) IDENT",
+	SH_FSMI_STR
+	"Name of the finite state machine\n"
+	"Look up the FSM instance by its id\n"
+	"Look up the FSM instance by its full name\n"
+	"Id or name of the FSM instance\n")
+{
+	struct osmo_fsm *fsm;
+	struct osmo_fsm_inst *fsmi;
+
+	fsm = osmo_fsm_find_by_name(argv[0]);
+	if (!fsm) {
+		vty_out(vty, "Error: FSM with name '%s' doesn't exist!%s",
+			argv[0], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	if (argv[1][0] == 'i')
+		fsmi = osmo_fsm_inst_find_by_id(fsm, argv[2]);
+	else
+		fsmi = osmo_fsm_inst_find_by_name(fsm, argv[2]);
+	if (!fsmi) {
+		vty_out(vty, "Error: FSM instance with %s '%s' doesn't exist!%s",
+			argv[1], argv[2], VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	vty_out_fsm_inst(vty, fsmi);
+
+	return CMD_SUCCESS;
+}
+
 /*! Install VTY commands for FSM introspection
  *  This installs a couple of VTY commands for introspection of FSM
  *  classes as well as FSM instances. Call this once from your
@@ -252,8 +362,10 @@ void osmo_fsm_vty_add_cmds(void)
 
 	install_lib_element_ve(&show_fsm_cmd);
 	install_lib_element_ve(&show_fsms_cmd);
+	install_lib_element_ve(&show_fsm_stats_cmd);
 	install_lib_element_ve(&show_fsm_state_graph_cmd);
 	install_lib_element_ve(&show_fsm_inst_cmd);
 	install_lib_element_ve(&show_fsm_insts_cmd);
+	install_lib_element_ve(&show_fsm_inst_by_cmd);
 	osmo_fsm_vty_cmds_installed = true;
 }
@@ -28,6 +28,7 @@
 #include <osmocom/core/utils.h>
 #include <osmocom/core/strrb.h>
 #include <osmocom/core/loggingrb.h>
+#include <osmocom/core/logging_binary.h>
 #include <osmocom/core/gsmtap.h>
 #include <osmocom/core/application.h>
 
@@ -1005,6 +1006,67 @@ DEFUN(cfg_no_log_alarms, cfg_no_log_alarms_cmd,
 	RET_WITH_UNLOCK(CMD_SUCCESS);
 }
 
+DEFUN(cfg_log_binary, cfg_log_binary_cmd,
+	"log binary FILENAME [<64-4194304>]",
+	LOG_STR "Logging to a binary file, formatted when read by osmo-log-decode\n"
+	"Filename\n" "Size of the record ring in KiB, rounded up to a power of two (default: 8192)\n")
+{
+	const char *fname = argv[0];
+	size_t size = 0;
+	struct log_target *tgt;
+
+	/* round up like log_target_create_binary() does, to compare with the size of an existing target */
+	if (argc > 1) {
+		size = 64 * 1024;
+		while (size < (size_t)atoi(argv[1]) * 1024)
+			size <<= 1;
+	}
+
+	log_tgt_mutex_lock();
+	tgt = log_target_find(LOG_TGT_TYPE_BINARY, fname);
+	if (tgt && (!size || tgt->tgt_binary.size == size)) {
+		vty->index = tgt;
+		vty->node = CFG_LOG_NODE;
+		RET_WITH_UNLOCK(CMD_SUCCESS);
+	}
+	if (tgt)
+		log_target_destroy(tgt);
+
+	tgt = log_target_create_binary(fname, size);
+	if (!tgt) {
+		vty_out(vty, "%% Unable to create binary log file '%s'%s",
+			fname, VTY_NEWLINE);
+		RET_WITH_UNLOCK(CMD_WARNING);
+	}
+	log_add_target(tgt);
+
+	vty->index = tgt;
+	vty->node = CFG_LOG_NODE;
+
+	RET_WITH_UNLOCK(CMD_SUCCESS);
+}
+
+DEFUN(cfg_no_log_binary, cfg_no_log_binary_cmd,
+	"no log binary FILENAME",
+	NO_STR LOG_STR "Logging to a binary file, formatted when read by osmo-log-decode\n"
+	"Filename\n")
+{
+	const char *fname = argv[0];
+	struct log_target *tgt;
+
+	log_tgt_mutex_lock();
+	tgt = log_target_find(LOG_TGT_TYPE_BINARY, fname);
+	if (!tgt) {
+		vty_out(vty, "%% No such binary log file '%s'%s",
+			fname, VTY_NEWLINE);
+		RET_WITH_UNLOCK(CMD_WARNING);
+	}
+
+	log_target_destroy(tgt);
+
+	RET_WITH_UNLOCK(CMD_SUCCESS);
+}
+
 static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 {
 	char level_buf[128];
@@ -1047,6 +1109,10 @@ static int config_write_log_single(struct vty *vty, struct log_target *tgt)
 			tgt->sd_journal.raw ? " raw" : "",
 			VTY_NEWLINE);
 		break;
+	case LOG_TGT_TYPE_BINARY:
+		vty_out(vty, "log binary %s %zu%s", tgt->tgt_binary.fname,
+			tgt->tgt_binary.size / 1024, VTY_NEWLINE);
+		break;
 	}
 
 	vty_out(vty, " logging filter all %u%s",
@@ -1265,6 +1331,8 @@ void logging_vty_add_cmds(void)
 	install_lib_element(CONFIG_NODE, &cfg_no_log_file_cmd);
 	install_lib_element(CONFIG_NODE, &cfg_log_alarms_cmd);
 	install_lib_element(CONFIG_NODE, &cfg_no_log_alarms_cmd);
+	install_lib_element(CONFIG_NODE, &cfg_log_binary_cmd);
+	install_lib_element(CONFIG_NODE, &cfg_no_log_binary_cmd);
 #ifdef HAVE_SYSLOG_H
 	install_lib_element(CONFIG_NODE, &cfg_log_syslog_cmd);
 	install_lib_element(CONFIG_NODE, &cfg_log_syslog_local_cmd);
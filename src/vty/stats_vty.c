@@ -34,6 +34,7 @@
 #include <osmocom/core/counter.h>
 #include <osmocom/core/rate_ctr.h>
 #include <osmocom/core/stats_tcp.h>
+#include <osmocom/core/stats_shm.h>
 
 #define CFG_STATS_STR "Configure stats sub-system\n"
 #define CFG_REPORTER_STR "Configure a stats reporter\n"
@@ -417,6 +418,43 @@ DEFUN(cfg_tcp_stats_batch_size, cfg_tcp_stats_batch_size_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_stats_shm_file, cfg_stats_shm_file_cmd,
+	"stats-shm file PATH",
+	CFG_STATS_STR "Export all counters and stat items to a shared memory file\n"
+	"Path of the file, e.g. /dev/shm/NAME\n")
+{
+	int rc;
+
+	if (osmo_stats_shm_config->path && !strcmp(osmo_stats_shm_config->path, argv[0]))
+		return CMD_SUCCESS;
+
+	rc = osmo_stats_shm_open(argv[0]);
+	if (rc < 0) {
+		vty_out(vty, "%% Unable to export stats to '%s': %s%s",
+			argv[0], strerror(-rc), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_no_stats_shm_file, cfg_no_stats_shm_file_cmd,
+	"no stats-shm file",
+	NO_STR CFG_STATS_STR "Stop exporting to a shared memory file and remove it\n")
+{
+	osmo_stats_shm_close();
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_stats_shm_interval, cfg_stats_shm_interval_cmd,
+	"stats-shm interval <0-3600000>",
+	CFG_STATS_STR "Set the shared memory file update interval\n"
+	"Interval in milliseconds (0 disables the update interval)\n")
+{
+	osmo_stats_shm_set_interval(atoi(argv[0]));
+	return CMD_SUCCESS;
+}
+
 DEFUN(show_stats,
       show_stats_cmd,
       "show stats [skip-zero]",
@@ -730,6 +768,10 @@ static int config_write_stats(struct vty *vty)
 		vty_out(vty, "stats-tcp interval %d%s", osmo_tcp_stats_config->interval, VTY_NEWLINE);
 	if (osmo_tcp_stats_config->batch_size != TCP_STATS_DEFAULT_BATCH_SIZE)
 		vty_out(vty, "stats-tcp batch-size %d%s", osmo_tcp_stats_config->batch_size, VTY_NEWLINE);
+	if (osmo_stats_shm_config->interval != STATS_SHM_DEFAULT_INTERVAL)
+		vty_out(vty, "stats-shm interval %u%s", osmo_stats_shm_config->interval, VTY_NEWLINE);
+	if (osmo_stats_shm_config->path)
+		vty_out(vty, "stats-shm file %s%s", osmo_stats_shm_config->path, VTY_NEWLINE);
 
 	/* Loop through all reporters */
 	llist_for_each_entry(srep, &osmo_stats_reporter_list, list)
@@ -754,6 +796,9 @@ void osmo_stats_vty_add_cmds(void)
 	install_lib_element(CONFIG_NODE, &cfg_stats_interval_cmd);
 	install_lib_element(CONFIG_NODE, &cfg_tcp_stats_interval_cmd);
 	install_lib_element(CONFIG_NODE, &cfg_tcp_stats_batch_size_cmd);
+	install_lib_element(CONFIG_NODE, &cfg_stats_shm_file_cmd);
+	install_lib_element(CONFIG_NODE, &cfg_no_stats_shm_file_cmd);
+	install_lib_element(CONFIG_NODE, &cfg_stats_shm_interval_cmd);
 
 	install_node(&cfg_stats_node, config_write_stats);
 
@@ -157,7 +157,7 @@ static int client_data(struct osmo_fd *fd, unsigned int what)
 	int rc = 0;
 
 	if (what & OSMO_FD_READ) {
-		conn->fd.when &= ~OSMO_FD_READ;
+		osmo_fd_read_disable(&conn->fd);
 		rc = vty_read(conn->vty);
 	}
 
@@ -168,7 +168,7 @@ static int client_data(struct osmo_fd *fd, unsigned int what)
 	if (what & OSMO_FD_WRITE) {
 		rc = buffer_flush_all(conn->vty->obuf, fd->fd);
 		if (rc == BUFFER_EMPTY)
-			conn->fd.when &= ~OSMO_FD_WRITE;
+			osmo_fd_write_disable(&conn->fd);
 	}
 
 	return rc;
@@ -248,10 +248,10 @@ void vty_event(enum event event, int sock, struct vty *vty)
 
 	switch (event) {
 	case VTY_READ:
-		bfd->when |= OSMO_FD_READ;
+		osmo_fd_read_enable(bfd);
 		break;
 	case VTY_WRITE:
-		bfd->when |= OSMO_FD_WRITE;
+		osmo_fd_write_enable(bfd);
 		break;
 	case VTY_CLOSED:
 		/* vty layer is about to free() vty */
@@ -0,0 +1,128 @@
+/*
+ * A5/1 and A5/2 keystream benchmark
+ *
+ * Generates the downlink and uplink keystreams of a number of bursts (one
+ * (key, frame number) pair each), once by calling osmo_a5() per burst and
+ * once through osmo_a5_batch() in batches of 32, 64 and 256 bursts, and
+ * reports bursts/s for each:
+ *
+ *   ./a5_bench -n 100000
+ *
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/a5.h>
+
+static unsigned int n_bursts = 50000;
+
+static double ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-n num_bursts]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned int batch_sizes[] = { 32, 64, 256 };
+	struct osmo_a5_batch_req *req;
+	struct timespec t_start, t_end;
+	uint8_t key[8] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef };
+	ubit_t *dl, *ul, ref_dl[114], ref_ul[114];
+	unsigned int i, j, num;
+	double ns;
+	int n, c;
+
+	while ((c = getopt(argc, argv, "n:h")) != -1) {
+		switch (c) {
+		case 'n':
+			n_bursts = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (n_bursts == 0) {
+		help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	req = calloc(n_bursts, sizeof(*req));
+	dl = malloc(n_bursts * 114);
+	ul = malloc(n_bursts * 114);
+	if (!req || !dl || !ul)
+		exit(EXIT_FAILURE);
+
+	/* consecutive frame numbers of one key, like one ciphered timeslot */
+	for (i = 0; i < n_bursts; i++) {
+		req[i].key = key;
+		req[i].fn = i;
+		req[i].dl = &dl[i * 114];
+		req[i].ul = &ul[i * 114];
+	}
+
+	for (n = 1; n <= 2; n++) {
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		for (i = 0; i < n_bursts; i++)
+			osmo_a5(n, req[i].key, req[i].fn, req[i].dl, req[i].ul);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+		ns = ts_diff_ns(&t_start, &t_end);
+		printf("A5/%d osmo_a5():              %10.0f bursts/s, %7.1f ns/burst\n",
+		       n, n_bursts * 1e9 / ns, ns / n_bursts);
+
+		for (j = 0; j < ARRAY_SIZE(batch_sizes); j++) {
+			memset(dl, 0xff, n_bursts * 114);
+			memset(ul, 0xff, n_bursts * 114);
+
+			clock_gettime(CLOCK_MONOTONIC, &t_start);
+			for (i = 0; i < n_bursts; i += num) {
+				num = OSMO_MIN(batch_sizes[j], n_bursts - i);
+				osmo_a5_batch(n, &req[i], num);
+			}
+			clock_gettime(CLOCK_MONOTONIC, &t_end);
+			ns = ts_diff_ns(&t_start, &t_end);
+			printf("A5/%d osmo_a5_batch() of %3u: %10.0f bursts/s, %7.1f ns/burst\n",
+			       n, batch_sizes[j], n_bursts * 1e9 / ns, ns / n_bursts);
+
+			/* spot check against the per-burst implementation */
+			for (i = 0; i < n_bursts; i += 997) {
+				osmo_a5(n, req[i].key, req[i].fn, ref_dl, ref_ul);
+				if (memcmp(ref_dl, req[i].dl, 114) || memcmp(ref_ul, req[i].ul, 114)) {
+					fprintf(stderr, "A5/%d: burst %u differs\n", n, i);
+					exit(EXIT_FAILURE);
+				}
+			}
+		}
+	}
+
+	free(ul);
+	free(dl);
+	free(req);
+	return EXIT_SUCCESS;
+}
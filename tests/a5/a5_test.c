@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -7,6 +8,7 @@
 #include <osmocom/core/bits.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/gsm/a5.h>
+#include <osmocom/gsm/gsm0502.h>
 
 // make compiler happy
 void _a5_3(const uint8_t *key, uint32_t fn, ubit_t *dl, ubit_t *ul, bool fn_correct);
@@ -81,6 +83,48 @@ static inline bool test_a54(const char * kc, uint32_t count, const char * block1
 	return print_a5(4, 8, "DL", dlout, block1) && print_a5(4, 8, "UL", ulout, block2);
 }
 
+/* Compare osmo_a5_batch() with osmo_a5() for each request */
+static void test_a5_batch(int n, unsigned int num)
+{
+	struct osmo_a5_batch_req *req = calloc(num, sizeof(*req));
+	uint8_t *keys = malloc(num * 16);
+	ubit_t *out = malloc(num * 2 * 114);
+	ubit_t exp_dl[114], exp_ul[114];
+	unsigned int i, j;
+
+	OSMO_ASSERT(req && keys && out);
+	for (i = 0; i < num; i++) {
+		for (j = 0; j < 16; j++)
+			keys[i * 16 + j] = rand();
+		req[i].key = &keys[i * 16];
+		req[i].fn = rand() % GSM_TDMA_HYPERFRAME;
+		/* some requests only want one direction */
+		req[i].dl = i % 5 == 3 ? NULL : &out[i * 2 * 114];
+		req[i].ul = i % 7 == 4 ? NULL : &out[i * 2 * 114 + 114];
+	}
+	memset(out, 0xaa, num * 2 * 114);
+
+	OSMO_ASSERT(osmo_a5_batch(n, req, num) == 0);
+
+	for (i = 0; i < num; i++) {
+		osmo_a5(n, req[i].key, req[i].fn, exp_dl, exp_ul);
+		if ((req[i].dl && memcmp(req[i].dl, exp_dl, 114)) ||
+		    (req[i].ul && memcmp(req[i].ul, exp_ul, 114))) {
+			printf("A5/%d batch of %u: request %u differs\n", n, num, i);
+			exit(1);
+		}
+		if (!req[i].dl)
+			OSMO_ASSERT(out[i * 2 * 114] == 0xaa);
+		if (!req[i].ul)
+			OSMO_ASSERT(out[i * 2 * 114 + 114] == 0xaa);
+	}
+	printf("A5/%d batch of %u: OK\n", n, num);
+
+	free(out);
+	free(keys);
+	free(req);
+}
+
 
 int main(int argc, char **argv)
 {
@@ -139,5 +183,13 @@ int main(int argc, char **argv)
 	test_a54("3D43C388C9581E337FF1F97EB5C1F85E", 0x35D2CF, "A2FE3034B6B22CC4E33C7090BEC340", "170D7497432FF897B91BE8AECBA880");
 	test_a54("A4496A64DF4F399F3B4506814A3E07A1", 0x212777, "89CDEE360DF9110281BCF57755A040", "33822C0C779598C9CBFC49183AF7C0");
 
+	srand(1);
+	for (n = 1; n <= 4; n++) {
+		static const unsigned int nums[] = { 0, 1, 7, 8, 64, 65, 100, 256, 300 };
+		for (i = 0; i < ARRAY_SIZE(nums); i++)
+			test_a5_batch(n, nums[i]);
+	}
+	OSMO_ASSERT(osmo_a5_batch(5, NULL, 0) == -ENOTSUP);
+
 	return 0;
 }
@@ -66,6 +66,58 @@ static int opc_test(const struct osmo_sub_auth_data *aud)
 	return rc;
 }
 
+/* Generate vectors with osmo_auth_gen_vecs2() and compare them to vectors
+ * from consecutive osmo_auth_gen_vec2() calls */
+static void gen_vecs_test(unsigned int num, int opc_is_op)
+{
+	struct osmo_sub_auth_data2 aud = {
+		.type = OSMO_AUTH_TYPE_UMTS,
+		.algo = OSMO_AUTH_ALG_MILENAGE,
+		.u.umts = {
+			.opc_len = 16,
+			.k_len = 16,
+			.amf = { 0x80, 0x00 },
+			.sqn = 0x1234,
+			.opc_is_op = opc_is_op,
+			.ind_bitlen = 5,
+			.ind = 3,
+		},
+	};
+	struct osmo_sub_auth_data2 aud_ref;
+	struct osmo_auth_vector vec[num], ref;
+	uint8_t _rand[num * 16];
+	unsigned int i, fail = 0;
+	int rc;
+
+	memcpy(aud.u.umts.opc, test_aud.u.umts.opc, 16);
+	memcpy(aud.u.umts.k, test_aud.u.umts.k, 16);
+	for (i = 0; i < sizeof(_rand); i++)
+		_rand[i] = i * 7 + 3;
+	memset(vec, 0, sizeof(vec));
+	for (i = 0; i < num; i++)
+		vec[i].res_len = i % 3 ? 8 : 4;
+	aud_ref = aud;
+
+	rc = osmo_auth_gen_vecs2(vec, num, &aud, _rand);
+	printf("osmo_auth_gen_vecs2(%u vectors, opc_is_op=%d): rc=%d, SQN = %" PRIu64 "\n",
+	       num, opc_is_op, rc, aud.u.umts.sqn);
+
+	for (i = 0; i < num; i++) {
+		memset(&ref, 0, sizeof(ref));
+		ref.res_len = vec[i].res_len;
+		rc = osmo_auth_gen_vec2(&ref, &aud_ref, &_rand[i * 16]);
+		if (rc < 0 || memcmp(&ref, &vec[i], sizeof(ref))) {
+			printf("vector %u differs:\n", i);
+			dump_auth_vec(&vec[i]);
+			dump_auth_vec(&ref);
+			fail++;
+		}
+	}
+	if (aud_ref.u.umts.sqn != aud.u.umts.sqn)
+		fail++;
+	printf("%s\n", fail ? "FAILED" : "same as osmo_auth_gen_vec2()");
+}
+
 #define RECALC_AUTS 0
 #if RECALC_AUTS
 typedef uint8_t u8;
@@ -193,6 +245,11 @@ int main(int argc, char **argv)
 
 	opc_test(&test_aud);
 
+	gen_vecs_test(1, 0);
+	gen_vecs_test(5, 0);
+	gen_vecs_test(5, 1);
+	gen_vecs_test(37, 0);
+
 	exit(0);
 
 }
@@ -296,6 +296,57 @@ static void execute_testspec(const struct tuak_testspec *tcase)
 	execute_testset(tset);
 }
 
+/* compare tuak_generate_batch() to tuak_generate() of each vector */
+static void test_generate_batch(uint8_t k_len_bytes, unsigned int keccak_iterations)
+{
+	enum { NUM = 11 };
+	const uint8_t amf[2] = { 0x80, 0x01 };
+	uint8_t k[32], opc[32], _rand[NUM][16], sqn[NUM][6];
+	uint8_t autn[NUM][16], ik[NUM][16], ck[NUM][16], res[NUM][32];
+	uint8_t ref_autn[16], ref_ik[16], ref_ck[16], ref_res[32];
+	struct tuak_vec v[NUM];
+	unsigned int i, j, fail = 0;
+	size_t res_len;
+	int rc;
+
+	for (i = 0; i < sizeof(k); i++) {
+		k[i] = 0xa0 + i;
+		opc[i] = 0x11 * i;
+	}
+	for (i = 0; i < NUM; i++) {
+		for (j = 0; j < 16; j++)
+			_rand[i][j] = i * 31 + j;
+		for (j = 0; j < 6; j++)
+			sqn[i][j] = j == 5 ? 0x20 + i : 0;
+		v[i] = (struct tuak_vec) {
+			._rand = _rand[i],
+			.sqn = sqn[i],
+			.autn = autn[i],
+			.ik = ik[i],
+			.ck = ck[i],
+			.res = res[i],
+			.res_len = 4 << (i % 4),
+		};
+	}
+
+	tuak_set_keccak_iterations(keccak_iterations);
+	rc = tuak_generate_batch(opc, amf, k, k_len_bytes, v, NUM);
+
+	for (i = 0; i < NUM; i++) {
+		res_len = v[i].res_len;
+		tuak_generate(opc, amf, k, k_len_bytes, sqn[i], _rand[i], ref_autn, ref_ik, ref_ck,
+			      ref_res, &res_len);
+		if (memcmp(ref_autn, autn[i], 16) || memcmp(ref_ik, ik[i], 16) ||
+		    memcmp(ref_ck, ck[i], 16) || memcmp(ref_res, res[i], v[i].res_len)) {
+			printf("\tvector %u: AUTN %s differs\n", i, osmo_hexdump_nospc(autn[i], 16));
+			fail++;
+		}
+	}
+
+	printf("==> tuak_generate_batch(%u vectors, K %u bytes, %u iterations): rc=%d, %s\n",
+	       NUM, k_len_bytes, keccak_iterations, rc, fail ? "FAILED" : "same as tuak_generate()");
+}
+
 int main(int argc, char **argv)
 {
 #if 0
@@ -306,4 +357,7 @@ int main(int argc, char **argv)
 	for (unsigned int i = 0; i < ARRAY_SIZE(testspecs); i++)
 		execute_testspec(&testspecs[i]);
 
+	test_generate_batch(16, 1);
+	test_generate_batch(32, 1);
+	test_generate_batch(16, 3);
 }
@@ -0,0 +1,121 @@
+/* test for the packed bits CRC routines */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/crcgen.h>
+#include <osmocom/core/utils.h>
+
+#define MAX_BITS	600
+
+/* The codes of TS 05.03 (see gsm0503_parity.c), plus some full width ones */
+static const struct osmo_crc8gen_code crc3 = { .bits = 3, .poly = 0x3, .init = 0x0, .remainder = 0x7 };
+static const struct osmo_crc8gen_code crc6 = { .bits = 6, .poly = 0x2f, .init = 0x00, .remainder = 0x3f };
+static const struct osmo_crc8gen_code crc8 = { .bits = 8, .poly = 0x49, .init = 0x00, .remainder = 0xff };
+static const struct osmo_crc16gen_code crc10 = { .bits = 10, .poly = 0x175, .init = 0x000, .remainder = 0x3ff };
+static const struct osmo_crc16gen_code crc12 = { .bits = 12, .poly = 0xd31, .init = 0x0, .remainder = 0xfff };
+static const struct osmo_crc16gen_code crc16 = { .bits = 16, .poly = 0x1021, .init = 0x0000, .remainder = 0xffff };
+static const struct osmo_crc32gen_code crc32 = { .bits = 32, .poly = 0x04c11db7, .init = 0xffffffff, .remainder = 0xffffffff };
+static const struct osmo_crc64gen_code crc40 = { .bits = 40, .poly = 0x0004820009ULL, .init = 0, .remainder = 0xffffffffffULL };
+static const struct osmo_crc64gen_code crc64 = {
+	.bits = 64, .poly = 0x42f0e1eba9ea3693ULL, .init = 0xffffffffffffffffULL, .remainder = 0,
+};
+
+#define CHECK_CODE(XX, name) do { \
+		struct osmo_crc##XX##gen_table tab; \
+		ubit_t ubits[MAX_BITS], crc_bits[XX]; \
+		pbit_t pbits[MAX_BITS / 8]; \
+		uint##XX##_t crc, ref; \
+		int i, len, lsb, clmul, fail = 0; \
+		osmo_crc##XX##gen_table_init(&tab, &name); \
+		for (len = 0; len <= MAX_BITS; len += 1 + len / 16) { \
+			for (lsb = 0; lsb <= 1; lsb++) { \
+				for (i = 0; i < sizeof(pbits); i++) \
+					pbits[i] = rand(); \
+				osmo_pbit2ubit_ext(ubits, 0, pbits, 0, len, lsb); \
+				ref = osmo_crc##XX##gen_compute_bits(&name, ubits, len); \
+				/* both the table and (if supported) the clmul path */ \
+				for (clmul = 0; clmul <= tab.clmul; clmul++) { \
+					struct osmo_crc##XX##gen_table t = tab; \
+					t.clmul = clmul; \
+					crc = osmo_crc##XX##gen_compute_pbits(&t, pbits, len, lsb); \
+					if (crc != ref) { \
+						printf("  len=%d lsb=%d clmul=%d: 0x%" PRIx64 " != 0x%" PRIx64 "\n", \
+						       len, lsb, clmul, (uint64_t)crc, (uint64_t)ref); \
+						fail++; \
+					} \
+					osmo_crc##XX##gen_set_pbits(&t, pbits, len, lsb, crc_bits); \
+					if (osmo_crc##XX##gen_check_pbits(&t, pbits, len, lsb, crc_bits) || \
+					    osmo_crc##XX##gen_check_bits(&name, ubits, len, crc_bits)) \
+						fail++; \
+					crc_bits[0] ^= 1; \
+					if (!osmo_crc##XX##gen_check_pbits(&t, pbits, len, lsb, crc_bits)) \
+						fail++; \
+				} \
+			} \
+		} \
+		printf("%s: %s\n", #name, fail ? "FAILED" : "all match"); \
+	} while (0)
+
+static void test_pbits_vs_bits(void)
+{
+	printf("Comparing osmo_crcXXgen_compute_pbits() to osmo_crcXXgen_compute_bits()\n");
+
+	CHECK_CODE(8, crc3);
+	CHECK_CODE(8, crc6);
+	CHECK_CODE(8, crc8);
+	CHECK_CODE(16, crc10);
+	CHECK_CODE(16, crc12);
+	CHECK_CODE(16, crc16);
+	CHECK_CODE(32, crc32);
+	CHECK_CODE(64, crc40);
+	CHECK_CODE(64, crc64);
+}
+
+static void test_known_values(void)
+{
+	/* CRC-32/BZIP2 and CRC-64/WE of "123456789" */
+	static const struct osmo_crc64gen_code crc64_we = {
+		.bits = 64, .poly = 0x42f0e1eba9ea3693ULL, .init = 0xffffffffffffffffULL,
+		.remainder = 0xffffffffffffffffULL,
+	};
+	struct osmo_crc32gen_table tab32;
+	struct osmo_crc64gen_table tab64;
+	const char *str = "123456789";
+
+	printf("Checking known CRC values\n");
+
+	osmo_crc32gen_table_init(&tab32, &crc32);
+	printf("CRC-32/BZIP2: 0x%08" PRIx32 "\n",
+	       osmo_crc32gen_compute_pbits(&tab32, (const pbit_t *)str, 72, 0));
+	osmo_crc64gen_table_init(&tab64, &crc64_we);
+	printf("CRC-64/WE: 0x%016" PRIx64 "\n",
+	       osmo_crc64gen_compute_pbits(&tab64, (const pbit_t *)str, 72, 0));
+}
+
+int main(int argc, char **argv)
+{
+	srand(1);
+	test_pbits_vs_bits();
+	test_known_values();
+	return 0;
+}
@@ -17,6 +17,74 @@ static void fill_random(ubit_t *b, int n)
 		b[i] = random() & 1;
 }
 
+#define BATCH_NUM	37
+
+/* Decode noisy codewords with every supported batch kernel and compare
+ * against decoding them one by one */
+static int do_check_batch(const struct conv_test_vector *test)
+{
+	enum osmo_conv_batch_kernel kernel, saved = osmo_conv_batch_get_kernel();
+	sbit_t *bs[BATCH_NUM];
+	ubit_t *ref[BATCH_NUM], *out[BATCH_NUM];
+	ubit_t *bu;
+	int i, j, v, rc = 0;
+
+	bu = malloc(sizeof(ubit_t) * MAX_LEN_BITS);
+
+	for (i = 0; i < BATCH_NUM; i++) {
+		bs[i] = malloc(sizeof(sbit_t) * MAX_LEN_BITS);
+		ref[i] = malloc(sizeof(ubit_t) * MAX_LEN_BITS);
+		out[i] = malloc(sizeof(ubit_t) * MAX_LEN_BITS);
+
+		fill_random(bu, test->in_len);
+		osmo_conv_encode(test->code, bu, ref[i]);
+		osmo_ubit2sbit(bs[i], ref[i], test->out_len);
+
+		/* Noise, so that the lanes take different paths */
+		for (j = 0; j < test->out_len; j++) {
+			v = bs[i][j] + (int) (random() % 301) - 150;
+			bs[i][j] = v > 127 ? 127 : v < -127 ? -127 : v;
+		}
+
+		osmo_conv_decode(test->code, bs[i], ref[i]);
+	}
+
+	for (kernel = OSMO_CONV_BATCH_SCALAR; kernel <= OSMO_CONV_BATCH_AVX512; kernel++) {
+		if (osmo_conv_batch_set_kernel(kernel) < 0)
+			continue;
+
+		for (i = 0; i < BATCH_NUM; i++)
+			memset(out[i], 0xff, MAX_LEN_BITS);
+
+		if (osmo_conv_decode_batch(test->code, (const sbit_t * const *) bs, out, BATCH_NUM) < 0) {
+			fprintf(stderr, "[!] Failed batch decoding (%s)\n",
+				osmo_conv_batch_kernel_name(kernel));
+			rc = -1;
+			continue;
+		}
+
+		for (i = 0; i < BATCH_NUM; i++) {
+			if (memcmp(ref[i], out[i], test->in_len)) {
+				fprintf(stderr, "[!] Failed batch decoding (%s): codeword %d doesn't match\n",
+					osmo_conv_batch_kernel_name(kernel), i);
+				rc = -1;
+				break;
+			}
+		}
+	}
+
+	osmo_conv_batch_set_kernel(saved);
+
+	for (i = 0; i < BATCH_NUM; i++) {
+		free(out[i]);
+		free(ref[i]);
+		free(bs[i]);
+	}
+	free(bu);
+
+	return rc;
+}
+
 int do_check(const struct conv_test_vector *test)
 {
 	ubit_t *bu0, *bu1;
@@ -132,6 +200,16 @@ int do_check(const struct conv_test_vector *test)
 		printf("OK\n");
 	}
 
+	/* Check batch decoding */
+	printf("[.] Batch decoding: ");
+
+	if (do_check_batch(test)) {
+		printf("ERROR !\n");
+		return -1;
+	}
+
+	printf("OK\n");
+
 	/* Spacing */
 	printf("\n");
 
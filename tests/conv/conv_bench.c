@@ -0,0 +1,182 @@
+/*
+ * Viterbi decoder throughput benchmark
+ *
+ * Decodes noisy GSM 05.03 codewords one by one with osmo_conv_decode()
+ * and in batches with osmo_conv_decode_batch() for every multi-codeword
+ * kernel the CPU supports, and reports blocks/s for each:
+ *
+ *   ./conv_bench -n 20000 -b 64
+ *
+ * The batch results are checked against the one-by-one decoding, so a
+ * mismatching kernel makes the benchmark fail.
+ *
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/bits.h>
+#include <osmocom/core/conv.h>
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm0503.h>
+
+#define MAX_LEN_BITS	2048
+
+static const struct {
+	const char *name;
+	const struct osmo_conv_code *code;
+} bench_codes[] = {
+	{ "xcch (K=5, N=2)", &gsm0503_xcch },
+	{ "tch_afs_12_2 (K=5, rec)", &gsm0503_tch_afs_12_2 },
+	{ "mcs1_dl_hdr (K=7, tail)", &gsm0503_mcs1_dl_hdr },
+	{ "mcs9 (K=7, N=3)", &gsm0503_mcs9 },
+};
+
+static unsigned int n_blocks = 20000;
+static unsigned int batch_size = 64;
+
+static double ts_diff_s(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static void bench_code(const char *name, const struct osmo_conv_code *code)
+{
+	enum osmo_conv_batch_kernel kernel;
+	struct timespec t_start, t_end;
+	sbit_t **bs;
+	ubit_t **ref, **out;
+	ubit_t bu[MAX_LEN_BITS], enc[MAX_LEN_BITS];
+	unsigned int i, j, n;
+	int in_len, out_len, v;
+	double single, t;
+
+	in_len = osmo_conv_get_input_length(code, 0);
+	out_len = osmo_conv_get_output_length(code, 0);
+
+	bs = malloc(sizeof(*bs) * batch_size);
+	ref = malloc(sizeof(*ref) * batch_size);
+	out = malloc(sizeof(*out) * batch_size);
+	if (!bs || !ref || !out)
+		exit(EXIT_FAILURE);
+
+	srand(1);
+	for (i = 0; i < batch_size; i++) {
+		bs[i] = malloc(out_len);
+		ref[i] = malloc(in_len);
+		out[i] = malloc(in_len);
+		if (!bs[i] || !ref[i] || !out[i])
+			exit(EXIT_FAILURE);
+
+		for (j = 0; j < in_len; j++)
+			bu[j] = rand() & 1;
+		osmo_conv_encode(code, bu, enc);
+		osmo_ubit2sbit(bs[i], enc, out_len);
+		for (j = 0; j < out_len; j++) {
+			v = bs[i][j] + (int) (rand() % 301) - 150;
+			bs[i][j] = v > 127 ? 127 : v < -127 ? -127 : v;
+		}
+	}
+
+	/* Reference: one codeword after the other */
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for (n = 0; n < n_blocks; n += batch_size) {
+		for (i = 0; i < batch_size; i++)
+			osmo_conv_decode(code, bs[i], ref[i]);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	single = n / ts_diff_s(&t_start, &t_end);
+	printf("%-24s %-8s %12.0f blocks/s\n", name, "single", single);
+
+	for (kernel = OSMO_CONV_BATCH_SCALAR; kernel <= OSMO_CONV_BATCH_AVX512; kernel++) {
+		if (osmo_conv_batch_set_kernel(kernel) < 0) {
+			printf("%-24s %-8s %12s\n", name, osmo_conv_batch_kernel_name(kernel),
+			       "unsupported");
+			continue;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		for (n = 0; n < n_blocks; n += batch_size)
+			osmo_conv_decode_batch(code, (const sbit_t * const *) bs, out, batch_size);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+		t = n / ts_diff_s(&t_start, &t_end);
+		printf("%-24s %-8s %12.0f blocks/s (x%.2f)\n", name,
+		       osmo_conv_batch_kernel_name(kernel), t, t / single);
+
+		for (i = 0; i < batch_size; i++) {
+			if (memcmp(ref[i], out[i], in_len)) {
+				fprintf(stderr, "%s: %s kernel output mismatch in block %u\n",
+					name, osmo_conv_batch_kernel_name(kernel), i);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+
+	for (i = 0; i < batch_size; i++) {
+		free(out[i]);
+		free(ref[i]);
+		free(bs[i]);
+	}
+	free(out);
+	free(ref);
+	free(bs);
+}
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-n num_blocks] [-b batch_size]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+	enum osmo_conv_batch_kernel def;
+	unsigned int i;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:b:h")) != -1) {
+		switch (c) {
+		case 'n':
+			n_blocks = atoi(optarg);
+			break;
+		case 'b':
+			batch_size = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (n_blocks == 0 || batch_size == 0) {
+		help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	def = osmo_conv_batch_get_kernel();
+	printf("Default batch kernel: %s, %u blocks in batches of %u\n",
+	       osmo_conv_batch_kernel_name(def), n_blocks, batch_size);
+
+	for (i = 0; i < ARRAY_SIZE(bench_codes); i++) {
+		bench_code(bench_codes[i].name, bench_codes[i].code);
+		osmo_conv_batch_set_kernel(def);
+	}
+
+	return EXIT_SUCCESS;
+}
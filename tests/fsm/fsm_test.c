@@ -4,11 +4,15 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <inttypes.h>
 
 #include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
 #include <osmocom/core/select.h>
 #include <osmocom/core/logging.h>
 #include <osmocom/core/fsm.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
 #include <osmocom/ctrl/control_if.h>
 
 enum {
@@ -16,6 +20,7 @@ enum {
 };
 
 static void *g_ctx;
+static struct log_target *stderr_target;
 
 static int safe_strcmp(const char *a, const char *b)
 {
@@ -472,6 +477,358 @@ static void test_state_chg_Tms(void)
 	fprintf(stderr, "--- %s() done\n", __func__);
 }
 
+/* Check every instance of fsm can be found by id and name (not necessarily itself if several share the id), and that
+ * unknown ids and names are not found */
+static void assert_lookups(void)
+{
+	struct osmo_fsm_inst *fi;
+
+	llist_for_each_entry(fi, &fsm.instances, list) {
+		OSMO_ASSERT(!strcmp(osmo_fsm_inst_find_by_name(&fsm, fi->name)->name, fi->name));
+		if (fi->id)
+			OSMO_ASSERT(!strcmp(osmo_fsm_inst_find_by_id(&fsm, fi->id)->id, fi->id));
+	}
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "no_such_id") == NULL);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, NULL) == NULL);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_name(&fsm, "Test_FSM(no_such_id)") == NULL);
+}
+
+static void test_inst_index(void)
+{
+	struct osmo_fsm_inst *fi[300];
+	unsigned int i;
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	log_set_category_filter(stderr_target, DMAIN, 1, LOGL_INFO);
+
+	/* some instances exist before the index is enabled */
+	for (i = 0; i < 10; i++)
+		fi[i] = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, i & 1 ? NULL : "early");
+	OSMO_ASSERT(osmo_fsm_set_inst_index(&fsm, true) == 0);
+	OSMO_ASSERT(fsm.inst_index);
+	assert_lookups();
+
+	/* enough instances to grow the index a few times */
+	for (; i < ARRAY_SIZE(fi); i++) {
+		fi[i] = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, NULL);
+		OSMO_ASSERT(fi[i]);
+		if (i % 3)
+			OSMO_ASSERT(osmo_fsm_inst_update_id_f(fi[i], "inst_%u", i) == 0);
+	}
+	assert_lookups();
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_299") == fi[299]);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_name(&fsm, "Test_FSM(inst_299)") == fi[299]);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_3") == NULL);
+	fprintf(stderr, "lookups of %zu instances ok\n", ARRAY_SIZE(fi));
+
+	/* the CTRL interface looks up through the index */
+	assert_cmd_reply("GET 1 fsm.Test_FSM.id.inst_100.state", "NULL");
+
+	/* change and clear ids */
+	for (i = 10; i < ARRAY_SIZE(fi); i += 7) {
+		int rc;
+		if (i & 1)
+			rc = osmo_fsm_inst_update_id(fi[i], NULL);
+		else
+			rc = osmo_fsm_inst_update_id_f(fi[i], "renamed_%u", i);
+		OSMO_ASSERT(rc == 0);
+	}
+	OSMO_ASSERT(osmo_fsm_inst_update_id(fi[100], "invalid.id") == -EINVAL);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_100") == fi[100]);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "renamed_24") == fi[24]);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_17") == NULL);
+	assert_lookups();
+	fprintf(stderr, "lookups after changing ids ok\n");
+
+	/* free every other instance */
+	for (i = 0; i < ARRAY_SIZE(fi); i += 2) {
+		osmo_fsm_inst_free(fi[i]);
+		fi[i] = NULL;
+	}
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_100") == NULL);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_103") == fi[103]);
+	assert_lookups();
+	fprintf(stderr, "lookups after freeing instances ok\n");
+
+	/* without the index, the lookups give the same results */
+	OSMO_ASSERT(osmo_fsm_set_inst_index(&fsm, false) == 0);
+	OSMO_ASSERT(!fsm.inst_index);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_103") == fi[103]);
+	OSMO_ASSERT(osmo_fsm_inst_update_id(fi[103], "inst_103b") == 0);
+	assert_lookups();
+	OSMO_ASSERT(osmo_fsm_set_inst_index(&fsm, true) == 0);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "inst_103b") == fi[103]);
+	assert_lookups();
+	fprintf(stderr, "lookups after disabling and enabling the index ok\n");
+
+	for (i = 0; i < ARRAY_SIZE(fi); i++) {
+		if (!fi[i])
+			continue;
+		osmo_fsm_inst_free(fi[i]);
+	}
+	OSMO_ASSERT(llist_empty(&fsm.instances));
+	assert_lookups();
+	OSMO_ASSERT(osmo_fsm_set_inst_index(&fsm, false) == 0);
+
+	log_set_category_filter(stderr_target, DMAIN, 1, LOGL_DEBUG);
+
+	fprintf(stderr, "--- %s() done\n", __func__);
+}
+
+static void test_id_name_storage(void)
+{
+	struct osmo_fsm_inst *fi;
+	char long_id[200];
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	fi = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "short_id");
+	OSMO_ASSERT(fi);
+	OSMO_ASSERT(!strcmp(fi->id, "short_id"));
+	OSMO_ASSERT(!strcmp(fi->name, "Test_FSM(short_id)"));
+	/* id and name are stored inside the instance */
+	OSMO_ASSERT(talloc_total_blocks(fi) == 1);
+
+	/* set the id to itself */
+	OSMO_ASSERT(osmo_fsm_inst_update_id(fi, fi->id) == 0);
+	OSMO_ASSERT(!strcmp(fi->name, "Test_FSM(short_id)"));
+	OSMO_ASSERT(osmo_fsm_inst_update_id_f(fi, "%s_%s", fi->id, fi->id) == 0);
+	OSMO_ASSERT(!strcmp(fi->name, "Test_FSM(short_id_short_id)"));
+	OSMO_ASSERT(talloc_total_blocks(fi) == 1);
+
+	/* too long for the inline storage */
+	memset(long_id, 'x', sizeof(long_id) - 1);
+	long_id[sizeof(long_id) - 1] = '\0';
+	OSMO_ASSERT(osmo_fsm_inst_update_id(fi, long_id) == 0);
+	OSMO_ASSERT(!strcmp(fi->id, long_id));
+	OSMO_ASSERT(!strncmp(fi->name, "Test_FSM(xxx", 12));
+	OSMO_ASSERT(strlen(fi->name) == strlen("Test_FSM()") + strlen(long_id));
+	OSMO_ASSERT(talloc_total_blocks(fi) == 3);
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, long_id) == fi);
+	OSMO_ASSERT(osmo_fsm_inst_update_id(fi, fi->id) == 0);
+	OSMO_ASSERT(!strcmp(fi->id, long_id));
+	OSMO_ASSERT(talloc_total_blocks(fi) == 3);
+
+	/* an id that fits, but the name does not */
+	long_id[sizeof(fi->id_name_buf) - 10] = '\0';
+	OSMO_ASSERT(osmo_fsm_inst_update_id(fi, long_id) == 0);
+	OSMO_ASSERT(!strcmp(fi->id, long_id));
+	OSMO_ASSERT(strlen(fi->name) == strlen("Test_FSM()") + strlen(long_id));
+	OSMO_ASSERT(talloc_total_blocks(fi) == 2);
+
+	OSMO_ASSERT(osmo_fsm_inst_update_id_f_sanitize(fi, '-', "sanitized.%d", 1) == 0);
+	OSMO_ASSERT(!strcmp(fi->name, "Test_FSM(sanitized-1)"));
+	OSMO_ASSERT(osmo_fsm_inst_update_id(fi, NULL) == 0);
+	OSMO_ASSERT(fi->id == NULL);
+	OSMO_ASSERT(!strcmp(fi->name, "Test_FSM"));
+	OSMO_ASSERT(talloc_total_blocks(fi) == 1);
+	fprintf(stderr, "id and name storage ok\n");
+
+	osmo_fsm_inst_free(fi);
+
+	fprintf(stderr, "--- %s() done\n", __func__);
+}
+
+static int child_destructor_calls;
+
+static int child_destructor(int *child)
+{
+	child_destructor_calls++;
+	return 0;
+}
+
+static void test_inst_cache(void)
+{
+	struct osmo_fsm_inst *fi[3], *fi2;
+	int *child;
+	unsigned int i;
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	OSMO_ASSERT(osmo_fsm_set_inst_cache(&fsm, 2) == 0);
+
+	for (i = 0; i < ARRAY_SIZE(fi); i++) {
+		fi[i] = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, NULL);
+		OSMO_ASSERT(fi[i]);
+		child = talloc_zero(fi[i], int);
+		talloc_set_destructor(child, child_destructor);
+	}
+	osmo_fsm_inst_state_chg(fi[0], ST_ONE, 10, 0);
+
+	for (i = 0; i < ARRAY_SIZE(fi); i++)
+		osmo_fsm_inst_free(fi[i]);
+	/* all children are deallocated, whether the instance is cached or not */
+	OSMO_ASSERT(child_destructor_calls == 3);
+
+	/* the cache holds the first two freed instances, the last one freed is re-used first */
+	fi2 = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "recycled");
+	OSMO_ASSERT(fi2 == fi[1]);
+	OSMO_ASSERT(talloc_parent(fi2) == g_ctx);
+	OSMO_ASSERT(talloc_total_blocks(fi2) == 1);
+	OSMO_ASSERT(fi2->state == ST_NULL);
+	OSMO_ASSERT(!osmo_timer_pending(&fi2->timer));
+	OSMO_ASSERT(!strcmp(fi2->name, "Test_FSM(recycled)"));
+	OSMO_ASSERT(osmo_fsm_inst_find_by_id(&fsm, "recycled") == fi2);
+	osmo_fsm_inst_dispatch(fi2, EV_A, (void *)23);
+	OSMO_ASSERT(fi2->state == ST_ONE);
+
+	osmo_fsm_inst_free(fi2);
+
+	OSMO_ASSERT(osmo_fsm_set_inst_cache(&fsm, 1) == 0);
+	OSMO_ASSERT(osmo_fsm_set_inst_cache(&fsm, 0) == 0);
+	OSMO_ASSERT(fsm.inst_cache == NULL);
+	fprintf(stderr, "instance cache ok\n");
+
+	fprintf(stderr, "--- %s() done\n", __func__);
+}
+
+static void test_queued_dispatch(void)
+{
+	const struct osmo_fsm_event_queue_stats *stats = osmo_fsm_event_queue_stats();
+	struct osmo_fsm_inst *fi, *fi2, *fi3;
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	fsm.queue_events = true;
+
+	fi = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "queued");
+	OSMO_ASSERT(fi);
+
+	/* EV_B is not permitted in ST_NULL, which is still the state while EV_A is queued */
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi, EV_A, (void *)23) == 0);
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi, EV_B, (void *)42) == -1);
+	OSMO_ASSERT(fi->state == ST_NULL);
+	OSMO_ASSERT(stats->len == 1);
+	fprintf(stderr, "running the queue\n");
+	OSMO_ASSERT(osmo_fsm_event_queue_run() == 1);
+	OSMO_ASSERT(fi->state == ST_ONE);
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi, EV_B, (void *)42) == 0);
+	OSMO_ASSERT(fi->state == ST_ONE);
+	OSMO_ASSERT(stats->len == 1);
+	fprintf(stderr, "running the queue\n");
+	OSMO_ASSERT(osmo_fsm_event_queue_run() == 1);
+	OSMO_ASSERT(fi->state == ST_TWO);
+	OSMO_ASSERT(stats->len == 0);
+	OSMO_ASSERT(stats->max_len == 1);
+	OSMO_ASSERT(stats->dispatched == 2);
+	OSMO_ASSERT(osmo_fsm_event_queue_run() == 0);
+
+	/* events of freed instances are dropped */
+	fi2 = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "queued2");
+	fi3 = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "queued3");
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi2, EV_A, (void *)23) == 0);
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi3, EV_A, (void *)23) == 0);
+	osmo_fsm_inst_term(fi2, OSMO_FSM_TERM_REQUEST, NULL);
+	OSMO_ASSERT(stats->len == 1);
+	OSMO_ASSERT(stats->dropped == 1);
+
+	/* the queue is processed from osmo_select_main() */
+	fprintf(stderr, "running osmo_select_main()\n");
+	osmo_select_main(1);
+	OSMO_ASSERT(stats->len == 0);
+	OSMO_ASSERT(stats->dispatched == 3);
+	OSMO_ASSERT(fi3->state == ST_ONE);
+
+	/* termination is not queued */
+	osmo_fsm_inst_term(fi, OSMO_FSM_TERM_REQUEST, NULL);
+	osmo_fsm_inst_term(fi3, OSMO_FSM_TERM_REQUEST, NULL);
+	fsm.queue_events = false;
+
+	fprintf(stderr, "--- %s() done\n", __func__);
+}
+
+static void test_queued_parent_term(void)
+{
+	const struct osmo_fsm_event_queue_stats *stats = osmo_fsm_event_queue_stats();
+	struct osmo_fsm_inst *parent, *child;
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	fsm.queue_events = true;
+
+	parent = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "queuing-parent");
+	OSMO_ASSERT(parent);
+	child = osmo_fsm_inst_alloc_child(&fsm, parent, EV_A);
+	OSMO_ASSERT(child);
+	OSMO_ASSERT(osmo_fsm_inst_update_id(child, "child") == 0);
+
+	/* the parent term event is dispatched while the data passed to the termination is still valid */
+	osmo_fsm_inst_term(child, OSMO_FSM_TERM_REGULAR, (void *)23);
+	OSMO_ASSERT(stats->len == 0);
+	OSMO_ASSERT(parent->state == ST_ONE);
+
+	osmo_fsm_inst_term(parent, OSMO_FSM_TERM_REQUEST, NULL);
+	fsm.queue_events = false;
+
+	fprintf(stderr, "--- %s() done\n", __func__);
+}
+
+static void print_state_stats(uint32_t state)
+{
+	const struct osmo_fsm_state_stats *st = osmo_fsm_state_stats(&fsm, state);
+	unsigned int i;
+
+	fprintf(stderr, "%s: residency %"PRIu64" x, %"PRIu64" ns, max %"PRIu64" ns; action %"PRIu64" x; events A=%"PRIu64
+		" B=%"PRIu64", rejected %"PRIu64"\n", osmo_fsm_state_name(&fsm, state),
+		st->residency.count, st->residency.sum_ns, st->residency.max_ns, st->action.count,
+		st->events[EV_A], st->events[EV_B], st->rejected);
+	for (i = 0; i < OSMO_FSM_HIST_BUCKETS; i++) {
+		if (st->residency.buckets[i])
+			fprintf(stderr, "  residency bucket %u: %"PRIu64"\n", i, st->residency.buckets[i]);
+	}
+}
+
+static void test_fsm_stats(void)
+{
+	const struct rate_ctr_group *ctrg;
+	const struct osmo_stat_item_group *statg;
+	struct osmo_fsm_inst *fi;
+
+	fprintf(stderr, "\n--- %s()\n", __func__);
+
+	/* the CPU time of the actions stays 0 */
+	osmo_clock_override_enable(CLOCK_THREAD_CPUTIME_ID, true);
+
+	OSMO_ASSERT(osmo_fsm_state_stats(&fsm, ST_NULL) == NULL);
+	OSMO_ASSERT(osmo_fsm_set_stats(&fsm, true) == 0);
+	OSMO_ASSERT(osmo_fsm_state_stats(&fsm, ST_NULL));
+	OSMO_ASSERT(osmo_fsm_state_stats(&fsm, 3) == NULL);
+
+	fi = osmo_fsm_inst_alloc(&fsm, g_ctx, NULL, LOGL_DEBUG, "stats");
+	OSMO_ASSERT(fi);
+	fake_time_passes(0, 1000);
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi, EV_B, (void *)42) < 0);
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi, EV_A, (void *)23) == 0);
+	fake_time_passes(2, 0);
+	OSMO_ASSERT(osmo_fsm_inst_dispatch(fi, EV_B, (void *)42) == 0);
+	fake_time_passes(0, 500000);
+	osmo_fsm_inst_free(fi);
+
+	print_state_stats(ST_NULL);
+	print_state_stats(ST_ONE);
+	print_state_stats(ST_TWO);
+
+	ctrg = rate_ctr_get_group_by_name_idx("fsm", 0);
+	OSMO_ASSERT(ctrg && !strcmp(ctrg->name, "Test_FSM"));
+	OSMO_ASSERT(ctrg->desc->num_ctr == 2);
+	OSMO_ASSERT(rate_ctr_get_by_name(ctrg, "event:NULL:EV_A")->current == 1);
+	OSMO_ASSERT(rate_ctr_get_by_name(ctrg, "event:ONE:EV_B")->current == 1);
+	statg = osmo_stat_item_get_group_by_name_idx("fsm", 0);
+	OSMO_ASSERT(statg && !strcmp(statg->name, "Test_FSM"));
+	OSMO_ASSERT(osmo_stat_item_get_last(osmo_stat_item_get_by_name(statg, "state:NULL:residency")) == 1000);
+	OSMO_ASSERT(osmo_stat_item_get_last(osmo_stat_item_get_by_name(statg, "state:ONE:residency")) == 2000000);
+	OSMO_ASSERT(osmo_stat_item_get_last(osmo_stat_item_get_by_name(statg, "state:TWO:residency")) == 500000);
+
+	OSMO_ASSERT(osmo_fsm_set_stats(&fsm, false) == 0);
+	OSMO_ASSERT(osmo_fsm_state_stats(&fsm, ST_NULL) == NULL);
+	OSMO_ASSERT(rate_ctr_get_group_by_name_idx("fsm", 0) == NULL);
+	OSMO_ASSERT(osmo_stat_item_get_group_by_name_idx("fsm", 0) == NULL);
+	osmo_clock_override_enable(CLOCK_THREAD_CPUTIME_ID, false);
+
+	fprintf(stderr, "--- %s() done\n", __func__);
+}
+
 static const struct log_info_cat default_categories[] = {
 	[DMAIN] = {
 		.name = "DMAIN",
@@ -487,7 +844,6 @@ static const struct log_info log_info = {
 
 int main(int argc, char **argv)
 {
-	struct log_target *stderr_target;
 	struct osmo_fsm_inst *finst;
 
 	osmo_fsm_log_addr(false);
@@ -522,6 +878,12 @@ int main(int argc, char **argv)
 	test_state_chg_T();
 	test_state_chg_Ts();
 	test_state_chg_Tms();
+	test_inst_index();
+	test_id_name_storage();
+	test_inst_cache();
+	test_queued_dispatch();
+	test_queued_parent_term();
+	test_fsm_stats();
 
 	osmo_fsm_unregister(&fsm);
 	exit(0);
@@ -0,0 +1,226 @@
+/*
+ * BSSGP BVC context lookup benchmark
+ *
+ * Allocates a large number of BVC contexts spread over many NSEs, the way
+ * an SGSN serving a big Gb deployment would, and then measures the
+ * per-PDU lookups btsctx_by_bvci_nsei() and btsctx_by_raid_cid() against
+ * a plain scan over all contexts (which is what both used to do), both for
+ * contexts that exist and for ones that do not, e.g. a paging for an
+ * unknown cell:
+ *
+ *   ./bssgp_bvc_bench -n 10000
+ *   ./bssgp_bvc_bench -n 100000
+ *
+ * Setting up 100k BVCs takes minutes, as each btsctx_alloc() looks for
+ * counter groups with the same name and index in a plain list; that is
+ * not part of what is measured here.
+ *
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/core/application.h>
+#include <osmocom/gprs/gprs_bssgp.h>
+
+/* BVCs per NSE, like a BSS with a few dozen cells per PCU */
+#define BVC_PER_NSE 32
+
+static unsigned int n_bvc = 10000;
+static unsigned int n_lookups = 1000000;
+/* all allocated contexts, in the order the library list used to be scanned */
+static struct bssgp_bvc_ctx **bvcs;
+
+int bssgp_prim_cb(struct osmo_prim_hdr *oph, void *ctx)
+{
+	return 0;
+}
+
+static void bvc_params(unsigned int i, uint16_t *bvci, uint16_t *nsei, struct gprs_ra_id *raid, uint16_t *cid)
+{
+	*bvci = 2 + i % BVC_PER_NSE;
+	*nsei = i / BVC_PER_NSE;
+	memset(raid, 0, sizeof(*raid));
+	raid->mcc = 901;
+	raid->mnc = 70;
+	raid->lac = 1000 + i / 256;
+	raid->rac = i % 256;
+	*cid = i;
+}
+
+static struct bssgp_bvc_ctx *scan_by_bvci_nsei(uint16_t bvci, uint16_t nsei)
+{
+	unsigned int i;
+
+	/* newest first, like llist_add() + llist_for_each_entry() */
+	for (i = n_bvc; i-- > 0;) {
+		if (bvcs[i]->nsei == nsei && bvcs[i]->bvci == bvci)
+			return bvcs[i];
+	}
+	return NULL;
+}
+
+static struct bssgp_bvc_ctx *scan_by_raid_cid(const struct gprs_ra_id *raid, uint16_t cid)
+{
+	unsigned int i;
+
+	for (i = n_bvc; i-- > 0;) {
+		if (!memcmp(&bvcs[i]->ra_id, raid, sizeof(bvcs[i]->ra_id)) && bvcs[i]->cell_id == cid)
+			return bvcs[i];
+	}
+	return NULL;
+}
+
+static double ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+enum bench_mode {
+	BENCH_HASH_BVCI_NSEI,
+	BENCH_HASH_RAID_CID,
+	BENCH_SCAN_BVCI_NSEI,
+	BENCH_SCAN_RAID_CID,
+};
+
+static const char *bench_mode_name[] = {
+	[BENCH_HASH_BVCI_NSEI] = "btsctx_by_bvci_nsei",
+	[BENCH_HASH_RAID_CID] = "btsctx_by_raid_cid",
+	[BENCH_SCAN_BVCI_NSEI] = "linear scan (bvci, nsei)",
+	[BENCH_SCAN_RAID_CID] = "linear scan (raid, cid)",
+};
+
+static void bench(enum bench_mode mode, unsigned int lookups, bool miss)
+{
+	struct timespec t_start, t_end;
+	struct bssgp_bvc_ctx *bctx;
+	struct gprs_ra_id raid;
+	uint16_t bvci, nsei, cid;
+	unsigned int i, idx;
+
+	srand(1);
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for (i = 0; i < lookups; i++) {
+		idx = rand() % n_bvc;
+		bvc_params(idx, &bvci, &nsei, &raid, &cid);
+		if (miss) {
+			/* no context has these */
+			bvci += BVC_PER_NSE;
+			raid.mcc++;
+		}
+		switch (mode) {
+		case BENCH_HASH_BVCI_NSEI:
+			bctx = btsctx_by_bvci_nsei(bvci, nsei);
+			break;
+		case BENCH_HASH_RAID_CID:
+			bctx = btsctx_by_raid_cid(&raid, cid);
+			break;
+		case BENCH_SCAN_BVCI_NSEI:
+			bctx = scan_by_bvci_nsei(bvci, nsei);
+			break;
+		case BENCH_SCAN_RAID_CID:
+		default:
+			bctx = scan_by_raid_cid(&raid, cid);
+			break;
+		}
+		if (miss ? bctx != NULL
+			 : !bctx || bctx->bvci != bvci || bctx->nsei != nsei || bctx->cell_id != cid) {
+			fprintf(stderr, "%s: lookup of BVC %u failed\n", bench_mode_name[mode], idx);
+			exit(EXIT_FAILURE);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+	printf("%-26s %-4s %8u lookups: %10.1f ns/lookup\n", bench_mode_name[mode], miss ? "miss" : "hit",
+	       lookups, ts_diff_ns(&t_start, &t_end) / lookups);
+}
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-n num_bvc] [-l num_lookups]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+	void *ctx = talloc_named_const(NULL, 0, "bssgp_bvc_bench");
+	struct bssgp_bvc_ctx *bctx;
+	struct gprs_ra_id raid;
+	uint16_t bvci, nsei, cid;
+	unsigned int i, scan_lookups;
+	int c, miss;
+
+	while ((c = getopt(argc, argv, "n:l:h")) != -1) {
+		switch (c) {
+		case 'n':
+			n_bvc = atoi(optarg);
+			break;
+		case 'l':
+			n_lookups = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (n_bvc == 0 || n_bvc > 65535 * BVC_PER_NSE || n_lookups == 0) {
+		help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	osmo_init_logging2(ctx, NULL);
+	/* BVCIs repeat across NSEs, which rate_ctr complains about */
+	log_set_log_level(osmo_stderr_target, LOGL_FATAL);
+
+	bvcs = talloc_array(ctx, struct bssgp_bvc_ctx *, n_bvc);
+	if (!bvcs)
+		exit(EXIT_FAILURE);
+	for (i = 0; i < n_bvc; i++) {
+		bvc_params(i, &bvci, &nsei, &raid, &cid);
+		bctx = btsctx_alloc(bvci, nsei);
+		if (!bctx)
+			exit(EXIT_FAILURE);
+		bssgp_bvc_ctx_set_raid_cid(bctx, &raid, cid);
+		bvcs[i] = bctx;
+	}
+
+	printf("BVCs: %u on %u NSEs\n", n_bvc, (n_bvc + BVC_PER_NSE - 1) / BVC_PER_NSE);
+	/* the scans are O(n), keep their total run time bounded */
+	scan_lookups = n_lookups / (n_bvc / 100 + 1) + 1;
+	for (miss = 0; miss <= 1; miss++) {
+		bench(BENCH_HASH_BVCI_NSEI, n_lookups, miss);
+		bench(BENCH_HASH_RAID_CID, n_lookups, miss);
+		bench(BENCH_SCAN_BVCI_NSEI, scan_lookups, miss);
+		bench(BENCH_SCAN_RAID_CID, scan_lookups, miss);
+	}
+
+	for (i = 0; i < n_bvc; i++)
+		bssgp_bvc_ctx_free(bvcs[i]);
+	if (btsctx_by_bvci_nsei(2, 0)) {
+		fprintf(stderr, "BVC still found after free\n");
+		exit(EXIT_FAILURE);
+	}
+
+	talloc_free(ctx);
+	return EXIT_SUCCESS;
+}
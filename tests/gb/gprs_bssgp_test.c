@@ -289,6 +289,60 @@ static void test_bssgp_msgb_copy(void)
 	printf("----- %s END\n", __func__);
 }
 
+static void test_bssgp_bvc_ctx_lookup(void)
+{
+	struct bssgp_bvc_ctx *bvcs[300];
+	const unsigned int num_bvc = ARRAY_SIZE(bvcs);
+	struct gprs_ra_id raid = { .mcc = 262, .mnc = 42, .lac = 1, .rac = 0 };
+	struct bssgp_bvc_ctx *bctx;
+	unsigned int i;
+
+	printf("----- %s START\n", __func__);
+
+	/* enough BVCs for the hash tables to be resized several times */
+	for (i = 0; i < num_bvc; i++) {
+		bvcs[i] = btsctx_alloc(100 + i, 0x100 + i % 3);
+		OSMO_ASSERT(bvcs[i]);
+		raid.rac = i % 256;
+		raid.lac = 1 + i / 256;
+		bssgp_bvc_ctx_set_raid_cid(bvcs[i], &raid, 1000 + i);
+	}
+	for (i = 0; i < num_bvc; i++) {
+		OSMO_ASSERT(btsctx_by_bvci_nsei(100 + i, 0x100 + i % 3) == bvcs[i]);
+		raid.rac = i % 256;
+		raid.lac = 1 + i / 256;
+		OSMO_ASSERT(btsctx_by_raid_cid(&raid, 1000 + i) == bvcs[i]);
+	}
+	OSMO_ASSERT(btsctx_by_bvci_nsei(100, 0x101) == NULL);
+	printf("all %u BVCs found by BVCI/NSEI and by RAI/CI\n", num_bvc);
+
+	/* changing the cell via bssgp_bvc_ctx_set_raid_cid() updates the index */
+	bctx = bvcs[0];
+	raid.rac = 0;
+	raid.lac = 1;
+	bssgp_bvc_ctx_set_raid_cid(bctx, &raid, 2000);
+	OSMO_ASSERT(btsctx_by_raid_cid(&raid, 1000) == NULL);
+	OSMO_ASSERT(btsctx_by_raid_cid(&raid, 2000) == bctx);
+
+	printf("changed cells are found\n");
+
+	/* unknown cells are not found */
+	raid.mcc = 901;
+	OSMO_ASSERT(btsctx_by_raid_cid(&raid, 2000) == NULL);
+	raid.mcc = 262;
+	raid.lac = 0xfffe;
+	OSMO_ASSERT(btsctx_by_raid_cid(&raid, 1000) == NULL);
+	raid.lac = 1;
+	printf("unknown cells are not found\n");
+
+	for (i = 0; i < num_bvc; i++)
+		bssgp_bvc_ctx_free(bvcs[i]);
+	OSMO_ASSERT(btsctx_by_bvci_nsei(102, 0x102) == NULL);
+	OSMO_ASSERT(btsctx_by_raid_cid(&raid, 2000) == NULL);
+
+	printf("----- %s END\n", __func__);
+}
+
 static struct log_info info = {};
 
 int main(int argc, char **argv)
@@ -317,6 +371,7 @@ int main(int argc, char **argv)
 	test_bssgp_bad_reset();
 	test_bssgp_flow_control_bvc();
 	test_bssgp_msgb_copy();
+	test_bssgp_bvc_ctx_lookup();
 	printf("===== BSSGP test END\n\n");
 
 	exit(EXIT_SUCCESS);
@@ -642,6 +642,62 @@ void test_unconfigured(void *ctx)
 	printf("--- Finish force unconfigured test\n");
 }
 
+/* the NSEI and NSVCI indexes must follow creation, re-assignment and removal */
+void test_lookup(void *ctx)
+{
+	struct gprs_ns2_inst *nsi;
+	struct gprs_ns2_vc_bind *bind;
+	struct gprs_ns2_nse *nse;
+	struct gprs_ns2_vc *nsvc;
+	unsigned int i;
+
+	printf("--- Testing NSE/NSVC lookup\n");
+	nsi = gprs_ns2_instantiate(ctx, ns_prim_cb, NULL);
+	bind = dummy_bind(nsi, "lookup");
+	/* don't log thousands of NSE/NSVC status changes */
+	log_set_log_level(osmo_stderr_target, LOGL_ERROR);
+
+	printf("---- Create 3000 NSE + NSVC\n");
+	for (i = 0; i < 3000; i++) {
+		nse = gprs_ns2_create_nse(nsi, 2000 + i, GPRS_NS2_LL_UDP, GPRS_NS2_DIALECT_STATIC_RESETBLOCK);
+		OSMO_ASSERT(nse);
+		nsvc = ns2_vc_alloc(bind, nse, false, GPRS_NS2_VC_MODE_BLOCKRESET, NULL);
+		OSMO_ASSERT(nsvc);
+		ns2_vc_set_nsvci(nsvc, 40000 + i);
+	}
+
+	for (i = 0; i < 3000; i++) {
+		nse = gprs_ns2_nse_by_nsei(nsi, 2000 + i);
+		OSMO_ASSERT(nse && nse->nsei == 2000 + i);
+		nsvc = gprs_ns2_nsvc_by_nsvci(nsi, 40000 + i);
+		OSMO_ASSERT(nsvc && nsvc->nse == nse);
+	}
+	OSMO_ASSERT(!gprs_ns2_nse_by_nsei(nsi, 1999));
+	OSMO_ASSERT(!gprs_ns2_nsvc_by_nsvci(nsi, 39999));
+
+	printf("---- Re-assign and clear NSVCI\n");
+	nsvc = gprs_ns2_nsvc_by_nsvci(nsi, 40000);
+	ns2_vc_set_nsvci(nsvc, 39999);
+	OSMO_ASSERT(!gprs_ns2_nsvc_by_nsvci(nsi, 40000));
+	OSMO_ASSERT(gprs_ns2_nsvc_by_nsvci(nsi, 39999) == nsvc);
+	ns2_vc_clear_nsvci(nsvc);
+	OSMO_ASSERT(!gprs_ns2_nsvc_by_nsvci(nsi, 39999));
+
+	printf("---- Free every other NSE\n");
+	for (i = 0; i < 3000; i += 2)
+		gprs_ns2_free_nse(gprs_ns2_nse_by_nsei(nsi, 2000 + i));
+	for (i = 0; i < 3000; i++) {
+		nse = gprs_ns2_nse_by_nsei(nsi, 2000 + i);
+		nsvc = gprs_ns2_nsvc_by_nsvci(nsi, 40000 + i);
+		OSMO_ASSERT(!!nse == !!(i % 2));
+		OSMO_ASSERT(!!nsvc == !!(i % 2));
+	}
+
+	gprs_ns2_free(nsi);
+	log_set_log_level(osmo_stderr_target, LOGL_INFO);
+	printf("--- Finish NSE/NSVC lookup\n");
+}
+
 int main(int argc, char **argv)
 {
 	void *ctx = talloc_named_const(NULL, 0, "gprs_ns2_test");
@@ -663,6 +719,7 @@ int main(int argc, char **argv)
 	test_unitdata_weights(ctx);
 	test_unconfigured(ctx);
 	test_mtu(ctx);
+	test_lookup(ctx);
 	printf("===== NS2 protocol test END\n\n");
 
 	talloc_free(ctx);
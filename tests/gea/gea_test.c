@@ -1,6 +1,8 @@
 #include <osmocom/core/bits.h>
+#include <osmocom/core/msgb.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/crypt/gprs_cipher.h>
+#include <osmocom/gsm/gea.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -40,6 +42,75 @@ static inline void real_gea(uint32_t iov_ui, uint8_t sapi, uint32_t lfn,
 		 len, res);
 }
 
+#define MAX_FRAMES	300
+#define MAX_LEN		GSM0464_CIPH_MAX_BLOCK
+
+/* Compare osmo_gea_xor(), osmo_gea_msgb() and osmo_gea_batch() to gprs_cipher_run() */
+static void test_gea_ctx(enum gprs_ciph_algo algo)
+{
+	static const unsigned int batch_sizes[] = { 1, 7, 64, 100, 300 };
+	static struct osmo_gea_ctx ctx[4];
+	static struct osmo_gea_batch_req req[MAX_FRAMES];
+	static uint8_t data[MAX_FRAMES][MAX_LEN], ref[MAX_FRAMES][MAX_LEN];
+	uint8_t kc[4][16], ks[MAX_LEN];
+	struct msgb *msg;
+	unsigned int i, j, k, n, fail;
+	int rc;
+
+	printf("%s: ", get_value_string(gprs_cipher_names, algo));
+
+	for (i = 0; i < ARRAY_SIZE(ctx); i++) {
+		for (j = 0; j < sizeof(kc[i]); j++)
+			kc[i][j] = rand();
+		rc = osmo_gea_ctx_init(&ctx[i], algo, kc[i]);
+		OSMO_ASSERT(rc == 0);
+	}
+
+	for (n = 0; n < ARRAY_SIZE(batch_sizes); n++) {
+		fail = 0;
+		for (i = 0; i < batch_sizes[n]; i++) {
+			/* mostly short frames, some up to the maximum LLC frame size */
+			k = rand() % ARRAY_SIZE(ctx);
+			req[i].ctx = &ctx[k];
+			req[i].data = data[i];
+			req[i].len = i % 17 == 5 ? rand() % MAX_LEN : rand() % 80;
+			req[i].iv = rand();
+			req[i].direction = rand() & 1;
+			for (j = 0; j < req[i].len; j++)
+				data[i][j] = ref[i][j] = rand();
+
+			gprs_cipher_run(ks, req[i].len, algo, kc[k], req[i].iv, req[i].direction);
+			for (j = 0; j < req[i].len; j++)
+				ref[i][j] ^= ks[j];
+		}
+
+		rc = osmo_gea_batch(req, batch_sizes[n]);
+		OSMO_ASSERT(rc == 0);
+		for (i = 0; i < batch_sizes[n]; i++) {
+			if (memcmp(data[i], ref[i], req[i].len)) {
+				printf("\n  batch of %u: frame %u (len %u) differs", batch_sizes[n], i, req[i].len);
+				fail++;
+			}
+		}
+		printf("batch of %u %s, ", batch_sizes[n], fail ? "FAILED" : "OK");
+	}
+
+	/* osmo_gea_msgb() leaves the header alone */
+	msg = msgb_alloc(MAX_LEN, "gea_test");
+	memcpy(msgb_put(msg, 100), ref[0], 100);
+	rc = osmo_gea_msgb(&ctx[0], msg, 3, 0x12345678, GPRS_CIPH_SGSN2MS);
+	OSMO_ASSERT(rc == 0);
+	memcpy(data[0], ref[0], 100);
+	osmo_gea_xor(&ctx[0], data[0] + 3, 97, 0x12345678, GPRS_CIPH_SGSN2MS);
+	printf("msgb %s", memcmp(msgb_data(msg), data[0], 100) ? "FAILED" : "OK");
+	rc = osmo_gea_msgb(&ctx[0], msg, 101, 0x12345678, GPRS_CIPH_SGSN2MS);
+	printf(", offset beyond data: %d\n", rc);
+	msgb_free(msg);
+
+	for (i = 0; i < ARRAY_SIZE(ctx); i++)
+		osmo_gea_ctx_clear(&ctx[i]);
+}
+
 int main(int argc, char **argv)
 {
     printf("GEA3 support: %d\n", gprs_cipher_supported(GPRS_ALGO_GEA3));
@@ -64,5 +135,9 @@ int main(int argc, char **argv)
     real_gea(0, 3, 20, 0, GPRS_CIPH_MS2SGSN, "bf4575e165fec400", 134, "c43845418e7fc4b3651bc9c3cc9af0163373126c0b31f85d192280e20c981f426dc4a0514a377f76da3d1672c6a0f463513608b3291bacd5d17bb44c8cc5383c3cc85de94e9c594e0fd61d4f2b74b452c1edf07eb04e0e67f352337cc0fd932936841fa41ee5ff0d8f3fad9625a9dec1f12726b74595a1c40d429926ba7e8461f3fa2ae2c0d3");
     real_gea(0, 3, 21, 0, GPRS_CIPH_MS2SGSN, "bf4575e165fec400", 65, "7b4fc1922c183e6f61e8d2317216ed1d2497477d6f84947f8318df42621ad9affc0c42ba2fd63e06bce4720598d5ae919ca2996f2f1feaea2aa79827692471fd0a");
 
+    srand(1);
+    test_gea_ctx(GPRS_ALGO_GEA3);
+    test_gea_ctx(GPRS_ALGO_GEA4);
+
     return 0;
 }
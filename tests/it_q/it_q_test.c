@@ -1,5 +1,10 @@
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/utils.h>
@@ -149,11 +154,270 @@ static void tc_eventfd(void)
 	osmo_it_q_destroy(q1);
 }
 
+static void tc_dequeue_batch(void)
+{
+	struct osmo_it_q *q1;
+	struct it_q_test2 *item, *tmp;
+	LLIST_HEAD(items);
+	unsigned int n;
+	int i, rc;
+
+	ENTER_TC;
+
+	printf("allocating q1\n");
+	q1 = osmo_it_q_alloc(OTC_GLOBAL, "q1", 10, NULL, NULL);
+	OSMO_ASSERT(q1);
+
+	for (i = 0; i < 7; i++) {
+		item = talloc_zero(OTC_GLOBAL, struct it_q_test2);
+		item->foo = i;
+		rc = osmo_it_q_enqueue(q1, item, list);
+		OSMO_ASSERT(rc == 0);
+	}
+
+	n = osmo_it_q_dequeue_batch(q1, &items, 5);
+	printf("dequeued %u entries, %u left in queue\n", n, q1->current_length);
+	n = osmo_it_q_dequeue_batch(q1, &items, 5);
+	printf("dequeued %u entries, %u left in queue\n", n, q1->current_length);
+	llist_for_each_entry_safe(item, tmp, &items, list) {
+		printf(" %d", item->foo);
+		llist_del(&item->list);
+		talloc_free(item);
+	}
+	printf("\n");
+
+	osmo_it_q_destroy(q1);
+}
+
+static void tc_mpsc_queue_length(void)
+{
+	struct osmo_it_q *q1;
+	unsigned int qlen = 3;
+	struct it_q_test1 *item;
+	int i, rc;
+
+	ENTER_TC;
+
+	printf("allocating q1\n");
+	q1 = osmo_it_q_alloc_mpsc(OTC_GLOBAL, "q1", qlen, NULL, NULL);
+	OSMO_ASSERT(q1);
+
+	printf("adding queue entries up to the limit\n");
+	for (i = 0; i < qlen; i++) {
+		item = talloc_zero(OTC_GLOBAL, struct it_q_test1);
+		rc = osmo_it_q_enqueue(q1, item, list);
+		OSMO_ASSERT(rc == 0);
+	}
+	printf("attempting to add more than the limit\n");
+	item = talloc_zero(OTC_GLOBAL, struct it_q_test1);
+	rc = osmo_it_q_enqueue(q1, item, list);
+	OSMO_ASSERT(rc == -ENOSPC);
+
+	printf("removing one entry makes room for one more\n");
+	osmo_it_q_dequeue(q1, &item, list);
+	OSMO_ASSERT(item);
+	rc = osmo_it_q_enqueue(q1, item, list);
+	OSMO_ASSERT(rc == 0);
+
+	osmo_it_q_destroy(q1);
+}
+
+static void tc_mpsc_enqueue_dequeue(void)
+{
+	struct osmo_it_q *q1;
+	struct it_q_test2 *item;
+	int i, round, rc;
+
+	ENTER_TC;
+
+	printf("allocating q1\n");
+	q1 = osmo_it_q_alloc_mpsc(OTC_GLOBAL, "q1", 4, NULL, NULL);
+	OSMO_ASSERT(q1);
+
+	printf("try dequeueing from an empty queue\n");
+	osmo_it_q_dequeue(q1, &item, list);
+	OSMO_ASSERT(item == NULL);
+
+	printf("filling and draining the ring several times, checking the order\n");
+	for (round = 0; round < 5; round++) {
+		for (i = 0; i < 3; i++) {
+			item = talloc_zero(OTC_GLOBAL, struct it_q_test2);
+			item->foo = round * 10 + i;
+			rc = osmo_it_q_enqueue(q1, item, list);
+			OSMO_ASSERT(rc == 0);
+		}
+		for (i = 0; i < 3; i++) {
+			osmo_it_q_dequeue(q1, &item, list);
+			OSMO_ASSERT(item && item->foo == round * 10 + i);
+			talloc_free(item);
+		}
+	}
+
+	printf("try dequeueing from an empty queue\n");
+	osmo_it_q_dequeue(q1, &item, list);
+	OSMO_ASSERT(item == NULL);
+
+	osmo_it_q_destroy(q1);
+}
+
+static void tc_mpsc_eventfd(void)
+{
+	struct osmo_it_q *q1;
+	unsigned int qlen = 30;
+	struct it_q_test1 *item;
+	uint64_t val;
+	int i, rc;
+
+	ENTER_TC;
+
+	g_read_cb_count = 0;
+
+	printf("allocating q1\n");
+	q1 = osmo_it_q_alloc_mpsc(OTC_GLOBAL, "q1", qlen, q_read_cb, NULL);
+	OSMO_ASSERT(q1);
+
+	printf("adding %u queue entries up to the limit\n", qlen);
+	for (i = 0; i < qlen; i++) {
+		item = talloc_zero(OTC_GLOBAL, struct it_q_test1);
+		item->foo = &g_read_cb_count;
+		rc = osmo_it_q_enqueue(q1, item, list);
+		OSMO_ASSERT(rc == 0);
+	}
+
+	/* all entries together must have caused only one wake-up */
+	rc = read(q1->event_ofd.fd, &val, sizeof(val));
+	OSMO_ASSERT(rc == sizeof(val));
+	printf("eventfd was signalled %u time(s)\n", (unsigned int)val);
+	/* put it back for the select loop */
+	rc = write(q1->event_ofd.fd, &val, sizeof(val));
+	OSMO_ASSERT(rc == sizeof(val));
+
+	osmo_fd_register(&q1->event_ofd);
+	osmo_select_main(1);
+	printf("%u entries were dequeued\n", g_read_cb_count);
+	OSMO_ASSERT(g_read_cb_count == qlen);
+
+	osmo_it_q_destroy(q1);
+}
+
+static void tc_mpsc_eventfd_batch(void)
+{
+	struct osmo_it_q *q1;
+	unsigned int qlen = 100;
+	struct it_q_test1 *item;
+	int i, rc;
+
+	ENTER_TC;
+
+	g_read_cb_count = 0;
+
+	printf("allocating q1\n");
+	q1 = osmo_it_q_alloc_mpsc(OTC_GLOBAL, "q1", qlen, q_read_cb, NULL);
+	OSMO_ASSERT(q1);
+
+	printf("adding %u queue entries up to the limit\n", qlen);
+	for (i = 0; i < qlen; i++) {
+		item = talloc_zero(OTC_GLOBAL, struct it_q_test1);
+		item->foo = &g_read_cb_count;
+		rc = osmo_it_q_enqueue(q1, item, list);
+		OSMO_ASSERT(rc == 0);
+	}
+
+	/* a single wake-up only dequeues a limited batch, the remainder follows in the next iteration */
+	osmo_fd_register(&q1->event_ofd);
+	osmo_select_main(1);
+	printf("%u entries were dequeued after the first iteration\n", g_read_cb_count);
+	OSMO_ASSERT(g_read_cb_count < qlen);
+	osmo_select_main(1);
+	printf("%u entries were dequeued after the second iteration\n", g_read_cb_count);
+	OSMO_ASSERT(g_read_cb_count == qlen);
+
+	osmo_it_q_destroy(q1);
+}
+
+#define MPSC_PRODUCERS 4
+#define MPSC_ITEMS_PER_PRODUCER 20000
+
+struct mpsc_item {
+	struct llist_head list;
+	int producer;
+	int seq;
+};
+
+static void *mpsc_producer(void *arg)
+{
+	struct osmo_it_q *q = osmo_it_q_by_name("mpsc");
+	int producer = (int)(intptr_t)arg;
+	struct mpsc_item *items;
+	int i;
+
+	/* allocated up-front, as talloc is not thread-safe */
+	items = calloc(MPSC_ITEMS_PER_PRODUCER, sizeof(*items));
+	OSMO_ASSERT(items);
+	for (i = 0; i < MPSC_ITEMS_PER_PRODUCER; i++) {
+		items[i].producer = producer;
+		items[i].seq = i;
+		/* spin while the queue is full */
+		while (osmo_it_q_enqueue(q, &items[i], list) == -ENOSPC)
+			sched_yield();
+	}
+	return items;
+}
+
+static void tc_mpsc_threads(void)
+{
+	pthread_t threads[MPSC_PRODUCERS];
+	int next_seq[MPSC_PRODUCERS] = { 0 };
+	struct mpsc_item *item, *tmp;
+	unsigned int total = 0;
+	struct osmo_it_q *q;
+	LLIST_HEAD(items);
+	void *ret;
+	int i;
+
+	ENTER_TC;
+
+	q = osmo_it_q_alloc_mpsc(OTC_GLOBAL, "mpsc", 64, NULL, NULL);
+	OSMO_ASSERT(q);
+
+	printf("starting %d producer threads\n", MPSC_PRODUCERS);
+	for (i = 0; i < MPSC_PRODUCERS; i++)
+		OSMO_ASSERT(pthread_create(&threads[i], NULL, mpsc_producer, (void *)(intptr_t)i) == 0);
+
+	while (total < MPSC_PRODUCERS * MPSC_ITEMS_PER_PRODUCER) {
+		if (osmo_it_q_dequeue_batch(q, &items, 16) == 0) {
+			sched_yield();
+			continue;
+		}
+		/* each producer's items must arrive exactly once and in order */
+		llist_for_each_entry_safe(item, tmp, &items, list) {
+			OSMO_ASSERT(item->seq == next_seq[item->producer]);
+			next_seq[item->producer]++;
+			llist_del(&item->list);
+			total++;
+		}
+	}
+
+	for (i = 0; i < MPSC_PRODUCERS; i++) {
+		OSMO_ASSERT(pthread_join(threads[i], &ret) == 0);
+		free(ret);
+	}
+	printf("received %u entries in order\n", total);
+
+	osmo_it_q_destroy(q);
+}
+
 int main(int argc, char **argv)
 {
 	tc_alloc();
 	tc_queue_length();
 	tc_enqueue_dequeue();
 	tc_eventfd();
+	tc_dequeue_batch();
+	tc_mpsc_queue_length();
+	tc_mpsc_enqueue_dequeue();
+	tc_mpsc_eventfd();
+	tc_mpsc_eventfd_batch();
+	tc_mpsc_threads();
 	return 0;
 }
@@ -0,0 +1,248 @@
+/* test for asynchronous logging via per-thread rings */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_THREADS	4
+#define NUM_MSGS	2000
+
+enum {
+	DTEST,
+};
+
+static const struct log_info_cat default_categories[] = {
+	[DTEST] = {
+		.name = "DTEST",
+		.description = "Test",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+};
+
+static const struct log_info log_info = {
+	.cat = default_categories,
+	.num_cat = ARRAY_SIZE(default_categories),
+};
+
+/* only ever called by one thread at a time, under the log target mutex */
+static unsigned int received;
+static unsigned int drop_notices;
+static int last_seq[NUM_THREADS];
+static bool out_of_order;
+
+static void test_output(struct log_target *target, unsigned int level, const char *string)
+{
+	unsigned int thread;
+	int seq;
+
+	/* log from inside the output function, while holding the log target mutex */
+	if (strstr(string, "flood")) {
+		for (seq = 0; seq < NUM_MSGS; seq++)
+			LOGP(DTEST, LOGL_NOTICE, "thread 3 msg %d\n", seq);
+		return;
+	}
+	if (strstr(string, "log_async: dropped")) {
+		drop_notices++;
+		return;
+	}
+	if (sscanf(string, "thread %u msg %d", &thread, &seq) != 2 || thread >= NUM_THREADS) {
+		printf("unexpected log line: %s", string);
+		return;
+	}
+	if (seq <= last_seq[thread])
+		out_of_order = true;
+	last_seq[thread] = seq;
+	received++;
+}
+
+static void reset(void)
+{
+	unsigned int i;
+
+	received = 0;
+	drop_notices = 0;
+	out_of_order = false;
+	for (i = 0; i < NUM_THREADS; i++)
+		last_seq[i] = -1;
+}
+
+static void *log_thread(void *arg)
+{
+	unsigned int thread = (unsigned int)(uintptr_t)arg;
+	int i;
+
+	for (i = 0; i < NUM_MSGS; i++)
+		LOGP(DTEST, LOGL_INFO, "thread %u msg %d\n", thread, i);
+
+	return NULL;
+}
+
+static void test_threads(void)
+{
+	pthread_t threads[NUM_THREADS];
+	struct log_async_stats stats;
+	unsigned int i;
+
+	printf("Testing %u threads, blocking on overflow\n", NUM_THREADS);
+	reset();
+
+	OSMO_ASSERT(log_async_start(0, LOG_ASYNC_OVERFLOW_BLOCK) == 0);
+	OSMO_ASSERT(log_async_is_running());
+	OSMO_ASSERT(log_async_start(0, LOG_ASYNC_OVERFLOW_BLOCK) == -EALREADY);
+
+	for (i = 0; i < NUM_THREADS; i++)
+		OSMO_ASSERT(pthread_create(&threads[i], NULL, log_thread, (void *)(uintptr_t)i) == 0);
+	for (i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	log_async_flush();
+	log_tgt_mutex_lock();
+	printf("received %u messages, in order: %s\n", received, out_of_order ? "no" : "yes");
+	log_tgt_mutex_unlock();
+
+	log_async_get_stats(&stats);
+	printf("enqueued %" PRIu64 ", dropped %" PRIu64 "\n", stats.enqueued, stats.dropped);
+
+	log_async_stop();
+	OSMO_ASSERT(!log_async_is_running());
+}
+
+static void test_drop(void)
+{
+	struct log_async_stats before, after;
+	int i;
+
+	printf("Testing drop on overflow with a stalled writer\n");
+	reset();
+	log_async_get_stats(&before);
+
+	OSMO_ASSERT(log_async_start(16 * 1024, LOG_ASYNC_OVERFLOW_DROP) == 0);
+
+	/* the writer thread cannot output anything while we hold the mutex */
+	log_tgt_mutex_lock();
+	for (i = 0; i < NUM_MSGS; i++)
+		LOGP(DTEST, LOGL_INFO, "thread 0 msg %d\n", i);
+	log_tgt_mutex_unlock();
+
+	log_async_flush();
+	log_async_get_stats(&after);
+
+	log_tgt_mutex_lock();
+	printf("all messages accounted for: %s\n",
+	       received + (after.dropped - before.dropped) == NUM_MSGS ? "yes" : "no");
+	printf("some messages dropped: %s, drop notices: %u, in order: %s\n",
+	       after.dropped > before.dropped ? "yes" : "no", drop_notices,
+	       out_of_order ? "no" : "yes");
+	log_tgt_mutex_unlock();
+
+	log_async_stop();
+}
+
+static void test_stop_drains(void)
+{
+	int i;
+
+	printf("Testing that stopping outputs all queued messages\n");
+	reset();
+
+	OSMO_ASSERT(log_async_start(0, LOG_ASYNC_OVERFLOW_BLOCK) == 0);
+	for (i = 0; i < NUM_MSGS; i++)
+		LOGP(DTEST, LOGL_INFO, "thread 1 msg %d\n", i);
+	log_async_stop();
+
+	printf("received %u messages, in order: %s\n", received, out_of_order ? "no" : "yes");
+
+	/* synchronous again */
+	LOGP(DTEST, LOGL_INFO, "thread 1 msg %d\n", NUM_MSGS);
+	printf("received %u messages after stop\n", received);
+}
+
+static void test_fatal_under_mutex(void)
+{
+	printf("Testing a FATAL message while holding the log target mutex\n");
+	reset();
+
+	OSMO_ASSERT(log_async_start(0, LOG_ASYNC_OVERFLOW_BLOCK) == 0);
+	/* the writer thread needs the mutex, so neither of these may wait for it */
+	log_tgt_mutex_lock();
+	LOGP(DTEST, LOGL_FATAL, "thread 2 msg 0\n");
+	log_async_flush();
+	printf("received %u messages while holding the mutex\n", received);
+	log_tgt_mutex_unlock();
+	log_async_stop();
+}
+
+static void test_log_from_output(void)
+{
+	struct log_async_stats before, after;
+
+	printf("Testing a full ring from within a log target's output function\n");
+	reset();
+	log_async_get_stats(&before);
+
+	OSMO_ASSERT(log_async_start(16 * 1024, LOG_ASYNC_OVERFLOW_BLOCK) == 0);
+	/* a FATAL message is output right away under the mutex, test_output() then floods the ring,
+	 * which the writer thread cannot drain before the mutex is released */
+	log_tgt_mutex_lock();
+	LOGP(DTEST, LOGL_FATAL, "flood\n");
+	log_tgt_mutex_unlock();
+
+	log_async_flush();
+	log_async_get_stats(&after);
+
+	log_tgt_mutex_lock();
+	printf("all messages accounted for: %s\n",
+	       received + (after.dropped - before.dropped) == NUM_MSGS ? "yes" : "no");
+	printf("some messages dropped: %s, in order: %s\n",
+	       after.dropped > before.dropped ? "yes" : "no", out_of_order ? "no" : "yes");
+	log_tgt_mutex_unlock();
+
+	log_async_stop();
+}
+
+int main(int argc, char **argv)
+{
+	struct log_target *tgt;
+
+	log_init(&log_info, NULL);
+	tgt = log_target_create();
+	OSMO_ASSERT(tgt);
+	tgt->output = test_output;
+	log_set_all_filter(tgt, 1);
+	log_set_print_category(tgt, 0);
+	log_set_print_category_hex(tgt, 0);
+	log_set_print_level(tgt, 0);
+	log_set_print_filename2(tgt, LOG_FILENAME_NONE);
+	log_set_use_color(tgt, 0);
+	log_add_target(tgt);
+
+	test_threads();
+	test_drop();
+	test_stop_drains();
+	test_fatal_under_mutex();
+	test_log_from_output();
+
+	log_fini();
+	return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * Log line fan-out benchmark
+ *
+ * Measures the cost of one LOGP() statement with 1, 2 and 4 active log
+ * targets, each with its own header configuration (timestamps, category,
+ * level, file name, colors), like a process logging to stderr, a file and
+ * gsmtap at the same time.  The targets' output functions only count the
+ * bytes, so that the numbers show the formatting cost and not the I/O:
+ *
+ *   ./logging_bench -n 1000000
+ *
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
+
+#define MAX_TARGETS	4
+
+enum {
+	DBENCH,
+};
+
+static const struct log_info_cat default_categories[] = {
+	[DBENCH] = {
+		.name = "DBENCH",
+		.description = "Benchmark",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+};
+
+static const struct log_info log_info = {
+	.cat = default_categories,
+	.num_cat = ARRAY_SIZE(default_categories),
+};
+
+static unsigned int n_lines = 200000;
+static unsigned long n_bytes;
+static unsigned long n_output;
+static struct log_target *targets[MAX_TARGETS];
+static char last_msg[MAX_TARGETS][256];
+
+static void bench_output(struct log_target *target, unsigned int level, const char *string)
+{
+	size_t len = strlen(string);
+	unsigned int i;
+
+	for (i = 0; targets[i] != target; i++)
+		;
+
+	n_bytes += len;
+	n_output++;
+	/* remember the message text after the header, to check it is the same for all targets */
+	OSMO_STRLCPY_ARRAY(last_msg[i], strstr(string, "subscr") ? : string);
+}
+
+static struct log_target *bench_target(unsigned int i)
+{
+	struct log_target *tgt = log_target_create();
+
+	OSMO_ASSERT(tgt);
+	tgt->output = bench_output;
+	log_set_all_filter(tgt, 1);
+	log_set_log_level(tgt, LOGL_DEBUG);
+	log_set_print_category(tgt, 1);
+	log_set_print_level(tgt, 1);
+	log_set_print_category_hex(tgt, 0);
+	log_set_print_filename2(tgt, LOG_FILENAME_BASENAME);
+	log_set_use_color(tgt, 0);
+
+	switch (i) {
+	case 0:
+		/* like stderr */
+		log_set_print_extended_timestamp(tgt, 1);
+		log_set_use_color(tgt, 1);
+		break;
+	case 1:
+		/* like a log file */
+		log_set_print_timestamp(tgt, 1);
+		log_set_print_filename_pos(tgt, LOG_FILENAME_POS_LINE_END);
+		break;
+	case 2:
+		/* like gsmtap */
+		log_set_print_filename2(tgt, LOG_FILENAME_NONE);
+		log_set_print_level(tgt, 0);
+		break;
+	default:
+		log_set_print_extended_timestamp(tgt, 1);
+		log_set_print_tid(tgt, 1);
+		break;
+	}
+	return tgt;
+}
+
+static double ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-n num_lines]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+	static const unsigned int n_targets[] = { 1, 2, 4 };
+	struct timespec t_start, t_end;
+	unsigned int i, j, k;
+	double ns;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:h")) != -1) {
+		switch (c) {
+		case 'n':
+			n_lines = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (n_lines == 0) {
+		help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	log_init(&log_info, NULL);
+
+	k = 0;
+	for (i = 0; i < ARRAY_SIZE(n_targets); i++) {
+		while (k < n_targets[i]) {
+			targets[k] = bench_target(k);
+			log_add_target(targets[k]);
+			k++;
+		}
+
+		n_bytes = 0;
+		n_output = 0;
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		for (j = 0; j < n_lines; j++)
+			LOGP(DBENCH, LOGL_INFO, "subscr IMSI-%015u: state %s, lchan %d.%d, rx %u bytes\n",
+			     j, "ACTIVE", j % 8, j % 3, j * 23);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+		ns = ts_diff_ns(&t_start, &t_end);
+
+		if (n_output != (unsigned long)n_lines * k) {
+			fprintf(stderr, "expected %lu log lines, got %lu\n", (unsigned long)n_lines * k, n_output);
+			exit(EXIT_FAILURE);
+		}
+		for (j = 1; j < k; j++) {
+			/* the file name position and colors differ, compare the text only */
+			if (strncmp(last_msg[0], last_msg[j], 40)) {
+				fprintf(stderr, "target %u logged '%s', target 0 '%s'\n", j, last_msg[j], last_msg[0]);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		printf("targets: %u, lines: %u, bytes/line: %lu, total: %.3f ms, %.1f ns/line\n",
+		       k, n_lines, n_bytes / n_lines, ns / 1e6, ns / n_lines);
+	}
+
+	for (i = 0; i < k; i++)
+		log_target_destroy(targets[i]);
+	log_fini();
+	return EXIT_SUCCESS;
+}
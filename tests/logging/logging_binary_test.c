@@ -0,0 +1,253 @@
+/* test for the binary logging target */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/logging_binary.h>
+#include <osmocom/core/utils.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum {
+	DRLL,
+	DCC,
+};
+
+static const struct log_info_cat default_categories[] = {
+	[DRLL] = {
+		.name = "DRLL",
+		.description = "A-bis Radio Link Layer (RLL)",
+		.enabled = 1, .loglevel = LOGL_DEBUG,
+	},
+	[DCC] = {
+		.name = "DCC",
+		.description = "Layer3 Call Control (CC)",
+		.enabled = 1, .loglevel = LOGL_NOTICE,
+	},
+};
+
+static const struct log_info log_info = {
+	.cat = default_categories,
+	.num_cat = ARRAY_SIZE(default_categories),
+};
+
+static char fname[] = "/tmp/logging_binary_test.XXXXXX";
+static char *expected[64];
+static unsigned int num_expected;
+
+/* Log a message to the binary target and remember how it should read */
+#define LOGB(ss, level, fmt, args...) do { \
+		char _buf[256]; \
+		OSMO_ASSERT(num_expected < ARRAY_SIZE(expected)); \
+		snprintf(_buf, sizeof(_buf), fmt, ##args); \
+		expected[num_expected++] = strdup(_buf); \
+		LOGP(ss, level, fmt, ##args); \
+	} while (0)
+
+static uint8_t *read_file(size_t *len)
+{
+	uint8_t *buf;
+	FILE *f;
+
+	f = fopen(fname, "r");
+	OSMO_ASSERT(f);
+	OSMO_ASSERT(fseek(f, 0, SEEK_END) == 0);
+	*len = ftell(f);
+	OSMO_ASSERT(fseek(f, 0, SEEK_SET) == 0);
+	buf = malloc(*len);
+	OSMO_ASSERT(buf);
+	OSMO_ASSERT(fread(buf, 1, *len, f) == *len);
+	fclose(f);
+	return buf;
+}
+
+static const char *dict_lookup(const uint8_t *map, const struct log_binary_hdr *hdr,
+			       enum log_binary_str_kind kind, uint32_t id)
+{
+	const uint8_t *pos = map + hdr->dict_off, *end = pos + hdr->dict_used;
+	const struct log_binary_str *ent;
+
+	while (pos < end) {
+		ent = (const struct log_binary_str *)pos;
+		if (ent->kind == kind && ent->id == id)
+			return ent->str;
+		pos += (sizeof(*ent) + ent->len + 1 + 7) & ~7;
+	}
+	return NULL;
+}
+
+/* Call cb for each record in the ring, oldest first */
+static unsigned int for_each_rec(const uint8_t *map,
+				 void (*cb)(const uint8_t *map, const struct log_binary_rec *rec))
+{
+	const struct log_binary_hdr *hdr = (const struct log_binary_hdr *)map;
+	const uint8_t *ring = map + hdr->ring_off;
+	const struct log_binary_rec *rec;
+	unsigned int n = 0;
+	uint64_t pos, off;
+
+	for (pos = hdr->tail; pos < hdr->head; pos += rec->len) {
+		off = pos & (hdr->ring_size - 1);
+		rec = (const struct log_binary_rec *)&ring[off];
+		if (hdr->ring_size - off < sizeof(*rec) || rec->len == 0) {
+			pos += hdr->ring_size - off;
+			rec = (const struct log_binary_rec *)ring;
+			if (pos >= hdr->head)
+				break;
+		}
+		OSMO_ASSERT(rec->len >= sizeof(*rec) + rec->args_len);
+		cb(map, rec);
+		n++;
+	}
+	return n;
+}
+
+static void render(const uint8_t *map, const struct log_binary_rec *rec, char *buf, size_t len)
+{
+	const struct log_binary_hdr *hdr = (const struct log_binary_hdr *)map;
+	const char *fmt = "%s";
+
+	if (rec->fmt_id != LOG_BINARY_ID_NONE)
+		fmt = dict_lookup(map, hdr, LOG_BINARY_STR_ID, rec->fmt_id);
+	OSMO_ASSERT(fmt);
+	OSMO_ASSERT(log_binary_render(buf, len, fmt, rec->args, rec->args_len) >= 0);
+}
+
+static unsigned int checked;
+
+static void check_rec(const uint8_t *map, const struct log_binary_rec *rec)
+{
+	const struct log_binary_hdr *hdr = (const struct log_binary_hdr *)map;
+	const char *file = dict_lookup(map, hdr, LOG_BINARY_STR_ID, rec->file_id);
+	char buf[4096];
+
+	render(map, rec, buf, sizeof(buf));
+	printf("%s %s %s%s: %s", dict_lookup(map, hdr, LOG_BINARY_STR_CAT, rec->subsys),
+	       log_level_str(rec->level), file ? strrchr(file, '/') ? strrchr(file, '/') + 1 : file : "?",
+	       rec->fmt_id == LOG_BINARY_ID_NONE ? " (text)" : "", buf);
+	if (checked >= num_expected || strcmp(buf, expected[checked]))
+		printf("  MISMATCH, expected: %s", checked < num_expected ? expected[checked] : "nothing\n");
+	checked++;
+}
+
+static void test_formats(void)
+{
+	char not_terminated[4] = { 'a', 'b', 'c', 'd' };
+	uint8_t *map;
+	size_t len;
+
+	printf("Testing format conversions\n");
+
+	LOGB(DRLL, LOGL_DEBUG, "plain text\n");
+	LOGB(DRLL, LOGL_INFO, "ints: %d %i %u %x %X %o %c %hhd %hu\n",
+	     -42, 7, 4000000000u, 0xbeef, 0xbeef, 8, 'Z', (signed char)-1, (unsigned short)65535);
+	LOGB(DRLL, LOGL_INFO, "longs: %ld %lu %lld %llx %zu %zd %jd %td\n",
+	     -1234567890123L, 1234567890123UL, -9000000000000000000LL, 0x123456789abcdefULL,
+	     (size_t)12345, (ssize_t)-12345, (intmax_t)-1, (ptrdiff_t)-2);
+	LOGB(DCC, LOGL_NOTICE, "floats: %f %.2e %g %10.3f %Lf\n", 3.25, 12345.678, 0.0001, -2.5,
+	     (long double)1.5);
+	LOGB(DCC, LOGL_ERROR, "strings: '%s' '%10s' '%-6s|' '%.3s' '%.*s'\n",
+	     "hello", "right", "left", "truncated", 2, not_terminated);
+	LOGB(DCC, LOGL_ERROR, "widths: '%*d' '%-*d' '%.*f' 100%%\n", 6, 42, 5, 7, 1, 2.25);
+	LOGB(DCC, LOGL_ERROR, "pointer: %p\n", NULL);
+	LOGB(DCC, LOGL_ERROR, "positional: %2$s %1$s\n", "world", "hello");
+	/* filtered out by the category log level, not recorded */
+	LOGP(DCC, LOGL_INFO, "not logged\n");
+	LOGB(DRLL, LOGL_INFO, "plain text\n");
+
+	map = read_file(&len);
+	printf("records: %u\n", for_each_rec(map, check_rec));
+	printf("all messages found: %s\n", checked == num_expected ? "yes" : "no");
+	free(map);
+}
+
+static unsigned int wrap_count;
+static int wrap_last;
+static bool wrap_gap;
+
+static void check_wrap(const uint8_t *map, const struct log_binary_rec *rec)
+{
+	char buf[4096];
+	int seq;
+
+	render(map, rec, buf, sizeof(buf));
+	OSMO_ASSERT(sscanf(buf, "wrap %d", &seq) == 1);
+	if (wrap_count && seq != wrap_last + 1)
+		wrap_gap = true;
+	wrap_last = seq;
+	wrap_count++;
+}
+
+static void test_wrap(void)
+{
+	const struct log_binary_hdr *hdr;
+	struct log_target *tgt;
+	uint8_t *map;
+	size_t len;
+	int i;
+
+	printf("Testing ring wrap-around\n");
+
+	tgt = log_target_create_binary(fname, 1);
+	OSMO_ASSERT(tgt);
+	OSMO_ASSERT(tgt->tgt_binary.size == 64 * 1024);
+	log_set_all_filter(tgt, 1);
+	log_add_target(tgt);
+
+	for (i = 0; i < 5000; i++)
+		LOGP(DRLL, LOGL_INFO, "wrap %d %s\n", i, "with some padding text to make it longer");
+
+	map = read_file(&len);
+	hdr = (const struct log_binary_hdr *)map;
+	for_each_rec(map, check_wrap);
+	printf("ring overwritten: %s, oldest records dropped: %s\n",
+	       hdr->head > hdr->ring_size ? "yes" : "no", hdr->tail > 0 ? "yes" : "no");
+	printf("last record: %d, records consecutive: %s, ring used: %s\n", wrap_last,
+	       wrap_gap ? "no" : "yes",
+	       hdr->head - hdr->tail <= hdr->ring_size && hdr->head - hdr->tail > hdr->ring_size / 2 ? "yes" : "no");
+	free(map);
+
+	log_target_destroy(tgt);
+}
+
+int main(int argc, char **argv)
+{
+	struct log_target *tgt;
+	int fd;
+
+	log_init(&log_info, NULL);
+
+	fd = mkstemp(fname);
+	OSMO_ASSERT(fd >= 0);
+	close(fd);
+
+	tgt = log_target_create_binary(fname, 0);
+	OSMO_ASSERT(tgt);
+	log_set_all_filter(tgt, 1);
+	log_add_target(tgt);
+
+	test_formats();
+	log_target_destroy(tgt);
+
+	test_wrap();
+
+	unlink(fname);
+	return 0;
+}
@@ -16,9 +16,11 @@
  */
 
 #include <osmocom/core/logging.h>
+#include <osmocom/core/timer.h>
 #include <osmocom/core/utils.h>
 
 #include <stdlib.h>
+#include <time.h>
 
 enum {
 	DRLL,
@@ -68,6 +70,7 @@ extern struct log_info *osmo_log_info;
 int main(int argc, char **argv)
 {
 	struct log_target *stderr_target;
+	int ext;
 
 	log_init(&log_info, NULL);
 	stderr_target = log_target_create_stderr();
@@ -138,5 +141,25 @@ int main(int argc, char **argv)
 	log_set_print_filename_pos(stderr_target, LOG_FILENAME_POS_LINE_END);
 	DEBUGP(DLGLOBAL, "A message with source info printed last\n");
 
+	/* Test the timestamp strings, which are cached for the current second */
+	log_set_print_filename2(stderr_target, LOG_FILENAME_NONE);
+	setenv("TZ", "UTC", 1);
+	tzset();
+	osmo_gettimeofday_override = true;
+	for (ext = 1; ext >= 0; ext--) {
+		log_set_print_extended_timestamp(stderr_target, ext);
+		log_set_print_timestamp(stderr_target, !ext);
+		/* 2023-11-14 22:13:58.005 UTC */
+		osmo_gettimeofday_override_time = (struct timeval){ .tv_sec = 1700000038, .tv_usec = 5000 };
+		DEBUGP(DLGLOBAL, "Timestamp\n");
+		osmo_gettimeofday_override_add(0, 990000);
+		DEBUGP(DLGLOBAL, "Timestamp within the same second\n");
+		osmo_gettimeofday_override_add(0, 10000);
+		DEBUGP(DLGLOBAL, "Timestamp across a second boundary\n");
+		osmo_gettimeofday_override_add(1, 0);
+		DEBUGP(DLGLOBAL, "Timestamp across a minute boundary\n");
+	}
+	osmo_gettimeofday_override = false;
+
 	return 0;
 }
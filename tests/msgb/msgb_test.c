@@ -19,7 +19,9 @@
 #include <osmocom/core/logging.h>
 #include <osmocom/core/utils.h>
 #include <osmocom/core/msgb.h>
+#include <osmocom/core/rate_ctr.h>
 #include <setjmp.h>
+#include <inttypes.h>
 
 #include <errno.h>
 
@@ -389,6 +391,110 @@ static void test_msgb_printf(void)
 	msgb_free(msg_ref);
 }
 
+static void print_pool_ctrs(const char *label)
+{
+	struct rate_ctr_group *ctrg = msgb_pool_get_ctrg();
+
+	printf("%s: hit=%" PRIu64 " miss=%" PRIu64 " cached=%" PRIu64 " released=%" PRIu64 "\n", label,
+	       rate_ctr_group_get_ctr(ctrg, MSGB_POOL_CTR_ALLOC_HIT)->current,
+	       rate_ctr_group_get_ctr(ctrg, MSGB_POOL_CTR_ALLOC_MISS)->current,
+	       rate_ctr_group_get_ctr(ctrg, MSGB_POOL_CTR_FREE_CACHED)->current,
+	       rate_ctr_group_get_ctr(ctrg, MSGB_POOL_CTR_FREE_RELEASED)->current);
+}
+
+static int pool_test_destructor_called;
+static int pool_test_destructor(struct msgb *msg)
+{
+	pool_test_destructor_called++;
+	return 0;
+}
+
+static void test_msgb_pool(void)
+{
+	static const uint16_t sizes[] = { 64, 256 };
+	static const uint16_t bad_sizes[] = { 256, 64 };
+	void *ctx = talloc_named_const(NULL, 0, "msgb_pool_test");
+	struct msgb *msg, *msg2, *msg3;
+	int rc;
+
+	printf("Testing msgb pool\n");
+
+	OSMO_ASSERT(msgb_pool_get_ctrg() == NULL);
+	rc = msgb_pool_init(ctx, bad_sizes, ARRAY_SIZE(bad_sizes), 1, 0);
+	OSMO_ASSERT(rc == -EINVAL);
+	rc = msgb_pool_init(ctx, sizes, ARRAY_SIZE(sizes), 1, 0);
+	OSMO_ASSERT(rc == 0);
+	rc = msgb_pool_init(ctx, sizes, ARRAY_SIZE(sizes), 1, 0);
+	OSMO_ASSERT(rc == -EALREADY);
+
+	/* the first allocation of a class misses, the msgb is recycled on free and re-used */
+	msg = msgb_alloc_headroom(50, 10, "pool1");
+	OSMO_ASSERT(msg->data_len == 50);
+	OSMO_ASSERT(msgb_headroom(msg) == 10);
+	OSMO_ASSERT(msgb_tailroom(msg) == 40);
+	msgb_put_u8(msg, 0x23);
+	msg->l2h = msg->data;
+	msg->cb[0] = 42;
+	msgb_free(msg);
+	print_pool_ctrs("after first free");
+
+	msg2 = msgb_alloc(60, "pool2");
+	OSMO_ASSERT(msg2 == msg);
+	OSMO_ASSERT(msg2->data_len == 60);
+	OSMO_ASSERT(msgb_length(msg2) == 0);
+	OSMO_ASSERT(msgb_tailroom(msg2) == 60);
+	OSMO_ASSERT(msg2->l2h == NULL);
+	OSMO_ASSERT(msg2->cb[0] == 0);
+	OSMO_ASSERT(!strcmp(talloc_get_name(msg2), "pool2"));
+	print_pool_ctrs("after re-use");
+
+	/* msgb with talloc children are not recycled */
+	talloc_strdup(msg2, "child");
+	msgb_free(msg2);
+	print_pool_ctrs("after free with child");
+
+	/* msgb with a talloc destructor are not recycled, and the destructor runs */
+	msg = msgb_alloc(60, "pool7");
+	talloc_set_destructor(msg, pool_test_destructor);
+	msgb_free(msg);
+	OSMO_ASSERT(pool_test_destructor_called == 1);
+	print_pool_ctrs("after free with destructor");
+
+	/* talloc_free() of the parent context frees pool msgb instead of recycling them */
+	msg = msgb_alloc_c(ctx, 60, "pool8");
+	msg2 = msgb_alloc_c(msg, 60, "pool9");
+	talloc_free(msg);
+	print_pool_ctrs("after talloc_free of parent");
+
+	/* larger than the largest size class: not handled by the pool at all */
+	msg = msgb_alloc(1000, "pool3");
+	OSMO_ASSERT(msg->data_len == 1000);
+	msgb_free(msg);
+	print_pool_ctrs("after large msgb");
+
+	/* only max_cached msgb are kept per size class */
+	msg = msgb_alloc(200, "pool4");
+	msg2 = msgb_alloc(200, "pool5");
+	msgb_free(msg);
+	msgb_free(msg2);
+	print_pool_ctrs("after free of two");
+	msg3 = msgb_alloc(256, "pool6");
+	OSMO_ASSERT(msg3 == msg);
+	msgb_free(msg3);
+	print_pool_ctrs("after third");
+
+	msgb_pool_destroy();
+	OSMO_ASSERT(msgb_pool_get_ctrg() == NULL);
+	OSMO_ASSERT(talloc_total_blocks(ctx) == 1);
+
+	/* without pool, msgb are zero-initialized again */
+	msg = msgb_alloc(64, "nopool");
+	OSMO_ASSERT(msg->_data[0] == 0);
+	msgb_free(msg);
+
+	talloc_free(ctx);
+}
+
 static struct log_info info = {};
 
 int main(int argc, char **argv)
@@ -402,6 +508,7 @@ int main(int argc, char **argv)
 	test_msgb_copy();
 	test_msgb_resize_area();
 	test_msgb_printf();
+	test_msgb_pool();
 
 	printf("Success.\n");
 
@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 #include <errno.h>
 
 #include <osmocom/core/application.h>
@@ -33,6 +34,7 @@
 #include <osmocom/core/msgb.h>
 #include <osmocom/core/osmo_io.h>
 #include <osmocom/core/select.h>
+#include <osmocom/core/socket.h>
 #include <osmocom/core/utils.h>
 
 #include "config.h"
@@ -247,6 +249,319 @@ static void test_unconnected(void)
 	for (int i = 0; i < 128; i++)
 		osmo_select_main(1);
 }
+
+#define NUM_BATCH_MSGS 10
+
+static unsigned int batch_tx_count;
+static unsigned int batch_rx_count;
+static bool batch_error;
+
+/* The backends interleave send and receive completions differently, so only count them here */
+static void batch_recvfrom_cb(struct osmo_io_fd *iofd, int rc, struct msgb *msg,
+			      const struct osmo_sockaddr *saddr)
+{
+	if (rc != sizeof(TESTDATA) || !msg || msgb_data(msg)[0] != batch_rx_count ||
+	    memcmp(msgb_data(msg) + 1, TESTDATA + 1, sizeof(TESTDATA) - 1))
+		batch_error = true;
+	batch_rx_count++;
+	talloc_free(msg);
+}
+
+static void batch_sendto_cb(struct osmo_io_fd *iofd, int rc, struct msgb *msg,
+			    const struct osmo_sockaddr *daddr)
+{
+	if (rc != sizeof(TESTDATA))
+		batch_error = true;
+	batch_tx_count++;
+}
+
+struct osmo_io_ops ioops_batch_recvfrom_sendto = {
+	.sendto_cb = batch_sendto_cb,
+	.recvfrom_cb = batch_recvfrom_cb,
+};
+
+static void test_unconnected_batch(void)
+{
+	int fds[2] = {0, 0}, rc;
+	struct osmo_io_fd *iofd1, *iofd2;
+	struct msgb *msg;
+	uint8_t *buf;
+
+	TEST_START();
+
+	rc = socketpair(AF_UNIX, SOCK_DGRAM, 0, fds);
+	OSMO_ASSERT(rc == 0);
+
+	iofd1 = osmo_iofd_setup(ctx, fds[0], "ep1", OSMO_IO_FD_MODE_RECVFROM_SENDTO, &ioops_batch_recvfrom_sendto, NULL);
+	OSMO_ASSERT(osmo_iofd_set_batch_size(iofd1, 8) == 0);
+	osmo_iofd_register(iofd1, fds[0]);
+	iofd2 = osmo_iofd_setup(ctx, fds[1], "ep2", OSMO_IO_FD_MODE_RECVFROM_SENDTO, &ioops_batch_recvfrom_sendto, NULL);
+	OSMO_ASSERT(osmo_iofd_set_batch_size(iofd2, 8) == 0);
+	OSMO_ASSERT(osmo_iofd_set_batch_size(iofd2, OSMO_IO_BATCH_SIZE_MAX + 1) == -EINVAL);
+	osmo_iofd_register(iofd2, fds[1]);
+
+	/* more messages than fit into one batch, all queued before the socket is served */
+	for (int i = 0; i < NUM_BATCH_MSGS; i++) {
+		msg = msgb_alloc(1024, "Test data");
+		buf = msgb_put(msg, sizeof(TESTDATA));
+		memcpy(buf, TESTDATA, sizeof(TESTDATA));
+		buf[0] = i;
+		osmo_iofd_sendto_msgb(iofd1, msg, 0, NULL);
+	}
+
+	/* Allow enough cycles to handle the messages */
+	for (int i = 0; i < 128; i++)
+		osmo_select_main(1);
+	printf("sent %u, received %u messages%s\n", batch_tx_count, batch_rx_count,
+	       batch_error ? " (with errors)" : "");
+	OSMO_ASSERT(batch_tx_count == NUM_BATCH_MSGS && batch_rx_count == NUM_BATCH_MSGS && !batch_error);
+
+	osmo_iofd_free(iofd1);
+	osmo_iofd_free(iofd2);
+
+	for (int i = 0; i < 128; i++)
+		osmo_select_main(1);
+}
+
+/* create a non-blocking UDP socket bound to a random port on the loopback address */
+static int udp_loopback_socket(struct osmo_sockaddr *local)
+{
+	socklen_t len = sizeof(local->u.sas);
+	int fd, rc;
+
+	memset(local, 0, sizeof(*local));
+	local->u.sin.sin_family = AF_INET;
+	local->u.sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	OSMO_ASSERT(fd >= 0);
+	rc = bind(fd, &local->u.sa, sizeof(local->u.sin));
+	OSMO_ASSERT(rc == 0);
+	rc = getsockname(fd, &local->u.sa, &len);
+	OSMO_ASSERT(rc == 0);
+	return fd;
+}
+
+#define NUM_MANY_MSGS 100
+
+static unsigned int many_rx_count;
+static bool many_rx_seen[NUM_MANY_MSGS];
+static bool many_rx_error;
+
+static void many_recvfrom_cb(struct osmo_io_fd *iofd, int rc, struct msgb *msg,
+			     const struct osmo_sockaddr *saddr)
+{
+	uint16_t seq;
+
+	if (rc != sizeof(seq) || !msg) {
+		many_rx_error = true;
+	} else {
+		seq = osmo_load16be(msgb_data(msg));
+		if (seq >= NUM_MANY_MSGS || many_rx_seen[seq])
+			many_rx_error = true;
+		else
+			many_rx_seen[seq] = true;
+		many_rx_count++;
+	}
+	msgb_free(msg);
+}
+
+/* More datagrams are queued on the socket when the receive is armed than the io_uring backend provides buffers
+ * for a multishot receive, so that its buffer ring runs empty and the receive has to be re-armed. */
+static void test_unconnected_many(void)
+{
+	struct osmo_io_ops ioops = { .recvfrom_cb = many_recvfrom_cb };
+	struct osmo_sockaddr rx_addr, tx_addr;
+	struct osmo_io_fd *iofd;
+	int rx_fd, tx_fd, rc;
+	uint8_t buf[2];
+
+	TEST_START();
+
+	rx_fd = udp_loopback_socket(&rx_addr);
+	tx_fd = udp_loopback_socket(&tx_addr);
+
+	iofd = osmo_iofd_setup(ctx, rx_fd, "rx", OSMO_IO_FD_MODE_RECVFROM_SENDTO, &ioops, NULL);
+	osmo_iofd_register(iofd, rx_fd);
+
+	for (int i = 0; i < NUM_MANY_MSGS; i++) {
+		osmo_store16be(i, buf);
+		rc = sendto(tx_fd, buf, sizeof(buf), 0, &rx_addr.u.sa, sizeof(rx_addr.u.sin));
+		OSMO_ASSERT(rc == sizeof(buf));
+	}
+
+	/* Allow enough cycles to handle the messages */
+	for (int i = 0; i < 1000 && many_rx_count < NUM_MANY_MSGS; i++) {
+		osmo_select_main(1);
+		usleep(1000);
+	}
+	printf("received %u of %u messages%s\n", many_rx_count, NUM_MANY_MSGS,
+	       many_rx_error ? " (with errors)" : "");
+	OSMO_ASSERT(many_rx_count == NUM_MANY_MSGS && !many_rx_error);
+
+	osmo_iofd_free(iofd);
+	close(tx_fd);
+
+	for (int i = 0; i < 128; i++)
+		osmo_select_main(1);
+}
+
+static unsigned int order_rx_count;
+static bool order_rx_error;
+
+static void order_recvmsg_cb(struct osmo_io_fd *iofd, int rc, struct msgb *msg, const struct msghdr *msgh)
+{
+	if (rc != sizeof(uint16_t) || !msg || osmo_load16be(msgb_data(msg)) != order_rx_count)
+		order_rx_error = true;
+	else
+		order_rx_count++;
+	msgb_free(msg);
+}
+
+/* RECVMSG mode serves ordered sockets like SCTP, messages have to be handed to the user in order */
+static void test_recvmsg_order(void)
+{
+	struct osmo_io_ops ioops = { .recvmsg_cb = order_recvmsg_cb };
+	struct osmo_io_fd *iofd;
+	int fds[2], rc;
+	uint8_t buf[2];
+
+	TEST_START();
+
+	rc = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds);
+	OSMO_ASSERT(rc == 0);
+
+	iofd = osmo_iofd_setup(ctx, fds[0], "seqpacket", OSMO_IO_FD_MODE_RECVMSG_SENDMSG, &ioops, NULL);
+	osmo_iofd_register(iofd, fds[0]);
+
+	for (int i = 0; i < NUM_MANY_MSGS; i++) {
+		osmo_store16be(i, buf);
+		rc = send(fds[1], buf, sizeof(buf), 0);
+		OSMO_ASSERT(rc == sizeof(buf));
+	}
+
+	for (int i = 0; i < 1000 && order_rx_count < NUM_MANY_MSGS && !order_rx_error; i++)
+		osmo_select_main(1);
+	printf("received %u of %u messages%s\n", order_rx_count, NUM_MANY_MSGS,
+	       order_rx_error ? " (out of order)" : " in order");
+	OSMO_ASSERT(order_rx_count == NUM_MANY_MSGS && !order_rx_error);
+
+	osmo_iofd_free(iofd);
+	close(fds[1]);
+
+	for (int i = 0; i < 128; i++)
+		osmo_select_main(1);
+}
+
+static void deferred_sendto_cb(struct osmo_io_fd *iofd, int rc, struct msgb *msg,
+			       const struct osmo_sockaddr *daddr)
+{
+	printf("%s: sendto() returned rc=%d\n", osmo_iofd_get_name(iofd), rc);
+}
+
+/* Messages are only queued by osmo_iofd_sendto_msgb(), they are handed to the kernel from osmo_select_main() */
+static void test_sendto_deferred(void)
+{
+	struct osmo_io_ops ioops = { .sendto_cb = deferred_sendto_cb };
+	struct osmo_sockaddr rx_addr, tx_addr;
+	struct osmo_io_fd *iofd;
+	struct msgb *msg;
+	uint8_t buf[sizeof(TESTDATA)];
+	int rx_fd, tx_fd, rc;
+
+	TEST_START();
+
+	rx_fd = udp_loopback_socket(&rx_addr);
+	tx_fd = udp_loopback_socket(&tx_addr);
+
+	iofd = osmo_iofd_setup(ctx, tx_fd, "tx", OSMO_IO_FD_MODE_RECVFROM_SENDTO, &ioops, NULL);
+	osmo_iofd_register(iofd, tx_fd);
+
+	msg = msgb_alloc(1024, "Test data");
+	memcpy(msgb_put(msg, sizeof(TESTDATA)), TESTDATA, sizeof(TESTDATA));
+	rc = osmo_iofd_sendto_msgb(iofd, msg, 0, &rx_addr);
+	OSMO_ASSERT(rc == 0);
+
+	rc = recv(rx_fd, buf, sizeof(buf), MSG_DONTWAIT);
+	OSMO_ASSERT(rc < 0 && errno == EAGAIN);
+	printf("nothing received before osmo_select_main()\n");
+
+	for (int i = 0; i < 1000; i++) {
+		osmo_select_main(1);
+		rc = recv(rx_fd, buf, sizeof(buf), MSG_DONTWAIT);
+		if (rc >= 0)
+			break;
+		usleep(1000);
+	}
+	printf("received %d bytes after osmo_select_main()\n", rc);
+	OSMO_ASSERT(rc == sizeof(TESTDATA) && !memcmp(buf, TESTDATA, sizeof(TESTDATA)));
+
+	osmo_iofd_free(iofd);
+	close(rx_fd);
+
+	for (int i = 0; i < 128; i++)
+		osmo_select_main(1);
+}
+
+/* With LIBOSMO_IO_URING_MULTISHOT=0 and LIBOSMO_IO_URING_READ_SQES=8, the reads armed for this many iofds within
+ * one event loop iteration exceed the io_uring submission queue, which then has to be flushed in between. */
+#define NUM_MANY_IOFDS 520
+
+static unsigned int many_iofds_rx_count[NUM_MANY_IOFDS];
+
+static void many_iofds_recvfrom_cb(struct osmo_io_fd *iofd, int rc, struct msgb *msg,
+				   const struct osmo_sockaddr *saddr)
+{
+	if (rc > 0)
+		many_iofds_rx_count[osmo_iofd_get_priv_nr(iofd)]++;
+	msgb_free(msg);
+}
+
+static void test_unconnected_many_iofds(void)
+{
+	struct osmo_io_ops ioops = { .recvfrom_cb = many_iofds_recvfrom_cb };
+	struct osmo_io_fd *iofd[NUM_MANY_IOFDS];
+	struct osmo_sockaddr rx_addr[NUM_MANY_IOFDS], tx_addr;
+	unsigned int num_done;
+	int fd, tx_fd, rc;
+
+	TEST_START();
+
+	for (int i = 0; i < NUM_MANY_IOFDS; i++) {
+		fd = udp_loopback_socket(&rx_addr[i]);
+		iofd[i] = osmo_iofd_setup(ctx, fd, "rx", OSMO_IO_FD_MODE_RECVFROM_SENDTO, &ioops, NULL);
+		osmo_iofd_set_priv_nr(iofd[i], i);
+		osmo_iofd_set_alloc_info(iofd[i], 64, 0);
+		osmo_iofd_register(iofd[i], fd);
+	}
+
+	tx_fd = udp_loopback_socket(&tx_addr);
+	for (int i = 0; i < NUM_MANY_IOFDS; i++) {
+		rc = sendto(tx_fd, TESTDATA, sizeof(TESTDATA), 0, &rx_addr[i].u.sa, sizeof(rx_addr[i].u.sin));
+		OSMO_ASSERT(rc == sizeof(TESTDATA));
+	}
+
+	/* Allow enough cycles to handle the messages */
+	for (int i = 0; i < 1000; i++) {
+		osmo_select_main(1);
+		num_done = 0;
+		for (int j = 0; j < NUM_MANY_IOFDS; j++)
+			num_done += many_iofds_rx_count[j] == 1;
+		if (num_done == NUM_MANY_IOFDS)
+			break;
+		usleep(1000);
+	}
+	printf("%u of %u iofds received their message\n", num_done, NUM_MANY_IOFDS);
+	OSMO_ASSERT(num_done == NUM_MANY_IOFDS);
+
+	for (int i = 0; i < NUM_MANY_IOFDS; i++)
+		osmo_iofd_free(iofd[i]);
+	close(tx_fd);
+
+	for (int i = 0; i < 128; i++)
+		osmo_select_main(1);
+}
+
 static const struct log_info_cat default_categories[] = {
 };
 
@@ -267,6 +582,11 @@ int main(int argc, char *argv[])
 	test_file();
 	test_connected();
 	test_unconnected();
+	test_unconnected_batch();
+	test_unconnected_many();
+	test_recvmsg_order();
+	test_sendto_deferred();
+	test_unconnected_many_iofds();
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,203 @@
+/* tests for the shared memory stats export */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/rate_ctr.h>
+#include <osmocom/core/stat_item.h>
+#include <osmocom/core/stats.h>
+#include <osmocom/core/stats_shm.h>
+
+static const struct rate_ctr_desc ctr_desc[] = {
+	{ "rx", "received frames" },
+	{ "tx", "sent frames" },
+};
+
+static const struct rate_ctr_group_desc ctrg_desc = {
+	.group_name_prefix = "shm-ctr",
+	.group_description = "shm test counters",
+	.class_id = OSMO_STATS_CLASS_PEER,
+	.num_ctr = ARRAY_SIZE(ctr_desc),
+	.ctr_desc = ctr_desc,
+};
+
+static const struct osmo_stat_item_desc item_desc[] = {
+	{ "queue:len", "queue length", OSMO_STAT_ITEM_NO_UNIT, 4, -1 },
+};
+
+static const struct osmo_stat_item_group_desc statg_desc = {
+	.group_name_prefix = "shm-item",
+	.group_description = "shm test items",
+	.class_id = OSMO_STATS_CLASS_GLOBAL,
+	.num_items = ARRAY_SIZE(item_desc),
+	.item_desc = item_desc,
+};
+
+static char path[64];
+
+static const char *rc_str(int rc)
+{
+	static char buf[16];
+
+	switch (rc) {
+	case -ESTALE:
+		return "-ESTALE";
+	case -ENODEV:
+		return "-ENODEV";
+	default:
+		snprintf(buf, sizeof(buf), "%d", rc);
+		return buf;
+	}
+}
+
+static const struct osmo_stats_shm_hdr *map_file(size_t *len)
+{
+	const struct osmo_stats_shm_hdr *hdr;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	OSMO_ASSERT(fd >= 0);
+	OSMO_ASSERT(fstat(fd, &st) == 0);
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	OSMO_ASSERT(hdr != MAP_FAILED);
+	close(fd);
+
+	OSMO_ASSERT(!memcmp(hdr->magic, OSMO_STATS_SHM_MAGIC, sizeof(hdr->magic)));
+	OSMO_ASSERT(hdr->version == OSMO_STATS_SHM_VERSION);
+	OSMO_ASSERT(hdr->byte_order == OSMO_STATS_SHM_BYTE_ORDER);
+	OSMO_ASSERT(hdr->pid == getpid());
+	OSMO_ASSERT(hdr->file_size == st.st_size);
+	OSMO_ASSERT((hdr->values_off & 63) == 0);
+	*len = st.st_size;
+	return hdr;
+}
+
+static void dump(const struct osmo_stats_shm_hdr *hdr)
+{
+	const struct osmo_stats_shm_entry *e = (const void *)((const uint8_t *)hdr + hdr->entries_off);
+	const char *names = (const char *)hdr + hdr->names_off;
+	int64_t values[16];
+	unsigned int i;
+	int rc;
+
+	OSMO_ASSERT(hdr->num_entries <= ARRAY_SIZE(values));
+	rc = osmo_stats_shm_read_values(hdr, values, NULL);
+	printf("  %u values, rc=%s\n", hdr->num_entries, rc_str(rc));
+	if (rc < 0)
+		return;
+	for (i = 0; i < hdr->num_entries; i++) {
+		OSMO_ASSERT(strlen(names + e[i].name_off) == e[i].name_len);
+		printf("  %s %s class=%u: %" PRId64 "\n", e[i].kind == OSMO_STATS_SHM_RATE_CTR ? "ctr " : "item",
+		       names + e[i].name_off, e[i].class_id, values[i]);
+	}
+}
+
+/* check that the mapping got obsolete, and map the file again */
+static const struct osmo_stats_shm_hdr *remap(const struct osmo_stats_shm_hdr *hdr, size_t *len)
+{
+	int64_t values[16];
+
+	printf("  old mapping: rc=%s\n", rc_str(osmo_stats_shm_read_values(hdr, values, NULL)));
+	munmap((void *)hdr, *len);
+	return map_file(len);
+}
+
+static void test_stats_shm(void)
+{
+	const struct osmo_stats_shm_hdr *hdr;
+	struct rate_ctr_group *ctrg, *ctrg2;
+	struct osmo_stat_item_group *statg;
+	size_t len;
+
+	printf("Testing the shared memory stats export\n");
+
+	snprintf(path, sizeof(path), "stats_shm_test.%d", (int)getpid());
+	osmo_stats_shm_set_interval(0);
+
+	ctrg = rate_ctr_group_alloc(NULL, &ctrg_desc, 0);
+	statg = osmo_stat_item_group_alloc(NULL, &statg_desc, 0);
+	OSMO_ASSERT(ctrg && statg);
+
+	OSMO_ASSERT(osmo_stats_shm_open(path) == 0);
+	hdr = map_file(&len);
+	dump(hdr);
+
+	printf("Changing values, no update yet\n");
+	rate_ctr_add2(ctrg, 0, 5);
+	rate_ctr_inc2(ctrg, 1);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(statg, 0), 42);
+	dump(hdr);
+
+	printf("Update\n");
+	OSMO_ASSERT(osmo_stats_shm_update() == 0);
+	dump(hdr);
+
+	printf("Allocating a sharded group\n");
+	ctrg2 = rate_ctr_group_alloc_sharded(NULL, &ctrg_desc, 1, 2);
+	OSMO_ASSERT(ctrg2);
+	rate_ctr_add2(ctrg2, 1, 1000);
+	OSMO_ASSERT(osmo_stats_shm_update() == 0);
+	hdr = remap(hdr, &len);
+	dump(hdr);
+
+	printf("Naming the sharded group\n");
+	rate_ctr_group_set_name(ctrg2, "trunk-a");
+	OSMO_ASSERT(osmo_stats_shm_update() == 0);
+	hdr = remap(hdr, &len);
+	dump(hdr);
+
+	printf("Changing the index of the first group\n");
+	rate_ctr_group_upd_idx(ctrg, 7);
+	OSMO_ASSERT(osmo_stats_shm_update() == 0);
+	hdr = remap(hdr, &len);
+	dump(hdr);
+
+	printf("Freeing groups\n");
+	rate_ctr_group_free(ctrg2);
+	osmo_stat_item_group_free(statg);
+	rate_ctr_inc2(ctrg, 0);
+	OSMO_ASSERT(osmo_stats_shm_update() == 0);
+	hdr = remap(hdr, &len);
+	dump(hdr);
+
+	printf("Closing\n");
+	osmo_stats_shm_close();
+	printf("  old mapping: rc=%s\n", rc_str(osmo_stats_shm_read_values(hdr, NULL, NULL)));
+	printf("  file exists: %d\n", access(path, F_OK) == 0);
+	printf("  update: rc=%s\n", rc_str(osmo_stats_shm_update()));
+	munmap((void *)hdr, len);
+
+	rate_ctr_group_free(ctrg);
+}
+
+int main(int argc, char **argv)
+{
+	test_stats_shm();
+	return EXIT_SUCCESS;
+}
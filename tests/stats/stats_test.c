@@ -24,11 +24,17 @@
 #include <osmocom/core/stat_item.h>
 #include <osmocom/core/rate_ctr.h>
 #include <osmocom/core/stats.h>
+#include <osmocom/core/counter.h>
 
 #include <stat_item_internal.h>
 
 #include <stdio.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 enum test_ctr {
 	TEST_A_CTR,
@@ -495,6 +501,173 @@ static void test_reporting(void)
 	fprintf(stderr, "End test: %s\n", __func__);
 }
 
+#define SHARD_THREADS 6
+#define SHARD_INCS 100000
+
+static void *sharded_worker(void *data)
+{
+	struct rate_ctr_group *ctrg = data;
+	int i;
+
+	for (i = 0; i < SHARD_INCS; i++) {
+		rate_ctr_inc2(ctrg, TEST_A_CTR);
+		rate_ctr_add2(ctrg, TEST_B_CTR, 2);
+	}
+	return NULL;
+}
+
+static int sharded_sum_cb(struct rate_ctr_group *ctrg, struct rate_ctr *ctr,
+			  const struct rate_ctr_desc *desc, void *data)
+{
+	uint64_t *sum = data;
+	*sum += ctr->current;
+	return 0;
+}
+
+static void test_sharded_rate_ctr(void)
+{
+	struct rate_ctr_group *ctrg;
+	pthread_t threads[SHARD_THREADS];
+	uint64_t sum = 0;
+	int i;
+
+	/* fewer shards than threads, so that the shared overflow row is exercised too */
+	ctrg = rate_ctr_group_alloc_sharded(NULL, &ctrg_desc, 7, 4);
+	OSMO_ASSERT(ctrg);
+	OSMO_ASSERT(rate_ctr_get_group_by_name_idx("ctr-test:one", 7) == ctrg);
+
+	/* increments from the main thread and direct increments are both counted */
+	rate_ctr_inc2(ctrg, TEST_A_CTR);
+	rate_ctr_inc(rate_ctr_group_get_ctr(ctrg, TEST_B_CTR));
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, TEST_A_CTR)->current == 0);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, TEST_B_CTR)->current == 1);
+	rate_ctr_group_sync(ctrg);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, TEST_A_CTR)->current == 1);
+
+	for (i = 0; i < SHARD_THREADS; i++)
+		OSMO_ASSERT(pthread_create(&threads[i], NULL, sharded_worker, ctrg) == 0);
+	for (i = 0; i < SHARD_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	/* reading through the iterator folds in the per-thread rows */
+	rate_ctr_for_each_counter(ctrg, sharded_sum_cb, &sum);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, TEST_A_CTR)->current == 1 + SHARD_THREADS * SHARD_INCS);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, TEST_B_CTR)->current == 1 + SHARD_THREADS * SHARD_INCS * 2);
+	OSMO_ASSERT(sum == 2 + SHARD_THREADS * SHARD_INCS * 3);
+
+	/* a reset only drops what was accumulated so far */
+	rate_ctr_group_reset(ctrg);
+	rate_ctr_add2(ctrg, TEST_B_CTR, 5);
+	rate_ctr_group_sync(ctrg);
+	rate_ctr_group_sync(ctrg);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, TEST_A_CTR)->current == 0);
+	OSMO_ASSERT(rate_ctr_group_get_ctr(ctrg, TEST_B_CTR)->current == 5);
+
+	rate_ctr_group_free(ctrg);
+
+	fprintf(stderr, "End test: %s\n", __func__);
+}
+
+/* print all datagrams received on fd */
+static void print_statsd_datagrams(int fd)
+{
+	char buf[2048];
+	char *line, *next;
+	int len;
+
+	while ((len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT)) > 0) {
+		buf[len] = '\0';
+		fprintf(stderr, "  datagram of %d bytes:\n", len);
+		for (line = buf; line; line = next) {
+			next = strchr(line, '\n');
+			if (next)
+				*next++ = '\0';
+			fprintf(stderr, "    %s\n", line);
+		}
+	}
+}
+
+static void test_statsd(void)
+{
+	struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+	socklen_t sin_len = sizeof(sin);
+	struct osmo_stats_reporter *srep;
+	struct osmo_stat_item_group *statg;
+	struct rate_ctr_group *ctrg;
+	/* not part of ctrg_desc, its name is never cached */
+	const struct rate_ctr_desc extra_ctr_desc = { "test:counter", "standalone counter" };
+	int fd;
+
+	fprintf(stderr, "Start test: %s\n", __func__);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	OSMO_ASSERT(fd >= 0);
+	OSMO_ASSERT(bind(fd, (struct sockaddr *)&sin, sizeof(sin)) == 0);
+	OSMO_ASSERT(getsockname(fd, (struct sockaddr *)&sin, &sin_len) == 0);
+
+	ctrg = rate_ctr_group_alloc(NULL, &ctrg_desc, 5);
+	statg = osmo_stat_item_group_alloc(NULL, &statg_desc, 5);
+	OSMO_ASSERT(ctrg && statg);
+
+	srep = osmo_stats_reporter_create_statsd("statsd");
+	OSMO_ASSERT(srep);
+	OSMO_ASSERT(osmo_stats_reporter_set_remote_addr(srep, "127.0.0.1") == 0);
+	OSMO_ASSERT(osmo_stats_reporter_set_remote_port(srep, ntohs(sin.sin_port)) == 0);
+	/* 72 bytes of payload per datagram */
+	OSMO_ASSERT(osmo_stats_reporter_set_mtu(srep, 100) == 0);
+	OSMO_ASSERT(osmo_stats_reporter_set_max_class(srep, OSMO_STATS_CLASS_SUBSCRIBER) == 0);
+	OSMO_ASSERT(osmo_stats_reporter_set_name_prefix(srep, "pfx") == 0);
+	OSMO_ASSERT(osmo_stats_reporter_enable(srep) == 0);
+
+	fprintf(stderr, "report with all values\n");
+	rate_ctr_add2(ctrg, TEST_A_CTR, 3);
+	rate_ctr_add2(ctrg, TEST_B_CTR, 1000000);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(statg, TEST_A_ITEM), 42);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(statg, TEST_B_ITEM), -5);
+	osmo_stats_report();
+	print_statsd_datagrams(fd);
+
+	fprintf(stderr, "report counters with uncached names\n");
+	OSMO_ASSERT(srep->send_counter(srep, NULL, &extra_ctr_desc, 1, 1) == 0);
+	OSMO_ASSERT(srep->send_counter(srep, ctrg, &extra_ctr_desc, 2, 2) == 0);
+	osmo_stats_reporter_send_buffer(srep);
+	print_statsd_datagrams(fd);
+
+	fprintf(stderr, "report with only changed values\n");
+	rate_ctr_add2(ctrg, TEST_B_CTR, -2);
+	osmo_stats_report();
+	print_statsd_datagrams(fd);
+
+	fprintf(stderr, "report after naming the groups\n");
+	rate_ctr_group_set_name(ctrg, "trunk:a");
+	osmo_stat_item_group_set_name(statg, "trunk-b");
+	rate_ctr_inc2(ctrg, TEST_A_CTR);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(statg, TEST_A_ITEM), 43);
+	osmo_stats_report();
+	print_statsd_datagrams(fd);
+
+	fprintf(stderr, "report after changing the group index\n");
+	osmo_stat_item_group_set_name(statg, NULL);
+	osmo_stats_report();
+	print_statsd_datagrams(fd);
+	osmo_stat_item_group_udp_idx(statg, 6);
+	osmo_stat_item_set(osmo_stat_item_group_get_item(statg, TEST_A_ITEM), 44);
+	osmo_stats_report();
+	print_statsd_datagrams(fd);
+
+	fprintf(stderr, "report after removing the prefix (forces a flush)\n");
+	OSMO_ASSERT(osmo_stats_reporter_set_name_prefix(srep, NULL) == 0);
+	osmo_stats_report();
+	print_statsd_datagrams(fd);
+
+	osmo_stats_reporter_free(srep);
+	osmo_stat_item_group_free(statg);
+	rate_ctr_group_free(ctrg);
+	close(fd);
+
+	fprintf(stderr, "End test: %s\n", __func__);
+}
+
 int main(int argc, char **argv)
 {
 	void *ctx = talloc_named_const(NULL, 0, "main");
@@ -510,6 +683,8 @@ int main(int argc, char **argv)
 
 	stat_test();
 	test_reporting();
+	test_sharded_rate_ctr();
+	test_statsd();
 	talloc_free(ctx);
 	return 0;
 }
@@ -0,0 +1,171 @@
+/*
+ * Timer churn benchmark
+ *
+ * Schedules a large population of timers and then repeatedly re-arms,
+ * deletes and expires them while advancing a fake clock in 1ms steps, the
+ * way a busy BSC/MSC with many FSM instances would.  Which timer backend is
+ * measured is selected through the LIBOSMO_TIMER_BACKEND environment
+ * variable, so compare both by running:
+ *
+ *   LIBOSMO_TIMER_BACKEND=RBTREE ./timer_bench -n 100000
+ *   LIBOSMO_TIMER_BACKEND=WHEEL ./timer_bench -n 100000
+ *
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/timer_compat.h>
+
+struct bench_timer {
+	struct osmo_timer_list timer;
+	struct timeval deadline;
+	unsigned int fired;
+};
+
+static unsigned int n_timers = 20000;
+static unsigned int n_steps = 2000;
+static unsigned long n_ops;
+static unsigned long n_expired;
+static unsigned long n_early;
+
+static void bench_schedule(struct bench_timer *bt)
+{
+	struct timeval now, tv;
+	/* mostly short guard timers, some long ones (like T3212 or X-timers) */
+	unsigned int ms = (rand() & 7) ? 10 + rand() % 2000 : rand() % 600000;
+
+	osmo_gettimeofday(&now, NULL);
+	tv.tv_sec = ms / 1000;
+	tv.tv_usec = (ms % 1000) * 1000;
+	timeradd(&now, &tv, &bt->deadline);
+	osmo_timer_schedule(&bt->timer, tv.tv_sec, tv.tv_usec);
+	n_ops++;
+}
+
+static void bench_cb(void *data)
+{
+	struct bench_timer *bt = data;
+	struct timeval now;
+
+	osmo_gettimeofday(&now, NULL);
+	if (timercmp(&now, &bt->deadline, <))
+		n_early++;
+	bt->fired++;
+	n_expired++;
+	/* most expired timers are immediately re-armed by the next state */
+	if (rand() & 3)
+		bench_schedule(bt);
+}
+
+static double ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-n num_timers] [-s num_steps]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_timer *timers;
+	struct timespec t_start, t_end;
+	unsigned int i, j;
+	double ns;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (c) {
+		case 'n':
+			n_timers = atoi(optarg);
+			break;
+		case 's':
+			n_steps = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (n_timers == 0) {
+		help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	timers = calloc(n_timers, sizeof(*timers));
+	if (!timers)
+		exit(EXIT_FAILURE);
+
+	osmo_gettimeofday_override = true;
+	osmo_gettimeofday_override_time = (struct timeval){ 1000, 0 };
+
+	/* deterministic, so that both backends see the exact same workload */
+	srand(1);
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+
+	for (i = 0; i < n_timers; i++) {
+		osmo_timer_setup(&timers[i].timer, bench_cb, &timers[i]);
+		bench_schedule(&timers[i]);
+	}
+
+	for (i = 0; i < n_steps; i++) {
+		/* re-arm or stop a slice of the population, like FSM state changes do */
+		for (j = 0; j < n_timers / 100 + 1; j++) {
+			struct bench_timer *bt = &timers[rand() % n_timers];
+			if (rand() % 4 == 0) {
+				osmo_timer_del(&bt->timer);
+				n_ops++;
+			} else
+				bench_schedule(bt);
+		}
+		osmo_gettimeofday_override_add(0, 1000);
+		osmo_timers_prepare();
+		osmo_timers_update();
+	}
+
+	/* drain everything that is left */
+	for (i = 0; i < n_timers; i++) {
+		osmo_timer_del(&timers[i].timer);
+		n_ops++;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	ns = ts_diff_ns(&t_start, &t_end);
+
+	printf("backend: %s\n", osmo_timer_backend_name(osmo_timers_get_backend()));
+	printf("timers: %u, steps: %u, ops: %lu, expired: %lu\n", n_timers, n_steps, n_ops, n_expired);
+	printf("total: %.3f ms, %.1f ns/op\n", ns / 1e6, ns / (n_ops + n_expired));
+
+	if (osmo_timers_check() != 0) {
+		fprintf(stderr, "timers still pending after drain\n");
+		exit(EXIT_FAILURE);
+	}
+	if (n_early) {
+		fprintf(stderr, "%lu timers expired before their deadline\n", n_early);
+		exit(EXIT_FAILURE);
+	}
+
+	free(timers);
+	return EXIT_SUCCESS;
+}
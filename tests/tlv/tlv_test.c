@@ -332,6 +332,100 @@ static void test_tlv_encoder(void)
 	msgb_free(msg);
 }
 
+/* Check that all accessors of a tlv_parsed_sparse agree with a tlv_parsed */
+static void check_sparse_equal(const struct tlv_parsed *tp, const struct tlv_parsed_sparse *tps)
+{
+	struct tlv_parsed conv;
+	int tag;
+
+	for (tag = 0; tag < 256; tag++) {
+		OSMO_ASSERT(TLVP_PRESENT(tp, tag) == TLVPS_PRESENT(tps, tag));
+		OSMO_ASSERT(TLVP_VAL(tp, tag) == TLVPS_VAL(tps, tag));
+		OSMO_ASSERT(TLVP_LEN(tp, tag) == TLVPS_LEN(tps, tag));
+		OSMO_ASSERT(TLVP_PRES_LEN(tp, tag, 2) == TLVPS_PRES_LEN(tps, tag, 2));
+		OSMO_ASSERT(TLVP_VAL_MINLEN(tp, tag, 2) == TLVPS_VAL_MINLEN(tps, tag, 2));
+		OSMO_ASSERT(!TLVP_GET(tp, tag) == !TLVPS_GET(tps, tag));
+		OSMO_ASSERT(!TLVP_GET_MINLEN(tp, tag, 2) == !TLVPS_GET_MINLEN(tps, tag, 2));
+		OSMO_ASSERT(tlvp_val8(tp, tag, 0x55) == tlvps_val8(tps, tag, 0x55));
+	}
+
+	tlv_parsed_sparse_to_full(&conv, tps);
+	for (tag = 0; tag < 256; tag++) {
+		OSMO_ASSERT(conv.lv[tag].val == tp->lv[tag].val);
+		OSMO_ASSERT(conv.lv[tag].len == tp->lv[tag].len);
+	}
+}
+
+static void test_tlv_parse_sparse(void)
+{
+	/* tags out of order, a repeated IE, an empty IE and tags in all four bitmap words */
+	const uint8_t ies[] = {
+		0x01, 0xaa,			/* LV */
+		0x17, 0x02, 0x01, 0x02,
+		0x40, 0x42,
+		0x05, 0x00,
+		0xc3, 0x01, 0x99,
+		0x17, 0x01, 0x03,
+		0x81, 0x03, 0x04, 0x05, 0x06,
+		0x3f, 0x01, 0x07,
+		0xff, 0x02, 0x08, 0x09,
+	};
+	struct tlv_definition def = {};
+	struct tlv_parsed tp;
+	struct tlv_parsed_sparse tps;
+	uint8_t many[2 * (TLV_PARSED_SPARSE_MAX_IE + 1)];
+	int i, rc;
+
+	printf("Testing sparse TLV parser\n");
+
+	def.def[0x17].type = TLV_TYPE_TLV;
+	def.def[0x40].type = TLV_TYPE_TV;
+	def.def[0x05].type = TLV_TYPE_TLV;
+	def.def[0xc3].type = TLV_TYPE_TLV;
+	def.def[0x81].type = TLV_TYPE_TLV;
+	def.def[0x3f].type = TLV_TYPE_TLV;
+	def.def[0xff].type = TLV_TYPE_TLV;
+
+	rc = tlv_parse(&tp, &def, ies, sizeof(ies), 0x01, 0);
+	OSMO_ASSERT(rc == 9);
+	/* parse into a dirty struct, it must not matter */
+	memset(&tps, 0xab, sizeof(tps));
+	rc = tlv_parse_sparse(&tps, &def, ies, sizeof(ies), 0x01, 0);
+	printf("parsed %d IEs, %u different tags\n", rc, tps.num);
+	OSMO_ASSERT(rc == 9);
+	for (i = 0; i < tps.num; i++)
+		printf("  ie[%d]: tag 0x%02x, len %u, val at offset %td\n", i, tps.tag[i], tps.ie[i].len, tps.ie[i].val - ies);
+	check_sparse_equal(&tp, &tps);
+
+	/* a message from a real codec, using the first entries of the bitmap only */
+	rc = osmo_bssap_tlv_parse(&tp, ies + 2, 4);
+	OSMO_ASSERT(rc == 1);
+	rc = tlv_parse_sparse(&tps, gsm0808_att_tlvdef(), ies + 2, 4, 0, 0);
+	OSMO_ASSERT(rc == 1);
+	check_sparse_equal(&tp, &tps);
+
+	/* errors are reported like tlv_parse() does */
+	rc = tlv_parse_sparse(&tps, &def, ies, 5, 0x01, 0);
+	printf("truncated: %d\n", rc);
+	OSMO_ASSERT(rc == tlv_parse(&tp, &def, ies, 5, 0x01, 0));
+	rc = tlv_parse_sparse(&tps, &def, ies, sizeof(ies), 0, 0);
+	printf("unknown tag: %d\n", rc);
+	OSMO_ASSERT(rc == tlv_parse(&tp, &def, ies, sizeof(ies), 0, 0));
+
+	/* more different IEs than fit */
+	for (i = 0; i <= TLV_PARSED_SPARSE_MAX_IE; i++) {
+		def.def[0x80 + i].type = TLV_TYPE_TV;
+		many[2 * i] = 0x80 + i;
+		many[2 * i + 1] = i;
+	}
+	rc = tlv_parse_sparse(&tps, &def, many, sizeof(many) - 2, 0, 0);
+	printf("%d IEs: %d\n", TLV_PARSED_SPARSE_MAX_IE, rc);
+	OSMO_ASSERT(rc == TLV_PARSED_SPARSE_MAX_IE);
+	rc = tlv_parse_sparse(&tps, &def, many, sizeof(many), 0, 0);
+	printf("%d IEs: %d\n", TLV_PARSED_SPARSE_MAX_IE + 1, rc);
+	OSMO_ASSERT(rc == OSMO_TLVP_ERR_TOO_MANY_IES);
+}
+
 static void test_tlv_parser_bounds(void)
 {
 	struct tlv_definition tdef;
@@ -485,6 +579,7 @@ int main(int argc, char **argv)
 	test_tlv_shift_functions();
 	test_tlv_repeated_ie();
 	test_tlv_encoder();
+	test_tlv_parse_sparse();
 	test_tlv_parser_bounds();
 	test_tlv_lens();
 	test_tlv_type_single_tv();
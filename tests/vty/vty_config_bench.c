@@ -0,0 +1,226 @@
+/*
+ * VTY config file benchmark
+ *
+ * Installs a config node with a number of synthetic commands (keywords with
+ * numeric ranges, 'no' variants, IP addresses, alternatives and free form
+ * arguments, like the config nodes of a network element), writes a config
+ * file with the given number of lines to the current directory and measures
+ * vty_read_config_file() on it:
+ *
+ *   ./vty_config_bench -c 500 -n 100000 -r 5
+ *
+ * All rights reserved.
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/vty/vty.h>
+#include <osmocom/vty/command.h>
+
+enum bench_vty_node {
+	BENCH_NODE = _LAST_OSMOVTY_NODE + 1,
+};
+
+static struct cmd_node bench_node = {
+	BENCH_NODE,
+	"%s(config-bench)# ",
+	1
+};
+
+/* the kinds of synthetic commands, each installed n_cmds times */
+enum bench_cmd_kind {
+	CMD_RANGE,
+	CMD_NO_RANGE,
+	CMD_IP,
+	CMD_ALT,
+	CMD_WORD,
+	_NUM_CMD_KINDS
+};
+
+static unsigned int n_cmds = 500;
+static unsigned int n_lines = 100000;
+static unsigned int n_rounds = 5;
+static unsigned long n_called;
+
+DEFUN(cfg_bench, cfg_bench_cmd,
+	"bench",
+	"Enter the benchmark node\n")
+{
+	vty->node = BENCH_NODE;
+	return CMD_SUCCESS;
+}
+
+static int cfg_bench_param(struct cmd_element *self, struct vty *vty, int argc, const char *argv[])
+{
+	n_called++;
+	return CMD_SUCCESS;
+}
+
+static double ts_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-c num_commands] [-n num_lines] [-r rounds]\n", progname);
+}
+
+static void install_bench_cmds(void *ctx)
+{
+	struct cmd_element *cmd;
+	unsigned int i, k;
+
+	install_element(CONFIG_NODE, &cfg_bench_cmd);
+	install_node(&bench_node, NULL);
+
+	for (i = 0; i < n_cmds; i++) {
+		for (k = 0; k < _NUM_CMD_KINDS; k++) {
+			cmd = talloc_zero(ctx, struct cmd_element);
+			OSMO_ASSERT(cmd);
+			cmd->func = cfg_bench_param;
+			switch (k) {
+			case CMD_RANGE:
+				cmd->string = talloc_asprintf(cmd, "param-%u <0-65535>", i);
+				cmd->doc = "Set a parameter\nValue\n";
+				break;
+			case CMD_NO_RANGE:
+				cmd->string = talloc_asprintf(cmd, "no param-%u", i);
+				cmd->doc = NO_STR "Set a parameter\n";
+				break;
+			case CMD_IP:
+				cmd->string = talloc_asprintf(cmd, "peer-%u remote-ip A.B.C.D", i);
+				cmd->doc = "Configure a peer\nRemote address\nIP address\n";
+				break;
+			case CMD_ALT:
+				cmd->string = talloc_asprintf(cmd, "feature-%u (on|off|auto)", i);
+				cmd->doc = "Configure a feature\nEnable\nDisable\nAutomatic\n";
+				break;
+			case CMD_WORD:
+				cmd->string = talloc_asprintf(cmd, "description-%u .TEXT", i);
+				cmd->doc = "Set a description\nText\n";
+				break;
+			}
+			install_element(BENCH_NODE, cmd);
+		}
+	}
+}
+
+static void write_config(const char *path)
+{
+	unsigned int i, n;
+	FILE *f;
+
+	f = fopen(path, "w");
+	OSMO_ASSERT(f);
+	srandom(42);
+	fprintf(f, "bench\n");
+	for (i = 0; i < n_lines; i++) {
+		n = random() % n_cmds;
+		switch (i % _NUM_CMD_KINDS) {
+		case CMD_RANGE:
+			fprintf(f, " param-%u %u\n", n, i % 65536);
+			break;
+		case CMD_NO_RANGE:
+			fprintf(f, " no param-%u\n", n);
+			break;
+		case CMD_IP:
+			fprintf(f, " peer-%u remote-ip 10.%u.%u.%u\n", n, (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+			break;
+		case CMD_ALT:
+			fprintf(f, " feature-%u %s\n", n, i & 1 ? "on" : "auto");
+			break;
+		case CMD_WORD:
+			fprintf(f, " description-%u line %u of the benchmark\n", n, i);
+			break;
+		}
+	}
+	OSMO_ASSERT(fclose(f) == 0);
+}
+
+int main(int argc, char **argv)
+{
+	struct vty_app_info vty_info = {
+		.name = "vty_config_bench",
+	};
+	struct timespec t_start, t_end;
+	char path[64];
+	unsigned int r;
+	double ns;
+	void *ctx;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:n:r:h")) != -1) {
+		switch (c) {
+		case 'c':
+			n_cmds = atoi(optarg);
+			break;
+		case 'n':
+			n_lines = atoi(optarg);
+			break;
+		case 'r':
+			n_rounds = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			help(argv[0]);
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+	}
+	if (n_cmds == 0 || n_lines == 0 || n_rounds == 0) {
+		help(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	ctx = talloc_named_const(NULL, 0, "vty_config_bench");
+	vty_info.tall_ctx = ctx;
+	vty_init(&vty_info);
+
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	install_bench_cmds(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	printf("%-24s %10.1f ns per command\n", "installing commands",
+	       ts_diff_ns(&t_start, &t_end) / (n_cmds * _NUM_CMD_KINDS));
+
+	snprintf(path, sizeof(path), "vty_config_bench.%d.cfg", (int)getpid());
+	write_config(path);
+
+	/* the first read includes any setup done on the first lookup in a node */
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	OSMO_ASSERT(vty_read_config_file(path, NULL) == 0);
+	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	printf("%-24s %10.1f ns per line\n", "first read", ts_diff_ns(&t_start, &t_end) / n_lines);
+
+	ns = 0;
+	for (r = 0; r < n_rounds; r++) {
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		OSMO_ASSERT(vty_read_config_file(path, NULL) == 0);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+		ns += ts_diff_ns(&t_start, &t_end);
+	}
+	printf("%-24s %10.1f ns per line, %8.3f ms per file (%u commands, %u lines)\n", "read",
+	       ns / n_rounds / n_lines, ns / n_rounds / 1e6, n_cmds * _NUM_CMD_KINDS, n_lines);
+
+	OSMO_ASSERT(n_called == (unsigned long)n_lines * (n_rounds + 1));
+	unlink(path);
+	return EXIT_SUCCESS;
+}
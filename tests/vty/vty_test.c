@@ -480,6 +480,43 @@ DEFUN(cfg_range_baseboth, cfg_range_baseboth_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_trie_kw_a, cfg_trie_kw_a_cmd,
+	"trie-test keyword-a",
+	"testing the command trie\n"
+	"first keyword\n")
+{
+	printf("Called: 'trie-test keyword-a'\n");
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_trie_kw_b, cfg_trie_kw_b_cmd,
+	"trie-test keyword-b <0-10>",
+	"testing the command trie\n"
+	"second keyword\n"
+	"a number\n")
+{
+	printf("Called: 'trie-test keyword-b %s'\n", argv[0]);
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_trie_word, cfg_trie_word_cmd,
+	"trie-test WORD",
+	"testing the command trie\n"
+	"any word\n")
+{
+	printf("Called: 'trie-test WORD' with '%s'\n", argv[0]);
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_trie_kw_c, cfg_trie_kw_c_cmd,
+	"trie-test keyword-c",
+	"testing the command trie\n"
+	"third keyword, installed late\n")
+{
+	printf("Called: 'trie-test keyword-c'\n");
+	return CMD_SUCCESS;
+}
+
 void test_vty_add_cmds(void)
 {
 	install_element(CONFIG_NODE, &cfg_ret_warning_cmd);
@@ -509,6 +546,10 @@ void test_vty_add_cmds(void)
 	install_element_ve(&cfg_range_base10_cmd);
 	install_element_ve(&cfg_range_base16_cmd);
 	install_element_ve(&cfg_range_baseboth_cmd);
+
+	install_element_ve(&cfg_trie_kw_a_cmd);
+	install_element_ve(&cfg_trie_kw_b_cmd);
+	install_element_ve(&cfg_trie_word_cmd);
 }
 
 void test_is_cmd_ambiguous(void)
@@ -579,6 +620,60 @@ void test_ranges(void)
 
 	destroy_test_vty(&test, vty);
 }
+
+static void do_vty_complete(struct vty *vty, const char *cmd)
+{
+	char **matched;
+	vector vline;
+	int i, status;
+
+	printf("Going to complete '%s'\n", cmd);
+	vline = cmd_make_strvec(cmd);
+	matched = cmd_complete_command(vline, vty, &status);
+	cmd_free_strvec(vline);
+	printf("Returned: %d,", status);
+	for (i = 0; matched && matched[i]; i++) {
+		printf(" '%s'", matched[i]);
+		talloc_free(matched[i]);
+	}
+	printf("\n");
+	if (matched)
+		vector_only_index_free(matched);
+}
+
+void test_cmd_trie(void)
+{
+	struct vty *vty;
+	struct vty_test test;
+
+	printf("Going to test the command trie\n");
+	vty = create_test_vty(&test);
+
+	/* keywords next to an argument in the same position */
+	OSMO_ASSERT(do_vty_command(vty, "trie-test keyword-a") == CMD_SUCCESS);
+	OSMO_ASSERT(do_vty_command(vty, "trie-test keyword-b 7") == CMD_SUCCESS);
+	OSMO_ASSERT(do_vty_command(vty, "trie-test keyword-b 11") == CMD_ERR_NO_MATCH);
+	OSMO_ASSERT(do_vty_command(vty, "trie-test something") == CMD_SUCCESS);
+	OSMO_ASSERT(do_vty_command(vty, "trie-test keyword") == CMD_ERR_AMBIGUOUS);
+
+	/* abbreviated keywords */
+	OSMO_ASSERT(do_vty_command(vty, "trie keyword-a") == CMD_SUCCESS);
+	OSMO_ASSERT(do_vty_command(vty, "trie-test keyword-b") == CMD_ERR_INCOMPLETE);
+	OSMO_ASSERT(do_vty_command(vty, "range-base1 5") == CMD_ERR_AMBIGUOUS);
+	OSMO_ASSERT(do_vty_command(vty, "range-baseb 5") == CMD_SUCCESS);
+
+	do_vty_complete(vty, "trie-t");
+	do_vty_complete(vty, "trie-test keyword-");
+
+	/* a command installed after the first lookup in the node */
+	OSMO_ASSERT(do_vty_command(vty, "trie-test keyword-c") == CMD_SUCCESS);
+	install_element_ve(&cfg_trie_kw_c_cmd);
+	OSMO_ASSERT(do_vty_command(vty, "trie-test keyword-c") == CMD_SUCCESS);
+	do_vty_complete(vty, "trie-test keyword-");
+
+	destroy_test_vty(&test, vty);
+}
+
 /* Application specific attributes */
 enum vty_test_attr {
 	VTY_TEST_ATTR_FOO = 0,
@@ -669,6 +764,8 @@ int main(int argc, char **argv)
 	test_numeric_range();
 	test_ranges();
 
+	test_cmd_trie();
+
 	/* Leak check */
 	OSMO_ASSERT(talloc_total_blocks(stats_ctx) == 1);
 
@@ -0,0 +1,274 @@
+/*! \file osmo-log-decode.c
+ * Utility program to turn binary log files into text. */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+
+#include <osmocom/core/logging.h>
+#include <osmocom/core/logging_binary.h>
+
+struct dict {
+	const char **strs;
+	uint32_t num_strs;
+	const char **cats;
+	uint32_t num_cats;
+};
+
+static int print_tid = 0;
+static int print_utc = 0;
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-h] [-t] [-u] FILE\n", progname);
+	printf("Print the messages of a binary log file (see 'log binary') as text.\n");
+	printf("  -h --help     This text\n");
+	printf("  -t --tid      Print the thread id of each message\n");
+	printf("  -u --utc      Print timestamps in UTC instead of local time\n");
+}
+
+static uint8_t *read_file(const char *fname, size_t *len)
+{
+	uint8_t *buf;
+	FILE *f;
+	long size;
+
+	f = fopen(fname, "r");
+	if (!f)
+		return NULL;
+	if (fseek(f, 0, SEEK_END) < 0 || (size = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) < 0)
+		goto err;
+	buf = malloc(size);
+	if (!buf)
+		goto err;
+	if (fread(buf, 1, size, f) != size) {
+		free(buf);
+		goto err;
+	}
+	fclose(f);
+	*len = size;
+	return buf;
+
+err:
+	fclose(f);
+	return NULL;
+}
+
+static int check_hdr(const struct log_binary_hdr *hdr, size_t len)
+{
+	if (len < sizeof(*hdr) || memcmp(hdr->magic, LOG_BINARY_MAGIC, sizeof(hdr->magic)))
+		return -EINVAL;
+	if (hdr->byte_order != LOG_BINARY_BYTE_ORDER || hdr->version != LOG_BINARY_VERSION)
+		return -EPROTONOSUPPORT;
+	if (hdr->dict_off + hdr->dict_size > len || hdr->dict_used > hdr->dict_size ||
+	    hdr->ring_off + hdr->ring_size > len || (hdr->ring_size & (hdr->ring_size - 1)) ||
+	    hdr->tail > hdr->head || hdr->head - hdr->tail > hdr->ring_size)
+		return -EINVAL;
+	return 0;
+}
+
+static int load_dict(struct dict *dict, const uint8_t *map, const struct log_binary_hdr *hdr)
+{
+	const uint8_t *pos = map + hdr->dict_off, *end = pos + hdr->dict_used;
+	const struct log_binary_str *ent;
+	const char ***tbl;
+	uint32_t *num;
+	size_t len;
+
+	while (end - pos >= sizeof(*ent)) {
+		ent = (const struct log_binary_str *)pos;
+		len = (sizeof(*ent) + ent->len + 1 + 7) & ~7;
+		if (len > end - pos || ent->str[ent->len] != '\0')
+			return -EINVAL;
+		pos += len;
+
+		if (ent->kind == LOG_BINARY_STR_CAT) {
+			tbl = &dict->cats;
+			num = &dict->num_cats;
+		} else {
+			tbl = &dict->strs;
+			num = &dict->num_strs;
+		}
+		if (ent->id >= *num) {
+			uint32_t new_num = ent->id * 2 + 16;
+			const char **new_tbl = realloc(*tbl, new_num * sizeof(**tbl));
+			if (!new_tbl)
+				return -ENOMEM;
+			memset(&new_tbl[*num], 0, (new_num - *num) * sizeof(**tbl));
+			*tbl = new_tbl;
+			*num = new_num;
+		}
+		(*tbl)[ent->id] = ent->str;
+	}
+	return 0;
+}
+
+static const char *dict_str(const struct dict *dict, uint32_t id)
+{
+	if (id == LOG_BINARY_ID_NONE || id >= dict->num_strs)
+		return NULL;
+	return dict->strs[id];
+}
+
+static void print_rec(const struct dict *dict, const struct log_binary_rec *rec)
+{
+	char msg[4096], tbuf[32];
+	const char *fmt, *file, *cat, *p;
+	struct tm tm;
+	time_t t;
+
+	if (rec->fmt_id == LOG_BINARY_ID_NONE)
+		fmt = "%s";
+	else
+		fmt = dict_str(dict, rec->fmt_id);
+	if (!fmt) {
+		printf("<unknown format string %u>\n", rec->fmt_id);
+		return;
+	}
+	if (log_binary_render(msg, sizeof(msg), fmt, rec->args, rec->args_len) < 0) {
+		printf("<malformed record: %s>\n", fmt);
+		return;
+	}
+
+	/* a continuation only adds to the previous line */
+	if (rec->cont) {
+		fputs(msg, stdout);
+		return;
+	}
+
+	t = rec->time_us / 1000000;
+	if (print_utc)
+		gmtime_r(&t, &tm);
+	else
+		localtime_r(&t, &tm);
+	strftime(tbuf, sizeof(tbuf), "%Y%m%d%H%M%S", &tm);
+	printf("%s%03d ", tbuf, (int)((rec->time_us / 1000) % 1000));
+
+	if (print_tid)
+		printf("%u ", rec->tid);
+
+	cat = rec->subsys < dict->num_cats ? dict->cats[rec->subsys] : NULL;
+	if (cat)
+		printf("%s ", cat);
+	else
+		printf("<%04x> ", rec->subsys);
+	printf("%s ", log_level_str(rec->level));
+
+	file = dict_str(dict, rec->file_id);
+	if (file) {
+		p = strrchr(file, '/');
+		printf("%s:%u ", p ? p + 1 : file, rec->line);
+	}
+
+	fputs(msg, stdout);
+}
+
+int main(int argc, char **argv)
+{
+	const struct log_binary_hdr *hdr;
+	const struct log_binary_rec *rec;
+	const uint8_t *ring;
+	struct dict dict = {};
+	uint64_t pos, off;
+	uint8_t *map;
+	size_t len;
+	int rc;
+
+	while (1) {
+		int option_index = 0, c;
+		static const struct option long_options[] = {
+			{ "help", 0, 0, 'h' },
+			{ "tid", 0, 0, 't' },
+			{ "utc", 0, 0, 'u' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "htu", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 't':
+			print_tid = 1;
+			break;
+		case 'u':
+			print_utc = 1;
+			break;
+		case 'h':
+			help(argv[0]);
+			exit(0);
+		default:
+			help(argv[0]);
+			exit(2);
+		}
+	}
+
+	if (optind != argc - 1) {
+		help(argv[0]);
+		exit(2);
+	}
+
+	map = read_file(argv[optind], &len);
+	if (!map) {
+		fprintf(stderr, "Cannot read '%s': %s\n", argv[optind], strerror(errno));
+		exit(1);
+	}
+
+	hdr = (const struct log_binary_hdr *)map;
+	rc = check_hdr(hdr, len);
+	if (rc < 0) {
+		fprintf(stderr, "'%s' is not a binary log file this program can read: %s\n",
+			argv[optind], strerror(-rc));
+		exit(1);
+	}
+	if (load_dict(&dict, map, hdr) < 0) {
+		fprintf(stderr, "'%s': dictionary is corrupt\n", argv[optind]);
+		exit(1);
+	}
+
+	ring = map + hdr->ring_off;
+	for (pos = hdr->tail; pos < hdr->head; pos += rec->len) {
+		off = pos & (hdr->ring_size - 1);
+		rec = (const struct log_binary_rec *)&ring[off];
+		if (hdr->ring_size - off < sizeof(*rec) || rec->len == 0) {
+			/* skip the unused end of the ring */
+			pos += hdr->ring_size - off;
+			off = 0;
+			rec = (const struct log_binary_rec *)ring;
+			if (pos >= hdr->head)
+				break;
+		}
+		if (rec->len < sizeof(*rec) || rec->len > hdr->ring_size - off ||
+		    rec->args_len > rec->len - sizeof(*rec)) {
+			fprintf(stderr, "'%s': record at %" PRIu64 " is corrupt\n", argv[optind], pos);
+			exit(1);
+		}
+		print_rec(&dict, rec);
+	}
+
+	free(dict.cats);
+	free(dict.strs);
+	free(map);
+	return 0;
+}
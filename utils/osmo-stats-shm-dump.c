@@ -0,0 +1,215 @@
+/*! \file osmo-stats-shm-dump.c
+ * Utility program to print the values of a shared memory stats file. */
+/*
+ * All Rights Reserved
+ *
+ * SPDX-License-Identifier: GPL-2.0+
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <osmocom/core/stats_shm.h>
+
+struct shm_file {
+	const struct osmo_stats_shm_hdr *hdr;
+	size_t len;
+	int64_t *values;
+};
+
+static unsigned int interval_ms = 0;
+static int count = -1;
+static const char *filter = NULL;
+static int print_kind = 0;
+
+static void help(const char *progname)
+{
+	printf("Usage: %s [-h] [-k] [-f FILTER] [-i MSEC [-c COUNT]] FILE\n", progname);
+	printf("Print the counters and stat items of a shared memory stats file (see 'stats-shm file').\n");
+	printf("  -h --help             This text\n");
+	printf("  -k --kind             Print whether a value is a counter or a stat item\n");
+	printf("  -f --filter FILTER    Only print values whose name contains FILTER\n");
+	printf("  -i --interval MSEC    Print the values again every MSEC milliseconds\n");
+	printf("  -c --count COUNT      Print the values COUNT times with -i (default: until killed)\n");
+}
+
+static void unmap_file(struct shm_file *f)
+{
+	if (f->hdr)
+		munmap((void *)f->hdr, f->len);
+	free(f->values);
+	memset(f, 0, sizeof(*f));
+}
+
+static int map_file(struct shm_file *f, const char *fname)
+{
+	const struct osmo_stats_shm_hdr *hdr;
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(fname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -EINVAL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return -errno;
+
+	f->hdr = hdr = map;
+	f->len = st.st_size;
+	if (memcmp(hdr->magic, OSMO_STATS_SHM_MAGIC, sizeof(hdr->magic))
+	    || hdr->version != OSMO_STATS_SHM_VERSION || hdr->byte_order != OSMO_STATS_SHM_BYTE_ORDER
+	    || hdr->file_size > f->len
+	    || hdr->entries_off + (uint64_t)hdr->num_entries * sizeof(struct osmo_stats_shm_entry) > hdr->names_off
+	    || hdr->names_off + hdr->names_size > hdr->values_off
+	    || hdr->values_off + (uint64_t)hdr->num_entries * sizeof(int64_t) > hdr->file_size) {
+		unmap_file(f);
+		return -EINVAL;
+	}
+
+	f->values = calloc(hdr->num_entries ? : 1, sizeof(int64_t));
+	if (!f->values) {
+		unmap_file(f);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void print_values(const struct shm_file *f, int64_t time_us)
+{
+	const struct osmo_stats_shm_hdr *hdr = f->hdr;
+	const struct osmo_stats_shm_entry *entries;
+	const char *names;
+	time_t t = time_us / 1000000;
+	struct tm tm;
+	char buf[64];
+	uint32_t i;
+
+	entries = (const struct osmo_stats_shm_entry *)((const uint8_t *)hdr + hdr->entries_off);
+	names = (const char *)hdr + hdr->names_off;
+
+	localtime_r(&t, &tm);
+	strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+	printf("# pid %" PRIu32 ", %s.%06" PRId64 "\n", hdr->pid, buf, time_us % 1000000);
+
+	for (i = 0; i < hdr->num_entries; i++) {
+		const char *name = names + entries[i].name_off;
+
+		if (entries[i].name_off + entries[i].name_len >= hdr->names_size)
+			continue;
+		if (filter && !strstr(name, filter))
+			continue;
+		if (print_kind)
+			printf("%s ", entries[i].kind == OSMO_STATS_SHM_RATE_CTR ? "ctr " : "item");
+		printf("%s %" PRId64 "\n", name, f->values[i]);
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	struct shm_file f = {};
+	const char *fname;
+	int64_t time_us;
+	int n, rc;
+
+	while (1) {
+		int option_index = 0, c;
+		static const struct option long_options[] = {
+			{ "help", 0, 0, 'h' },
+			{ "kind", 0, 0, 'k' },
+			{ "filter", 1, 0, 'f' },
+			{ "interval", 1, 0, 'i' },
+			{ "count", 1, 0, 'c' },
+			{ 0, 0, 0, 0 }
+		};
+
+		c = getopt_long(argc, argv, "hkf:i:c:", long_options, &option_index);
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			help(argv[0]);
+			exit(0);
+		case 'k':
+			print_kind = 1;
+			break;
+		case 'f':
+			filter = optarg;
+			break;
+		case 'i':
+			interval_ms = atoi(optarg);
+			break;
+		case 'c':
+			count = atoi(optarg);
+			break;
+		default:
+			help(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (optind >= argc) {
+		help(argv[0]);
+		exit(1);
+	}
+	fname = argv[optind];
+	if (count < 0)
+		count = interval_ms ? 0 : 1;
+
+	for (n = 0; !count || n < count; n++) {
+		if (n > 0) {
+			struct timespec ts = { .tv_sec = interval_ms / 1000, .tv_nsec = (interval_ms % 1000) * 1000000 };
+			nanosleep(&ts, NULL);
+		}
+
+		do {
+			if (!f.hdr) {
+				rc = map_file(&f, fname);
+				if (rc < 0) {
+					fprintf(stderr, "Cannot map '%s': %s\n", fname, strerror(-rc));
+					exit(1);
+				}
+			}
+			rc = osmo_stats_shm_read_values(f.hdr, f.values, &time_us);
+			if (rc == -ESTALE)
+				unmap_file(&f);
+		} while (rc == -ESTALE);
+
+		if (rc < 0) {
+			fprintf(stderr, "Cannot read '%s': %s\n", fname, strerror(-rc));
+			exit(1);
+		}
+		print_values(&f, time_us);
+	}
+
+	unmap_file(&f);
+	return 0;
+}